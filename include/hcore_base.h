@@ -132,6 +132,8 @@ hcore_int_t hcore_get_slab_exact_shift(void);
 #define hcore_cpu_pause()   __asm__("pause")
 #define hcore_sched_yield() sched_yield()
 
+#define HCORE_CACHELINE_SIZE 64
+
 #define HCORE_SMP_LOCK "lock;"
 
 
@@ -24,6 +24,13 @@ struct hcore_buf_s
 
     hcore_uchar_t *start; /* start of buffer */
     hcore_uchar_t *end;   /* end of buffer */
+
+    off_t file_pos;  /* start of data in file */
+    off_t file_last; /* end of data in file */
+    int   fd;        /* fd of file or pipe */
+
+    hcore_uint_t in_file : 1; /* data is '[file_pos, file_last)' of 'fd' */
+    hcore_uint_t in_pipe : 1; /* 'fd' is a pipe, file offsets count data only */
 };
 
 struct hcore_chain_s
@@ -36,6 +43,8 @@ struct hcore_chain_s
 
 #define hcore_buf_get_freesize(b) ((b)->end - (b)->last)
 #define hcore_buf_get_size(b)     ((b)->last - (b)->pos)
+#define hcore_buf_get_file_size(b) ((b)->file_last - (b)->file_pos)
+#define hcore_buf_in_memory(b)     (!(b)->in_file)
 
 hcore_chain_t *hcore_alloc_chain(hcore_pool_t *pool);
 void         hcore_free_chain(hcore_pool_t *pool, hcore_chain_t *cl);
@@ -43,4 +52,19 @@ hcore_chain_t *hcore_alloc_chain_with_buf(hcore_pool_t *pool);
 void         hcore_free_chain_hold_buf(hcore_pool_t *pool, hcore_chain_t *cl);
 hcore_buf_t *  hcore_alloc_buf(hcore_pool_t *pool, size_t size);
 
+/**
+ * @brief  allocate a buffer of data in file, the file isn't read into memory
+ * @note   the fd isn't closed with the buffer. For a pipe, 'offset' is ignored
+ * * and 'size' is the size of data to be spliced from it.
+ * @param  *pool: pool
+ * @param  fd: fd of file or pipe
+ * @param  offset: start of data in file
+ * @param  size: size of data
+ * @param  pipe: 1 if 'fd' is a pipe
+ * @retval
+ * Upon successful return a buffer, otherwise return NULL
+ */
+hcore_buf_t *hcore_alloc_file_buf(hcore_pool_t *pool, int fd, off_t offset,
+                                  off_t size, hcore_uint_t pipe);
+
 #endif // !_HCORE_BUF_H_INCLUDED_
@@ -17,13 +17,32 @@
 #include <hcore_buf.h>
 #include <hcore_connection.h>
 #include <hcore_event.h>
+#include <hcore_inet.h>
 #include <hcore_log.h>
 #include <hcore_pool.h>
 #include <hcore_string.h>
 
 #define HCORE_CHAIN_ERROR (hcore_chain_t *)HCORE_ERROR
 
-typedef struct hcore_connection_s hcore_connection_t;
+// policy of flushing for tcp
+#define HCORE_TCP_FLUSH_IMMEDIATE 0 // send data as soon as possible
+#define HCORE_TCP_FLUSH_CORK      1 // TCP_CORK until hcore_connection_flush()
+#define HCORE_TCP_FLUSH_MORE      2 // MSG_MORE until hcore_connection_flush()
+
+// max number of messages are handled by one syscall of udp batch
+#define HCORE_UDP_BATCH_MAX 64
+
+// limits of kernel for a send with UDP_SEGMENT
+#define HCORE_UDP_GSO_MAX_SEGMENTS 64
+#define HCORE_UDP_GSO_MAX_SIZE     (65535 - 40 - 8)
+
+typedef struct
+{
+    hcore_buf_t     *buf;      // buffer of message
+    hcore_sockaddr_t sockaddr; // peer of message
+    socklen_t        socklen;  // length of sockaddr, 0 is unknown
+    size_t           segment;  // size of datagram if coalesced by GRO, or 0
+} hcore_udp_msg_t;
 
 typedef ssize_t (*hcore_send_pt)(hcore_connection_t *c, hcore_uchar_t *buf,
                                  size_t size);
@@ -34,6 +53,64 @@ typedef ssize_t (*hcore_recv_pt)(hcore_connection_t *c, hcore_uchar_t *buf,
 typedef hcore_chain_t *(*hcore_send_chain_pt)(hcore_connection_t *c,
                                               hcore_chain_t      *out);
 
+typedef struct hcore_zerocopy_s  hcore_zerocopy_t;
+typedef struct hcore_listening_s hcore_listening_t;
+
+typedef void (*hcore_connection_handler_pt)(hcore_connection_t *c);
+
+typedef struct
+{
+    hcore_connection_t *connections;  // slots of connection
+    hcore_event_t      *read_events;  // read events of slots
+    hcore_event_t      *write_events; // write events of slots
+    hcore_connection_t *free;         // free slots, linked by 'data'
+    size_t              pool_size;    // size of pool of connection
+    hcore_log_t        *log;          // log of table
+
+    hcore_uint_t size;       // number of slots
+    hcore_uint_t nfree;      // number of free slots
+    hcore_uint_t high_water; // max number of used slots ever
+    hcore_uint_t nfailed;    // times of no free slot
+} hcore_connection_table_t;
+
+#define hcore_connection_table_used(t) ((t)->size - (t)->nfree)
+
+#define HCORE_LISTEN_BACKLOG        511
+#define HCORE_ACCEPT_BUDGET_DEFAULT 64
+#define HCORE_ACCEPT_DELAY_DEFAULT  500 // milliseconds
+
+struct hcore_listening_s
+{
+    int              fd;       // fd of listening
+    hcore_sockaddr_t sockaddr; // address of listening
+    socklen_t        socklen;  // length of sockaddr
+    int              backlog;  // backlog of listen()
+
+    hcore_uint_t accept_budget; // max accepts per event, 0 is unlimited
+    hcore_msec_t accept_delay;  // pause of accepting if fds are exhausted
+    hcore_uint_t defer_accept;  // seconds of TCP_DEFER_ACCEPT, 0 is disabled
+
+    hcore_connection_handler_pt handler; // handle the accepted connection
+    hcore_connection_table_t   *table;   // get connections from it if set
+    hcore_connection_t         *connection; // connection of listening fd
+    hcore_event_loop_t         *loop;       // loop of accepting, see below
+    hcore_log_t                *log;        // log of accepted connections
+    void                       *data;       // private data
+
+    hcore_uint_t naccepted; // number of accepted connections
+
+    hcore_uint_t reuseport : 1; // SO_REUSEPORT, one listening per worker
+};
+
+// sent links of chain wait for completion of MSG_ZEROCOPY send
+struct hcore_zerocopy_s
+{
+    hcore_uint32_t    seq;   // the last zerocopy send which covered the links
+    hcore_chain_t    *chain; // links to be released
+    hcore_chain_t   **last;  // last of 'chain'
+    hcore_zerocopy_t *next;
+};
+
 struct hcore_connection_s
 {
     int              fd;        // fd of the connection
@@ -56,20 +133,133 @@ struct hcore_connection_s
 
     void *data; // private data
 
+    hcore_listening_t *listening; // listening which accepted it
+
     off_t sent_size; // counted the number of sent byte
     off_t recv_size; // counted the number of received byte
 
+    /* for MSG_ZEROCOPY */
+    size_t            zerocopy;     // threshold of size, 0 is disabled
+    hcore_uint32_t    zc_seq;       // sequence of next zerocopy send
+    hcore_uint32_t    zc_done;      // sends before it were completed
+    hcore_zerocopy_t *zc_busy;      // links wait for completion
+    hcore_zerocopy_t *zc_busy_last; // last of 'zc_busy'
+    hcore_zerocopy_t *zc_free;      // free nodes of 'zc_busy'
+
     hcore_uint_t shared  : 1; // to indicate shared fd
     hcore_uint_t pipe    : 1; // is pipe
     hcore_uint_t closed  : 1; // the connection was closed by client
     hcore_uint_t timeout : 1; // timeout for reading or writing
     hcore_uint_t error   : 1; // has a error occur
 
+    /* for tcp */
+    hcore_uint_t flush  : 2; // policy of flushing, see HCORE_TCP_FLUSH_*
+    hcore_uint_t corked : 1; // TCP_CORK is set
+
     /* for udp */
     hcore_uint_t known     : 1; // refuse to receive message from unknown client
     hcore_uint_t bind_peer : 1; // bind peer
+    hcore_uint_t udp_gso   : 1; // coalesce datagrams to send by UDP_SEGMENT
+    hcore_uint_t udp_gro   : 1; // datagrams are received coalesced by UDP_GRO
 };
 
+/**
+ * @brief  create a table of connections, the connections and their events
+ * * are allocated in contiguous arrays at once
+ * @param  *pool: pool of table
+ * @param  size: number of connections
+ * @param  pool_size: size of pool of connection, 0 is HCORE_POOL_SIZE_DEFAULT
+ * @retval
+ * Upon successful return a table, otherwise return NULL
+ */
+hcore_connection_table_t *hcore_create_connection_table(hcore_pool_t *pool,
+                                                        hcore_uint_t  size,
+                                                        size_t pool_size);
+
+/**
+ * @brief  get a free connection from table in O(1)
+ * @note   the connection is same as 'hcore_create_connection()', except that
+ * * 'c->log' is 'log' itself. The 'instance' of its events is toggled, so
+ * * the stale events of previous user are ignored by event loop.
+ * @param  *table: table of connections
+ * @param  fd: fd of the connection
+ * @param  *log: log of the connection
+ * @retval
+ * Upon successful return a connection, return NULL if no free connection
+ */
+hcore_connection_t *hcore_get_connection(hcore_connection_table_t *table,
+                                         int fd, hcore_log_t *log);
+
+/**
+ * @brief  put a connection back to table in O(1), its fd is closed unless
+ * * it is shared and its pool is destroyed
+ * @note   the events and timers of connection must be deleted before
+ * @param  *table: table of connections
+ * @param  *c: connection
+ * @retval None
+ */
+void hcore_put_connection(hcore_connection_table_t *table,
+                          hcore_connection_t       *c);
+
+/**
+ * @brief  create a connection with its own pool and events
+ * @note   'rev->data' and 'wev->data' point to the connection, so the
+ * * events can be added to 'hcore_event_loop_t' directly
+ * @param  *log: log, it is copied to the pool of connection
+ * @param  fd: fd of the connection
+ * @retval
+ * Upon successful return a connection, otherwise return NULL
+ */
+hcore_connection_t *hcore_create_connection(hcore_log_t *log, int fd);
+
+/**
+ * @brief  destroy a connection, its fd is closed unless it is shared
+ * @note   the events of connection must be deleted from event loop before
+ * @param  *c: connection
+ * @retval None
+ */
+void hcore_destroy_connection(hcore_connection_t *c);
+
+/**
+ * @brief  create a listening with default settings, it isn't opened
+ * @param  *pool: pool
+ * @param  *sockaddr: address to listen
+ * @param  socklen: length of sockaddr
+ * @retval
+ * Upon successful return a listening, otherwise return NULL
+ */
+hcore_listening_t *hcore_create_listening(hcore_pool_t    *pool,
+                                          struct sockaddr *sockaddr,
+                                          socklen_t        socklen);
+
+/**
+ * @brief  open the socket of listening, the caller adds 'ls->connection->rev'
+ * * to 'ls->loop' as a level-triggered read event to accept connections
+ * @note
+ * 1. connections are accepted by accept4() in a loop until it's not ready or
+ * * 'accept_budget' is reached, the rest is left to next event.
+ * 2. the accepted connection is non-blocking, 'c->sockaddr' is the peer and
+ * * 'c->listening' is 'ls', then it's passed to 'ls->handler'.
+ * 3. with 'reuseport', open a listening of same address per worker, the
+ * * kernel balances connections between them.
+ * 4. if fds are exhausted (EMFILE, ENFILE), the read event is deleted from
+ * * 'ls->loop' and added again after 'accept_delay', so the level-triggered
+ * * event doesn't spin. 'ls->loop' must be set if the event is added.
+ * @param  *ls: listening, 'handler' must be set
+ * @retval
+ * Upon successful return HCORE_OK, otherwise return HCORE_ERROR
+ */
+hcore_int_t hcore_open_listening(hcore_listening_t *ls);
+
+/**
+ * @brief  close the socket of listening
+ * @note   the event of listening must be deleted before, the timer of paused
+ * * accepting is deleted by it
+ * @param  *ls: listening
+ * @retval None
+ */
+void hcore_close_listening(hcore_listening_t *ls);
+
 /**
  * @brief  send 'buf' on udp
  * @note
@@ -102,6 +292,82 @@ ssize_t hcore_udp_send(struct hcore_connection_s *c, hcore_uchar_t *buf,
 ssize_t hcore_udp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf,
                        size_t size);
 
+/**
+ * @brief  Enable UDP_SEGMENT (GSO) for 'hcore_udp_send_batch()'
+ * @note   it's disabled automatically if the device can't offload it
+ * @param  *c: connection
+ * @retval
+ * Upon successful return HCORE_OK, return HCORE_ERROR if the kernel doesn't
+ * * support it
+ */
+hcore_int_t hcore_udp_enable_gso(hcore_connection_t *c);
+
+/**
+ * @brief  Enable UDP_GRO for 'hcore_udp_recv_batch()'
+ * @note   the buffers of messages should be large enough for a coalesced
+ * * message (up to 64KB), and 'hcore_udp_split_msg()' splits it to datagrams.
+ * * 'hcore_udp_recv()' can't tell the boundary of datagrams, don't use it.
+ * @param  *c: connection
+ * @retval
+ * Upon successful return HCORE_OK, otherwise return HCORE_ERROR
+ */
+hcore_int_t hcore_udp_enable_gro(hcore_connection_t *c);
+
+/**
+ * @brief  Split a received message to views of its datagrams without copying
+ * @note   the views point to the memory of 'msg->buf'
+ * @param  *msg: message
+ * @param  *views: views of datagram
+ * @param  n: number of views
+ * @retval
+ * return number of filled views, it's 1 if the message isn't coalesced
+ */
+hcore_uint_t hcore_udp_split_msg(hcore_udp_msg_t *msg, hcore_buf_t *views,
+                                 hcore_uint_t n);
+
+/**
+ * @brief  Send a batch of messages on udp by one syscall
+ * @note
+ * 1. the data of message is '[buf->pos, buf->last)', 'buf->pos' is moved to
+ * * 'buf->last' if it was sent.
+ * 2. the message is sent to 'msg->sockaddr' if 'msg->socklen' isn't 0,
+ * * otherwise to 'c->sockaddr'.
+ * 3. if 'c->udp_gso' is set, successive messages to the same peer with same
+ * * size (the last may be shorter) are coalesced into one UDP_SEGMENT send.
+ * @param  *c: connection
+ * @param  *msgs: messages
+ * @param  n: number of messages, at most HCORE_UDP_BATCH_MAX are handled
+ * @retval
+ * Upon successful return number of sent messages, it's less than 'n' and
+ * * c->wev->ready will be set 0 if connection is no ready. Return HCORE_AGAIN
+ * * if nothing was sent. Otherwise return HCORE_ERROR and c->wev->error will
+ * * be set 1
+ */
+ssize_t hcore_udp_send_batch(hcore_connection_t *c, hcore_udp_msg_t *msgs,
+                             hcore_uint_t n);
+
+/**
+ * @brief  Receive a batch of messages on udp by one syscall
+ * @note
+ * 1. the data is received into '[buf->last, buf->end)' and 'buf->last' is
+ * * moved forward, 'msg->sockaddr' and 'msg->socklen' are filled with peer.
+ * 2. 'c->known' and 'c->bind_peer' are same as 'hcore_udp_recv()'. The dropped
+ * * messages are moved behind the received ones, so 'msgs' is still a
+ * * permutation of the buffers of caller.
+ * 3. if 'c->udp_gro' is set, 'msg->segment' is set to the size of datagram
+ * * for a coalesced message.
+ * @param  *c: connection
+ * @param  *msgs: messages
+ * @param  n: number of messages, at most HCORE_UDP_BATCH_MAX are handled
+ * @retval
+ * Upon successful return number of received messages, they are
+ * * 'msgs[0, ret)'. Return HCORE_AGAIN and c->rev->ready will be set 0 if
+ * * connection is no ready. Otherwise return HCORE_ERROR and c->rev->error
+ * * will be set 1
+ */
+ssize_t hcore_udp_recv_batch(hcore_connection_t *c, hcore_udp_msg_t *msgs,
+                             hcore_uint_t n);
+
 /**
  * @brief  send 'buf' on tcp
  * @note
@@ -132,8 +398,66 @@ ssize_t hcore_tcp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf,
                        size_t size);
 
 /**
- * @brief  send 'out' on tcp
+ * @brief  Receive data to the free space of 'in' chain on tcp by one readv
+ * @note   '[last, end)' of buffers are filled in order and 'last' is moved
+ * * forward, the full buffers are skipped
+ * @param  *c: connection
+ * @param  *in: buffer chain, it should have free space
+ * @param  *nbufs: return number of touched buffers, it can be NULL
+ * @retval
+ * Upon successful return size of received. Return 0 and c->rev->eof will be
+ * * set 1 if peer closed. Return HCORE_AGAIN and c->rev->ready will be set 0
+ * * if connection is no ready. Otherwise return HCORE_ERROR (encounter a
+ * * error) and c->rev->error will be set 1
+ */
+ssize_t hcore_tcp_recv_chain(hcore_connection_t *c, hcore_chain_t *in,
+                             hcore_uint_t *nbufs);
+
+/**
+ * @brief  Push the data held by the policy of 'c->flush' out
+ * @note   with HCORE_TCP_FLUSH_CORK or HCORE_TCP_FLUSH_MORE, the data of
+ * * 'hcore_tcp_send()' and 'hcore_tcp_send_chain()' is held by kernel to fill
+ * * full-sized segments, call it once a message is completed. The connection
+ * * is corked again by the next send.
+ * @param  *c: connection
+ * @retval
+ * Upon successful return HCORE_OK, otherwise return HCORE_ERROR
+ */
+hcore_int_t hcore_connection_flush(hcore_connection_t *c);
+
+/**
+ * @brief  Enable MSG_ZEROCOPY for 'hcore_tcp_send_chain()'
  * @note
+ * 1. a batch of memory buffers is sent with MSG_ZEROCOPY if its size is
+ * * 'threshold' at least, otherwise it's copied as usual.
+ * 2. the links of chain are owned by connection once they have been sent
+ * * completely: they are released by 'hcore_free_chain(c->pool, cl)' (so
+ * * 'cl->free' is called) after the kernel confirms completion. So the
+ * * links must be allocated from 'c->pool' and mustn't be touched by caller.
+ * @param  *c: connection
+ * @param  threshold: threshold of size, it must be greater than 0
+ * @retval
+ * Upon successful return HCORE_OK, otherwise return HCORE_ERROR
+ */
+hcore_int_t hcore_tcp_enable_zerocopy(hcore_connection_t *c, size_t threshold);
+
+/**
+ * @brief  Read completions of MSG_ZEROCOPY from error queue of socket and
+ * * release the links which were completed
+ * @note   it's called by 'hcore_tcp_send_chain()', call it in the handler of
+ * * events if nothing is sent any more
+ * @param  *c: connection
+ * @retval
+ * Upon successful return HCORE_OK, otherwise return HCORE_ERROR
+ */
+hcore_int_t hcore_tcp_reap_zerocopy(hcore_connection_t *c);
+
+/**
+ * @brief  send 'out' on tcp
+ * @note   memory buffers are sent by writev, file buffers are sent by
+ * * sendfile (or splice if 'in_pipe'). The 'pos' or 'file_pos' of sent
+ * * buffers are moved forward. See 'hcore_tcp_enable_zerocopy()' for
+ * * zerocopy mode.
  * @param  *c: connection
  * @param  *out: buffer chain
  * @retval
@@ -0,0 +1,195 @@
+/**
+ * @file hcore_coroutine.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief stackful coroutines driven by the event loop, the I/O of connection
+ * is written in sequential style and the coroutine yields on HCORE_AGAIN
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ * co: coroutine
+ * sched: scheduler
+ */
+
+#ifndef _HCORE_COROUTINE_H_INCLUDED_
+#define _HCORE_COROUTINE_H_INCLUDED_
+
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_pool.h>
+#include <hcore_types.h>
+
+#define HCORE_CO_STACK_SIZE_DEFAULT (64 * 1024)
+#define HCORE_CO_SLAB_SIZE          64 // stacks are mapped in slabs of it
+
+typedef struct hcore_co_s       hcore_co_t;
+typedef struct hcore_co_sched_s hcore_co_sched_t;
+typedef struct hcore_co_slab_s  hcore_co_slab_t;
+
+typedef void (*hcore_co_handler_pt)(hcore_co_t *co);
+
+/**
+ * @brief a coroutine, it's placed at the top of its stack, so it's released
+ * with the stack after 'handler' returns
+ */
+struct hcore_co_s
+{
+    void *sp; // saved stack pointer, see hcore_co_switch()
+
+    hcore_co_sched_t   *sched;   // scheduler of coroutine
+    hcore_co_t         *caller;  // context to switch to on yield
+    hcore_co_handler_pt handler; // body of coroutine
+    void               *data;    // data of 'handler'
+
+    hcore_msec_t timeout; // timeout of I/O in milliseconds, 0 is infinite
+
+    hcore_co_t *next; // link of free list
+
+    hcore_uint_t done : 1; // 'handler' returned
+};
+
+struct hcore_co_slab_s
+{
+    void            *addr; // mapping of stacks
+    size_t           size; // size of mapping
+    hcore_co_slab_t *next;
+};
+
+struct hcore_co_sched_s
+{
+    hcore_event_loop_t *loop;
+    hcore_log_t        *log;
+
+    hcore_co_t main; // context of the thread which runs the loop, no stack
+
+    size_t       stack_size; // usable size of each stack
+    hcore_uint_t max;        // max number of coroutines, 0 is unlimited
+
+    hcore_co_t      *free;  // finished coroutines, their stacks are reused
+    hcore_co_slab_t *slabs; // mapped stacks
+
+    /* statistics */
+    hcore_uint_t ncos;      // number of alive coroutines
+    hcore_uint_t nstacks;   // number of mapped stacks
+    hcore_uint_t nswitches; // number of context switches
+
+    hcore_uint_t guard : 1; // stacks are protected by guard pages, default 1
+};
+
+/**
+ * @brief create a scheduler of coroutines for an event loop
+ *
+ * @note
+ * 1. stacks are mapped with MAP_NORESERVE in slabs of HCORE_CO_SLAB_SIZE, so
+ * only the touched pages of a stack consume memory. The budget of virtual
+ * memory is 'max * (stack_size + guard page)'.
+ * 2. each guard page splits the mapping, so a stack costs two entries of
+ * 'vm.max_map_count'. Set 'sched->guard = 0' before the first coroutine to
+ * run more than about 30000 coroutines without raising it.
+ * 3. the scheduler must be used by the thread which runs 'loop' only.
+ *
+ * @param loop event loop, the scheduler is allocated from 'loop->pool'
+ * @param stack_size size of each stack, it's rounded up to page size, 0
+ * means HCORE_CO_STACK_SIZE_DEFAULT
+ * @param max max number of alive coroutines, 0 means unlimited
+ *
+ * @return hcore_co_sched_t* : Upon successful is return a scheduler,
+ * otherwise return NULL
+ */
+hcore_co_sched_t *hcore_create_co_sched(hcore_event_loop_t *loop,
+                                        size_t stack_size, hcore_uint_t max);
+
+/**
+ * @brief unmap all stacks of scheduler
+ *
+ * @note the coroutines which didn't finish are dropped without unwinding,
+ * their connections should be closed before.
+ *
+ * @param sched scheduler
+ */
+void hcore_destroy_co_sched(hcore_co_sched_t *sched);
+
+/**
+ * @brief create a coroutine and run it until it yields or finishes
+ *
+ * @param sched scheduler
+ * @param handler body of coroutine
+ * @param data data of 'handler'
+ *
+ * @return hcore_co_t* : the coroutine, it's invalid if 'handler' has
+ * returned. Return NULL if 'max' is reached or no memory
+ */
+hcore_co_t *hcore_co_spawn(hcore_co_sched_t *sched, hcore_co_handler_pt handler,
+                           void *data);
+
+/**
+ * @brief switch to a suspended coroutine, it returns when the coroutine
+ * yields or finishes
+ *
+ * @param co coroutine
+ */
+void hcore_co_resume(hcore_co_t *co);
+
+/**
+ * @brief suspend the current coroutine and switch back to its caller
+ *
+ * @note it mustn't be called out of coroutines.
+ */
+void hcore_co_yield(void);
+
+/**
+ * @brief get the coroutine running in the current thread
+ *
+ * @return hcore_co_t* : NULL if no coroutine is running
+ */
+hcore_co_t *hcore_co_self(void);
+
+/**
+ * @brief suspend the current coroutine until the event is triggered
+ *
+ * @note the read and write events of connection are added to the loop in
+ * edge-triggered mode by the first wait, and they are left in the loop.
+ * They must be deleted by 'hcore_event_del_conn()' before closing. The
+ * handlers of both events are replaced.
+ *
+ * @param ev 'c->rev' or 'c->wev'
+ * @param timer timeout in milliseconds, 0 is infinite
+ *
+ * @return hcore_int_t : HCORE_OK if the event is ready, HCORE_ERROR on
+ * timeout ('c->timeout' is set) or failure
+ */
+hcore_int_t hcore_co_wait(hcore_event_t *ev, hcore_msec_t timer);
+
+/**
+ * @brief receive data on tcp in the current coroutine, it yields until some
+ * data is received
+ *
+ * @note the wait is bounded by 'co->timeout'.
+ *
+ * @param c connection
+ * @param buf buffer
+ * @param size size of buffer
+ *
+ * @return ssize_t : size of received. Return 0 if peer closed, otherwise
+ * return HCORE_ERROR
+ */
+ssize_t hcore_co_recv(hcore_connection_t *c, hcore_uchar_t *buf, size_t size);
+
+/**
+ * @brief send all data on tcp in the current coroutine, it yields until all
+ * data is sent
+ *
+ * @note the wait is bounded by 'co->timeout'.
+ *
+ * @param c connection
+ * @param buf data
+ * @param size size of data
+ *
+ * @return ssize_t : 'size' on success, otherwise return HCORE_ERROR
+ */
+ssize_t hcore_co_send(hcore_connection_t *c, hcore_uchar_t *buf, size_t size);
+
+#endif // !_HCORE_COROUTINE_H_INCLUDED_
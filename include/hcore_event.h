@@ -17,13 +17,19 @@
 #include <hcore_array.h>
 #include <hcore_constant.h>
 #include <hcore_log.h>
+#include <hcore_queue.h>
 #include <hcore_rbtree.h>
 #include <hcore_types.h>
 
 #include <signal.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/time.h>
 
+#define HCORE_EVENT_NEVENTS_DEFAULT 512
+
+#define HCORE_TIMER_INFINITE (hcore_msec_t)-1
+
 /* type of event */
 
 #define HCORE_EVENT_READ  0x01
@@ -37,8 +43,19 @@
  */
 #define HCORE_CLOSE_EVENT 0x01
 
+/**
+ * @brief 事件以边缘触发（EPOLLET）的方式添加，处理函数必须把描述符读写到
+ ** HCORE_AGAIN 为止，否则不会再被通知。
+ */
+#define HCORE_CLEAR_EVENT 0x02
+
 typedef int (*hcore_event_get_debug_id_pt)(void *data);
-typedef struct hcore_event_s hcore_event_t;
+typedef struct hcore_event_s             hcore_event_t;
+typedef struct hcore_event_loop_s        hcore_event_loop_t;
+typedef struct hcore_event_timer_wheel_s hcore_event_timer_wheel_t;
+typedef struct hcore_uring_s             hcore_uring_t;
+typedef struct hcore_uring_op_s          hcore_uring_op_t;
+typedef struct hcore_co_s                hcore_co_t;
 
 typedef void (*hcore_event_handler_pt)(struct hcore_event_s *event);
 
@@ -48,7 +65,17 @@ struct hcore_event_s
     hcore_log_t           *log;     // log
     void                  *data;    // data of 'handler'
 
-    hcore_rbtree_node_t timer; // timer of event
+    hcore_rbtree_node_t timer;       // timer of event
+    hcore_queue_t       timer_queue; // link of timer wheel, 'timer.key' is
+                                     // still the deadline
+
+    /* for io_uring, see hcore_uring.h */
+    hcore_uring_op_t *op;     // operation in flight
+    ssize_t           result; // result of the completed operation
+    hcore_uint_t      buf_id; // id of provided buffer if 'buffer' is set
+
+    /* for coroutine, see hcore_coroutine.h */
+    hcore_co_t *co; // coroutine waiting for the event
 
     /* for debug */
     hcore_event_get_debug_id_pt get_id;
@@ -63,9 +90,31 @@ struct hcore_event_s
     hcore_uint_t timeout    : 1; // timeout for timer
     hcore_uint_t eof        : 1;
     hcore_uint_t cancelable : 1; // don't wait to close at exiting
+    hcore_uint_t buffer     : 1; // data is in the provided buffer 'buf_id'
 
     /* private status */
-    hcore_uint_t deleted : 1;
+    hcore_uint_t deleted  : 1;
+    hcore_uint_t instance : 1; // toggled on reusing to detect stale events
+};
+
+struct hcore_event_loop_s
+{
+    int                 ep;         // fd of epoll
+    struct epoll_event *event_list; // buffer of 'epoll_wait()'
+    hcore_uint_t        nevents;    // capacity of 'event_list'
+
+    hcore_rbtree_t      timer;          // timers of events, key is deadline
+    hcore_rbtree_node_t timer_sentinel; // sentinel of 'timer'
+    hcore_msec_t        current_msec;   // cached monotonic time
+
+    /* timers are hold by the wheel instead of 'timer' if it isn't NULL */
+    hcore_event_timer_wheel_t *timer_wheel;
+
+    /* operations are submitted to it if it isn't NULL */
+    hcore_uring_t *uring;
+
+    hcore_pool_t *pool;
+    hcore_log_t  *log;
 };
 
 /**
@@ -76,4 +125,95 @@ struct hcore_event_s
 #define hcore_event_flag_assert(flag) \
     hcore_assert((flag) & (HCORE_EVENT_READ | HCORE_EVENT_WRITE))
 
+/**
+ * @brief create a event loop that is backed by epoll
+ *
+ * @param pool pool that the loop is allocated from, and 'pool->log' is used
+ * as log of the loop
+ * @param nevents max number of events that is returned by one 'epoll_wait()',
+ * 0 means HCORE_EVENT_NEVENTS_DEFAULT
+ *
+ * @return hcore_event_loop_t* : Upon successful is return a loop, otherwise
+ * return NULL
+ */
+hcore_event_loop_t *hcore_create_event_loop(hcore_pool_t *pool,
+                                            hcore_uint_t  nevents);
+
+/**
+ * @brief destroy a event loop, the memory of loop is belong to pool, so only
+ * the epoll fd is closed
+ *
+ * @param loop event loop
+ */
+void hcore_destroy_event_loop(hcore_event_loop_t *loop);
+
+/**
+ * @brief add a read or write event of connection to the loop
+ *
+ * @note 'ev->data' must point to a 'hcore_connection_t'. If the opposite event
+ * of the connection is active, the registration will be modified rather than
+ * added.
+ *
+ * @param loop event loop
+ * @param ev 'c->rev' or 'c->wev'
+ * @param event HCORE_EVENT_READ or HCORE_EVENT_WRITE
+ * @param flags 0 or HCORE_CLEAR_EVENT
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_add(hcore_event_loop_t *loop, hcore_event_t *ev,
+                            hcore_uint_t event, hcore_uint_t flags);
+
+/**
+ * @brief delete a read or write event of connection from the loop
+ *
+ * @param loop event loop
+ * @param ev 'c->rev' or 'c->wev'
+ * @param event HCORE_EVENT_READ or HCORE_EVENT_WRITE
+ * @param flags HCORE_CLOSE_EVENT if the fd will be closed at once, so that
+ * 'epoll_ctl()' can be skipped
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_del(hcore_event_loop_t *loop, hcore_event_t *ev,
+                            hcore_uint_t event, hcore_uint_t flags);
+
+/**
+ * @brief add both read and write event of connection to the loop in
+ * edge-triggered mode with only one 'epoll_ctl()'
+ *
+ * @param loop event loop
+ * @param c connection
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_add_conn(hcore_event_loop_t *loop,
+                                 hcore_connection_t *c);
+
+/**
+ * @brief delete both read and write event of connection from the loop
+ *
+ * @param loop event loop
+ * @param c connection
+ * @param flags HCORE_CLOSE_EVENT if the fd will be closed at once
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_del_conn(hcore_event_loop_t *loop,
+                                 hcore_connection_t *c, hcore_uint_t flags);
+
+/**
+ * @brief wait for events and dispatch them to the handlers of events, then
+ * expire timers
+ *
+ * @note the wait is bounded by both 'timer' and the nearest timer of loop
+ *
+ * @param loop event loop
+ * @param timer max time to wait in milliseconds, HCORE_TIMER_INFINITE means
+ * waiting until an event or a timer is triggered
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_process(hcore_event_loop_t *loop, hcore_msec_t timer);
+
 #endif // !_HCORE_EVENT_H_INCLUDED_
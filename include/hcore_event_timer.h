@@ -0,0 +1,132 @@
+/**
+ * @file hcore_event_timer.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief timers of event, they are hold by the event loop
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#ifndef _HCORE_EVENT_TIMER_H_INCLUDED_
+#define _HCORE_EVENT_TIMER_H_INCLUDED_
+
+#include <hcore_event.h>
+#include <hcore_types.h>
+
+/**
+ * @brief re-arming a timer is skipped if the new deadline is close to the old
+ * one in the range, it saves a lot of rbtree operations for timers that are
+ * re-armed on every read
+ */
+#define HCORE_TIMER_LAZY_DELAY 300
+
+/*
+ * The wheel has 5 levels, the first one has 256 slots and each of others has
+ * 64 slots, so it can cover the whole range of 32 bits ticks:
+ *
+ *   level 0 : ticks [0, 2^8)
+ *   level 1 : ticks [2^8, 2^14)
+ *   level 2 : ticks [2^14, 2^20)
+ *   level 3 : ticks [2^20, 2^26)
+ *   level 4 : ticks [2^26, 2^32)
+ */
+#define HCORE_TIMER_WHEEL_ROOT_BITS 8
+#define HCORE_TIMER_WHEEL_BITS      6
+#define HCORE_TIMER_WHEEL_LEVELS    5
+#define HCORE_TIMER_WHEEL_ROOT_SIZE (1 << HCORE_TIMER_WHEEL_ROOT_BITS)
+#define HCORE_TIMER_WHEEL_SIZE      (1 << HCORE_TIMER_WHEEL_BITS)
+#define HCORE_TIMER_WHEEL_ROOT_MASK (HCORE_TIMER_WHEEL_ROOT_SIZE - 1)
+#define HCORE_TIMER_WHEEL_MASK      (HCORE_TIMER_WHEEL_SIZE - 1)
+#define HCORE_TIMER_WHEEL_SLOTS  \
+    (HCORE_TIMER_WHEEL_ROOT_SIZE \
+     + (HCORE_TIMER_WHEEL_LEVELS - 1) * HCORE_TIMER_WHEEL_SIZE)
+
+#define HCORE_TIMER_WHEEL_TICK_DEFAULT 1
+
+/**
+ * @brief hierarchical timer wheel, arm, re-arm and cancel are O(1). A timer
+ * expires within one tick after its deadline.
+ */
+struct hcore_event_timer_wheel_s
+{
+    hcore_queue_t slots[HCORE_TIMER_WHEEL_SLOTS];
+
+    /* bitmap of non-empty slots of level 0, it's used to find timer */
+    uint64_t bitmap[HCORE_TIMER_WHEEL_ROOT_SIZE / 64];
+
+    hcore_msec_t tick;    // resolution in milliseconds
+    hcore_msec_t jiffies; // next tick to process
+    hcore_msec_t msec;    // time of 'jiffies'
+    hcore_uint_t count;   // number of armed timers
+};
+
+/**
+ * @brief initialize timers of loop
+ *
+ * @param loop event loop
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_timer_init(hcore_event_loop_t *loop);
+
+/**
+ * @brief let the loop hold timers by a hierarchical timer wheel instead of
+ * rbtree, it must be invoked before any timer is armed
+ *
+ * @param loop event loop
+ * @param tick resolution of wheel in milliseconds, 0 means
+ * HCORE_TIMER_WHEEL_TICK_DEFAULT
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_event_timer_use_wheel(hcore_event_loop_t *loop,
+                                        hcore_msec_t        tick);
+
+/**
+ * @brief update the cached time of loop
+ *
+ * @param loop event loop
+ */
+void hcore_event_update_time(hcore_event_loop_t *loop);
+
+/**
+ * @brief get the time to the nearest timer
+ *
+ * @param loop event loop
+ *
+ * @return hcore_msec_t : HCORE_TIMER_INFINITE if there is no timer, 0 if the
+ * nearest timer was expired, otherwise the milliseconds to the nearest timer
+ */
+hcore_msec_t hcore_event_find_timer(hcore_event_loop_t *loop);
+
+/**
+ * @brief expire timers, the handler of expired event is invoked with
+ * 'ev->timeout' set
+ *
+ * @param loop event loop
+ */
+void hcore_event_expire_timers(hcore_event_loop_t *loop);
+
+/**
+ * @brief arm or re-arm timer of event
+ *
+ * @param loop event loop
+ * @param ev event
+ * @param timer milliseconds from now
+ */
+void hcore_event_add_timer(hcore_event_loop_t *loop, hcore_event_t *ev,
+                           hcore_msec_t timer);
+
+/**
+ * @brief cancel timer of event, nothing to do if the timer wasn't set
+ *
+ * @param loop event loop
+ * @param ev event
+ */
+void hcore_event_del_timer(hcore_event_loop_t *loop, hcore_event_t *ev);
+
+#endif // !_HCORE_EVENT_TIMER_H_INCLUDED_
@@ -21,5 +21,6 @@
 
 FILE *  hcore_fopen(const hcore_uchar_t *path, const char *mode);
 ssize_t hcore_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t hcore_readv(int fd, const struct iovec *iov, int iovcnt);
 
 #endif // !_HCORE_IO_H_INCLUDED_
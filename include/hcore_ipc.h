@@ -0,0 +1,153 @@
+/**
+ * @file hcore_ipc.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief rings of messages in shared memory for processes, a message is
+ * copied once and no syscall is made unless the consumer sleeps
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ * ipc: inter-process communication
+ * spsc: single producer, single consumer
+ * mpmc: multiple producers, multiple consumers
+ */
+
+#ifndef _HCORE_IPC_H_INCLUDED_
+#define _HCORE_IPC_H_INCLUDED_
+
+#include <hcore_base.h>
+#include <hcore_log.h>
+#include <hcore_types.h>
+
+#define HCORE_IPC_SPSC    0x01 // single producer and single consumer
+#define HCORE_IPC_MPMC    0x02 // multiple producers and consumers
+#define HCORE_IPC_RECORD  0x04 // variable-length records, SPSC only
+#define HCORE_IPC_EVENTFD 0x08 // the doorbell is an eventfd, anonymous only
+
+/**
+ * @brief the header of ring in shared memory, the positions are increased
+ * only, and the index is 'position & (n - 1)'
+ */
+typedef struct
+{
+    hcore_atomic_t head __attribute__((aligned(HCORE_CACHELINE_SIZE)));
+    hcore_atomic_t tail __attribute__((aligned(HCORE_CACHELINE_SIZE)));
+
+    hcore_atomic_t wait __attribute__((aligned(HCORE_CACHELINE_SIZE)));
+    hcore_uint32_t doorbell; // futex, it's changed on every ring
+
+    hcore_uint32_t flags;
+    hcore_uint32_t n;         // number of slots, or bytes of records
+    hcore_uint32_t size;      // max size of message
+    hcore_uint32_t slot_size; // size of slot with its header
+
+    hcore_uchar_t data[] __attribute__((aligned(HCORE_CACHELINE_SIZE)));
+} hcore_ipc_sh_t;
+
+typedef struct
+{
+    hcore_log_t    *log;
+    hcore_ipc_sh_t *sh;
+    size_t          size; // size of mapping
+    const char     *name; // name of shared memory, NULL is anonymous
+    int             fd;   // eventfd of doorbell, -1 is futex
+
+    /* the positions of peer seen last time, SPSC and RECORD only */
+    hcore_atomic_uint_t head;
+    hcore_atomic_uint_t tail;
+
+    hcore_uint_t create : 1; // 1: create, 0: get
+} hcore_ipc_t;
+
+/**
+ * @brief create a ring in shared memory
+ *
+ * @note
+ * 1. HCORE_IPC_SPSC and HCORE_IPC_MPMC carry messages in fixed-size slots,
+ * HCORE_IPC_RECORD packs them by their length in a ring of bytes.
+ * 2. the eventfd of HCORE_IPC_EVENTFD is inherited by fork(), it can be
+ * added to an event loop, see hcore_ipc_arm().
+ *
+ * @param log log object
+ * @param name name of shared memory, NULL is anonymous, then the ring is
+ * shared by the processes forked after it's created
+ * @param flags HCORE_IPC_*
+ * @param n number of messages of max size it holds at least
+ * @param size max size of message
+ *
+ * @return hcore_ipc_t* : Upon successful is return a ring, otherwise return
+ * NULL
+ */
+hcore_ipc_t *hcore_create_ipc(hcore_log_t *log, const char *name,
+                              hcore_uint_t flags, hcore_uint_t n, size_t size);
+
+/**
+ * @brief get a named ring created by another process
+ *
+ * @param log log object
+ * @param name name of shared memory
+ *
+ * @return hcore_ipc_t* : Upon successful is return a ring, otherwise return
+ * NULL
+ */
+hcore_ipc_t *hcore_get_ipc(hcore_log_t *log, const char *name);
+
+/**
+ * @brief unmap a ring, the named memory is unlinked by its creator
+ *
+ * @param ipc ring
+ */
+void hcore_destroy_ipc(hcore_ipc_t *ipc);
+
+/**
+ * @brief copy a message into the ring, the consumers sleeping are woken
+ *
+ * @param ipc ring
+ * @param data message
+ * @param len length of message
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_AGAIN if the ring is
+ * full, HCORE_ERROR if 'len' exceeds the max size
+ */
+hcore_int_t hcore_ipc_send(hcore_ipc_t *ipc, const void *data, size_t len);
+
+/**
+ * @brief copy a message out of the ring
+ *
+ * @param ipc ring
+ * @param buf buffer
+ * @param size size of buffer
+ *
+ * @return ssize_t : length of message. HCORE_AGAIN if the ring is empty,
+ * HCORE_ERROR if 'size' is too small, the message is left
+ */
+ssize_t hcore_ipc_recv(hcore_ipc_t *ipc, void *buf, size_t size);
+
+/**
+ * @brief sleep until a message is sent
+ *
+ * @param ipc ring
+ * @param timer timeout in milliseconds, 0 is infinite
+ *
+ * @return hcore_int_t : HCORE_OK if there may be messages, HCORE_AGAIN on
+ * timeout, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_ipc_wait(hcore_ipc_t *ipc, hcore_msec_t timer);
+
+/**
+ * @brief ask the producers to signal 'ipc->fd' for the next message, it's
+ * called when the consumer returns to event loop after draining the ring
+ *
+ * @note the eventfd should be read by the handler of its read event.
+ *
+ * @param ipc ring created with HCORE_IPC_EVENTFD
+ *
+ * @return hcore_int_t : HCORE_OK if armed, HCORE_AGAIN if the ring isn't
+ * empty, it should be drained again
+ */
+hcore_int_t hcore_ipc_arm(hcore_ipc_t *ipc);
+
+#endif // !_HCORE_IPC_H_INCLUDED_
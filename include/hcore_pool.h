@@ -16,10 +16,23 @@
 
 
 #include <hcore_log.h>
+#include <hcore_queue.h>
 #include <hcore_types.h>
 
 #define HCORE_POOL_SIZE_DEFAULT (16 * 1024)
 
+#define HCORE_POOL_CACHE_MAX   64   // blocks cached by a thread by default
+#define HCORE_POOL_CACHE_SIZES 4    // sizes of blocks cached by a thread
+#define HCORE_POOL_CACHE_IDLE  1000 // interval of trimming in milliseconds
+
+#define HCORE_POOL_LARGE_SHIFT   12 // the smallest class of large is 4KB
+#define HCORE_POOL_LARGE_CLASSES 7  // classes of large: 4KB, 8KB, ..., 256KB
+#define HCORE_POOL_LARGE_CACHE   4  // large ones cached for each class
+
+#define HCORE_POOL_FREE_SHIFT   4   // size classes are multiples of 16 bytes
+#define HCORE_POOL_FREE_MAX     512 // max size of recycled objects
+#define HCORE_POOL_FREE_CLASSES (HCORE_POOL_FREE_MAX >> HCORE_POOL_FREE_SHIFT)
+
 typedef struct hcore_pool_large_s   hcore_pool_large_t;
 typedef struct hcore_pool_data_s    hcore_pool_data_t;
 typedef struct hcore_pool_cleanup_s hcore_pool_cleanup_t;
@@ -35,10 +48,16 @@ struct hcore_pool_cleanup_s
     hcore_pool_cleanup_t       *next;
 };
 
+/**
+ * @brief the header in front of a large allocation
+ */
 struct hcore_pool_large_s
 {
-    struct hcore_pool_large_s *next;
-    void                      *alloc;
+    hcore_queue_t queue;  // in 'pool->large', the newest is the head
+    size_t        size;   // size of allocation from the header
+    hcore_uint_t  seq;    // sequence of allocation in the pool
+    hcore_uint_t  magic;  // it's a large allocation of the pool
+    hcore_uint_t  offset; // padding in front of the header for alignment
 };
 
 struct hcore_pool_data_s
@@ -64,14 +83,42 @@ struct hcore_pool_s
     hcore_pool_data_t     d;
     size_t                max;
     hcore_pool_t         *current;
-    hcore_pool_large_t   *large;
+    hcore_queue_t         large;     // hcore_pool_large_t
+    hcore_uint_t          large_seq; // sequence of the last large allocation
     hcore_log_t          *log;
     hcore_chain_t        *chain;
     hcore_pool_cleanup_t *cleanup;
 
+    /*
+     * lists of small objects freed by hcore_pfree_sized(), one for each size
+     * class, NULL is disabled */
+    void **recycled;
+
     hcore_uint_t customed : 1;
 };
 
+typedef struct
+{
+    hcore_uint_t hits;     // blocks and large ones reused from the cache
+    hcore_uint_t misses;   // blocks and large ones allocated by the system
+    hcore_uint_t cached;   // blocks in the cache
+    hcore_uint_t released; // blocks and large ones released by the cache
+} hcore_pool_cache_stat_t;
+
+/**
+ * @brief 内存池的位置，用于回滚到创建它时的状态，见'hcore_pool_mark()'
+ */
+typedef struct
+{
+    hcore_pool_t         *block; // 标记时的最后一个块
+    u_char               *last;  // 'block'的'd.last'
+    hcore_pool_t         *current;
+    hcore_uint_t          large; // 'large_seq'
+    hcore_chain_t        *chain;
+    hcore_pool_cleanup_t *cleanup;
+    void                **recycled;
+} hcore_pool_mark_t;
+
 hcore_pool_t *hcore_create_custom_pool(hcore_log_t *log, void *pool,
                                        hcore_pool_alloc_pt   alloc,
                                        hcore_pool_free_pt    free,
@@ -95,16 +142,85 @@ hcore_pool_t *hcore_create_pool(size_t size, hcore_log_t *log);
  */
 void hcore_destroy_pool(hcore_pool_t *pool);
 
+/**
+ * @brief  重置内存池，保留内存池的块以便复用
+ * @note
+ * 运行所有的清理函数，释放大块内存，将每个块的'last'回退到块的起始处并重置'current'，
+ * 因此之前从内存池分配的空间都不再可用。
+ * 自定义内存池（hcore_create_custom_pool）只运行清理函数。
+ * @param  *pool:
+ * @retval None
+ */
+void hcore_reset_pool(hcore_pool_t *pool);
+
+/**
+ * @brief  标记内存池的当前位置，之后的分配可以通过'hcore_pool_release()'回滚
+ * @note
+ * 1. 标记之后的小块分配都在最后一个块或新块中进行，因此回滚只需恢复'last'。
+ * 2. 标记可以嵌套，但必须按相反的顺序回滚。
+ * 3. 不支持自定义内存池。
+ * @param  *pool:
+ * @param  *mark: 保存位置
+ * @retval None
+ */
+void hcore_pool_mark(hcore_pool_t *pool, hcore_pool_mark_t *mark);
+
+/**
+ * @brief  回滚到标记'mark'的位置
+ * @note
+ * 运行标记之后添加的清理函数，释放标记之后分配的大块内存，
+ * 标记之后从内存池分配的空间（包括从'pool->chain'中取出的链）都不再可用。
+ * @param  *pool:
+ * @param  *mark: 'hcore_pool_mark()'保存的位置
+ * @retval None
+ */
+void hcore_pool_release(hcore_pool_t *pool, hcore_pool_mark_t *mark);
+
 /**
  * @brief  释放大块内存'p'；
- * @note   由于释放一块内存池的内存是非常消耗性能的，
- * * 因此只有大内存才有必要调用此接口去释放。
+ * @note
+ * 1. 大块内存前有'hcore_pool_large_t'头部，因此释放是O(1)的；
+ * 小块内存不能通过此接口释放，见'hcore_pfree_sized()'。
+ * 2. 'p'为NULL或者位于内存池的块中（小块内存）时返回HCORE_ERROR，不会读取头部；
+ * 其他的'p'必须是此内存池尚未释放的大块内存，已释放的大块内存可能已经还给系统，
+ * 不能再次释放。
  * @param  *pool:
  * @param  *p:
  * @retval
+ * 成功：HCORE_OK
+ * 失败：HCORE_ERROR，'p'不是此内存池的大块内存
  */
 hcore_int_t hcore_pfree(hcore_pool_t *pool, void *p);
 
+/**
+ * @brief  开启内存池的小块内存复用，见'hcore_pfree_sized()'
+ * @note
+ * 1. 开启后不大于'HCORE_POOL_FREE_MAX'的分配按16字节向上取整，
+ * 每个大小类别有一个空闲链表，'hcore_pnalloc()'优先从链表中取出。
+ * 2. 必须在分配要复用的对象之前开启，通常紧跟在'hcore_create_pool()'之后。
+ * 3. 'hcore_reset_pool()'清空链表并保持开启；'hcore_pool_release()'清空链表。
+ * 4. 不支持自定义内存池。
+ * @param  *pool:
+ * @retval
+ * 成功：HCORE_OK
+ * 失败：HCORE_ERROR
+ */
+hcore_int_t hcore_pool_enable_recycle(hcore_pool_t *pool);
+
+/**
+ * @brief  释放大小为'size'的内存'p'，小块内存放入空闲链表以便之后的分配复用
+ * @note
+ * 长期存在的内存池反复申请、释放小对象时因此不会持续增长；大块内存同'hcore_pfree()'。
+ * @param  *pool:
+ * @param  *p:
+ * @param  size: 申请'p'时的大小
+ * @retval
+ * 成功：HCORE_OK
+ * 未开启复用：HCORE_DECLINED，'p'直到内存池重置或销毁时才释放
+ * 失败：HCORE_ERROR
+ */
+hcore_int_t hcore_pfree_sized(hcore_pool_t *pool, void *p, size_t size);
+
 /**
  * @brief  申请一块安'alignment'排列的内存，空间大小为'size'
  * @note
@@ -154,13 +270,59 @@ void *hcore_prealloc(hcore_pool_t *pool, void *p, size_t old_size,
                      size_t new_size);
 
 /**
- * @brief  pool align alloc; 申请一块'size'大小的空间，地址进行排列
+ * @brief  pool align alloc; 申请一块'size'大小的空间，地址按'HCORE_ALIGNMENT'排列
+ * @note   自定义内存池的地址由其分配函数决定
+ * @param  *pool:
+ * @param  size:
+ * @retval
+ * 成功：分配的空间地址
+ * 失败：NULL
+ */
+void *hcore_palloc(hcore_pool_t *pool, size_t size);
+
+/**
+ * @brief  申请一块'size'大小的空间，地址按'align'排列
  * @note
+ * 1. 用于按缓存行（HCORE_CACHELINE_SIZE）排列的结构或SIMD数据，
+ * 小块内存的填充不超过'align - 1'个字节。
+ * 2. 不支持自定义内存池。
  * @param  *pool:
  * @param  size:
+ * @param  align: 排列的基数，必须是2的幂
  * @retval
+ * 成功：分配的空间地址
+ * 失败：NULL
+ */
+void *hcore_palloc_aligned(hcore_pool_t *pool, size_t size, size_t align);
+
+/**
+ * @brief  设置当前线程的块缓存的上限（high-water）
+ * @note
+ * 1. 内存池的块在销毁时被放入当前线程的缓存，创建内存池或扩展块时优先从缓存中取，
+ * 因此稳态下创建、销毁内存池不会调用系统的分配器。
+ * 2. 缓存按块的大小分为'HCORE_POOL_CACHE_SIZES'类，超出上限的块直接释放。
+ * 3. 不大于256KB的大块内存按2的幂向上取整，释放后每类最多缓存'HCORE_POOL_LARGE_CACHE'个，
+ * 不计入上限。
+ * 4. 线程退出时缓存被释放；调试模式（_HCORE_DEBUG）下不缓存。
+ * @param  max: 缓存块的上限，默认为'HCORE_POOL_CACHE_MAX'；0表示关闭并清空缓存
+ * @retval None
+ */
+void hcore_pool_cache_set_max(hcore_uint_t max);
+
+/**
+ * @brief  释放当前线程缓存中自上次整理以来一直空闲的块
+ * @note   销毁内存池时每隔'HCORE_POOL_CACHE_IDLE'毫秒会自动整理一次，
+ * 空闲的线程可以主动调用此接口归还内存。
+ * @retval None
+ */
+void hcore_pool_cache_trim(void);
+
+/**
+ * @brief  获取当前线程的块缓存的统计
+ * @param  *stat: 统计
+ * @retval None
  */
-#define hcore_palloc(pool, size) hcore_pnalloc(pool, size)
+void hcore_pool_cache_stat(hcore_pool_cache_stat_t *stat);
 
 hcore_chain_t *hcore_alloc_chain(hcore_pool_t *pool);
 void           hcore_free_chain(hcore_pool_t *pool, hcore_chain_t *cl);
@@ -55,6 +55,9 @@ void hcore_rbtree_insert(hcore_rbtree_t *tree, hcore_rbtree_node_t *node);
 void hcore_rbtree_delete(hcore_rbtree_t *tree, hcore_rbtree_node_t *node);
 void hcore_rbtree_insert_value(hcore_rbtree_node_t *root, hcore_rbtree_node_t *node,
                              hcore_rbtree_node_t *sentinel);
+void hcore_rbtree_insert_timer_value(hcore_rbtree_node_t *root,
+                                   hcore_rbtree_node_t *node,
+                                   hcore_rbtree_node_t *sentinel);
 
 #define hcore_rbt_red(node)          ((node)->color = 1)
 #define hcore_rbt_black(node)        ((node)->color = 0)
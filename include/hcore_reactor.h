@@ -0,0 +1,170 @@
+/**
+ * @file hcore_reactor.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief multi-reactor runtime, each worker thread runs its own event loop
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#ifndef _HCORE_REACTOR_H_INCLUDED_
+#define _HCORE_REACTOR_H_INCLUDED_
+
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_inet.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+#include <hcore_types.h>
+
+#include <pthread.h>
+
+typedef struct hcore_reactor_s hcore_reactor_t;
+typedef struct hcore_worker_s  hcore_worker_t;
+typedef struct hcore_task_s    hcore_task_t;
+
+typedef void (*hcore_task_handler_pt)(hcore_worker_t *wk, hcore_task_t *task);
+
+/**
+ * @brief a task which is run by a worker, it's linked into the mailbox of
+ * worker without copying, so it must be valid until 'handler' is called
+ */
+struct hcore_task_s
+{
+    hcore_task_handler_pt handler; // run in the thread of worker
+    void                 *data;    // data of 'handler'
+    hcore_task_t         *next;    // link of mailbox
+};
+
+/**
+ * @brief a worker thread owns an event loop, a pool and a table of
+ * connections. The connections stay on the worker for their lifetime, so
+ * the pool and log of worker are never touched by other threads.
+ */
+struct hcore_worker_s
+{
+    hcore_uint_t     id;      // index of worker
+    int              cpu;     // cpu which the thread is pinned to, or -1
+    pthread_t        tid;     // thread of worker
+    hcore_reactor_t *reactor; // reactor of worker
+
+    hcore_log_t               log;       // copy of log of reactor
+    hcore_pool_t             *pool;      // pool of worker
+    hcore_event_loop_t       *loop;      // event loop of worker
+    hcore_connection_table_t *table;     // connections, NULL if not set
+    hcore_listening_t        *listening; // shard of SO_REUSEPORT
+
+    /* mailbox, it's a lock-free stack of tasks notified by an eventfd */
+    hcore_task_t       *mailbox;   // posted tasks, the latest is first
+    hcore_connection_t *notify;    // connection of eventfd
+    hcore_task_t        quit_task; // stop the loop
+
+    void *data; // private data
+
+    /* statistics */
+    hcore_uint_t ntasks;  // number of run tasks
+    hcore_uint_t nwakeup; // number of notifications of mailbox
+
+    hcore_uint_t quit; // the loop is stopped, it's only set by worker
+
+    hcore_uint_t started : 1; // the thread was created
+};
+
+struct hcore_reactor_s
+{
+    hcore_worker_t *workers;  // workers
+    hcore_uint_t    nworkers; // number of workers
+
+    /* settings, they must be set before 'hcore_start_reactor()' */
+
+    hcore_uint_t connections; // slots of connection table of each worker,
+                              // 0 means connections are created by pool
+
+    hcore_sockaddr_t sockaddr; // address to listen, see
+                               // 'hcore_reactor_listen()'
+    socklen_t        socklen;  // 0 means no listening
+
+    hcore_connection_handler_pt handler; // handle the accepted connections
+
+    hcore_pool_t *pool; // pool of reactor
+    hcore_log_t  *log;  // log of reactor, each worker uses a copy of it
+
+    void *data; // private data
+
+    hcore_uint_t affinity : 1; // pin worker 'i' to cpu 'i % ncpus'
+    hcore_uint_t running  : 1; // workers are running
+};
+
+/**
+ * @brief create a reactor with 'n' workers, they aren't started
+ *
+ * @param pool pool that reactor is allocated from, and 'pool->log' is used
+ * as log of reactor
+ * @param n number of workers, 0 means number of online cpus
+ *
+ * @return hcore_reactor_t* : Upon successful is return a reactor, otherwise
+ * return NULL
+ */
+hcore_reactor_t *hcore_create_reactor(hcore_pool_t *pool, hcore_uint_t n);
+
+/**
+ * @brief listen on an address by all workers
+ *
+ * @note each worker opens its own listening with SO_REUSEPORT, the kernel
+ * balances new connections between them, so a connection is accepted and
+ * handled by one worker. If the port is 0, the port of the first worker is
+ * used by the others and it's copied back to 'r->sockaddr' on start.
+ *
+ * @param r reactor
+ * @param sockaddr address to listen
+ * @param socklen length of sockaddr
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_reactor_listen(hcore_reactor_t *r, struct sockaddr *sockaddr,
+                                 socklen_t socklen);
+
+/**
+ * @brief create loops of workers and start their threads
+ *
+ * @note the accepted connection is passed to 'r->handler' in the thread of
+ * worker, the worker is 'c->listening->data'.
+ *
+ * @param r reactor
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure and
+ * nothing is started
+ */
+hcore_int_t hcore_start_reactor(hcore_reactor_t *r);
+
+/**
+ * @brief stop all workers and wait for their threads, then release their
+ * loops and pools
+ *
+ * @note the connections of workers should be closed before, for example by
+ * posting tasks to workers.
+ *
+ * @param r reactor
+ */
+void hcore_stop_reactor(hcore_reactor_t *r);
+
+/**
+ * @brief post a task to the mailbox of worker, it's safe to be called from
+ * any thread
+ *
+ * @note the tasks are run in the order of posting by each thread. Only the
+ * post to an empty mailbox writes the eventfd, so the posts in a burst cost
+ * one notification.
+ *
+ * @param wk worker
+ * @param task task, 'handler' must be set
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_worker_post(hcore_worker_t *wk, hcore_task_t *task);
+
+#endif // !_HCORE_REACTOR_H_INCLUDED_
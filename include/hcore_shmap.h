@@ -0,0 +1,180 @@
+/**
+ * @file hcore_shmap.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief hash map in the shared memory pool, it's shared by processes
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ * shmap: shared map
+ * ttl: time to live
+ * lru: least recently used
+ */
+
+#ifndef _HCORE_SHMAP_H_INCLUDED_
+#define _HCORE_SHMAP_H_INCLUDED_
+
+#include <hcore_base.h>
+#include <hcore_queue.h>
+#include <hcore_shmtx.h>
+#include <hcore_shpool.h>
+#include <hcore_types.h>
+
+#define HCORE_SHMAP_SEGMENT_SIZE 512  // buckets of a segment
+#define HCORE_SHMAP_SEGMENTS     1024 // max number of segments
+#define HCORE_SHMAP_LOAD         2    // max average entries of a bucket
+#define HCORE_SHMAP_EVICT        8    // max entries evicted for an insert
+
+typedef struct hcore_shmap_node_s hcore_shmap_node_t;
+
+struct hcore_shmap_node_s
+{
+    hcore_shmap_node_t *next; // link of bucket
+    hcore_queue_t       lru;  // link of stripe, the head is the most recent
+
+    hcore_uint32_t hash;
+    hcore_uint32_t klen;
+    hcore_uint32_t vlen;
+    hcore_msec_t   expire; // monotonic time in milliseconds, 0 is never
+
+    hcore_uchar_t data[]; // key, then value
+};
+
+/**
+ * @brief a group of buckets protected by a lock, the bucket 'b' belongs to
+ * the stripe 'b & (nstripes - 1)'
+ */
+typedef struct
+{
+    hcore_shmtx_sh_t lock;
+    hcore_queue_t    lru;
+    hcore_uint_t     count; // number of entries
+} __attribute__((aligned(HCORE_CACHELINE_SIZE))) hcore_shmap_stripe_t;
+
+/**
+ * @brief the part in shared memory
+ *
+ * @note the buckets grow by linear hashing, a bucket is split at a time, so
+ * a resize never blocks the whole map. The number of buckets is
+ * 'nbuckets << level + split'.
+ */
+typedef struct
+{
+    hcore_shmtx_sh_t resize; // lock of splitting
+    hcore_atomic_t   state;  // 'level << 32 | split'
+
+    hcore_uint_t nbuckets; // initial number of buckets
+    hcore_uint_t nstripes;
+
+    hcore_shmap_stripe_t *stripes;
+    hcore_shmap_node_t  **segments[HCORE_SHMAP_SEGMENTS];
+} hcore_shmap_sh_t;
+
+typedef struct
+{
+    hcore_shpool_t   *shpool;
+    hcore_shmap_sh_t *sh;
+    hcore_shmtx_t    *locks; // locks of stripes
+    hcore_shmtx_t     resize;
+} hcore_shmap_t;
+
+/**
+ * @brief create a hash map in the shared memory pool
+ *
+ * @note
+ * 1. the map is shared by the processes forked after it's created, they use
+ * the same handle.
+ * 2. the keys and values are copied to the pool. If the pool runs out of
+ * memory, the least recently used entries are evicted.
+ *
+ * @param shpool shared memory pool
+ * @param nbuckets initial number of buckets, it's rounded up to power of 2
+ * @param nstripes number of locks, it's rounded up to power of 2 and limited
+ * to 'nbuckets'
+ *
+ * @return hcore_shmap_t* : Upon successful is return a map, otherwise
+ * return NULL
+ */
+hcore_shmap_t *hcore_create_shmap(hcore_shpool_t *shpool, hcore_uint_t nbuckets,
+                                  hcore_uint_t nstripes);
+
+/**
+ * @brief free all entries and the map
+ *
+ * @param map hash map
+ */
+void hcore_destroy_shmap(hcore_shmap_t *map);
+
+/**
+ * @brief insert or replace an entry
+ *
+ * @param map hash map
+ * @param key key
+ * @param klen length of key
+ * @param value value
+ * @param vlen length of value
+ * @param ttl time to live in milliseconds, 0 is never expired
+ *
+ * @return hcore_int_t : HCORE_OK on success. HCORE_ERROR if no memory even
+ * after eviction, the old value of key is removed
+ */
+hcore_int_t hcore_shmap_set(hcore_shmap_t *map, const void *key, size_t klen,
+                            const void *value, size_t vlen, hcore_msec_t ttl);
+
+/**
+ * @brief copy the value of key
+ *
+ * @param map hash map
+ * @param key key
+ * @param klen length of key
+ * @param buf buffer of value, the value is truncated to '*len'
+ * @param len size of 'buf', it's set to length of value
+ *
+ * @return hcore_int_t : HCORE_OK if found, HCORE_DECLINED if not found or
+ * expired
+ */
+hcore_int_t hcore_shmap_get(hcore_shmap_t *map, const void *key, size_t klen,
+                            void *buf, size_t *len);
+
+/**
+ * @brief add 'delta' to an integer value atomically, it's created with 'ttl'
+ * if not found, and the expire time isn't changed by later increments
+ *
+ * @param map hash map
+ * @param key key
+ * @param klen length of key
+ * @param delta delta
+ * @param ttl time to live in milliseconds, 0 is never expired
+ * @param value the value after adding, it can be NULL
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_ERROR if no memory
+ */
+hcore_int_t hcore_shmap_incr(hcore_shmap_t *map, const void *key, size_t klen,
+                             hcore_int_t delta, hcore_msec_t ttl,
+                             hcore_int_t *value);
+
+/**
+ * @brief remove an entry
+ *
+ * @param map hash map
+ * @param key key
+ * @param klen length of key
+ *
+ * @return hcore_int_t : HCORE_OK if removed, HCORE_DECLINED if not found
+ */
+hcore_int_t hcore_shmap_delete(hcore_shmap_t *map, const void *key,
+                               size_t klen);
+
+/**
+ * @brief get number of entries, it's inexact while the map is updated
+ *
+ * @param map hash map
+ *
+ * @return hcore_uint_t : number of entries
+ */
+hcore_uint_t hcore_shmap_count(hcore_shmap_t *map);
+
+#endif // !_HCORE_SHMAP_H_INCLUDED_
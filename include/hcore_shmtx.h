@@ -14,6 +14,7 @@
 #ifndef _HCORE_SHMTX_H_INCLUDED_
 #define _HCORE_SHMTX_H_INCLUDED_
 
+#include <hcore_base.h>
 #include <hcore_types.h>
 
 /**
@@ -21,18 +22,30 @@
  */
 typedef struct
 {
-    hcore_atomic_t lock;
+    hcore_atomic_t lock;  // pid of owner, 0 means unlocked
+    hcore_atomic_t wait;  // number of processes sleeping on 'futex'
+    hcore_uint32_t futex; // changed on every wakeup, it's a futex
 } hcore_shmtx_sh_t;
 
 typedef struct
 {
-    hcore_atomic_t *lock; // point to hcore_shmtx_sh_t.lock
+    hcore_atomic_t *lock;  // point to hcore_shmtx_sh_t.lock
+    hcore_atomic_t *wait;  // point to hcore_shmtx_sh_t.wait
+    hcore_uint32_t *futex; // point to hcore_shmtx_sh_t.futex
     hcore_uint_t    spin;
+
+    hcore_uint_t sleep : 1; // sleep on futex after spinning instead of
+                            // 'sched_yield()'
 } hcore_shmtx_t;
 
 /**
  * @brief initialize a shared mutex
- * 
+ *
+ * @note if 'mtx->spin' is (hcore_uint_t)-1, the mutex spins and yields
+ * without sleeping on the futex. Otherwise the waiters spin briefly, then
+ * sleep on a futex in the shared memory, and the unlocker wakes one of them
+ * only if there are sleepers.
+ *
  * @param mtx shared mutex
  * @param addr shared memory address
  * @return hcore_int_t HCORE_OK on success, HCORE_ERROR on failure
@@ -66,4 +79,97 @@ void         hcore_shmtx_unlock(hcore_shmtx_t *mtx);
  */
 hcore_uint_t hcore_shmtx_force_unlock(hcore_shmtx_t *mtx, hcore_pid_t pid);
 
+#define HCORE_SHRWLOCK_READERS 32 // max number of processes reading at once
+
+/**
+ * @brief a slot of reader, each one is in its own cache line, so the readers
+ * don't write the same line
+ */
+typedef struct
+{
+    hcore_atomic_t pid; // pid of reader, 0 means free
+    hcore_uchar_t  pad[HCORE_CACHELINE_SIZE - sizeof(hcore_atomic_t)];
+} hcore_shrwlock_reader_t;
+
+/**
+ * @brief the space must in shared memory
+ */
+typedef struct
+{
+    hcore_atomic_t lock;  // pid of writer, 0 means no writer
+    hcore_atomic_t wait;  // number of processes sleeping on 'futex'
+    hcore_uint32_t futex; // changed on every wakeup, it's a futex
+
+    hcore_shrwlock_reader_t readers[HCORE_SHRWLOCK_READERS]
+        __attribute__((aligned(HCORE_CACHELINE_SIZE)));
+} hcore_shrwlock_sh_t;
+
+typedef struct
+{
+    hcore_shrwlock_sh_t *sh;
+
+    hcore_uint_t spin;
+    hcore_uint_t slot; // slot of reader held by current process
+} hcore_shrwlock_t;
+
+/**
+ * @brief initialize a shared reader-writer lock
+ *
+ * @note
+ * 1. a reader takes a slot in 'readers' instead of counting in a shared
+ * word, so the readers scale with the number of processes.
+ * 2. writers are preferred, a writer owns 'lock' at once and new readers
+ * wait while it waits for the current readers to leave.
+ * 3. it isn't recursive, and the owner is identified by pid like
+ * hcore_shmtx_t, so it must not be shared by threads of a process.
+ *
+ * @param rw shared reader-writer lock
+ * @param addr shared memory address, it must be zeroed
+ * @return hcore_int_t HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t  hcore_shrwlock_init(hcore_shrwlock_t *rw, hcore_shrwlock_sh_t *addr);
+/**
+ * @brief try to lock a shared reader-writer lock for reading
+ *
+ * @param rw shared reader-writer lock
+ * @return hcore_uint_t 1 on success, 0 on failure
+ */
+hcore_uint_t hcore_shrwlock_tryrlock(hcore_shrwlock_t *rw);
+/**
+ * @brief lock a shared reader-writer lock for reading
+ *
+ * @param rw shared reader-writer lock
+ */
+void         hcore_shrwlock_rlock(hcore_shrwlock_t *rw);
+/**
+ * @brief try to lock a shared reader-writer lock for writing
+ *
+ * @param rw shared reader-writer lock
+ * @return hcore_uint_t 1 on success, 0 on failure
+ */
+hcore_uint_t hcore_shrwlock_trywlock(hcore_shrwlock_t *rw);
+/**
+ * @brief lock a shared reader-writer lock for writing, it waits for the
+ * readers to leave
+ *
+ * @param rw shared reader-writer lock
+ */
+void         hcore_shrwlock_wlock(hcore_shrwlock_t *rw);
+/**
+ * @brief unlock a shared reader-writer lock which is held for reading or
+ * writing
+ *
+ * @param rw shared reader-writer lock
+ */
+void         hcore_shrwlock_unlock(hcore_shrwlock_t *rw);
+/**
+ * @brief force unlock a shared reader-writer lock held by a process, it's
+ * used to recover the lock after the process died
+ *
+ * @param rw shared reader-writer lock
+ * @param pid process id
+ * @return hcore_uint_t 1 if the writer or a reader was released, otherwise 0
+ */
+hcore_uint_t hcore_shrwlock_force_unlock(hcore_shrwlock_t *rw, hcore_pid_t pid);
+
 #endif //!_HCORE_SHMTX_H_INCLUDED_
\ No newline at end of file
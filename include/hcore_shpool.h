@@ -29,6 +29,18 @@ struct hcore_slab_page_s
     hcore_slab_page_t *next;
 };
 
+/**
+ * @brief statistics of a slot size, they follow the headers of slots in
+ * shared memory
+ */
+typedef struct
+{
+    hcore_atomic_t total; // slots in the pages of the size
+    hcore_atomic_t used;  // slots allocated, including the cached ones
+    hcore_atomic_t reqs;  // allocation requests
+    hcore_atomic_t fails; // allocation failures
+} hcore_slab_stat_t;
+
 typedef struct
 {
     hcore_shmtx_sh_t   lock;
@@ -40,13 +52,42 @@ typedef struct
     hcore_slab_page_t *last; // last page that can be allocated by the pool
     hcore_slab_page_t  free; // header of free list
 
-    hcore_uint_t pfree; // free pages
+    hcore_uint_t pfree;   // free pages
+    hcore_uint_t largest; // pages of the largest free run
+
+    /*
+     * the counters are changed under lock, and read without lock */
+    hcore_atomic_t page_reqs;  // allocation requests of whole pages
+    hcore_atomic_t page_fails; // allocation failures of whole pages
+    hcore_atomic_t lock_count; // times that the pool is locked by shpool
+    hcore_atomic_t lock_nsec;  // total nanoseconds that the lock is held
 
     hcore_uchar_t *addr;  // start address of the whole shared memory
     hcore_uchar_t *start; // start address that can be allocated by the pool
     hcore_uchar_t *end;   // end address that the whole shared memory
 } hcore_slab_pool_t;
 
+#define HCORE_SHPOOL_CACHE_SIZE 32 // default number of objects of a magazine
+
+/**
+ * @brief a magazine is a stack of free objects of a slot size, it's private
+ * to the process
+ */
+typedef struct
+{
+    hcore_uint_t n;    // number of cached objects
+    void       **objs; // cached objects
+} hcore_shpool_magazine_t;
+
+typedef struct
+{
+    hcore_uint_t generation; // it's changed by fork() in the child
+    hcore_uint_t size;       // max number of objects of each magazine
+    hcore_uint_t nslots;     // number of magazines, one for each slot
+
+    hcore_shpool_magazine_t mags[];
+} hcore_shpool_cache_t;
+
 typedef struct
 {
     hcore_log_t       *log;
@@ -56,9 +97,40 @@ typedef struct
     hcore_shmtx_t      mutex;
     const char        *name; // name of shpool, it's must string of constant
 
+    hcore_shpool_cache_t *cache; // magazines of process, NULL is disabled
+
     hcore_uint_t create : 1; // 1: create, 0: get
 } hcore_shpool_t;
 
+#define HCORE_SHPOOL_MAX_SLOTS 16 // enough for pages of 512KB
+
+typedef struct
+{
+    size_t              size;  // size of slot
+    hcore_atomic_uint_t total; // slots in the pages of the size
+    hcore_atomic_uint_t used;  // slots allocated, 'total - used' are free
+    hcore_atomic_uint_t reqs;  // allocation requests
+    hcore_atomic_uint_t fails; // allocation failures
+} hcore_shpool_slot_stat_t;
+
+/**
+ * @brief a snapshot of statistics of pool, see hcore_shpool_stat()
+ */
+typedef struct
+{
+    hcore_uint_t pages;      // pages of pool
+    hcore_uint_t free_pages; // free pages
+    hcore_uint_t largest;    // pages of the largest free run
+
+    hcore_atomic_uint_t page_reqs;  // allocation requests of whole pages
+    hcore_atomic_uint_t page_fails; // allocation failures of whole pages
+    hcore_atomic_uint_t lock_count; // times that the pool is locked by shpool
+    hcore_atomic_uint_t lock_nsec;  // total nanoseconds that the lock is held
+
+    hcore_uint_t             nslots; // number of slot sizes
+    hcore_shpool_slot_stat_t slots[HCORE_SHPOOL_MAX_SLOTS];
+} hcore_shpool_stat_t;
+
 /**
  * @brief create a pool of shared memory
  *
@@ -137,6 +209,51 @@ void  hcore_shpool_free(hcore_shpool_t *shpool, void *p);
  */
 void  hcore_shpool_free_locked(hcore_shpool_t *shpool, void *p);
 
+/**
+ * @brief enable the magazines of process for the slot sizes, then
+ * hcore_shpool_alloc() and hcore_shpool_free() of small objects take the
+ * lock once for a batch of objects
+ *
+ * @note
+ * 1. each magazine holds 'size' objects at most, they are allocated from
+ * the view of pool until they are flushed.
+ * 2. the magazines belong to the handle, so a handle with magazines must not
+ * be shared by threads. The magazines inherited by fork() are dropped in the
+ * child, the objects in them still belong to the parent.
+ * 3. the *_locked() interfaces bypass the magazines.
+ *
+ * @param shpool shared memory pool
+ * @param size max number of objects of each magazine, 0 means
+ * HCORE_SHPOOL_CACHE_SIZE
+ * @return hcore_int_t HCORE_OK on success, HCORE_ERROR on failure
+ */
+hcore_int_t hcore_shpool_init_cache(hcore_shpool_t *shpool, hcore_uint_t size);
+/**
+ * @brief return all objects of the magazines to pool
+ *
+ * @note it's done when the pool is exhausted and when the handle is
+ * destroyed.
+ *
+ * @param shpool shared memory pool
+ */
+void        hcore_shpool_flush_cache(hcore_shpool_t *shpool);
+
+/**
+ * @brief get statistics of a pool without lock, so a monitoring process can
+ * read them through hcore_get_shpool() cheaply
+ *
+ * @note
+ * 1. the counters are read one by one while the pool is changed, so they
+ * may be a little inconsistent with each other.
+ * 2. the objects in magazines are counted as used, see
+ * hcore_shpool_init_cache().
+ * 3. the locks taken by hcore_shpool_lock() aren't counted.
+ *
+ * @param shpool shared memory pool
+ * @param stat statistics
+ */
+void hcore_shpool_stat(hcore_shpool_t *shpool, hcore_shpool_stat_t *stat);
+
 /**
  * @brief lock a pool
  *
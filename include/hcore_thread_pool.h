@@ -0,0 +1,187 @@
+/**
+ * @file hcore_thread_pool.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief work-stealing thread pool for blocking tasks, the completion is
+ * notified back to the event loop which posted the task
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#ifndef _HCORE_THREAD_POOL_H_INCLUDED_
+#define _HCORE_THREAD_POOL_H_INCLUDED_
+
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_pool.h>
+#include <hcore_types.h>
+
+#include <pthread.h>
+
+#define HCORE_THREAD_POOL_DEQUE_SIZE_DEFAULT 1024
+
+typedef struct hcore_thread_pool_s   hcore_thread_pool_t;
+typedef struct hcore_thread_task_s   hcore_thread_task_t;
+typedef struct hcore_thread_notify_s hcore_thread_notify_t;
+typedef struct hcore_thread_worker_s hcore_thread_worker_t;
+
+typedef void (*hcore_thread_handler_pt)(hcore_thread_task_t *task);
+
+struct hcore_thread_task_s
+{
+    hcore_thread_handler_pt handler; // run in a thread of pool
+    void                   *ctx;     // context of 'handler'
+
+    /*
+     * 'event.handler' is called in the event loop of 'notify' after
+     * 'handler' returns, 'event.data' isn't touched
+     */
+    hcore_event_t event;
+
+    /* private */
+    hcore_thread_notify_t *notify; // completion queue, NULL if not notified
+    hcore_thread_task_t   *next;   // link of injection or completion queue
+    uint64_t               posted; // monotonic time of posting in ns
+};
+
+/**
+ * @brief Chase-Lev deque, the owner pushes and takes tasks at bottom, the
+ * other workers steal tasks at top
+ */
+typedef struct
+{
+    int64_t               top;
+    int64_t               bottom;
+    hcore_thread_task_t **buf;
+    hcore_uint_t          mask;
+} hcore_thread_deque_t;
+
+struct hcore_thread_worker_s
+{
+    pthread_t             tid;
+    hcore_uint_t          id;
+    hcore_thread_pool_t  *tp;
+    hcore_thread_deque_t  deque;
+    hcore_uint_t          seed; // for choosing a victim to steal
+};
+
+struct hcore_thread_pool_s
+{
+    hcore_thread_worker_t *workers;
+    hcore_uint_t           nworkers;
+
+    hcore_thread_task_t *injected; // tasks posted from outside, a stack
+
+    /* sleep of idle workers */
+    hcore_uint32_t epoch;    // changed by posting, it's a futex
+    hcore_uint_t   nsleeps;  // number of sleeping workers
+    hcore_uint_t   nthreads; // number of started threads
+    hcore_uint_t   quit;
+
+    hcore_log_t *log;
+
+    /* statistics, they are updated atomically */
+    hcore_uint_t nposted;  // number of posted tasks
+    hcore_uint_t ndone;    // number of finished tasks
+    hcore_uint_t nsteals;  // number of stolen tasks
+    uint64_t     wait_ns;  // sum of time from posting to starting
+    uint64_t     wait_max; // max time from posting to starting
+};
+
+/**
+ * @brief notify completions of tasks to an event loop through an eventfd
+ */
+struct hcore_thread_notify_s
+{
+    hcore_thread_task_t *completed; // completed tasks, the latest is first
+    hcore_connection_t  *connection; // connection of eventfd
+    hcore_event_loop_t  *loop;
+    hcore_uint_t         ncompleted; // it's only touched by the loop
+    hcore_uint_t         busy;       // threads are writing the eventfd
+};
+
+typedef struct
+{
+    hcore_uint_t depth;    // tasks are queued or running
+    hcore_uint_t nposted;  // number of posted tasks
+    hcore_uint_t nsteals;  // number of stolen tasks
+    uint64_t     wait_avg; // average time from posting to starting in ns
+    uint64_t     wait_max; // max time from posting to starting in ns
+} hcore_thread_pool_stat_t;
+
+/**
+ * @brief create a thread pool and start its threads
+ *
+ * @param pool pool that thread pool is allocated from, and 'pool->log' is
+ * used as log of thread pool
+ * @param n number of threads, 0 means number of online cpus
+ * @param size capacity of deque of each thread, it's rounded up to a power
+ * of 2, 0 means HCORE_THREAD_POOL_DEQUE_SIZE_DEFAULT
+ *
+ * @return hcore_thread_pool_t* : Upon successful is return a thread pool,
+ * otherwise return NULL
+ */
+hcore_thread_pool_t *hcore_create_thread_pool(hcore_pool_t *pool,
+                                              hcore_uint_t  n,
+                                              hcore_uint_t  size);
+
+/**
+ * @brief stop threads of pool after the posted tasks are finished
+ *
+ * @note the completions are still delivered to the event loops
+ *
+ * @param tp thread pool
+ */
+void hcore_destroy_thread_pool(hcore_thread_pool_t *tp);
+
+/**
+ * @brief post a task to thread pool, it's safe to be called from any thread
+ *
+ * @note the tasks are pushed to a lock-free injection queue, an idle thread
+ * moves them to its deque and the others steal from it. So the posting
+ * costs a futex wake only if there are sleeping threads.
+ *
+ * @param tp thread pool
+ * @param task task, 'handler' must be set and it must be valid until
+ * completion
+ * @param notify 'task->event.handler' is called in the loop of 'notify' on
+ * completion. NULL means no completion
+ *
+ * @return hcore_int_t : HCORE_OK on success, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_thread_pool_post(hcore_thread_pool_t *tp,
+                                   hcore_thread_task_t *task,
+                                   hcore_thread_notify_t *notify);
+
+/**
+ * @brief get statistics of thread pool
+ *
+ * @param tp thread pool
+ * @param stat statistics
+ */
+void hcore_thread_pool_stat(hcore_thread_pool_t      *tp,
+                            hcore_thread_pool_stat_t *stat);
+
+/**
+ * @brief create a completion queue of an event loop, an eventfd is added to
+ * the loop to notify completions
+ *
+ * @param loop event loop
+ *
+ * @return hcore_thread_notify_t* : Upon successful is return a notify,
+ * otherwise return NULL
+ */
+hcore_thread_notify_t *hcore_create_thread_notify(hcore_event_loop_t *loop);
+
+/**
+ * @brief destroy a completion queue, the tasks of it mustn't be in flight
+ *
+ * @param notify notify
+ */
+void hcore_destroy_thread_notify(hcore_thread_notify_t *notify);
+
+#endif // !_HCORE_THREAD_POOL_H_INCLUDED_
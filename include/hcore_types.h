@@ -40,6 +40,7 @@ typedef struct hcore_pool_s        hcore_pool_t;
 typedef struct hcore_custom_pool_s hcore_custom_pool_t;
 typedef struct hcore_chain_s       hcore_chain_t;
 typedef struct hcore_buf_s         hcore_buf_t;
+typedef struct hcore_connection_s  hcore_connection_t;
 
 
 #if (HCORE_HAVE_AUTOMIC_OPS)
@@ -0,0 +1,235 @@
+/**
+ * @file hcore_uring.h
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief io_uring backend of event loop, recv and send of connection are
+ * submitted as operations and their completions are delivered to the handlers
+ * of events
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#ifndef _HCORE_URING_H_INCLUDED_
+#define _HCORE_URING_H_INCLUDED_
+
+#include <hcore_buf.h>
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_types.h>
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define HCORE_URING_ENTRIES_DEFAULT 256
+
+// max number of buffers are sent by one operation of 'hcore_uring_send_chain()'
+#define HCORE_URING_IOV_MAX 64
+
+// group id of provided buffers
+#define HCORE_URING_BGID 0
+
+/* type of operation */
+
+#define HCORE_URING_OP_RECV           1
+#define HCORE_URING_OP_RECV_MULTISHOT 2
+#define HCORE_URING_OP_SEND           3
+
+struct hcore_uring_op_s
+{
+    hcore_event_t    *event; // event to be notified, NULL if it was canceled
+    hcore_uint_t      type;  // see HCORE_URING_OP_*
+    hcore_buf_t      *buf;   // buffer of HCORE_URING_OP_RECV
+    hcore_chain_t    *out;   // chain of HCORE_URING_OP_SEND
+    hcore_uring_op_t *next;  // link of free operations
+
+    /* they must be valid until the operation is submitted */
+    struct msghdr msg;
+    struct iovec  iovs[HCORE_URING_IOV_MAX];
+};
+
+struct hcore_uring_s
+{
+    int fd; // fd of io_uring
+
+    /* submission queue */
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_array;
+    unsigned             sq_mask;
+    unsigned             sq_entries;
+    unsigned             sq_local_tail; // tail of queued but unpublished sqes
+    struct io_uring_sqe *sqes;
+    hcore_uint_t         to_submit; // number of queued sqes
+
+    /* completion queue */
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned             cq_mask;
+    unsigned             cq_entries;
+    struct io_uring_cqe *cqes;
+
+    /* mapped memory of rings */
+    void  *sq_ring;
+    size_t sq_ring_size;
+    void  *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    hcore_uring_op_t *ops;  // all operations, there are 'cq_entries'
+    hcore_uring_op_t *free; // free operations
+
+    /* provided buffers, see 'hcore_uring_setup_buffers()' */
+    struct io_uring_buf_ring *br;      // ring of buffers shared with kernel
+    size_t                    br_size; // mapped size of 'br'
+    hcore_uchar_t            *bufs;    // memory of buffers
+    size_t                    buf_size;
+    hcore_uint_t              nbufs;
+    unsigned short            br_tail;
+
+    hcore_connection_t *connection; // connection of 'fd' in epoll
+    hcore_event_loop_t *loop;
+    hcore_log_t        *log;
+
+    /* statistics */
+    hcore_uint_t nenters; // calls of io_uring_enter()
+    hcore_uint_t nsqes;   // submitted sqes
+    hcore_uint_t ncqes;   // handled cqes
+};
+
+/**
+ * @brief get memory of the provided buffer which is reported by 'ev->buf_id'
+ */
+#define hcore_uring_buffer(ring, id) \
+    ((ring)->bufs + (size_t)(id) * (ring)->buf_size)
+
+/**
+ * @brief use io_uring as a backend of loop, then 'loop->uring' can be used by
+ * 'hcore_uring_*()' functions
+ *
+ * @note
+ * 1. the fd of io_uring is added to epoll, so the readiness events and the
+ * completions are handled by the same 'hcore_event_process()'.
+ * 2. operations are queued and submitted by one io_uring_enter() before
+ * waiting for events, it's a batch of all connections of an iteration.
+ * 3. the ring is destroyed by 'hcore_destroy_event_loop()'.
+ *
+ * @param loop event loop
+ * @param entries size of submission queue, 0 means
+ * HCORE_URING_ENTRIES_DEFAULT
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_DECLINED if io_uring isn't
+ * available, the epoll should be used instead. Otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_event_use_uring(hcore_event_loop_t *loop,
+                                  hcore_uint_t        entries);
+
+/**
+ * @brief destroy a ring, the operations in flight are dropped
+ *
+ * @param ring ring
+ */
+void hcore_destroy_uring(hcore_uring_t *ring);
+
+/**
+ * @brief register 'n' buffers of 'size' bytes which are allocated from pool
+ * of loop, the kernel picks one of them for each completion of
+ * 'hcore_uring_recv_multishot()'
+ *
+ * @param ring ring
+ * @param n number of buffers, it must be a power of 2 and less than 32768
+ * @param size size of buffer
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_DECLINED if kernel doesn't
+ * support it, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_setup_buffers(hcore_uring_t *ring, hcore_uint_t n,
+                                      size_t size);
+
+/**
+ * @brief receive data to '[b->last, b->end)' of 'b' by an operation
+ *
+ * @note 'c->rev->handler' is called on completion with 'rev->ready' set and
+ * 'rev->result' is the result of recv(). 'b->last' is moved forward if data
+ * was received, 'rev->eof' is set if peer closed, and 'rev->error' is set on
+ * failure ('rev->result' is -errno).
+ *
+ * @param ring ring
+ * @param c connection
+ * @param b buffer, it must be valid until completion
+ *
+ * @return hcore_int_t : HCORE_OK on success, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_recv(hcore_uring_t *ring, hcore_connection_t *c,
+                             hcore_buf_t *b);
+
+/**
+ * @brief receive data to provided buffers until it's canceled or failed
+ *
+ * @note same as 'hcore_uring_recv()' except that 'c->rev->handler' is called
+ * for each completion with 'rev->buffer' set if data was received. The data
+ * is in 'hcore_uring_buffer(ring, rev->buf_id)' and its size is
+ * 'rev->result', the buffer is given back to kernel once the handler returns,
+ * so the data must be consumed in the handler. The operation is finished if
+ * 'rev->op' is NULL in the handler, a 'rev->result' of -ENOBUFS means that
+ * buffers ran out and the operation can be submitted again.
+ *
+ * @param ring ring, buffers must be set up
+ * @param c connection
+ *
+ * @return hcore_int_t : HCORE_OK on success, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_recv_multishot(hcore_uring_t      *ring,
+                                       hcore_connection_t *c);
+
+/**
+ * @brief send memory buffers of 'out' by one sendmsg() operation
+ *
+ * @note 'c->wev->handler' is called on completion with 'wev->ready' set and
+ * 'wev->result' is the result of sendmsg(). The 'pos' of sent buffers are
+ * moved forward, so the remain of 'out' can be sent by calling it again.
+ * 'wev->error' is set on failure. The data is held by MSG_MORE if 'c->flush'
+ * is HCORE_TCP_FLUSH_MORE.
+ *
+ * @param ring ring
+ * @param c connection
+ * @param out buffer chain, it must be valid until completion and has no file
+ * buffer
+ *
+ * @return hcore_int_t : HCORE_OK on success, HCORE_DONE if 'out' is empty,
+ * otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_send_chain(hcore_uring_t *ring, hcore_connection_t *c,
+                                   hcore_chain_t *out);
+
+/**
+ * @brief cancel operations of connection, the handlers won't be called for
+ * them any more
+ *
+ * @note call it before the connection is destroyed or put back to table. The
+ * cancellation is submitted at once, the operations waiting for socket are
+ * canceled by kernel before return.
+ *
+ * @param ring ring
+ * @param c connection
+ *
+ * @return hcore_int_t : HCORE_OK on success, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_cancel(hcore_uring_t *ring, hcore_connection_t *c);
+
+/**
+ * @brief submit queued operations by one io_uring_enter()
+ *
+ * @note it's called by 'hcore_event_process()' before waiting
+ *
+ * @param ring ring
+ *
+ * @return hcore_int_t : HCORE_OK on success, otherwise HCORE_ERROR
+ */
+hcore_int_t hcore_uring_submit(hcore_uring_t *ring);
+
+#endif // !_HCORE_URING_H_INCLUDED_
@@ -43,6 +43,10 @@ hcore_init_slab(void)
     g_hcore_slab_exact_size =
         hcore_getpagesize() / (8 * sizeof(uintptr_t) /* bits */);
 
+    // count from 0, 'n' is shifted once more than the shift of size
+
+    g_hcore_slab_exact_shift = 0;
+
     for (n = g_hcore_slab_exact_size; n >>= 1; g_hcore_slab_exact_shift++)
     {
         // nothing
@@ -89,6 +93,9 @@ hcore_getpagesize_shift(void)
     if (g_hcore_pagesize_shift == -1)
     {
         hcore_int_t n;
+
+        g_hcore_pagesize_shift = 0;
+
         for (n = pagesize; n >>= 1; g_hcore_pagesize_shift++)
         {
             // nothing
@@ -89,5 +89,25 @@ hcore_alloc_buf(hcore_pool_t *pool, size_t size)
 
     b->end = b->start + size;
 
+    return b;
+}
+
+hcore_buf_t *
+hcore_alloc_file_buf(hcore_pool_t *pool, int fd, off_t offset, off_t size,
+                     hcore_uint_t pipe)
+{
+    hcore_buf_t *b;
+
+    b = hcore_pcalloc(pool, sizeof(hcore_buf_t));
+    if (b == NULL) return NULL;
+
+    if (pipe) offset = 0;
+
+    b->fd        = fd;
+    b->file_pos  = offset;
+    b->file_last = offset + size;
+    b->in_file   = 1;
+    b->in_pipe   = pipe ? 1 : 0;
+
     return b;
 }
\ No newline at end of file
@@ -11,15 +11,36 @@
  * @abbr:
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for recvmmsg(), sendmmsg() and splice()
+#endif
+
 #include <hcore_base.h>
 #include <hcore_buf.h>
 #include <hcore_connection.h>
+#include <hcore_event_timer.h>
 #include <hcore_inet.h>
 #include <hcore_io.h>
 
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
+// max size of a sendfile(), same as limit of kernel
+#define HCORE_SENDFILE_MAX 0x7ffff000
+
+// control message of UDP_SEGMENT or UDP_GRO
+typedef union
+{
+    char           buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} hcore_udp_cmsg_t;
+
 // for writev
 typedef struct
 {
@@ -34,7 +55,21 @@ static hcore_chain_t *hcore_output_chain_to_iovec(hcore_iovec_t *vec,
 
 static hcore_chain_t *hcore_update_output_chain(hcore_chain_t *out, size_t sent);
 
-// TODO: create connection
+static ssize_t hcore_tcp_send_file(hcore_connection_t *c, hcore_buf_t *b,
+                                   size_t size);
+static ssize_t hcore_tcp_send_zerocopy(hcore_connection_t *c,
+                                       hcore_iovec_t *vec);
+static void hcore_tcp_release_chain(hcore_connection_t *c, hcore_chain_t *cl,
+                                    hcore_chain_t *last);
+static hcore_int_t hcore_tcp_cork(hcore_connection_t *c, int on);
+static ssize_t hcore_tcp_sendv(hcore_connection_t *c, hcore_iovec_t *vec);
+
+static void hcore_listening_accept_handler(hcore_event_t *ev);
+
+static hcore_int_t hcore_udp_bind_peer(hcore_connection_t *c,
+                                       struct sockaddr *sockaddr,
+                                       socklen_t socklen);
+
 struct hcore_connection_s *
 hcore_create_connection(hcore_log_t *log, int fd)
 {
@@ -96,8 +131,140 @@ failed:
     return NULL;
 }
 
-// TODO: destroy connection
-void hcore_destroy_connection(struct hcore_connection_s *c)
+hcore_connection_table_t *
+hcore_create_connection_table(hcore_pool_t *pool, hcore_uint_t size,
+                              size_t pool_size)
+{
+    hcore_uint_t i;
+    hcore_connection_t *c, *next;
+    hcore_connection_table_t *table;
+
+    hcore_assert(pool && size);
+
+    if (pool == NULL || size == 0)
+        return NULL;
+
+    table = hcore_pcalloc(pool, sizeof(hcore_connection_table_t));
+    if (table == NULL)
+        return NULL;
+
+    table->connections = hcore_pcalloc(pool, sizeof(hcore_connection_t) * size);
+    table->read_events = hcore_pcalloc(pool, sizeof(hcore_event_t) * size);
+    table->write_events = hcore_pcalloc(pool, sizeof(hcore_event_t) * size);
+
+    if (table->connections == NULL || table->read_events == NULL
+        || table->write_events == NULL)
+    {
+        return NULL;
+    }
+
+    c = table->connections;
+    next = NULL;
+
+    for (i = size; i--; /* void */)
+    {
+        c[i].data = next;
+        c[i].fd = -1;
+        c[i].rev = &table->read_events[i];
+        c[i].wev = &table->write_events[i];
+
+        table->read_events[i].data = &c[i];
+        table->write_events[i].data = &c[i];
+
+        next = &c[i];
+    }
+
+    table->free = next;
+    table->size = size;
+    table->nfree = size;
+    table->pool_size = pool_size ? pool_size : HCORE_POOL_SIZE_DEFAULT;
+    table->log = pool->log;
+
+    return table;
+}
+
+hcore_connection_t *
+hcore_get_connection(hcore_connection_table_t *table, int fd, hcore_log_t *log)
+{
+    hcore_uint_t instance, used;
+    hcore_pool_t *pool;
+    hcore_event_t *rev, *wev;
+    hcore_connection_t *c;
+
+    hcore_assert(table && log);
+
+    c = table->free;
+
+    if (c == NULL)
+    {
+        table->nfailed++;
+        hcore_log_error(HCORE_LOG_ALERT, log, 0,
+                        "%ui connections are not enough", table->size);
+        return NULL;
+    }
+
+    pool = hcore_create_pool(table->pool_size, log);
+    if (pool == NULL)
+        return NULL;
+
+    table->free = c->data;
+    table->nfree--;
+
+    used = hcore_connection_table_used(table);
+    if (used > table->high_water)
+        table->high_water = used;
+
+    rev = c->rev;
+    wev = c->wev;
+
+    hcore_memzero(c, sizeof(hcore_connection_t));
+
+    c->rev = rev;
+    c->wev = wev;
+    c->fd = fd;
+    c->log = log;
+    c->pool = pool;
+
+    instance = rev->instance;
+
+    hcore_memzero(rev, sizeof(hcore_event_t));
+    hcore_memzero(wev, sizeof(hcore_event_t));
+
+    rev->instance = !instance;
+    wev->instance = !instance;
+    rev->data = c;
+    wev->data = c;
+
+    return c;
+}
+
+void
+hcore_put_connection(hcore_connection_table_t *table, hcore_connection_t *c)
+{
+    hcore_assert(table && c);
+    hcore_assert(c >= table->connections
+                 && c < table->connections + table->size);
+    hcore_assert(!c->rev->timer_set && !c->wev->timer_set);
+
+    if (!c->shared && c->fd != -1)
+        close(c->fd);
+
+    // the stale events of the fd are ignored
+    c->fd = -1;
+
+    if (c->pool)
+    {
+        hcore_destroy_pool(c->pool);
+        c->pool = NULL;
+    }
+
+    c->data = table->free;
+    table->free = c;
+    table->nfree++;
+}
+
+void
+hcore_destroy_connection(struct hcore_connection_s *c)
 {
     if (c->shared)
     {
@@ -111,6 +278,250 @@ void hcore_destroy_connection(struct hcore_connection_s *c)
     hcore_destroy_pool(c->pool);
 }
 
+hcore_listening_t *
+hcore_create_listening(hcore_pool_t *pool, struct sockaddr *sockaddr,
+                       socklen_t socklen)
+{
+    hcore_listening_t *ls;
+
+    hcore_assert(pool && sockaddr);
+
+    if (socklen > sizeof(hcore_sockaddr_t))
+        return NULL;
+
+    ls = hcore_pcalloc(pool, sizeof(hcore_listening_t));
+    if (ls == NULL)
+        return NULL;
+
+    hcore_memcpy(&ls->sockaddr, sockaddr, socklen);
+
+    ls->fd = -1;
+    ls->socklen = socklen;
+    ls->backlog = HCORE_LISTEN_BACKLOG;
+    ls->accept_budget = HCORE_ACCEPT_BUDGET_DEFAULT;
+    ls->accept_delay = HCORE_ACCEPT_DELAY_DEFAULT;
+    ls->log = pool->log;
+
+    return ls;
+}
+
+hcore_int_t
+hcore_open_listening(hcore_listening_t *ls)
+{
+    int fd, on, defer;
+    const char *op;
+    hcore_connection_t *c;
+
+    hcore_assert(ls && ls->handler);
+
+    fd = socket(ls->sockaddr.sockaddr.sa_family,
+                SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ls->log, errno, "socket() failed");
+        return HCORE_ERROR;
+    }
+
+    on = 1;
+    op = "setsockopt(SO_REUSEADDR)";
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1)
+        goto failed;
+
+    op = "setsockopt(SO_REUSEPORT)";
+
+    if (ls->reuseport
+        && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+    {
+        goto failed;
+    }
+
+    op = "bind()";
+
+    if (bind(fd, &ls->sockaddr.sockaddr, ls->socklen) == -1)
+        goto failed;
+
+    op = "listen()";
+
+    if (listen(fd, ls->backlog) == -1)
+        goto failed;
+
+    // the connection is accepted after its data arrives
+
+    op = "setsockopt(TCP_DEFER_ACCEPT)";
+    defer = (int)ls->defer_accept;
+
+    if (defer
+        && setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer, sizeof(int))
+               == -1)
+    {
+        goto failed;
+    }
+
+    // the real port if it's 0
+
+    ls->socklen = sizeof(hcore_sockaddr_t);
+
+    op = "getsockname()";
+
+    if (getsockname(fd, &ls->sockaddr.sockaddr, &ls->socklen) == -1)
+        goto failed;
+
+    c = hcore_create_connection(ls->log, fd);
+    if (c == NULL)
+    {
+        close(fd);
+        return HCORE_ERROR;
+    }
+
+    c->type = SOCK_STREAM;
+    c->listening = ls;
+    c->rev->handler = hcore_listening_accept_handler;
+
+    ls->fd = fd;
+    ls->connection = c;
+
+    return HCORE_OK;
+
+failed:
+
+    hcore_log_error(HCORE_LOG_ALERT, ls->log, errno, "%s failed", op);
+
+    close(fd);
+
+    return HCORE_ERROR;
+}
+
+void
+hcore_close_listening(hcore_listening_t *ls)
+{
+    hcore_assert(ls);
+
+    if (ls->connection)
+    {
+        if (ls->loop && ls->connection->rev->timer_set)
+        {
+            hcore_event_del_timer(ls->loop, ls->connection->rev);
+        }
+
+        hcore_destroy_connection(ls->connection);
+        ls->connection = NULL;
+    }
+
+    ls->fd = -1;
+}
+
+static void
+hcore_listening_accept_handler(hcore_event_t *ev)
+{
+    int fd;
+    hcore_uint_t n;
+    hcore_err_t err;
+    socklen_t socklen;
+    hcore_sockaddr_t sa;
+    hcore_listening_t *ls;
+    hcore_connection_t *c, *lc;
+
+    lc = ev->data;
+    ls = lc->listening;
+
+    if (ev->timeout)
+    {
+        // the pause of accepting is over
+
+        ev->timeout = 0;
+
+        if (hcore_event_add(ls->loop, ev, HCORE_EVENT_READ, 0) != HCORE_OK)
+        {
+            return;
+        }
+    }
+
+    for (n = 0; ls->accept_budget == 0 || n < ls->accept_budget; n++)
+    {
+        socklen = sizeof(hcore_sockaddr_t);
+
+        fd = accept4(lc->fd, &sa.sockaddr, &socklen,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd == -1)
+        {
+            err = errno;
+
+            if (err == EAGAIN)
+            {
+                ev->ready = 0;
+                hcore_log_debug(ls->log, err, "accept4() not ready");
+                return;
+            }
+
+            if (err == EINTR || err == ECONNABORTED)
+                continue;
+
+            hcore_log_error(HCORE_LOG_ALERT, ls->log, err, "accept4() failed");
+
+            /*
+             * the level-triggered event is reported again at once while the
+             * fds are exhausted, so accepting is paused for a while
+             */
+
+            if ((err == EMFILE || err == ENFILE) && ls->loop
+                && ls->accept_delay)
+            {
+                if (hcore_event_del(ls->loop, ev, HCORE_EVENT_READ, 0)
+                    != HCORE_OK)
+                {
+                    return;
+                }
+
+                hcore_event_add_timer(ls->loop, ev, ls->accept_delay);
+            }
+
+            // the others are tried at next event
+
+            return;
+        }
+
+        if (ls->table)
+            c = hcore_get_connection(ls->table, fd, ls->log);
+        else
+            c = hcore_create_connection(ls->log, fd);
+
+        if (c == NULL)
+        {
+            close(fd);
+            return;
+        }
+
+        c->sockaddr = hcore_palloc(c->pool, socklen);
+        if (c->sockaddr == NULL)
+        {
+            if (ls->table)
+                hcore_put_connection(ls->table, c);
+            else
+                hcore_destroy_connection(c);
+
+            return;
+        }
+
+        hcore_memcpy(c->sockaddr, &sa, socklen);
+
+        c->socklen = socklen;
+        c->type = SOCK_STREAM;
+        c->local_sockaddr = &ls->sockaddr.sockaddr;
+        c->local_socklen = ls->socklen;
+        c->listening = ls;
+
+        ls->naccepted++;
+
+        hcore_log_debug(ls->log, 0, "accept: fd:#%d on fd:#%d", fd, lc->fd);
+
+        ls->handler(c);
+    }
+
+    // the budget is used up, the rest is left to next event
+}
+
 ssize_t
 hcore_udp_send(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
 {
@@ -162,19 +573,19 @@ ssize_t
 hcore_udp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
 {
     ssize_t n;
-    struct sockaddr sockaddr;
+    hcore_sockaddr_t sockaddr; // large enough for an IPv6 peer
     socklen_t socklen = sizeof(sockaddr);
     hcore_err_t err;
 
     if (c->bind_peer && c->socklen)
     {
-        sockaddr = *c->sockaddr;
-        socklen = c->socklen;
+        socklen = hcore_min(c->socklen, sizeof(sockaddr));
+        hcore_memcpy(&sockaddr, c->sockaddr, socklen);
     }
 
     for (;;)
     {
-        n = recvfrom(c->fd, buf, size, 0, &sockaddr, &socklen);
+        n = recvfrom(c->fd, buf, size, 0, &sockaddr.sockaddr, &socklen);
         if (0 < n)
         {
             hcore_log_debug(c->log, 0, "recvfrom %z/%uz bytes", n, size);
@@ -188,28 +599,11 @@ hcore_udp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
 
             if (c->bind_peer && !c->socklen)
             {
-                c->sockaddr = hcore_pcalloc(c->pool, socklen);
-                if (c->sockaddr == NULL)
-                {
-                    hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
-                                    "failed for creating sockaddr");
-                    continue;
-                }
-                *c->sockaddr = sockaddr;
-                c->socklen = socklen;
-
-                size_t max_len = hcore_get_max_addr_len(c->sockaddr->sa_family);
-                c->addr_text.data = hcore_palloc(c->pool, max_len);
-                if (c->addr_text.data == NULL)
+                if (hcore_udp_bind_peer(c, &sockaddr.sockaddr, socklen)
+                    != HCORE_OK)
                 {
                     return HCORE_ERROR;
                 }
-
-                c->addr_text.len = hcore_sock_ntop(c->sockaddr, c->socklen,
-                                                   c->addr_text.data, max_len);
-
-                hcore_log_debug(c->log, 0, "bind udp of peer '%V' is successful",
-                                &c->addr_text);
             }
 
             return n;
@@ -244,79 +638,462 @@ hcore_udp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
     }
 }
 
-ssize_t
-hcore_tcp_send(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
+hcore_int_t
+hcore_udp_enable_gso(hcore_connection_t *c)
 {
-    ssize_t n;
-    hcore_err_t err;
-    hcore_event_t *wev;
+    int       segment;
+    socklen_t len;
 
-    wev = c->rev;
+    hcore_assert(c);
 
-    for (;;)
-    {
-        n = send(c->fd, buf, size, 0);
+    len = sizeof(segment);
 
-        hcore_log_debug(c->log, 0, "send: fd:#%d %z of %uz", c->fd, n, size);
+    if (getsockopt(c->fd, SOL_UDP, UDP_SEGMENT, &segment, &len) == -1)
+    {
+        hcore_log_error(HCORE_LOG_NOTICE, c->log, errno,
+                        "getsockopt(UDP_SEGMENT) failed");
+        return HCORE_ERROR;
+    }
 
-        if (n > 0)
-        {
-            if (n < (ssize_t)size)
-            {
-                wev->ready = 0;
-            }
+    c->udp_gso = 1;
 
-            c->sent_size += n;
+    return HCORE_OK;
+}
 
-            return n;
-        }
+hcore_int_t
+hcore_udp_enable_gro(hcore_connection_t *c)
+{
+    int on;
 
-        err = errno;
+    hcore_assert(c);
 
-        if (n == 0)
-        {
-            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "send() returned zero");
-            wev->ready = 0;
-            return n;
-        }
+    on = 1;
 
-        if (err == EAGAIN || err == EINTR)
-        {
-            wev->ready = 0;
+    if (setsockopt(c->fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == -1)
+    {
+        hcore_log_error(HCORE_LOG_NOTICE, c->log, errno,
+                        "setsockopt(UDP_GRO) failed");
+        return HCORE_ERROR;
+    }
 
-            hcore_log_debug(c->log, err, "send() not ready");
+    c->udp_gro = 1;
 
-            if (err == EAGAIN)
-            {
-                return HCORE_AGAIN;
-            }
-        }
-        else
-        {
-            wev->error = 1;
-            hcore_log_error(HCORE_LOG_ALERT, c->log, errno, "send() failed");
-            return HCORE_ERROR;
-        }
-    }
+    return HCORE_OK;
 }
 
-ssize_t
-hcore_tcp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
+hcore_uint_t
+hcore_udp_split_msg(hcore_udp_msg_t *msg, hcore_buf_t *views, hcore_uint_t n)
 {
-    ssize_t n;
-    hcore_err_t err;
-    hcore_event_t *rev;
+    size_t         segment;
+    hcore_uint_t   i;
+    hcore_uchar_t *p, *last;
 
-    rev = c->rev;
+    hcore_assert(msg && views && n);
 
-    for (;;)
+    p       = msg->buf->pos;
+    last    = msg->buf->last;
+    segment = msg->segment ? msg->segment : (size_t)(last - p);
+
+    for (i = 0; i < n && (p < last || i == 0); i++)
     {
-        n = recv(c->fd, buf, size, 0);
+        views[i].start = views[i].pos = p;
 
-        hcore_log_debug(c->log, 0, "recv: fd:#%d %z of %uz", c->fd, n, size);
+        p = p + hcore_min(segment, (size_t)(last - p));
 
-        if (n == 0)
-        {
+        views[i].end = views[i].last = p;
+    }
+
+    return i;
+}
+
+ssize_t
+hcore_udp_send_batch(hcore_connection_t *c, hcore_udp_msg_t *msgs,
+                     hcore_uint_t n)
+{
+    int              rc;
+    size_t           size, segment, total;
+    hcore_uint_t     i, k, nhdrs, sent;
+    hcore_err_t      err;
+    hcore_event_t   *wev;
+    struct msghdr   *h;
+    struct cmsghdr  *cmsg;
+    struct iovec     iovs[HCORE_UDP_BATCH_MAX];
+    struct mmsghdr   hdrs[HCORE_UDP_BATCH_MAX];
+    hcore_uint_t     first[HCORE_UDP_BATCH_MAX + 1];
+    hcore_udp_cmsg_t ctls[HCORE_UDP_BATCH_MAX];
+
+    hcore_assert(c && msgs && n);
+
+    wev = c->wev;
+    n   = hcore_min(n, HCORE_UDP_BATCH_MAX);
+
+    for (i = 0; i < n; i++)
+    {
+        iovs[i].iov_base = msgs[i].buf->pos;
+        iovs[i].iov_len  = hcore_buf_get_size(msgs[i].buf);
+    }
+
+again:
+
+    hcore_memzero(hdrs, n * sizeof(struct mmsghdr));
+
+    /*
+     * one header per message, or per run of messages to the same peer
+     * if GSO is enabled: all of the run have the same size except the last
+     * one, which may be shorter
+     */
+
+    for (i = 0, nhdrs = 0; i < n; i = k, nhdrs++)
+    {
+        h = &hdrs[nhdrs].msg_hdr;
+
+        first[nhdrs] = i;
+
+        if (msgs[i].socklen)
+        {
+            h->msg_name    = &msgs[i].sockaddr;
+            h->msg_namelen = msgs[i].socklen;
+        }
+        else
+        {
+            h->msg_name    = c->sockaddr;
+            h->msg_namelen = c->socklen;
+        }
+
+        segment = iovs[i].iov_len;
+        total   = segment;
+
+        for (k = i + 1; c->udp_gso && segment && k < n; k++)
+        {
+            size = iovs[k].iov_len;
+
+            if (size == 0 || size > segment
+                || k - i == HCORE_UDP_GSO_MAX_SEGMENTS
+                || total + size > HCORE_UDP_GSO_MAX_SIZE
+                || msgs[k].socklen != msgs[i].socklen
+                || hcore_memcmp(&msgs[k].sockaddr, &msgs[i].sockaddr,
+                                msgs[i].socklen)
+                       != 0)
+            {
+                break;
+            }
+
+            total += size;
+
+            if (size < segment)
+            {
+                k++;
+                break;
+            }
+        }
+
+        h->msg_iov    = &iovs[i];
+        h->msg_iovlen = k - i;
+
+        if (k - i > 1)
+        {
+            h->msg_control    = &ctls[nhdrs];
+            h->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+            cmsg             = CMSG_FIRSTHDR(h);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+
+            *(uint16_t *)CMSG_DATA(cmsg) = (uint16_t)segment;
+        }
+    }
+
+    first[nhdrs] = n;
+
+    for (;;)
+    {
+        rc = sendmmsg(c->fd, hdrs, nhdrs, 0);
+
+        hcore_log_debug(c->log, 0, "sendmmsg: fd:%d %d of %ui (%ui msgs)",
+                        c->fd, rc, nhdrs, n);
+
+        if (rc >= 0)
+        {
+            break;
+        }
+
+        err = errno;
+
+        if (err == EAGAIN)
+        {
+            wev->ready = 0;
+            hcore_log_debug(c->log, err, "sendmmsg() not ready");
+            return HCORE_AGAIN;
+        }
+
+        if (err == EIO && c->udp_gso)
+        {
+            /* the device has no checksum offload */
+
+            hcore_log_error(HCORE_LOG_NOTICE, c->log, err,
+                            "sendmmsg() with UDP_SEGMENT failed, "
+                            "GSO is disabled");
+
+            c->udp_gso = 0;
+            goto again;
+        }
+
+        if (err != EINTR)
+        {
+            wev->error = 1;
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "sendmmsg() failed");
+            return HCORE_ERROR;
+        }
+    }
+
+    sent = first[rc];
+
+    for (k = 0; k < (hcore_uint_t)rc; k++)
+    {
+        for (i = first[k], total = 0; i < first[k + 1]; i++)
+        {
+            total += iovs[i].iov_len;
+        }
+
+        if (hdrs[k].msg_len != total)
+        {
+            wev->error = 1;
+            return HCORE_ERROR;
+        }
+    }
+
+    for (i = 0; i < sent; i++)
+    {
+        msgs[i].buf->pos = msgs[i].buf->last;
+
+        c->sent_size += iovs[i].iov_len;
+    }
+
+    if (sent < n)
+    {
+        wev->ready = 0;
+    }
+
+    return sent;
+}
+
+ssize_t
+hcore_udp_recv_batch(hcore_connection_t *c, hcore_udp_msg_t *msgs,
+                     hcore_uint_t n)
+{
+    int              rc;
+    hcore_uint_t     i, count;
+    hcore_buf_t     *b;
+    hcore_err_t      err;
+    hcore_udp_msg_t  tmp;
+    struct cmsghdr  *cmsg;
+    struct iovec     iovs[HCORE_UDP_BATCH_MAX];
+    struct mmsghdr   hdrs[HCORE_UDP_BATCH_MAX];
+    hcore_udp_cmsg_t ctls[HCORE_UDP_BATCH_MAX];
+
+    hcore_assert(c && msgs && n);
+
+    n = hcore_min(n, HCORE_UDP_BATCH_MAX);
+
+    for (;;)
+    {
+        hcore_memzero(hdrs, n * sizeof(struct mmsghdr));
+
+        for (i = 0; i < n; i++)
+        {
+            b = msgs[i].buf;
+
+            iovs[i].iov_base = b->last;
+            iovs[i].iov_len  = hcore_buf_get_freesize(b);
+
+            hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen  = 1;
+            hdrs[i].msg_hdr.msg_name    = &msgs[i].sockaddr;
+            hdrs[i].msg_hdr.msg_namelen = sizeof(hcore_sockaddr_t);
+
+            if (c->udp_gro)
+            {
+                hdrs[i].msg_hdr.msg_control    = &ctls[i];
+                hdrs[i].msg_hdr.msg_controllen = sizeof(hcore_udp_cmsg_t);
+            }
+        }
+
+        rc = recvmmsg(c->fd, hdrs, n, 0, NULL);
+
+        hcore_log_debug(c->log, 0, "recvmmsg: fd:%d %d of %ui", c->fd, rc, n);
+
+        if (rc == -1)
+        {
+            err = errno;
+
+            if (err == EAGAIN)
+            {
+                c->rev->ready = 0;
+                hcore_log_debug(c->log, err, "recvmmsg() not ready");
+                return HCORE_AGAIN;
+            }
+
+            if (err == EINTR) continue;
+
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "recvmmsg() failed");
+
+            c->rev->error = 1;
+
+            return HCORE_ERROR;
+        }
+
+        /* keep received messages at front and move dropped ones behind */
+
+        for (i = 0, count = 0; i < (hcore_uint_t)rc; i++)
+        {
+            msgs[i].socklen = hdrs[i].msg_hdr.msg_namelen;
+
+            if (msgs[i].socklen == 0 && c->known)
+            {
+                hcore_log_error(HCORE_LOG_NOTICE, c->log, 0,
+                                "receive a message from unknown client");
+                continue;
+            }
+
+            if (hdrs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                hcore_log_error(HCORE_LOG_NOTICE, c->log, 0,
+                                "message was truncated to %uz bytes",
+                                iovs[i].iov_len);
+            }
+
+            msgs[i].buf->last += hdrs[i].msg_len;
+            msgs[i].segment = 0;
+
+            if (c->udp_gro)
+            {
+                for (cmsg = CMSG_FIRSTHDR(&hdrs[i].msg_hdr); cmsg;
+                     cmsg = CMSG_NXTHDR(&hdrs[i].msg_hdr, cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP
+                        && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        msgs[i].segment = *(int *)CMSG_DATA(cmsg);
+                        break;
+                    }
+                }
+
+                if (msgs[i].segment >= hdrs[i].msg_len)
+                {
+                    msgs[i].segment = 0;
+                }
+            }
+
+            if (i != count)
+            {
+                tmp         = msgs[count];
+                msgs[count] = msgs[i];
+                msgs[i]     = tmp;
+            }
+
+            count++;
+        }
+
+        if (count == 0)
+        {
+            continue;
+        }
+
+        if (c->bind_peer && !c->socklen)
+        {
+            if (hcore_udp_bind_peer(c, &msgs[0].sockaddr.sockaddr,
+                                    msgs[0].socklen)
+                != HCORE_OK)
+            {
+                return HCORE_ERROR;
+            }
+        }
+
+        return count;
+    }
+}
+
+ssize_t
+hcore_tcp_send(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
+{
+    ssize_t n;
+    hcore_err_t err;
+    hcore_event_t *wev;
+
+    wev = c->wev;
+
+    if (c->flush == HCORE_TCP_FLUSH_CORK && !c->corked
+        && hcore_tcp_cork(c, 1) != HCORE_OK)
+    {
+        return HCORE_ERROR;
+    }
+
+    for (;;)
+    {
+        n = send(c->fd, buf, size,
+                 c->flush == HCORE_TCP_FLUSH_MORE ? MSG_MORE : 0);
+
+        hcore_log_debug(c->log, 0, "send: fd:#%d %z of %uz", c->fd, n, size);
+
+        if (n > 0)
+        {
+            if (n < (ssize_t)size)
+            {
+                wev->ready = 0;
+            }
+
+            c->sent_size += n;
+
+            return n;
+        }
+
+        err = errno;
+
+        if (n == 0)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "send() returned zero");
+            wev->ready = 0;
+            return n;
+        }
+
+        if (err == EAGAIN || err == EINTR)
+        {
+            wev->ready = 0;
+
+            hcore_log_debug(c->log, err, "send() not ready");
+
+            if (err == EAGAIN)
+            {
+                return HCORE_AGAIN;
+            }
+        }
+        else
+        {
+            wev->error = 1;
+            hcore_log_error(HCORE_LOG_ALERT, c->log, errno, "send() failed");
+            return HCORE_ERROR;
+        }
+    }
+}
+
+ssize_t
+hcore_tcp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
+{
+    ssize_t n;
+    hcore_err_t err;
+    hcore_event_t *rev;
+
+    rev = c->rev;
+
+    for (;;)
+    {
+        n = recv(c->fd, buf, size, 0);
+
+        hcore_log_debug(c->log, 0, "recv: fd:#%d %z of %uz", c->fd, n, size);
+
+        if (n == 0)
+        {
             rev->ready = 0;
             rev->eof = 1;
 
@@ -346,6 +1123,87 @@ hcore_tcp_recv(struct hcore_connection_s *c, hcore_uchar_t *buf, size_t size)
     }
 }
 
+ssize_t
+hcore_tcp_recv_chain(hcore_connection_t *c, hcore_chain_t *in,
+                     hcore_uint_t *nbufs)
+{
+    ssize_t        n;
+    size_t         size, left;
+    hcore_uint_t   count;
+    hcore_err_t    err;
+    hcore_chain_t *cl;
+    hcore_event_t *rev;
+    struct iovec   iovs[HCORE_IOV_MAX];
+
+    hcore_assert(c && in);
+
+    rev = c->rev;
+
+    if (nbufs) *nbufs = 0;
+
+    for (cl = in, count = 0; cl && count < HCORE_IOV_MAX; cl = cl->next)
+    {
+        size = hcore_buf_get_freesize(cl->buf);
+        if (size == 0) continue;
+
+        iovs[count].iov_base = cl->buf->last;
+        iovs[count].iov_len  = size;
+        count++;
+    }
+
+    if (count == 0)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                        "no free space in chain to receive");
+        return HCORE_ERROR;
+    }
+
+    n = hcore_readv(c->fd, iovs, count);
+
+    hcore_log_debug(c->log, 0, "readv: fd:#%d %z of %ui bufs", c->fd, n, count);
+
+    if (n == 0)
+    {
+        rev->ready = 0;
+        rev->eof   = 1;
+
+        return 0;
+    }
+
+    if (n > 0)
+    {
+        for (cl = in, left = n, count = 0; left; cl = cl->next)
+        {
+            size = hcore_min(left, (size_t)hcore_buf_get_freesize(cl->buf));
+            if (size == 0) continue;
+
+            cl->buf->last += size;
+            left -= size;
+            count++;
+        }
+
+        if (nbufs) *nbufs = count;
+
+        c->recv_size += n;
+
+        return n;
+    }
+
+    err = errno;
+
+    if (err == EAGAIN)
+    {
+        rev->ready = 0;
+        hcore_log_debug(c->log, err, "readv() not ready");
+        return HCORE_AGAIN;
+    }
+
+    rev->error = 1;
+    hcore_log_error(HCORE_LOG_ALERT, c->log, err, "readv() failed");
+
+    return HCORE_ERROR;
+}
+
 hcore_chain_t *
 hcore_tcp_send_chain(hcore_connection_t *c, hcore_chain_t *out)
 {
@@ -354,42 +1212,96 @@ hcore_tcp_send_chain(hcore_connection_t *c, hcore_chain_t *out)
     hcore_event_t *wev = c->wev;
     hcore_iovec_t vec;
     ssize_t n;
+    size_t size;
+    hcore_chain_t *sent;
     struct iovec iovs[HCORE_IOV_MAX];
 
+    if (c->zc_busy && hcore_tcp_reap_zerocopy(c) != HCORE_OK)
+        return HCORE_CHAIN_ERROR;
+
     if (!wev->ready)
         return out;
 
+    if (c->flush == HCORE_TCP_FLUSH_CORK && !c->corked
+        && hcore_tcp_cork(c, 1) != HCORE_OK)
+    {
+        return HCORE_CHAIN_ERROR;
+    }
+
     vec.iovs = iovs;
     vec.nalloc = HCORE_IOV_MAX;
 
     for (;;)
     {
-        // convert 'out' chain to iovec
-        if (hcore_output_chain_to_iovec(&vec, out, c->log) == HCORE_CHAIN_ERROR)
-            return HCORE_CHAIN_ERROR;
+        // skip the empty buffers
+        sent = out;
+        out = hcore_update_output_chain(out, 0);
 
-        // writev
+        if (c->zerocopy)
+            hcore_tcp_release_chain(c, sent, out);
 
-        n = hcore_writev(c->fd, vec.iovs, vec.count);
-        if (n == -1)
+        if (out == NULL)
+            return NULL;
+
+        if (out->buf->in_file)
         {
-            if (errno != EAGAIN)
-            {
-                c->wev->error = 1;
-                hcore_log_error(HCORE_LOG_ALERT, c->log, errno, "writev() failed");
+            // sendfile or splice
+
+            size = hcore_buf_get_file_size(out->buf);
+
+            n = hcore_tcp_send_file(c, out->buf, size);
+        }
+        else
+        {
+            // convert 'out' chain to iovec
+            if (hcore_output_chain_to_iovec(&vec, out, c->log) == HCORE_CHAIN_ERROR)
                 return HCORE_CHAIN_ERROR;
+
+            size = vec.size;
+
+            if (c->zerocopy && size >= c->zerocopy)
+            {
+                n = hcore_tcp_send_zerocopy(c, &vec);
+            }
+            else
+            {
+                // writev, or sendmsg() for MSG_MORE
+
+                n = hcore_tcp_sendv(c, &vec);
+                if (n == -1)
+                {
+                    if (errno != EAGAIN)
+                    {
+                        c->wev->error = 1;
+                        hcore_log_error(HCORE_LOG_ALERT, c->log, errno, "writev() failed");
+                        return HCORE_CHAIN_ERROR;
+                    }
+
+                    n = HCORE_AGAIN;
+                }
             }
+        }
+
+        if (n == HCORE_ERROR)
+            return HCORE_CHAIN_ERROR;
 
+        if (n == HCORE_AGAIN)
+        {
+            wev->ready = 0;
             return out;
         }
 
         /* 0 <= n */
 
+        sent = out;
         out = hcore_update_output_chain(out, n);
 
+        if (c->zerocopy)
+            hcore_tcp_release_chain(c, sent, out);
+
         c->sent_size += n;
 
-        if (vec.size != n)
+        if (size != (size_t)n)
         {
             wev->ready = 0;
             return out;
@@ -397,26 +1309,434 @@ hcore_tcp_send_chain(hcore_connection_t *c, hcore_chain_t *out)
     }
 }
 
+hcore_int_t
+hcore_connection_flush(hcore_connection_t *c)
+{
+    int on;
+
+    hcore_assert(c);
+
+    switch (c->flush)
+    {
+    case HCORE_TCP_FLUSH_CORK:
+        return c->corked ? hcore_tcp_cork(c, 0) : HCORE_OK;
+
+    case HCORE_TCP_FLUSH_MORE:
+        // setting TCP_NODELAY pushes pending frames out
+        on = 1;
+
+        if (setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, c->log, errno,
+                            "setsockopt(TCP_NODELAY) failed");
+            return HCORE_ERROR;
+        }
+
+        return HCORE_OK;
+
+    default:
+        return HCORE_OK;
+    }
+}
+
+static hcore_int_t
+hcore_tcp_cork(hcore_connection_t *c, int on)
+{
+    if (setsockopt(c->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, errno,
+                        "setsockopt(TCP_CORK, %d) failed", on);
+        return HCORE_ERROR;
+    }
+
+    c->corked = on ? 1 : 0;
+
+    return HCORE_OK;
+}
+
+static ssize_t
+hcore_tcp_sendv(hcore_connection_t *c, hcore_iovec_t *vec)
+{
+    ssize_t n;
+    struct msghdr msg;
+
+    if (c->flush != HCORE_TCP_FLUSH_MORE)
+        return hcore_writev(c->fd, vec->iovs, vec->count);
+
+    hcore_memzero(&msg, sizeof(struct msghdr));
+    msg.msg_iov = vec->iovs;
+    msg.msg_iovlen = vec->count;
+
+    do
+    {
+        n = sendmsg(c->fd, &msg, MSG_MORE);
+    } while (n == -1 && errno == EINTR);
+
+    return n;
+}
+
+hcore_int_t
+hcore_tcp_enable_zerocopy(hcore_connection_t *c, size_t threshold)
+{
+    int on;
+
+    hcore_assert(c && threshold);
+
+    on = 1;
+
+    if (setsockopt(c->fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == -1)
+    {
+        hcore_log_error(HCORE_LOG_NOTICE, c->log, errno,
+                        "setsockopt(SO_ZEROCOPY) failed");
+        return HCORE_ERROR;
+    }
+
+    c->zerocopy = threshold;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_tcp_reap_zerocopy(hcore_connection_t *c)
+{
+    ssize_t n;
+    hcore_err_t err;
+    hcore_chain_t *cl, *next;
+    hcore_zerocopy_t *zc;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct sock_extended_err *serr;
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err)
+                            + sizeof(struct sockaddr_in6))];
+        struct cmsghdr align;
+    } control;
+
+    hcore_assert(c);
+
+    for (;;)
+    {
+        hcore_memzero(&msg, sizeof(struct msghdr));
+        msg.msg_control = &control;
+        msg.msg_controllen = sizeof(control);
+
+        n = recvmsg(c->fd, &msg, MSG_ERRQUEUE);
+
+        if (n == -1)
+        {
+            err = errno;
+
+            if (err == EAGAIN)
+                break;
+
+            if (err == EINTR)
+                continue;
+
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err,
+                            "recvmsg(MSG_ERRQUEUE) failed");
+            return HCORE_ERROR;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                && !(cmsg->cmsg_level == SOL_IPV6
+                     && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+
+            serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+                continue;
+
+            // [ee_info, ee_data] were completed, the completion is in order
+
+            hcore_log_debug(c->log, 0, "zerocopy completed: %uD-%uD%s",
+                            serr->ee_info, serr->ee_data,
+                            (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                                ? " (copied)"
+                                : "");
+
+            if ((hcore_int32_t)(serr->ee_data + 1 - c->zc_done) > 0)
+                c->zc_done = serr->ee_data + 1;
+        }
+    }
+
+    // release the links of completed sends
+
+    while ((zc = c->zc_busy)
+           && (hcore_int32_t)(zc->seq - c->zc_done) < 0)
+    {
+        for (cl = zc->chain; cl; cl = next)
+        {
+            next = cl->next;
+            hcore_free_chain(c->pool, cl);
+        }
+
+        c->zc_busy = zc->next;
+
+        zc->next = c->zc_free;
+        c->zc_free = zc;
+    }
+
+    if (c->zc_busy == NULL)
+        c->zc_busy_last = NULL;
+
+    return HCORE_OK;
+}
+
+static ssize_t
+hcore_tcp_send_zerocopy(hcore_connection_t *c, hcore_iovec_t *vec)
+{
+    ssize_t n;
+    hcore_err_t err;
+    struct msghdr msg;
+
+    hcore_memzero(&msg, sizeof(struct msghdr));
+    msg.msg_iov = vec->iovs;
+    msg.msg_iovlen = vec->count;
+
+    for (;;)
+    {
+        n = sendmsg(c->fd, &msg,
+                    MSG_ZEROCOPY
+                        | (c->flush == HCORE_TCP_FLUSH_MORE ? MSG_MORE : 0));
+
+        hcore_log_debug(c->log, 0, "sendmsg(MSG_ZEROCOPY): fd:#%d %z of %uz",
+                        c->fd, n, vec->size);
+
+        if (n >= 0)
+        {
+            // every successful send takes a sequence
+            c->zc_seq++;
+            return n;
+        }
+
+        err = errno;
+
+        if (err == EAGAIN)
+            return HCORE_AGAIN;
+
+        if (err == ENOBUFS)
+        {
+            // the limit of optmem is reached, copy it
+            hcore_log_debug(c->log, err, "zerocopy is busy, copy it");
+
+            n = hcore_tcp_sendv(c, vec);
+            if (n >= 0)
+                return n;
+
+            err = errno;
+
+            if (err == EAGAIN)
+                return HCORE_AGAIN;
+        }
+
+        if (err != EINTR)
+        {
+            c->wev->error = 1;
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "sendmsg() failed");
+            return HCORE_ERROR;
+        }
+    }
+}
+
+static void
+hcore_tcp_release_chain(hcore_connection_t *c, hcore_chain_t *cl,
+                        hcore_chain_t *last)
+{
+    hcore_chain_t *next;
+    hcore_zerocopy_t *zc;
+
+    if (cl == last)
+        return;
+
+    // no zerocopy send is in flight, the data was copied
+
+    if (c->zc_done == c->zc_seq)
+    {
+        for (/* void */; cl != last; cl = next)
+        {
+            next = cl->next;
+            hcore_free_chain(c->pool, cl);
+        }
+
+        return;
+    }
+
+    // held by the last zerocopy send
+
+    zc = c->zc_busy_last;
+
+    if (zc == NULL || zc->seq != c->zc_seq - 1)
+    {
+        zc = c->zc_free;
+
+        if (zc)
+        {
+            c->zc_free = zc->next;
+        }
+        else
+        {
+            zc = hcore_palloc(c->pool, sizeof(hcore_zerocopy_t));
+            if (zc == NULL)
+            {
+                // never released, it's safer than releasing too early
+                hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                                "failed for holding zerocopy chain");
+                return;
+            }
+        }
+
+        zc->seq = c->zc_seq - 1;
+        zc->chain = NULL;
+        zc->last = &zc->chain;
+        zc->next = NULL;
+
+        if (c->zc_busy_last)
+            c->zc_busy_last->next = zc;
+        else
+            c->zc_busy = zc;
+
+        c->zc_busy_last = zc;
+    }
+
+    for (/* void */; cl != last; cl = cl->next)
+    {
+        *zc->last = cl;
+        zc->last = &cl->next;
+    }
+
+    *zc->last = NULL;
+}
+
+static ssize_t
+hcore_tcp_send_file(hcore_connection_t *c, hcore_buf_t *b, size_t size)
+{
+    ssize_t n;
+    off_t offset;
+    hcore_err_t err;
+
+    size = hcore_min(size, HCORE_SENDFILE_MAX);
+
+    for (;;)
+    {
+        if (b->in_pipe)
+        {
+            n = splice(b->fd, NULL, c->fd, NULL, size,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            hcore_log_debug(c->log, 0, "splice: fd:#%d %z of %uz", c->fd, n, size);
+        }
+        else
+        {
+            offset = b->file_pos;
+
+            n = sendfile(c->fd, b->fd, &offset, size);
+
+            hcore_log_debug(c->log, 0, "sendfile: fd:#%d %z of %uz @%O", c->fd, n,
+                            size, b->file_pos);
+        }
+
+        if (n > 0)
+            return n;
+
+        if (n == 0)
+        {
+            // the file was truncated or the writer of pipe was closed
+
+            c->wev->error = 1;
+            hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                            "%s() reported that no more data in fd:#%d",
+                            b->in_pipe ? "splice" : "sendfile", b->fd);
+            return HCORE_ERROR;
+        }
+
+        err = errno;
+
+        if (err == EAGAIN)
+        {
+            hcore_log_debug(c->log, err, "send file not ready");
+            return HCORE_AGAIN;
+        }
+
+        if (err != EINTR)
+        {
+            c->wev->error = 1;
+            hcore_log_error(HCORE_LOG_ALERT, c->log, err, "%s() failed",
+                            b->in_pipe ? "splice" : "sendfile");
+            return HCORE_ERROR;
+        }
+    }
+}
+
+static hcore_int_t
+hcore_udp_bind_peer(hcore_connection_t *c, struct sockaddr *sockaddr,
+                    socklen_t socklen)
+{
+    size_t max_len;
+
+    c->sockaddr = hcore_palloc(c->pool, socklen);
+    if (c->sockaddr == NULL)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                        "failed for creating sockaddr");
+        return HCORE_ERROR;
+    }
+
+    hcore_memcpy(c->sockaddr, sockaddr, socklen);
+    c->socklen = socklen;
+
+    max_len = hcore_get_max_addr_len(c->sockaddr->sa_family);
+
+    c->addr_text.data = hcore_palloc(c->pool, max_len);
+    if (c->addr_text.data == NULL)
+    {
+        return HCORE_ERROR;
+    }
+
+    c->addr_text.len = hcore_sock_ntop(c->sockaddr, c->socklen,
+                                       c->addr_text.data, max_len);
+
+    hcore_log_debug(c->log, 0, "bind udp of peer '%V' is successful",
+                    &c->addr_text);
+
+    return HCORE_OK;
+}
+
 static hcore_chain_t *
 hcore_update_output_chain(hcore_chain_t *out, size_t sent)
 {
     size_t size;
+    hcore_buf_t *b;
 
-    if (sent == 0)
-        return out;
+    // return the first buffer that isn't sent completely
 
     for (/* void */; out; out = out->next)
     {
-        size = hcore_buf_get_size(out->buf);
+        b = out->buf;
 
-        size = hcore_min(sent, size);
+        size = b->in_file ? hcore_buf_get_file_size(b) : hcore_buf_get_size(b);
 
-        out->buf->pos += size;
-
-        sent -= size;
+        if (size > sent)
+        {
+            if (b->in_file)
+                b->file_pos += sent;
+            else
+                b->pos += sent;
 
-        if (sent == 0)
             break;
+        }
+
+        if (b->in_file)
+            b->file_pos = b->file_last;
+        else
+            b->pos = b->last;
+
+        sent -= size;
     }
 
     return out;
@@ -435,23 +1755,31 @@ hcore_output_chain_to_iovec(hcore_iovec_t *vec, hcore_chain_t *out, hcore_log_t
     n = 0;
     total = 0;
     prev_last = NULL;
+    iov = NULL;
 
     for (/* void */; out; out = out->next)
     {
         hcore_assert(out->buf);
 
-        if (n == vec->nalloc)
+        // the file buffer is sent alone
+        if (out->buf->in_file)
             break;
 
         size = hcore_buf_get_size(out->buf);
 
-        if (prev_last == out->buf->pos)
+        if (size == 0)
+            continue;
+
+        if (iov && prev_last == out->buf->pos)
         {
             // concat buffer
             iov->iov_len += size;
         }
         else
         {
+            if (n == vec->nalloc)
+                break;
+
             iov = &vec->iovs[n++];
 
             iov->iov_base = (void *)out->buf->pos;
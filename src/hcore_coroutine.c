@@ -0,0 +1,502 @@
+/**
+ * @file hcore_coroutine.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_coroutine.h>
+#include <hcore_debug.h>
+#include <hcore_event.h>
+#include <hcore_event_timer.h>
+
+#include <sys/mman.h>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+static hcore_co_t *hcore_co_alloc(hcore_co_sched_t *sched);
+static void        hcore_co_main(hcore_co_t *co);
+static void        hcore_co_event_handler(hcore_event_t *ev);
+
+/* the coroutine running in the thread, NULL means the loop is running */
+static __thread hcore_co_t *hcore_co_current;
+
+#if defined(__x86_64__)
+
+/*
+ * Only the callee-saved registers and the control words of x87 and SSE are
+ * saved, the others are saved by the caller of 'hcore_co_switch()' as it's a
+ * normal function call.
+ *
+ * layout of saved context from 'sp' upwards:
+ *
+ *     mxcsr, x87 cw | r15 | r14 | r13 | r12 | rbx | rbp | return address
+ */
+
+void hcore_co_switch(void **from, void *to);
+void hcore_co_trampoline(void);
+
+__asm__(".text\n"
+        ".p2align 4\n"
+        ".globl hcore_co_switch\n"
+        ".hidden hcore_co_switch\n"
+        ".type hcore_co_switch, @function\n"
+        "hcore_co_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size hcore_co_switch, .-hcore_co_switch\n"
+
+        /* the first switch to a coroutine returns here, 'r12' is it */
+
+        ".p2align 4\n"
+        ".globl hcore_co_trampoline\n"
+        ".hidden hcore_co_trampoline\n"
+        ".type hcore_co_trampoline, @function\n"
+        "hcore_co_trampoline:\n"
+        "    movq %r12, %rdi\n"
+        "    callq *%r13\n"
+        "    ud2\n"
+        ".size hcore_co_trampoline, .-hcore_co_trampoline\n");
+
+static void
+hcore_co_make(hcore_co_t *co, void *top)
+{
+    uint64_t *sp;
+
+    // 'rsp' is 16-byte aligned after returning to the trampoline
+
+    sp = (uint64_t *)((uintptr_t)top & ~(uintptr_t)15) - 10;
+
+    sp[0] = 0x1f80 | ((uint64_t)0x037f << 32); // default mxcsr and x87 cw
+    sp[1] = 0;                                 // r15
+    sp[2] = 0;                                 // r14
+    sp[3] = (uintptr_t)hcore_co_main;          // r13
+    sp[4] = (uintptr_t)co;                     // r12
+    sp[5] = 0;                                 // rbx
+    sp[6] = 0;                                 // rbp
+    sp[7] = (uintptr_t)hcore_co_trampoline;    // return address
+
+    co->sp = sp;
+}
+
+#else
+
+/*
+ * the portable but slower fallback, 'sp' points to a ucontext_t which is
+ * placed below the coroutine, or embedded in the scheduler for 'main'
+ */
+
+static void
+hcore_co_switch(void **from, void *to)
+{
+    swapcontext(*from, to);
+}
+
+static void
+hcore_co_entry(unsigned int hi, unsigned int lo)
+{
+    hcore_co_main((hcore_co_t *)(((uintptr_t)hi << 32) | lo));
+}
+
+static void
+hcore_co_make(hcore_co_t *co, void *top)
+{
+    ucontext_t *uc;
+
+    uc = (ucontext_t *)((uintptr_t)(co) - sizeof(ucontext_t)) - 1;
+    uc = (ucontext_t *)((uintptr_t)uc & ~(uintptr_t)15);
+
+    getcontext(uc);
+
+    uc->uc_stack.ss_sp   = (char *)top - co->sched->stack_size;
+    uc->uc_stack.ss_size = (uintptr_t)uc - (uintptr_t)uc->uc_stack.ss_sp;
+    uc->uc_link          = NULL;
+
+    makecontext(uc, (void (*)(void))hcore_co_entry, 2,
+                (unsigned int)((uintptr_t)co >> 32), (unsigned int)(uintptr_t)co);
+
+    co->sp = uc;
+}
+
+#endif
+
+hcore_co_sched_t *
+hcore_create_co_sched(hcore_event_loop_t *loop, size_t stack_size,
+                      hcore_uint_t max)
+{
+    size_t            page;
+    hcore_co_sched_t *sched;
+
+    hcore_assert(loop);
+
+    if (loop == NULL) return NULL;
+
+    if (stack_size == 0) stack_size = HCORE_CO_STACK_SIZE_DEFAULT;
+
+    page       = (size_t)sysconf(_SC_PAGESIZE);
+    stack_size = (stack_size + page - 1) / page * page;
+
+    sched = hcore_pcalloc(loop->pool, sizeof(hcore_co_sched_t));
+    if (sched == NULL) return NULL;
+
+#if !defined(__x86_64__)
+    sched->main.sp = hcore_pcalloc(loop->pool, sizeof(ucontext_t));
+    if (sched->main.sp == NULL) return NULL;
+#endif
+
+    sched->loop       = loop;
+    sched->log        = loop->log;
+    sched->main.sched = sched;
+    sched->stack_size = stack_size;
+    sched->max        = max;
+    sched->guard      = 1;
+
+    return sched;
+}
+
+void
+hcore_destroy_co_sched(hcore_co_sched_t *sched)
+{
+    hcore_co_slab_t *slab;
+
+    hcore_assert(sched && hcore_co_current == NULL);
+
+    if (sched == NULL) return;
+
+    for (slab = sched->slabs; slab; slab = slab->next)
+    {
+        if (munmap(slab->addr, slab->size) == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, sched->log, errno,
+                            "munmap() of coroutine stacks failed");
+        }
+    }
+
+    sched->slabs   = NULL;
+    sched->free    = NULL;
+    sched->nstacks = 0;
+    sched->ncos    = 0;
+}
+
+hcore_co_t *
+hcore_co_spawn(hcore_co_sched_t *sched, hcore_co_handler_pt handler,
+               void *data)
+{
+    hcore_co_t *co;
+
+    hcore_assert(sched && handler);
+
+    if (sched->max && sched->ncos >= sched->max)
+    {
+        hcore_log_error(HCORE_LOG_ERR, sched->log, 0,
+                        "%ui coroutines are not enough", sched->max);
+        return NULL;
+    }
+
+    co = sched->free;
+
+    if (co)
+    {
+        sched->free = co->next;
+    }
+    else
+    {
+        co = hcore_co_alloc(sched);
+        if (co == NULL) return NULL;
+    }
+
+    co->caller  = NULL;
+    co->handler = handler;
+    co->data    = data;
+    co->timeout = 0;
+    co->next    = NULL;
+    co->done    = 0;
+
+    hcore_co_make(co, co);
+
+    sched->ncos++;
+
+    hcore_co_resume(co);
+
+    return co;
+}
+
+void
+hcore_co_resume(hcore_co_t *co)
+{
+    hcore_co_t       *from;
+    hcore_co_sched_t *sched;
+
+    hcore_assert(co && !co->done && co != hcore_co_current);
+
+    sched = co->sched;
+    from  = hcore_co_current ? hcore_co_current : &sched->main;
+
+    co->caller       = from;
+    hcore_co_current = co;
+
+    sched->nswitches++;
+
+    hcore_co_switch(&from->sp, co->sp);
+
+    hcore_co_current = from == &sched->main ? NULL : from;
+
+    if (co->done)
+    {
+        /* it's safe to reuse the stack after switching out of it */
+
+        co->next    = sched->free;
+        sched->free = co;
+
+        sched->ncos--;
+    }
+}
+
+void
+hcore_co_yield(void)
+{
+    hcore_co_t *co;
+
+    co = hcore_co_current;
+
+    hcore_assert(co);
+
+    co->sched->nswitches++;
+
+    hcore_co_switch(&co->sp, co->caller->sp);
+}
+
+hcore_co_t *
+hcore_co_self(void)
+{
+    return hcore_co_current;
+}
+
+hcore_int_t
+hcore_co_wait(hcore_event_t *ev, hcore_msec_t timer)
+{
+    hcore_co_t         *co;
+    hcore_event_loop_t *loop;
+    hcore_connection_t *c;
+
+    co = hcore_co_current;
+
+    hcore_assert(co && ev && ev->co == NULL);
+
+    c    = ev->data;
+    loop = co->sched->loop;
+
+    if (!c->rev->active && !c->wev->active)
+    {
+        c->rev->handler = hcore_co_event_handler;
+        c->wev->handler = hcore_co_event_handler;
+
+        if (hcore_event_add_conn(loop, c) != HCORE_OK) return HCORE_ERROR;
+    }
+    else if (!ev->active)
+    {
+        // the opposite event was added by the caller
+
+        if (hcore_event_add(loop, ev,
+                            ev == c->wev ? HCORE_EVENT_WRITE : HCORE_EVENT_READ,
+                            HCORE_CLEAR_EVENT)
+            != HCORE_OK)
+        {
+            return HCORE_ERROR;
+        }
+    }
+
+    ev->handler = hcore_co_event_handler;
+
+    if (timer) hcore_event_add_timer(loop, ev, timer);
+
+    ev->co = co;
+
+    hcore_co_yield();
+
+    ev->co = NULL;
+
+    if (ev->timeout)
+    {
+        ev->timeout = 0;
+        c->timeout  = 1;
+
+        hcore_log_error(HCORE_LOG_INFO, c->log, 0, "coroutine: fd:%d timed out",
+                        c->fd);
+        return HCORE_ERROR;
+    }
+
+    if (ev->timer_set) hcore_event_del_timer(loop, ev);
+
+    return HCORE_OK;
+}
+
+ssize_t
+hcore_co_recv(hcore_connection_t *c, hcore_uchar_t *buf, size_t size)
+{
+    ssize_t n;
+
+    hcore_assert(c && hcore_co_current);
+
+    for (;;)
+    {
+        n = hcore_tcp_recv(c, buf, size);
+
+        if (n != HCORE_AGAIN) return n;
+
+        if (hcore_co_wait(c->rev, hcore_co_current->timeout) != HCORE_OK)
+        {
+            return HCORE_ERROR;
+        }
+    }
+}
+
+ssize_t
+hcore_co_send(hcore_connection_t *c, hcore_uchar_t *buf, size_t size)
+{
+    size_t  sent;
+    ssize_t n;
+
+    hcore_assert(c && hcore_co_current);
+
+    for (sent = 0; sent < size; /* void */)
+    {
+        n = hcore_tcp_send(c, buf + sent, size - sent);
+
+        if (n == HCORE_ERROR) return HCORE_ERROR;
+
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+
+        if (hcore_co_wait(c->wev, hcore_co_current->timeout) != HCORE_OK)
+        {
+            return HCORE_ERROR;
+        }
+    }
+
+    return size;
+}
+
+static hcore_co_t *
+hcore_co_alloc(hcore_co_sched_t *sched)
+{
+    size_t           page, slot, size;
+    hcore_uint_t     i;
+    hcore_uchar_t   *p;
+    hcore_co_t      *co, *first;
+    hcore_co_slab_t *slab;
+
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    slot = sched->stack_size + (sched->guard ? page : 0);
+    size = slot * HCORE_CO_SLAB_SIZE;
+
+    slab = hcore_palloc(sched->loop->pool, sizeof(hcore_co_slab_t));
+    if (slab == NULL) return NULL;
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+
+    if (p == MAP_FAILED)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, sched->log, errno,
+                        "mmap(%uz) of coroutine stacks failed", size);
+        return NULL;
+    }
+
+    slab->addr   = p;
+    slab->size   = size;
+    slab->next   = sched->slabs;
+    sched->slabs = slab;
+
+    /*
+     * the stack grows down from the coroutine at its top to the guard page
+     * at its bottom, the stacks are pushed to the free list
+     */
+
+    first = NULL;
+
+    for (i = 0; i < HCORE_CO_SLAB_SIZE; i++, p += slot)
+    {
+        if (sched->guard && mprotect(p, page, PROT_NONE) == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, sched->log, errno,
+                            "mprotect() of guard page failed");
+            return NULL;
+        }
+
+        co = (hcore_co_t *)(p + slot) - 1;
+        co = (hcore_co_t *)((uintptr_t)co & ~(uintptr_t)15);
+
+        co->sched = sched;
+
+        if (first == NULL)
+        {
+            first = co;
+            continue;
+        }
+
+        co->next    = sched->free;
+        sched->free = co;
+    }
+
+    sched->nstacks += HCORE_CO_SLAB_SIZE;
+
+    hcore_log_debug(sched->log, 0, "coroutine: %ui stacks are mapped",
+                    sched->nstacks);
+
+    return first;
+}
+
+static void
+hcore_co_main(hcore_co_t *co)
+{
+    co->handler(co);
+
+    co->done = 1;
+
+    co->sched->nswitches++;
+
+    // never returns, the stack is reused by the caller
+
+    hcore_co_switch(&co->sp, co->caller->sp);
+}
+
+static void
+hcore_co_event_handler(hcore_event_t *ev)
+{
+    // the edge of an event which isn't waited is remembered by 'ev->ready'
+
+    if (ev->co) hcore_co_resume(ev->co);
+}
@@ -10,3 +10,384 @@
  * @format: UTF-8
  * @abbr:
  */
+
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_debug.h>
+#include <hcore_event.h>
+#include <hcore_event_timer.h>
+#include <hcore_uring.h>
+
+#include <sys/epoll.h>
+
+hcore_event_loop_t *
+hcore_create_event_loop(hcore_pool_t *pool, hcore_uint_t nevents)
+{
+    hcore_event_loop_t *loop;
+
+    hcore_assert(pool);
+
+    if (pool == NULL) return NULL;
+
+    if (nevents == 0) nevents = HCORE_EVENT_NEVENTS_DEFAULT;
+
+    loop = hcore_pcalloc(pool, sizeof(hcore_event_loop_t));
+    if (loop == NULL) return NULL;
+
+    loop->event_list = hcore_palloc(pool, sizeof(struct epoll_event) * nevents);
+    if (loop->event_list == NULL) return NULL;
+
+    loop->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->ep == -1)
+    {
+        hcore_log_error(HCORE_LOG_EMERG, pool->log, errno,
+                        "epoll_create1() failed");
+        return NULL;
+    }
+
+    loop->nevents = nevents;
+    loop->pool    = pool;
+    loop->log     = pool->log;
+
+    if (hcore_event_timer_init(loop) != HCORE_OK)
+    {
+        close(loop->ep);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void
+hcore_destroy_event_loop(hcore_event_loop_t *loop)
+{
+    hcore_assert(loop);
+
+    if (loop == NULL) return;
+
+    if (loop->uring)
+    {
+        hcore_destroy_uring(loop->uring);
+        loop->uring = NULL;
+    }
+
+    if (loop->ep != -1 && close(loop->ep) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno,
+                        "epoll close() failed");
+    }
+
+    loop->ep = -1;
+}
+
+hcore_int_t
+hcore_event_add(hcore_event_loop_t *loop, hcore_event_t *ev,
+                hcore_uint_t event, hcore_uint_t flags)
+{
+    int                 op;
+    uint32_t            events, prev;
+    hcore_event_t      *e;
+    hcore_connection_t *c;
+    struct epoll_event  ee;
+
+    hcore_event_flag_assert(event);
+
+    c = ev->data;
+
+    if (event == HCORE_EVENT_READ)
+    {
+        e      = c->wev;
+        prev   = EPOLLOUT;
+        events = EPOLLIN | EPOLLRDHUP;
+    }
+    else
+    {
+        e      = c->rev;
+        prev   = EPOLLIN | EPOLLRDHUP;
+        events = EPOLLOUT;
+    }
+
+    if (e->active)
+    {
+        op = EPOLL_CTL_MOD;
+        events |= prev;
+    }
+    else
+    {
+        op = EPOLL_CTL_ADD;
+    }
+
+    if (flags & HCORE_CLEAR_EVENT)
+    {
+        events |= EPOLLET;
+    }
+
+    ee.events   = events;
+    ee.data.ptr = (void *)((uintptr_t)c | ev->instance);
+
+    hcore_log_debug(loop->log, 0, "epoll add event: fd:%d op:%d ev:%08XD",
+                    c->fd, op, ee.events);
+
+    if (epoll_ctl(loop->ep, op, c->fd, &ee) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno,
+                        "epoll_ctl(%d, %d) failed", op, c->fd);
+        return HCORE_ERROR;
+    }
+
+    ev->active = 1;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_event_del(hcore_event_loop_t *loop, hcore_event_t *ev,
+                hcore_uint_t event, hcore_uint_t flags)
+{
+    int                 op;
+    uint32_t            prev;
+    hcore_event_t      *e;
+    hcore_connection_t *c;
+    struct epoll_event  ee;
+
+    hcore_event_flag_assert(event);
+
+    /*
+     * when the file descriptor is closed, the epoll automatically deletes
+     * it from its queue, so we do not need to delete explicitly the event
+     * before the closing the file descriptor
+     */
+
+    if (flags & HCORE_CLOSE_EVENT)
+    {
+        ev->active = 0;
+        return HCORE_OK;
+    }
+
+    c = ev->data;
+
+    if (event == HCORE_EVENT_READ)
+    {
+        e    = c->wev;
+        prev = EPOLLOUT;
+    }
+    else
+    {
+        e    = c->rev;
+        prev = EPOLLIN | EPOLLRDHUP;
+    }
+
+    if (e->active)
+    {
+        op          = EPOLL_CTL_MOD;
+        ee.events   = prev;
+        ee.data.ptr = (void *)((uintptr_t)c | ev->instance);
+    }
+    else
+    {
+        op          = EPOLL_CTL_DEL;
+        ee.events   = 0;
+        ee.data.ptr = NULL;
+    }
+
+    hcore_log_debug(loop->log, 0, "epoll del event: fd:%d op:%d ev:%08XD",
+                    c->fd, op, ee.events);
+
+    if (epoll_ctl(loop->ep, op, c->fd, &ee) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno,
+                        "epoll_ctl(%d, %d) failed", op, c->fd);
+        return HCORE_ERROR;
+    }
+
+    ev->active = 0;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_event_add_conn(hcore_event_loop_t *loop, hcore_connection_t *c)
+{
+    struct epoll_event ee;
+
+    ee.events   = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    ee.data.ptr = (void *)((uintptr_t)c | c->rev->instance);
+
+    hcore_log_debug(loop->log, 0, "epoll add connection: fd:%d ev:%08XD",
+                    c->fd, ee.events);
+
+    if (epoll_ctl(loop->ep, EPOLL_CTL_ADD, c->fd, &ee) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno,
+                        "epoll_ctl(EPOLL_CTL_ADD, %d) failed", c->fd);
+        return HCORE_ERROR;
+    }
+
+    c->rev->active = 1;
+    c->wev->active = 1;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_event_del_conn(hcore_event_loop_t *loop, hcore_connection_t *c,
+                     hcore_uint_t flags)
+{
+    struct epoll_event ee;
+
+    /*
+     * when the file descriptor is closed the epoll automatically deletes
+     * it from its queue so we do not need to delete explicitly the event
+     * before the closing the file descriptor
+     */
+
+    if (flags & HCORE_CLOSE_EVENT)
+    {
+        c->rev->active = 0;
+        c->wev->active = 0;
+        return HCORE_OK;
+    }
+
+    hcore_log_debug(loop->log, 0, "epoll del connection: fd:%d", c->fd);
+
+    ee.events   = 0;
+    ee.data.ptr = NULL;
+
+    if (epoll_ctl(loop->ep, EPOLL_CTL_DEL, c->fd, &ee) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno,
+                        "epoll_ctl(EPOLL_CTL_DEL, %d) failed", c->fd);
+        return HCORE_ERROR;
+    }
+
+    c->rev->active = 0;
+    c->wev->active = 0;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_event_process(hcore_event_loop_t *loop, hcore_msec_t timer)
+{
+    int                 events;
+    uint32_t            revents;
+    hcore_int_t         i;
+    hcore_err_t         err;
+    hcore_uint_t        instance;
+    hcore_msec_t        t;
+    hcore_event_t      *rev, *wev;
+    hcore_connection_t *c;
+
+    t = hcore_event_find_timer(loop);
+
+    if (t != HCORE_TIMER_INFINITE
+        && (timer == HCORE_TIMER_INFINITE || t < timer))
+    {
+        timer = t;
+    }
+
+    hcore_log_debug(loop->log, 0, "epoll timer: %M", timer);
+
+    /*
+     * operations queued by handlers of the last iteration are submitted by
+     * one syscall, the completions make the fd of ring readable
+     */
+
+    if (loop->uring && hcore_uring_submit(loop->uring) != HCORE_OK)
+    {
+        return HCORE_ERROR;
+    }
+
+    events = epoll_wait(loop->ep, loop->event_list, (int)loop->nevents,
+                        timer == HCORE_TIMER_INFINITE ? -1 : (int)timer);
+
+    err = (events == -1) ? errno : 0;
+
+    hcore_event_update_time(loop);
+
+    if (err)
+    {
+        if (err == EINTR)
+        {
+            hcore_log_debug(loop->log, err, "epoll_wait() was interrupted");
+            hcore_event_expire_timers(loop);
+            return HCORE_OK;
+        }
+
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, err, "epoll_wait() failed");
+        return HCORE_ERROR;
+    }
+
+    if (events == 0 && timer == HCORE_TIMER_INFINITE)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, 0,
+                        "epoll_wait() returned no events without timeout");
+        return HCORE_ERROR;
+    }
+
+    for (i = 0; i < events; i++)
+    {
+        c = loop->event_list[i].data.ptr;
+
+        instance = (uintptr_t)c & 1;
+        c        = (hcore_connection_t *)((uintptr_t)c & (uintptr_t)~1);
+
+        rev = c->rev;
+
+        if (c->fd == -1 || rev->instance != instance)
+        {
+            /*
+             * the stale event from a file descriptor
+             * that was just closed in this iteration,
+             * or its connection was reused
+             */
+
+            hcore_log_debug(loop->log, 0, "epoll: stale event %p", c);
+            continue;
+        }
+
+        revents = loop->event_list[i].events;
+
+        hcore_log_debug(loop->log, 0, "epoll: fd:%d ev:%04XD d:%p", c->fd,
+                        revents, c);
+
+        if (revents & (EPOLLERR | EPOLLHUP))
+        {
+            hcore_log_debug(loop->log, 0, "epoll_wait() error on fd:%d ev:%04XD",
+                            c->fd, revents);
+
+            /*
+             * if the error events were returned, add EPOLLIN and EPOLLOUT
+             * to handle the events at least in one active handler
+             */
+
+            revents |= EPOLLIN | EPOLLOUT;
+        }
+
+        if ((revents & EPOLLIN) && rev->active)
+        {
+            rev->ready = 1;
+
+            rev->handler(rev);
+        }
+
+        wev = c->wev;
+
+        if ((revents & EPOLLOUT) && wev->active)
+        {
+            if (c->fd == -1 || wev->instance != instance)
+            {
+                /* the connection was closed by the read handler */
+                continue;
+            }
+
+            wev->ready = 1;
+
+            wev->handler(wev);
+        }
+    }
+
+    hcore_event_expire_timers(loop);
+
+    return HCORE_OK;
+}
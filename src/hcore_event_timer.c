@@ -0,0 +1,502 @@
+/**
+ * @file hcore_event_timer.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#include <hcore_base.h>
+#include <hcore_debug.h>
+#include <hcore_event_timer.h>
+#include <hcore_time.h>
+
+#define hcore_event_timer_wheel_slot(wheel, level, index)     \
+    (&(wheel)->slots[HCORE_TIMER_WHEEL_ROOT_SIZE              \
+                     + ((level)-1) * HCORE_TIMER_WHEEL_SIZE + (index)])
+
+static void hcore_event_timer_wheel_link(hcore_event_timer_wheel_t *wheel,
+                                         hcore_event_t             *ev);
+static void hcore_event_timer_wheel_unlink(hcore_event_timer_wheel_t *wheel,
+                                           hcore_event_t             *ev);
+static hcore_int_t  hcore_event_timer_wheel_scan(hcore_event_timer_wheel_t *wheel,
+                                                 hcore_uint_t               from);
+static hcore_uint_t hcore_event_timer_wheel_cascade(
+    hcore_event_timer_wheel_t *wheel, hcore_uint_t level, hcore_uint_t index);
+static hcore_msec_t hcore_event_timer_wheel_find(hcore_event_loop_t *loop);
+static void         hcore_event_timer_wheel_expire(hcore_event_loop_t *loop);
+
+hcore_int_t
+hcore_event_timer_init(hcore_event_loop_t *loop)
+{
+    hcore_rbtree_init(&loop->timer, &loop->timer_sentinel,
+                      hcore_rbtree_insert_timer_value);
+
+    hcore_event_update_time(loop);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_event_timer_use_wheel(hcore_event_loop_t *loop, hcore_msec_t tick)
+{
+    hcore_uint_t               i;
+    hcore_event_timer_wheel_t *wheel;
+
+    hcore_assert(loop);
+
+    if (loop == NULL) return HCORE_ERROR;
+
+    if (loop->timer_wheel) return HCORE_OK;
+
+    if (loop->timer.root != loop->timer.sentinel)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, 0,
+                        "timer wheel must be used before arming timers");
+        return HCORE_ERROR;
+    }
+
+    wheel = hcore_pcalloc(loop->pool, sizeof(hcore_event_timer_wheel_t));
+    if (wheel == NULL) return HCORE_ERROR;
+
+    for (i = 0; i < HCORE_TIMER_WHEEL_SLOTS; i++)
+    {
+        hcore_queue_init(&wheel->slots[i]);
+    }
+
+    wheel->tick    = tick ? tick : HCORE_TIMER_WHEEL_TICK_DEFAULT;
+    wheel->jiffies = 0;
+    wheel->msec    = loop->current_msec;
+    wheel->count   = 0;
+
+    loop->timer_wheel = wheel;
+
+    return HCORE_OK;
+}
+
+void
+hcore_event_update_time(hcore_event_loop_t *loop)
+{
+    loop->current_msec = hcore_monotonic_time();
+}
+
+hcore_msec_t
+hcore_event_find_timer(hcore_event_loop_t *loop)
+{
+    hcore_msec_int_t     timer;
+    hcore_rbtree_node_t *node, *root, *sentinel;
+
+    if (loop->timer_wheel)
+    {
+        return hcore_event_timer_wheel_find(loop);
+    }
+
+    if (loop->timer.root == &loop->timer_sentinel)
+    {
+        return HCORE_TIMER_INFINITE;
+    }
+
+    root     = loop->timer.root;
+    sentinel = loop->timer.sentinel;
+
+    node = hcore_rbtree_min(root, sentinel);
+
+    timer = (hcore_msec_int_t)(node->key - loop->current_msec);
+
+    return (hcore_msec_t)(timer > 0 ? timer : 0);
+}
+
+void
+hcore_event_expire_timers(hcore_event_loop_t *loop)
+{
+    hcore_event_t       *ev;
+    hcore_rbtree_node_t *node, *root, *sentinel;
+
+    if (loop->timer_wheel)
+    {
+        hcore_event_timer_wheel_expire(loop);
+        return;
+    }
+
+    sentinel = loop->timer.sentinel;
+
+    for (;;)
+    {
+        root = loop->timer.root;
+
+        if (root == sentinel)
+        {
+            return;
+        }
+
+        node = hcore_rbtree_min(root, sentinel);
+
+        /* node->key > loop->current_msec */
+
+        if ((hcore_msec_int_t)(node->key - loop->current_msec) > 0)
+        {
+            return;
+        }
+
+        ev = HCORE_GET_DATA_BY_FIELD(node, hcore_event_t, timer);
+
+        hcore_log_debug(loop->log, 0, "event timer del: %p: %ud", ev,
+                        ev->timer.key);
+
+        hcore_rbtree_delete(&loop->timer, &ev->timer);
+
+        ev->timer_set = 0;
+        ev->timeout   = 1;
+
+        ev->handler(ev);
+    }
+}
+
+void
+hcore_event_add_timer(hcore_event_loop_t *loop, hcore_event_t *ev,
+                      hcore_msec_t timer)
+{
+    hcore_msec_t     key;
+    hcore_msec_int_t diff;
+
+    key = loop->current_msec + timer;
+
+    if (ev->timer_set)
+    {
+        /*
+         * Use a previous timer value if difference between it and a new
+         * value is less than HCORE_TIMER_LAZY_DELAY milliseconds: this allows
+         * to minimize the rbtree operations for fast connections. Moving a
+         * timer of the wheel is cheap, and it never fires early, so the new
+         * value is always used.
+         */
+
+        diff = (hcore_msec_int_t)(key - ev->timer.key);
+
+        if (loop->timer_wheel == NULL
+            && hcore_abs(diff) < HCORE_TIMER_LAZY_DELAY)
+        {
+            hcore_log_debug(loop->log, 0, "event timer: %p, old: %ud, new: %ud",
+                            ev, ev->timer.key, key);
+            return;
+        }
+
+        hcore_event_del_timer(loop, ev);
+    }
+
+    ev->timer.key = key;
+
+    hcore_log_debug(loop->log, 0, "event timer add: %p: %ud:%ud", ev, timer,
+                    ev->timer.key);
+
+    if (loop->timer_wheel)
+    {
+        hcore_event_timer_wheel_link(loop->timer_wheel, ev);
+        loop->timer_wheel->count++;
+    }
+    else
+    {
+        hcore_rbtree_insert(&loop->timer, &ev->timer);
+    }
+
+    ev->timer_set = 1;
+}
+
+void
+hcore_event_del_timer(hcore_event_loop_t *loop, hcore_event_t *ev)
+{
+    if (!ev->timer_set)
+    {
+        return;
+    }
+
+    hcore_log_debug(loop->log, 0, "event timer del: %p: %ud", ev,
+                    ev->timer.key);
+
+    if (loop->timer_wheel)
+    {
+        hcore_event_timer_wheel_unlink(loop->timer_wheel, ev);
+        loop->timer_wheel->count--;
+
+        ev->timer_set = 0;
+        return;
+    }
+
+    hcore_rbtree_delete(&loop->timer, &ev->timer);
+
+#ifdef _HCORE_DEBUG
+    ev->timer.left   = NULL;
+    ev->timer.right  = NULL;
+    ev->timer.parent = NULL;
+#endif
+
+    ev->timer_set = 0;
+}
+
+static void
+hcore_event_timer_wheel_link(hcore_event_timer_wheel_t *wheel,
+                             hcore_event_t             *ev)
+{
+    hcore_uint_t     level, shift, slot;
+    hcore_msec_t     expires, idx;
+    hcore_msec_int_t delta;
+
+    /* round up to tick, so a timer never expires before its deadline */
+
+    delta = (hcore_msec_int_t)(ev->timer.key - wheel->msec);
+
+    if (delta <= 0)
+    {
+        expires = wheel->jiffies;
+    }
+    else
+    {
+        expires = wheel->jiffies + (delta + wheel->tick - 1) / wheel->tick;
+    }
+
+    idx = expires - wheel->jiffies;
+
+    if (idx < HCORE_TIMER_WHEEL_ROOT_SIZE)
+    {
+        slot = expires & HCORE_TIMER_WHEEL_ROOT_MASK;
+
+        wheel->bitmap[slot / 64] |= (uint64_t)1 << (slot % 64);
+
+        hcore_queue_insert_tail(&wheel->slots[slot], &ev->timer_queue);
+        return;
+    }
+
+    for (level = 1, shift = HCORE_TIMER_WHEEL_ROOT_BITS;
+         level < HCORE_TIMER_WHEEL_LEVELS - 1;
+         level++, shift += HCORE_TIMER_WHEEL_BITS)
+    {
+        if (idx < (hcore_msec_t)1 << (shift + HCORE_TIMER_WHEEL_BITS))
+        {
+            break;
+        }
+    }
+
+    hcore_queue_insert_tail(
+        hcore_event_timer_wheel_slot(wheel, level,
+                                     (expires >> shift) & HCORE_TIMER_WHEEL_MASK),
+        &ev->timer_queue);
+}
+
+static void
+hcore_event_timer_wheel_unlink(hcore_event_timer_wheel_t *wheel,
+                               hcore_event_t             *ev)
+{
+    hcore_queue_t *prev, *next;
+    hcore_uint_t   slot;
+
+    prev = ev->timer_queue.prev;
+    next = ev->timer_queue.next;
+
+    hcore_queue_remove(&ev->timer_queue);
+
+    /* the slot of level 0 becomes empty */
+
+    if (prev == next && prev >= &wheel->slots[0]
+        && prev < &wheel->slots[HCORE_TIMER_WHEEL_ROOT_SIZE])
+    {
+        slot = prev - wheel->slots;
+        wheel->bitmap[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    }
+}
+
+/*
+ * find the first non-empty slot of level 0 in range [from, root size),
+ * return -1 if there is no one
+ */
+static hcore_int_t
+hcore_event_timer_wheel_scan(hcore_event_timer_wheel_t *wheel,
+                             hcore_uint_t               from)
+{
+    hcore_uint_t i;
+    uint64_t     bits;
+
+    i    = from / 64;
+    bits = wheel->bitmap[i] & (~(uint64_t)0 << (from % 64));
+
+    for (;;)
+    {
+        if (bits)
+        {
+            return (hcore_int_t)(i * 64 + __builtin_ctzll(bits));
+        }
+
+        if (++i == HCORE_TIMER_WHEEL_ROOT_SIZE / 64)
+        {
+            return -1;
+        }
+
+        bits = wheel->bitmap[i];
+    }
+}
+
+static hcore_uint_t
+hcore_event_timer_wheel_cascade(hcore_event_timer_wheel_t *wheel,
+                                hcore_uint_t level, hcore_uint_t index)
+{
+    hcore_queue_t  list, *head, *q;
+    hcore_event_t *ev;
+
+    head = hcore_event_timer_wheel_slot(wheel, level, index);
+
+    if (hcore_queue_empty(head))
+    {
+        return index;
+    }
+
+    hcore_queue_init(&list);
+    hcore_queue_add(&list, head);
+    hcore_queue_init(head);
+
+    while (!hcore_queue_empty(&list))
+    {
+        q = hcore_queue_head(&list);
+        hcore_queue_remove(q);
+
+        ev = hcore_queue_data(q, hcore_event_t, timer_queue);
+
+        hcore_event_timer_wheel_link(wheel, ev);
+    }
+
+    return index;
+}
+
+static hcore_msec_t
+hcore_event_timer_wheel_find(hcore_event_loop_t *loop)
+{
+    hcore_int_t                slot;
+    hcore_uint_t               index;
+    hcore_msec_t               offset;
+    hcore_msec_int_t           timer;
+    hcore_event_timer_wheel_t *wheel;
+
+    wheel = loop->timer_wheel;
+
+    if (wheel->count == 0)
+    {
+        return HCORE_TIMER_INFINITE;
+    }
+
+    index = wheel->jiffies & HCORE_TIMER_WHEEL_ROOT_MASK;
+
+    /*
+     * timers of upper levels are cascaded at the end of level 0, so wake up
+     * there at the latest
+     */
+
+    slot   = hcore_event_timer_wheel_scan(wheel, index);
+    offset = (slot >= 0) ? (hcore_msec_t)slot - index
+                         : HCORE_TIMER_WHEEL_ROOT_SIZE - index;
+
+    timer = (hcore_msec_int_t)(wheel->msec + offset * wheel->tick
+                               - loop->current_msec);
+
+    return (hcore_msec_t)(timer > 0 ? timer : 0);
+}
+
+static void
+hcore_event_timer_wheel_expire(hcore_event_loop_t *loop)
+{
+    hcore_uint_t               index, level, shift, n;
+    hcore_queue_t              list, *head, *q;
+    hcore_event_t             *ev;
+    hcore_event_timer_wheel_t *wheel;
+
+    wheel = loop->timer_wheel;
+
+    /* process the ticks whose time is reached */
+
+    while ((hcore_msec_int_t)(loop->current_msec - wheel->msec) >= 0)
+    {
+        if (wheel->count == 0)
+        {
+            /* all slots are empty, catch up at once */
+
+            n = (loop->current_msec - wheel->msec) / wheel->tick + 1;
+
+            wheel->jiffies += n;
+            wheel->msec += n * wheel->tick;
+
+            return;
+        }
+
+        index = wheel->jiffies & HCORE_TIMER_WHEEL_ROOT_MASK;
+
+        if (index == 0)
+        {
+            for (level = 1, shift = HCORE_TIMER_WHEEL_ROOT_BITS;
+                 level < HCORE_TIMER_WHEEL_LEVELS;
+                 level++, shift += HCORE_TIMER_WHEEL_BITS)
+            {
+                if (hcore_event_timer_wheel_cascade(
+                        wheel, level,
+                        (wheel->jiffies >> shift) & HCORE_TIMER_WHEEL_MASK))
+                {
+                    break;
+                }
+            }
+        }
+        else if (hcore_event_timer_wheel_scan(wheel, index) == -1)
+        {
+            /* skip the empty rest of level 0 if it's all reached */
+
+            n = HCORE_TIMER_WHEEL_ROOT_SIZE - index;
+
+            if ((hcore_msec_int_t)(loop->current_msec - wheel->msec
+                                   - (n - 1) * wheel->tick)
+                >= 0)
+            {
+                wheel->jiffies += n;
+                wheel->msec += n * wheel->tick;
+                continue;
+            }
+        }
+
+        head = &wheel->slots[index];
+
+        /*
+         * the tick is advanced before handlers are invoked, so that timers
+         * which are armed by handlers never fall into the detached slot
+         */
+
+        wheel->jiffies++;
+        wheel->msec += wheel->tick;
+
+        if (hcore_queue_empty(head))
+        {
+            continue;
+        }
+
+        hcore_queue_init(&list);
+        hcore_queue_add(&list, head);
+        hcore_queue_init(head);
+
+        wheel->bitmap[index / 64] &= ~((uint64_t)1 << (index % 64));
+
+        while (!hcore_queue_empty(&list))
+        {
+            q  = hcore_queue_head(&list);
+            ev = hcore_queue_data(q, hcore_event_t, timer_queue);
+
+            hcore_event_timer_wheel_unlink(wheel, ev);
+            wheel->count--;
+
+            hcore_log_debug(loop->log, 0, "event timer del: %p: %ud", ev,
+                            ev->timer.key);
+
+            ev->timer_set = 0;
+            ev->timeout   = 1;
+
+            ev->handler(ev);
+        }
+    }
+}
@@ -30,7 +30,20 @@ hcore_writev(int fd, const struct iovec *iov, int iovcnt)
 eintr:
     n = writev(fd, iov, iovcnt);
 
-    if (n == -1 && errno == EAGAIN) goto eintr;
+    if (n == -1 && errno == EINTR) goto eintr;
+
+    return n;
+}
+
+ssize_t
+hcore_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+eintr:
+    n = readv(fd, iov, iovcnt);
+
+    if (n == -1 && errno == EINTR) goto eintr;
 
     return n;
 }
\ No newline at end of file
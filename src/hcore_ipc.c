@@ -0,0 +1,736 @@
+/**
+ * @file hcore_ipc.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief rings of messages in shared memory for processes, a message is
+ * copied once and no syscall is made unless the consumer sleeps
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ * ipc: inter-process communication
+ * spsc: single producer, single consumer
+ * mpmc: multiple producers, multiple consumers
+ */
+
+#include <hcore_base.h>
+#include <hcore_debug.h>
+#include <hcore_ipc.h>
+#include <hcore_lib.h>
+#include <hcore_string.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define HCORE_IPC_MODE (HCORE_IPC_SPSC | HCORE_IPC_MPMC | HCORE_IPC_RECORD)
+#define HCORE_IPC_WRAP 0xffffffff // the rest of ring is skipped
+
+#define hcore_ipc_align(n) (((n) + 7) & ~(size_t)7)
+
+/**
+ * @brief a slot of HCORE_IPC_SPSC and HCORE_IPC_MPMC
+ */
+typedef struct
+{
+    hcore_atomic_t seq; // position the slot is ready for, MPMC only
+    hcore_uint32_t len;
+    hcore_uint32_t reserved;
+    hcore_uchar_t  data[];
+} hcore_ipc_slot_t;
+
+/**
+ * @brief a record of HCORE_IPC_RECORD, it's aligned to 8 bytes
+ */
+typedef struct
+{
+    hcore_uint32_t len; // HCORE_IPC_WRAP means the rest is skipped
+    hcore_uint32_t reserved;
+    hcore_uchar_t  data[];
+} hcore_ipc_record_t;
+
+#define hcore_ipc_slot(sh, pos)                                            \
+    ((hcore_ipc_slot_t *)((sh)->data                                       \
+                          + ((pos) & ((sh)->n - 1)) * (sh)->slot_size))
+#define hcore_ipc_record(sh, pos) \
+    ((hcore_ipc_record_t *)((sh)->data + ((pos) & ((sh)->n - 1))))
+
+static hcore_int_t  hcore_ipc_map(hcore_ipc_t *ipc, const char *name,
+                                  size_t size);
+static hcore_uint_t hcore_ipc_round(hcore_uint_t n);
+static hcore_uint_t hcore_ipc_empty(hcore_ipc_sh_t *sh);
+static void         hcore_ipc_ring(hcore_ipc_t *ipc);
+
+static hcore_int_t hcore_ipc_send_spsc(hcore_ipc_t *ipc, const void *data,
+                                       size_t len);
+static hcore_int_t hcore_ipc_send_mpmc(hcore_ipc_t *ipc, const void *data,
+                                       size_t len);
+static hcore_int_t hcore_ipc_send_record(hcore_ipc_t *ipc, const void *data,
+                                         size_t len);
+static ssize_t     hcore_ipc_recv_spsc(hcore_ipc_t *ipc, void *buf,
+                                       size_t size);
+static ssize_t     hcore_ipc_recv_mpmc(hcore_ipc_t *ipc, void *buf,
+                                       size_t size);
+static ssize_t     hcore_ipc_recv_record(hcore_ipc_t *ipc, void *buf,
+                                         size_t size);
+
+hcore_ipc_t *
+hcore_create_ipc(hcore_log_t *log, const char *name, hcore_uint_t flags,
+                 hcore_uint_t n, size_t size)
+{
+    hcore_ipc_t    *ipc;
+    hcore_ipc_sh_t *sh;
+    hcore_uint_t    i, mode;
+    size_t          slot_size, bytes;
+
+    hcore_assert(log && n && size);
+
+    if (log == NULL || n == 0 || size == 0) return NULL;
+
+    mode = flags & HCORE_IPC_MODE;
+
+    if (mode == (HCORE_IPC_RECORD | HCORE_IPC_SPSC)) mode = HCORE_IPC_RECORD;
+
+    if ((mode != HCORE_IPC_SPSC && mode != HCORE_IPC_MPMC
+         && mode != HCORE_IPC_RECORD)
+        || ((flags & HCORE_IPC_EVENTFD) && name) || size > 0x7fffffff
+        || n > 0x7fffffff)
+    {
+        hcore_log_error(HCORE_LOG_ERR, log, 0,
+                        "invalid ipc: flags 0x%xd, n %ud, size %uz", flags, n,
+                        size);
+        return NULL;
+    }
+
+    if (mode == HCORE_IPC_RECORD)
+    {
+        // a record is less than half of ring, so it always fits after wrap
+
+        slot_size = 0;
+        bytes     = (size_t)hcore_max(n, 2)
+                * hcore_ipc_align(sizeof(hcore_ipc_record_t) + size);
+
+        if (bytes > 0x40000000)
+        {
+            hcore_log_error(HCORE_LOG_ERR, log, 0,
+                            "too large ipc: n %ud, size %uz", n, size);
+            return NULL;
+        }
+
+        n     = hcore_ipc_round(bytes);
+        bytes = n;
+    }
+    else
+    {
+        slot_size = hcore_ipc_align(sizeof(hcore_ipc_slot_t) + size);
+        n         = hcore_ipc_round(n);
+        bytes     = n * slot_size;
+    }
+
+    ipc = hcore_malloc(sizeof(hcore_ipc_t));
+    if (ipc == NULL) return NULL;
+
+    hcore_memzero(ipc, sizeof(hcore_ipc_t));
+
+    ipc->log    = log;
+    ipc->fd     = -1;
+    ipc->create = 1;
+
+    if (hcore_ipc_map(ipc, name, sizeof(hcore_ipc_sh_t) + bytes) != HCORE_OK)
+    {
+        hcore_free(ipc);
+        return NULL;
+    }
+
+    sh = ipc->sh;
+
+    sh->flags     = (flags & ~HCORE_IPC_MODE) | mode;
+    sh->n         = n;
+    sh->size      = size;
+    sh->slot_size = slot_size;
+
+    if (mode == HCORE_IPC_MPMC)
+    {
+        for (i = 0; i < n; i++)
+        {
+            hcore_ipc_slot(sh, i)->seq = i;
+        }
+    }
+
+    if (flags & HCORE_IPC_EVENTFD)
+    {
+        ipc->fd = eventfd(0, EFD_NONBLOCK);
+        if (ipc->fd == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, log, errno, "eventfd() failed");
+            hcore_destroy_ipc(ipc);
+            return NULL;
+        }
+    }
+
+    return ipc;
+}
+
+hcore_ipc_t *
+hcore_get_ipc(hcore_log_t *log, const char *name)
+{
+    hcore_ipc_t *ipc;
+
+    hcore_assert(log && name);
+
+    if (log == NULL || name == NULL) return NULL;
+
+    ipc = hcore_malloc(sizeof(hcore_ipc_t));
+    if (ipc == NULL) return NULL;
+
+    hcore_memzero(ipc, sizeof(hcore_ipc_t));
+
+    ipc->log = log;
+    ipc->fd  = -1;
+
+    if (hcore_ipc_map(ipc, name, 0) != HCORE_OK)
+    {
+        hcore_free(ipc);
+        return NULL;
+    }
+
+    // the ring may have been used, the positions cached start from its own
+
+    ipc->head = __atomic_load_n(&ipc->sh->head, __ATOMIC_ACQUIRE);
+    ipc->tail = __atomic_load_n(&ipc->sh->tail, __ATOMIC_ACQUIRE);
+
+    return ipc;
+}
+
+void
+hcore_destroy_ipc(hcore_ipc_t *ipc)
+{
+    hcore_assert(ipc);
+
+    if (ipc == NULL) return;
+
+    if (ipc->fd != -1 && close(ipc->fd) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno, "close(#%d) failed",
+                        ipc->fd);
+    }
+
+    if (munmap(ipc->sh, ipc->size) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                        "munmap(%p, %uz) failed", ipc->sh, ipc->size);
+    }
+
+    if (ipc->name && ipc->create && shm_unlink(ipc->name) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                        "shm_unlink(%s) failed", ipc->name);
+    }
+
+    hcore_free(ipc);
+}
+
+hcore_int_t
+hcore_ipc_send(hcore_ipc_t *ipc, const void *data, size_t len)
+{
+    hcore_int_t rc;
+
+    hcore_assert(ipc && (data || len == 0));
+
+    if (len > ipc->sh->size) return HCORE_ERROR;
+
+    switch (ipc->sh->flags & HCORE_IPC_MODE)
+    {
+    case HCORE_IPC_SPSC:
+        rc = hcore_ipc_send_spsc(ipc, data, len);
+        break;
+
+    case HCORE_IPC_MPMC:
+        rc = hcore_ipc_send_mpmc(ipc, data, len);
+        break;
+
+    default: /* HCORE_IPC_RECORD */
+        rc = hcore_ipc_send_record(ipc, data, len);
+        break;
+    }
+
+    if (rc == HCORE_OK) hcore_ipc_ring(ipc);
+
+    return rc;
+}
+
+ssize_t
+hcore_ipc_recv(hcore_ipc_t *ipc, void *buf, size_t size)
+{
+    hcore_assert(ipc);
+
+    switch (ipc->sh->flags & HCORE_IPC_MODE)
+    {
+    case HCORE_IPC_SPSC:
+        return hcore_ipc_recv_spsc(ipc, buf, size);
+
+    case HCORE_IPC_MPMC:
+        return hcore_ipc_recv_mpmc(ipc, buf, size);
+
+    default: /* HCORE_IPC_RECORD */
+        return hcore_ipc_recv_record(ipc, buf, size);
+    }
+}
+
+hcore_int_t
+hcore_ipc_wait(hcore_ipc_t *ipc, hcore_msec_t timer)
+{
+    hcore_ipc_sh_t *sh = ipc->sh;
+    hcore_uint32_t  doorbell;
+    uint64_t        v;
+    struct pollfd   pfd;
+    struct timespec ts;
+    int             rc;
+
+    if (ipc->fd != -1)
+    {
+        // a signal left by the messages received already is cleared
+
+        (void)!read(ipc->fd, &v, sizeof(v));
+
+        if (hcore_ipc_arm(ipc) == HCORE_AGAIN) return HCORE_OK;
+
+        pfd.fd     = ipc->fd;
+        pfd.events = POLLIN;
+
+        rc = poll(&pfd, 1, timer ? (int)timer : -1);
+
+        if (rc == -1 && errno != EINTR)
+        {
+            hcore_log_error(HCORE_LOG_ERR, ipc->log, errno, "poll() failed");
+            return HCORE_ERROR;
+        }
+
+        if (rc == 0) return HCORE_AGAIN;
+
+        (void)!read(ipc->fd, &v, sizeof(v));
+
+        return HCORE_OK;
+    }
+
+    /*
+     * the value of doorbell is read before counting self as a waiter, so a
+     * message sent after the check below changes it and the wait returns
+     */
+
+    doorbell = __atomic_load_n(&sh->doorbell, __ATOMIC_SEQ_CST);
+
+    hcore_atomic_fetch_add(&sh->wait, 1);
+
+    if (!hcore_ipc_empty(sh))
+    {
+        hcore_atomic_fetch_add(&sh->wait, -1);
+        return HCORE_OK;
+    }
+
+    ts.tv_sec  = timer / 1000;
+    ts.tv_nsec = (timer % 1000) * 1000000;
+
+    // it isn't FUTEX_PRIVATE, the producers are in different processes
+    rc = syscall(SYS_futex, &sh->doorbell, FUTEX_WAIT, doorbell,
+                 timer ? &ts : NULL, NULL, 0);
+
+    hcore_atomic_fetch_add(&sh->wait, -1);
+
+    if (rc == -1 && errno == ETIMEDOUT) return HCORE_AGAIN;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_ipc_arm(hcore_ipc_t *ipc)
+{
+    hcore_assert(ipc && ipc->fd != -1);
+
+    // it's a full barrier, the check below sees the messages sent before
+
+    __atomic_exchange_n(&ipc->sh->wait, 1, __ATOMIC_SEQ_CST);
+
+    return hcore_ipc_empty(ipc->sh) ? HCORE_OK : HCORE_AGAIN;
+}
+
+static hcore_int_t
+hcore_ipc_map(hcore_ipc_t *ipc, const char *name, size_t size)
+{
+    int         fd    = -1;
+    int         flags = MAP_SHARED;
+    struct stat st;
+
+    if (name == NULL)
+    {
+        flags |= MAP_ANON;
+    }
+    else
+    {
+        fd = ipc->create
+                 ? shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)
+                 : shm_open(name, O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                            "shm_open(%s) failed", name);
+            return HCORE_ERROR;
+        }
+
+        if (!ipc->create)
+        {
+            if (fstat(fd, &st) == -1)
+            {
+                hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                                "fstat(#%d) failed", fd);
+                goto failed;
+            }
+
+            size = st.st_size;
+
+            if (size < sizeof(hcore_ipc_sh_t))
+            {
+                hcore_log_error(HCORE_LOG_ALERT, ipc->log, 0,
+                                "shared memory \"%s\" isn't a ring", name);
+                goto failed;
+            }
+        }
+        else if (ftruncate(fd, size) == -1)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                            "ftruncate(#%d, %uz) failed", fd, size);
+            goto failed;
+        }
+    }
+
+    ipc->sh = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (ipc->sh == MAP_FAILED)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ipc->log, errno,
+                        "mmap(MAP_SHARED%s, %uz) failed",
+                        flags & MAP_ANON ? "|MAP_ANON" : "", size);
+        goto failed;
+    }
+
+    ipc->size = size;
+    ipc->name = name;
+
+    if (fd != -1) close(fd);
+
+    return HCORE_OK;
+
+failed:
+
+    if (fd != -1)
+    {
+        close(fd);
+
+        if (ipc->create) shm_unlink(name);
+    }
+
+    return HCORE_ERROR;
+}
+
+static hcore_uint_t
+hcore_ipc_round(hcore_uint_t n)
+{
+    hcore_uint_t r;
+
+    for (r = 1; r < n; r <<= 1)
+    {
+        // nothing
+    }
+
+    return r;
+}
+
+static hcore_uint_t
+hcore_ipc_empty(hcore_ipc_sh_t *sh)
+{
+    hcore_atomic_uint_t head;
+
+    head = __atomic_load_n(&sh->head, __ATOMIC_ACQUIRE);
+
+    if (sh->flags & HCORE_IPC_MPMC)
+    {
+        return (hcore_atomic_int_t)(
+                   __atomic_load_n(&hcore_ipc_slot(sh, head)->seq,
+                                   __ATOMIC_ACQUIRE)
+                   - (head + 1))
+               < 0;
+    }
+
+    return head == __atomic_load_n(&sh->tail, __ATOMIC_ACQUIRE);
+}
+
+static void
+hcore_ipc_ring(hcore_ipc_t *ipc)
+{
+    hcore_ipc_sh_t *sh = ipc->sh;
+    uint64_t        v  = 1;
+
+    // the message is visible before 'wait' is checked
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (hcore_atomic_fetch(&sh->wait) == 0) return;
+
+    if (ipc->fd != -1)
+    {
+        // the armed consumer is signaled once
+
+        if (hcore_atomic_cmp_set(&sh->wait, 1, 0))
+        {
+            (void)!write(ipc->fd, &v, sizeof(v));
+        }
+
+        return;
+    }
+
+    __atomic_fetch_add(&sh->doorbell, 1, __ATOMIC_SEQ_CST);
+
+    syscall(SYS_futex, &sh->doorbell, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static hcore_int_t
+hcore_ipc_send_spsc(hcore_ipc_t *ipc, const void *data, size_t len)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_slot_t   *slot;
+    hcore_atomic_uint_t tail;
+
+    tail = __atomic_load_n(&sh->tail, __ATOMIC_RELAXED);
+
+    // the head of consumer is read only if the ring looks full
+
+    if (tail - ipc->head >= sh->n)
+    {
+        ipc->head = __atomic_load_n(&sh->head, __ATOMIC_ACQUIRE);
+
+        if (tail - ipc->head >= sh->n) return HCORE_AGAIN;
+    }
+
+    slot      = hcore_ipc_slot(sh, tail);
+    slot->len = len;
+    hcore_memcpy(slot->data, data, len);
+
+    __atomic_store_n(&sh->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return HCORE_OK;
+}
+
+static ssize_t
+hcore_ipc_recv_spsc(hcore_ipc_t *ipc, void *buf, size_t size)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_slot_t   *slot;
+    hcore_atomic_uint_t head;
+    size_t              len;
+
+    head = __atomic_load_n(&sh->head, __ATOMIC_RELAXED);
+
+    // the tail cached may be behind 'head' if another handle has consumed
+
+    if ((hcore_atomic_int_t)(ipc->tail - head) <= 0)
+    {
+        ipc->tail = __atomic_load_n(&sh->tail, __ATOMIC_ACQUIRE);
+
+        if ((hcore_atomic_int_t)(ipc->tail - head) <= 0) return HCORE_AGAIN;
+    }
+
+    slot = hcore_ipc_slot(sh, head);
+    len  = slot->len;
+
+    if (len > size) return HCORE_ERROR;
+
+    hcore_memcpy(buf, slot->data, len);
+
+    __atomic_store_n(&sh->head, head + 1, __ATOMIC_RELEASE);
+
+    return len;
+}
+
+/*
+ * the bounded queue of Dmitry Vyukov: a slot is ready for the producer of
+ * position 'pos' if its sequence is 'pos', and for the consumer if it's
+ * 'pos + 1'. The positions are claimed by CAS.
+ */
+static hcore_int_t
+hcore_ipc_send_mpmc(hcore_ipc_t *ipc, const void *data, size_t len)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_slot_t   *slot;
+    hcore_atomic_uint_t pos, seq;
+    hcore_atomic_int_t  dif;
+
+    pos = __atomic_load_n(&sh->tail, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        slot = hcore_ipc_slot(sh, pos);
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        dif  = (hcore_atomic_int_t)(seq - pos);
+
+        if (dif == 0)
+        {
+            if (__atomic_compare_exchange_n(&sh->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (dif < 0)
+        {
+            return HCORE_AGAIN; // full
+        }
+        else
+        {
+            pos = __atomic_load_n(&sh->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->len = len;
+    hcore_memcpy(slot->data, data, len);
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return HCORE_OK;
+}
+
+static ssize_t
+hcore_ipc_recv_mpmc(hcore_ipc_t *ipc, void *buf, size_t size)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_slot_t   *slot;
+    hcore_atomic_uint_t pos, seq;
+    hcore_atomic_int_t  dif;
+    size_t              len;
+
+    pos = __atomic_load_n(&sh->head, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        slot = hcore_ipc_slot(sh, pos);
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        dif  = (hcore_atomic_int_t)(seq - (pos + 1));
+
+        if (dif == 0)
+        {
+            // the slot isn't reused until it's released below
+
+            if (slot->len > size) return HCORE_ERROR;
+
+            if (__atomic_compare_exchange_n(&sh->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (dif < 0)
+        {
+            return HCORE_AGAIN; // empty
+        }
+        else
+        {
+            pos = __atomic_load_n(&sh->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    len = slot->len;
+    hcore_memcpy(buf, slot->data, len);
+
+    __atomic_store_n(&slot->seq, pos + sh->n, __ATOMIC_RELEASE);
+
+    return len;
+}
+
+static hcore_int_t
+hcore_ipc_send_record(hcore_ipc_t *ipc, const void *data, size_t len)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_record_t *rec;
+    hcore_atomic_uint_t tail;
+    size_t              size, pad;
+
+    size = hcore_ipc_align(sizeof(hcore_ipc_record_t) + len);
+    tail = __atomic_load_n(&sh->tail, __ATOMIC_RELAXED);
+
+    // a record isn't split, the rest of ring is skipped if it doesn't fit
+
+    pad = tail & (sh->n - 1);
+    pad = pad + size > sh->n ? sh->n - pad : 0;
+
+    if (tail - ipc->head + pad + size > sh->n)
+    {
+        ipc->head = __atomic_load_n(&sh->head, __ATOMIC_ACQUIRE);
+
+        if (tail - ipc->head + pad + size > sh->n) return HCORE_AGAIN;
+    }
+
+    if (pad)
+    {
+        hcore_ipc_record(sh, tail)->len = HCORE_IPC_WRAP;
+        tail += pad;
+    }
+
+    rec      = hcore_ipc_record(sh, tail);
+    rec->len = len;
+    hcore_memcpy(rec->data, data, len);
+
+    __atomic_store_n(&sh->tail, tail + size, __ATOMIC_RELEASE);
+
+    return HCORE_OK;
+}
+
+static ssize_t
+hcore_ipc_recv_record(hcore_ipc_t *ipc, void *buf, size_t size)
+{
+    hcore_ipc_sh_t     *sh = ipc->sh;
+    hcore_ipc_record_t *rec;
+    hcore_atomic_uint_t head;
+    size_t              len;
+
+    head = __atomic_load_n(&sh->head, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        if ((hcore_atomic_int_t)(ipc->tail - head) <= 0)
+        {
+            ipc->tail = __atomic_load_n(&sh->tail, __ATOMIC_ACQUIRE);
+
+            if ((hcore_atomic_int_t)(ipc->tail - head) <= 0)
+            {
+                return HCORE_AGAIN;
+            }
+        }
+
+        rec = hcore_ipc_record(sh, head);
+
+        if (rec->len != HCORE_IPC_WRAP) break;
+
+        head += sh->n - (head & (sh->n - 1));
+
+        __atomic_store_n(&sh->head, head, __ATOMIC_RELEASE);
+    }
+
+    len = rec->len;
+
+    if (len > size) return HCORE_ERROR;
+
+    hcore_memcpy(buf, rec->data, len);
+
+    __atomic_store_n(&sh->head,
+                     head + hcore_ipc_align(sizeof(hcore_ipc_record_t) + len),
+                     __ATOMIC_RELEASE);
+
+    return len;
+}
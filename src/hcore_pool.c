@@ -16,28 +16,158 @@
 #include <hcore_lib.h>
 #include <hcore_pool.h>
 #include <hcore_string.h>
+#include <hcore_time.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 
 #define HCORE_POOL_ALIGNMENT 16
 
-static inline void *hcore_palloc_small(hcore_pool_t *pool, size_t size,
-                                       hcore_uint_t align);
+#define HCORE_POOL_LARGE_MAGIC 0x6c617267 // "larg"
+
+/* the header of a large allocation is stamped with its pool */
+#define hcore_pool_large_magic(pool) \
+    ((hcore_uint_t)(uintptr_t)(pool) ^ HCORE_POOL_LARGE_MAGIC)
+
+#ifdef _HCORE_DEBUG
+/* hcore_malloc() of debug keeps the alignment of word only */
+#define HCORE_POOL_LARGE_ALIGNMENT HCORE_ALIGNMENT
+#else
+#define HCORE_POOL_LARGE_ALIGNMENT HCORE_POOL_ALIGNMENT
+#endif
+
+/* the data after the header keeps the alignment of malloc() */
+#define HCORE_POOL_LARGE_HEADER                                         \
+    ((sizeof(hcore_pool_large_t) + HCORE_POOL_ALIGNMENT - 1)             \
+     & ~(size_t)(HCORE_POOL_ALIGNMENT - 1))
 
-static void *hcore_palloc_block(hcore_pool_t *pool, size_t size);
-static void *hcore_palloc_large(hcore_pool_t *pool, size_t size);
+#define hcore_pool_large_data(l) ((hcore_uchar_t *)(l) + HCORE_POOL_LARGE_HEADER)
+#define hcore_pool_large_of(p) \
+    ((hcore_pool_large_t *)((hcore_uchar_t *)(p) - HCORE_POOL_LARGE_HEADER))
+
+#define hcore_pool_large_class_size(c) \
+    ((size_t)1 << ((c) + HCORE_POOL_LARGE_SHIFT))
+
+/* the first block holds the whole 'hcore_pool_t', the others only 'd' */
+#define hcore_pool_block_start(pool, p)                                      \
+    ((p) == (pool) ? (hcore_uchar_t *)(p) + sizeof(hcore_pool_t)              \
+                   : hcore_align_ptr((hcore_uchar_t *)(p)                     \
+                                         + offsetof(hcore_pool_t, d)          \
+                                         + sizeof(hcore_pool_data_t),         \
+                                     HCORE_ALIGNMENT))
+
+typedef struct hcore_pool_block_s hcore_pool_block_t;
+
+struct hcore_pool_block_s
+{
+    hcore_pool_block_t *next;
+};
+
+typedef struct
+{
+    size_t              size; // size of blocks, 0 is unused
+    hcore_uint_t        n;    // number of blocks
+    hcore_uint_t        low;  // min of 'n' since last trimming
+    hcore_pool_block_t *head;
+} hcore_pool_cache_list_t;
+
+/**
+ * @brief the blocks of pools and the large allocations released by a thread
+ */
+typedef struct
+{
+    hcore_uint_t            max;     // high-water mark of blocks
+    hcore_uint_t            n;       // number of blocks
+    hcore_msec_t            trimmed; // time of last trimming
+    hcore_pool_cache_stat_t stat;
+
+    /*
+     * the lists of blocks are followed by the lists of large ones, whose
+     * sizes are fixed and aren't counted in 'n'
+     */
+    hcore_pool_cache_list_t
+        lists[HCORE_POOL_CACHE_SIZES + HCORE_POOL_LARGE_CLASSES];
+
+    hcore_uint_t inited : 1;
+} hcore_pool_cache_t;
+
+static inline void *hcore_palloc_align(hcore_pool_t *pool, size_t size,
+                                       size_t align);
+static inline void *hcore_palloc_small(hcore_pool_t *pool, size_t size,
+                                       size_t align);
+
+static void *hcore_palloc_block(hcore_pool_t *pool, size_t size, size_t align);
+static void *hcore_palloc_large(hcore_pool_t *pool, size_t size, size_t align);
+static void  hcore_pool_run_cleanup(hcore_pool_t         *pool,
+                                    hcore_pool_cleanup_t *end);
+static void  hcore_pool_free_large(hcore_pool_t      *pool,
+                                   hcore_pool_mark_t *mark);
+
+#define hcore_pool_class_of(size)   (((size) - 1) >> HCORE_POOL_FREE_SHIFT)
+#define hcore_pool_class_size(size) \
+    ((hcore_pool_class_of(size) + 1) << HCORE_POOL_FREE_SHIFT)
+
+/* the objects of size are recycled, they're allocated with class size */
+#define hcore_pool_recyclable(pool, size)                               \
+    ((pool)->recycled && (size) && (size) <= HCORE_POOL_FREE_MAX        \
+     && hcore_pool_class_size(size) <= (pool)->max)
+
+static void *hcore_pool_cache_get(size_t size, hcore_log_t *log);
+static void  hcore_pool_cache_put(void *p, size_t size);
+static void  hcore_pool_cache_expire(void);
+static hcore_pool_large_t *hcore_pool_large_get(size_t size, hcore_log_t *log);
+static void                hcore_pool_large_put(hcore_pool_large_t *l);
+#ifndef _HCORE_DEBUG
+static hcore_pool_cache_t *hcore_pool_cache_init(void);
+static void                hcore_pool_cache_create_key(void);
+static void                hcore_pool_cache_exit(void *data);
+
+static __thread hcore_pool_cache_t hcore_pool_cache;
+static pthread_once_t              hcore_pool_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t               hcore_pool_cache_key;
+#endif
 
 void *
 hcore_prealloc(hcore_pool_t *pool, void *p, size_t old_size, size_t new_size)
 {
-    void         *new_p;
-    hcore_pool_t *node;
+    void               *new_p;
+    size_t              old_end, new_end;
+    hcore_pool_t       *node;
+    hcore_pool_large_t *l;
 
     if (p == NULL)
     {
         return hcore_palloc(pool, new_size);
     }
 
+    if (pool->customed)
+    {
+        // the memory belongs to the custom pool, it has no header of large
+
+        if (new_size == 0)
+        {
+            pool->custom.free(pool->custom.pool, p);
+            return NULL;
+        }
+
+        if (new_size <= old_size)
+        {
+            return p;
+        }
+
+        new_p = pool->custom.alloc(pool->custom.pool, new_size);
+        if (new_p == NULL)
+        {
+            return NULL;
+        }
+
+        hcore_memcpy(new_p, p, old_size);
+
+        pool->custom.free(pool->custom.pool, p);
+
+        return new_p;
+    }
+
     if (new_size == 0)
     {
         if ((u_char *)p + old_size == pool->d.last)
@@ -46,7 +176,7 @@ hcore_prealloc(hcore_pool_t *pool, void *p, size_t old_size, size_t new_size)
         }
         else
         {
-            hcore_pfree(pool, p);
+            hcore_pfree_sized(pool, p, old_size);
         }
 
         return NULL;
@@ -54,16 +184,37 @@ hcore_prealloc(hcore_pool_t *pool, void *p, size_t old_size, size_t new_size)
 
     if (old_size <= pool->max)
     {
+        // the objects recycled take the sizes of their classes
+
+        old_end = hcore_pool_recyclable(pool, old_size)
+                    ? hcore_pool_class_size(old_size)
+                    : old_size;
+        new_end = hcore_pool_recyclable(pool, new_size)
+                    ? hcore_pool_class_size(new_size)
+                    : new_size;
+
         for (node = pool; node; node = node->d.next)
         {
-            if ((u_char *)p + old_size == node->d.last
-                && (u_char *)p + new_size <= node->d.end)
+            if ((u_char *)p + old_end == node->d.last
+                && (u_char *)p + new_end <= node->d.end)
             {
-                node->d.last = (u_char *)p + new_size;
+                node->d.last = (u_char *)p + new_end;
                 return p;
             }
         }
     }
+    else
+    {
+        // the size of large one may be rounded up to its class
+
+        l = hcore_pool_large_of(p);
+
+        if (l->magic == hcore_pool_large_magic(pool)
+            && new_size <= l->size - HCORE_POOL_LARGE_HEADER)
+        {
+            return p;
+        }
+    }
 
     if (new_size <= old_size)
     {
@@ -78,7 +229,7 @@ hcore_prealloc(hcore_pool_t *pool, void *p, size_t old_size, size_t new_size)
 
     hcore_memcpy(new_p, p, old_size);
 
-    hcore_pfree(pool, p);
+    hcore_pfree_sized(pool, p, old_size);
 
     return new_p;
 }
@@ -114,41 +265,161 @@ hcore_memalign(size_t alignment, size_t size, hcore_log_t *log)
 void
 hcore_destroy_pool(hcore_pool_t *pool)
 {
-    hcore_pool_t         *p, *n;
-    hcore_pool_large_t   *l;
-    hcore_pool_cleanup_t *cleanup;
+    hcore_pool_t *p, *n;
+
+    hcore_pool_run_cleanup(pool, NULL);
 
-    for (cleanup = pool->cleanup; cleanup; cleanup = cleanup->next)
+    if (pool->customed)
     {
-        if (cleanup->handler)
+        pool->custom.destroy(pool->custom.pool);
+        return;
+    }
+
+    hcore_pool_free_large(pool, NULL);
+
+    for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next)
+    {
+        hcore_pool_cache_put(p, (size_t)(p->d.end - (hcore_uchar_t *)p));
+
+        if (n == NULL)
         {
-            hcore_log_debug(pool->log, 0, "run cleanup: %p", cleanup);
-            cleanup->handler(cleanup->data);
+            break;
         }
     }
 
-    if (pool->customed)
+    hcore_pool_cache_expire();
+}
+
+void
+hcore_reset_pool(hcore_pool_t *pool)
+{
+    hcore_pool_t *p;
+
+    hcore_assert(pool);
+
+    hcore_pool_run_cleanup(pool, NULL);
+
+    pool->cleanup = NULL;
+
+    if (pool->customed) return;
+
+    hcore_pool_free_large(pool, NULL);
+
+    for (p = pool; p; p = p->d.next)
     {
-        pool->custom.destroy(pool->custom.pool);
-        return;
+        p->d.last   = hcore_pool_block_start(pool, p);
+        p->d.failed = 0;
     }
 
-    for (l = pool->large; l; l = l->next)
+    pool->current = pool;
+    pool->chain   = NULL;
+
+    // the lists were in the space rewound
+
+    if (pool->recycled)
     {
-        if (l->alloc)
+        pool->recycled = NULL;
+        hcore_pool_enable_recycle(pool);
+    }
+}
+
+void
+hcore_pool_mark(hcore_pool_t *pool, hcore_pool_mark_t *mark)
+{
+    hcore_pool_t *p;
+
+    hcore_assert(pool && mark && !pool->customed);
+
+    for (p = pool->current; p->d.next; p = p->d.next)
+    {
+        /* void */
+    }
+
+    mark->block   = p;
+    mark->last    = p->d.last;
+    mark->current = pool->current;
+    mark->large   = pool->large_seq;
+    mark->chain   = pool->chain;
+    mark->cleanup  = pool->cleanup;
+    mark->recycled = pool->recycled;
+
+    /*
+     * the space left in the blocks before isn't used until release, so only
+     * the last block and the new ones are rewound
+     */
+
+    pool->current = p;
+}
+
+void
+hcore_pool_release(hcore_pool_t *pool, hcore_pool_mark_t *mark)
+{
+    hcore_pool_t *p;
+
+    hcore_assert(pool && mark && !pool->customed);
+
+    hcore_pool_run_cleanup(pool, mark->cleanup);
+    hcore_pool_free_large(pool, mark);
+
+    mark->block->d.last = mark->last;
+
+    for (p = mark->block->d.next; p; p = p->d.next)
+    {
+        p->d.last   = hcore_pool_block_start(pool, p);
+        p->d.failed = 0;
+    }
+
+    pool->current = mark->current;
+    pool->chain   = mark->chain;
+    pool->cleanup = mark->cleanup;
+
+    // the objects recycled in the scope may be in the space rewound
+
+    pool->recycled = mark->recycled;
+
+    if (pool->recycled)
+    {
+        hcore_memzero(pool->recycled, HCORE_POOL_FREE_CLASSES * sizeof(void *));
+    }
+}
+
+static void
+hcore_pool_run_cleanup(hcore_pool_t *pool, hcore_pool_cleanup_t *end)
+{
+    hcore_pool_cleanup_t *cleanup;
+
+    for (cleanup = pool->cleanup; cleanup != end; cleanup = cleanup->next)
+    {
+        if (cleanup->handler)
         {
-            hcore_free(l->alloc);
+            hcore_log_debug(pool->log, 0, "run cleanup: %p", cleanup);
+            cleanup->handler(cleanup->data);
         }
     }
+}
 
-    for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next)
+static void
+hcore_pool_free_large(hcore_pool_t *pool, hcore_pool_mark_t *mark)
+{
+    hcore_queue_t      *q;
+    hcore_pool_large_t *l;
+
+    // the newest is the head, the ones allocated after 'mark' are freed
+
+    while (!hcore_queue_empty(&pool->large))
     {
-        hcore_free(p);
+        q = hcore_queue_head(&pool->large);
+        l = hcore_queue_data(q, hcore_pool_large_t, queue);
 
-        if (n == NULL)
+        if (mark && (hcore_int_t)(l->seq - mark->large) <= 0)
         {
             break;
         }
+
+        hcore_queue_remove(q);
+
+        l->magic = 0;
+        hcore_pool_large_put(l);
     }
 }
 
@@ -158,7 +429,7 @@ hcore_create_pool(size_t size, hcore_log_t *log)
     hcore_pool_t *p;
     int           hcore_pagesize;
 
-    p = hcore_memalign(HCORE_POOL_ALIGNMENT, size, log);
+    p = hcore_pool_cache_get(size, log);
     if (p == NULL)
     {
         return NULL;
@@ -176,11 +447,14 @@ hcore_create_pool(size_t size, hcore_log_t *log)
 
     p->current  = p;
     p->chain    = NULL;
-    p->large    = NULL;
     p->log      = log;
     p->cleanup  = NULL;
+    p->recycled = NULL;
     p->customed = 0;
 
+    hcore_queue_init(&p->large);
+    p->large_seq = 0;
+
     return p;
 }
 
@@ -263,16 +537,68 @@ hcore_pnalloc(hcore_pool_t *pool, size_t size)
         return pool->custom.alloc(pool->custom.pool, size);
     }
 
-    if (size <= pool->max)
+    return hcore_palloc_align(pool, size, 1);
+}
+
+void *
+hcore_palloc(hcore_pool_t *pool, size_t size)
+{
+    if (pool->customed)
     {
-        return hcore_palloc_small(pool, size, 0);
+        return pool->custom.alloc(pool->custom.pool, size);
     }
 
-    return hcore_palloc_large(pool, size);
+    return hcore_palloc_align(pool, size, HCORE_ALIGNMENT);
+}
+
+void *
+hcore_palloc_aligned(hcore_pool_t *pool, size_t size, size_t align)
+{
+    hcore_assert(pool && !pool->customed && align && !(align & (align - 1)));
+
+    if (pool->customed || align == 0 || (align & (align - 1)))
+    {
+        return NULL;
+    }
+
+    return hcore_palloc_align(pool, size, hcore_max(align, HCORE_ALIGNMENT));
 }
 
 static inline void *
-hcore_palloc_small(hcore_pool_t *pool, size_t size, hcore_uint_t align)
+hcore_palloc_align(hcore_pool_t *pool, size_t size, size_t align)
+{
+    hcore_uint_t c;
+    void        *p;
+
+    if (hcore_pool_recyclable(pool, size))
+    {
+        c = hcore_pool_class_of(size);
+        p = pool->recycled[c];
+
+        // the objects of hcore_pnalloc() may be unaligned, so is the link
+
+        if (p && ((uintptr_t)p & (align - 1)) == 0)
+        {
+            hcore_memcpy(&pool->recycled[c], p, sizeof(void *));
+            return p;
+        }
+
+        size = hcore_pool_class_size(size);
+    }
+
+    // a new block has room for the padding up to HCORE_POOL_ALIGNMENT
+
+    if (size <= pool->max
+        && (align <= HCORE_POOL_ALIGNMENT || size + align - 1 <= pool->max))
+    {
+        return hcore_palloc_small(pool, size, align);
+    }
+
+    return hcore_palloc_large(pool, size, align);
+}
+
+static inline void *
+hcore_palloc_small(hcore_pool_t *pool, size_t size, size_t align)
 {
     hcore_uchar_t *m;
     hcore_pool_t  *p;
@@ -283,12 +609,14 @@ hcore_palloc_small(hcore_pool_t *pool, size_t size, hcore_uint_t align)
     {
         m = p->d.last;
 
-        if (align)
+        if (align > 1)
         {
-            m = hcore_align_ptr(m, HCORE_ALIGNMENT);
+            m = hcore_align_ptr(m, align);
         }
 
-        if ((size_t)(p->d.end - m) >= size)
+        // the padding may be beyond the end
+
+        if (m <= p->d.end && (size_t)(p->d.end - m) >= size)
         {
             p->d.last = m + size;
 
@@ -299,11 +627,11 @@ hcore_palloc_small(hcore_pool_t *pool, size_t size, hcore_uint_t align)
 
     } while (p);
 
-    return hcore_palloc_block(pool, size);
+    return hcore_palloc_block(pool, size, align);
 }
 
 static void *
-hcore_palloc_block(hcore_pool_t *pool, size_t size)
+hcore_palloc_block(hcore_pool_t *pool, size_t size, size_t align)
 {
     hcore_uchar_t *m;
     size_t         psize;
@@ -311,7 +639,7 @@ hcore_palloc_block(hcore_pool_t *pool, size_t size)
 
     psize = (size_t)(pool->d.end - (hcore_uchar_t *)pool);
 
-    m = hcore_memalign(HCORE_POOL_ALIGNMENT, psize, pool->log);
+    m = hcore_pool_cache_get(psize, pool->log);
     if (m == NULL)
     {
         return NULL;
@@ -323,8 +651,10 @@ hcore_palloc_block(hcore_pool_t *pool, size_t size)
     new_pool->d.next   = NULL;
     new_pool->d.failed = 0;
 
-    m += sizeof(hcore_pool_data_t);
-    m                = hcore_align_ptr(m, HCORE_ALIGNMENT);
+    /* only 'd' is used in the following blocks */
+
+    m += offsetof(hcore_pool_t, d) + sizeof(hcore_pool_data_t);
+    m                = hcore_align_ptr(m, hcore_max(align, HCORE_ALIGNMENT));
     new_pool->d.last = m + size;
 
     for (p = pool->current; p->d.next; p = p->d.next)
@@ -341,51 +671,59 @@ hcore_palloc_block(hcore_pool_t *pool, size_t size)
 }
 
 static void *
-hcore_palloc_large(hcore_pool_t *pool, size_t size)
+hcore_palloc_large(hcore_pool_t *pool, size_t size, size_t align)
 {
-    void               *p;
-    hcore_uint_t        n;
-    hcore_pool_large_t *large;
+    hcore_uchar_t      *m;
+    hcore_pool_large_t *l;
 
-    p = hcore_malloc(size);
-    if (p == NULL)
+    if (size > (size_t)-1 - HCORE_POOL_LARGE_HEADER - align)
     {
         return NULL;
     }
 
-    n = 0;
+    size += HCORE_POOL_LARGE_HEADER;
 
-    for (large = pool->large; large; large = large->next)
+    if (align <= HCORE_POOL_LARGE_ALIGNMENT)
     {
-        if (large->alloc == NULL)
+        l = hcore_pool_large_get(size, pool->log);
+        if (l == NULL)
         {
-            large->alloc = p;
-            return p;
+            return NULL;
         }
 
-        if (n++ > 3)
+        l->offset = 0;
+    }
+    else
+    {
+        // the header is moved forward by the padding, it isn't cached
+
+        m = hcore_malloc(size + align - 1);
+        if (m == NULL)
         {
-            break;
+            hcore_log_error(HCORE_LOG_EMERG, pool->log, errno,
+                            "malloc(%uz) failed", size + align - 1);
+            return NULL;
         }
-    }
 
-    large = hcore_palloc_small(pool, sizeof(hcore_pool_large_t), 1);
-    if (large == NULL)
-    {
-        hcore_free(p);
-        return NULL;
+        l = hcore_pool_large_of(
+            hcore_align_ptr(m + HCORE_POOL_LARGE_HEADER, align));
+
+        l->offset = (hcore_uint_t)((hcore_uchar_t *)l - m);
+        l->size   = size;
     }
 
-    large->alloc = p;
-    large->next  = pool->large;
-    pool->large  = large;
+    l->seq   = ++pool->large_seq;
+    l->magic = hcore_pool_large_magic(pool);
 
-    return p;
+    hcore_queue_insert_head(&pool->large, &l->queue);
+
+    return hcore_pool_large_data(l);
 }
 
 hcore_int_t
 hcore_pfree(hcore_pool_t *pool, void *p)
 {
+    hcore_pool_t       *node;
     hcore_pool_large_t *l;
 
     if (pool->customed)
@@ -394,17 +732,404 @@ hcore_pfree(hcore_pool_t *pool, void *p)
         return HCORE_OK;
     }
 
-    for (l = pool->large; l; l = l->next)
+    if (p == NULL)
+    {
+        return HCORE_ERROR;
+    }
+
+    // the objects in the blocks of pool have no header in front of them
+
+    for (node = pool; node; node = node->d.next)
+    {
+        if ((hcore_uchar_t *)p >= (hcore_uchar_t *)node
+            && (hcore_uchar_t *)p < node->d.end)
+        {
+            return HCORE_ERROR;
+        }
+    }
+
+    l = hcore_pool_large_of(p);
+
+    if (l->magic != hcore_pool_large_magic(pool)
+        || l->queue.prev->next != &l->queue
+        || l->queue.next->prev != &l->queue)
+    {
+        return HCORE_ERROR;
+    }
+
+    hcore_log_debug(pool->log, 0, "free: %p", p);
+
+    l->magic = 0;
+
+    hcore_queue_remove(&l->queue);
+
+    hcore_pool_large_put(l);
+
+    return HCORE_OK;
+}
+
+void
+hcore_pool_cache_set_max(hcore_uint_t max)
+{
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t *cache = hcore_pool_cache_init();
+    hcore_uint_t        i;
+
+    cache->max = max;
+
+    if (max && cache->n <= max) return;
+
+    // no block is idle, only the blocks over the mark are released
+
+    for (i = 0; i < HCORE_POOL_CACHE_SIZES + HCORE_POOL_LARGE_CLASSES; i++)
+    {
+        cache->lists[i].low = 0;
+    }
+
+    hcore_pool_cache_trim();
+#endif
+}
+
+void
+hcore_pool_cache_trim(void)
+{
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t      *cache = &hcore_pool_cache;
+    hcore_pool_cache_list_t *list;
+    hcore_pool_block_t      *b, *next, **tail;
+    hcore_uint_t             i, keep;
+
+    for (i = 0; i < HCORE_POOL_CACHE_SIZES + HCORE_POOL_LARGE_CLASSES; i++)
     {
-        if (p == l->alloc)
+        list = &cache->lists[i];
+
+        /*
+         * the 'low' blocks at the bottom of the stack weren't taken since last
+         * trimming, they're released, and the blocks over the mark too
+         */
+
+        keep = list->n - list->low;
+
+        if (i >= HCORE_POOL_CACHE_SIZES)
+        {
+            if (cache->max == 0) keep = 0;
+        }
+        else if (cache->n - list->low > cache->max)
+        {
+            keep -= hcore_min(keep, cache->n - list->low - cache->max);
+        }
+
+        for (tail = &list->head; keep; keep--)
         {
-            hcore_log_debug(pool->log, 0, "free: %p", l->alloc);
-            hcore_free(l->alloc);
-            l->alloc = NULL;
+            tail = &(*tail)->next;
+        }
+
+        for (b = *tail, *tail = NULL; b; b = next)
+        {
+            next = b->next;
+
+            hcore_free(b);
+
+            list->n--;
+            cache->stat.released++;
 
-            return HCORE_OK;
+            if (i < HCORE_POOL_CACHE_SIZES) cache->n--;
         }
+
+        if (list->n == 0 && i < HCORE_POOL_CACHE_SIZES) list->size = 0;
+
+        list->low = list->n;
+    }
+
+    cache->trimmed = hcore_monotonic_time();
+#endif
+}
+
+void
+hcore_pool_cache_stat(hcore_pool_cache_stat_t *stat)
+{
+    hcore_assert(stat);
+
+    if (stat == NULL) return;
+
+#ifndef _HCORE_DEBUG
+    *stat        = hcore_pool_cache.stat;
+    stat->cached = hcore_pool_cache.n;
+#else
+    hcore_memzero(stat, sizeof(hcore_pool_cache_stat_t));
+#endif
+}
+
+static void *
+hcore_pool_cache_get(size_t size, hcore_log_t *log)
+{
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t      *cache = &hcore_pool_cache;
+    hcore_pool_cache_list_t *list;
+    hcore_pool_block_t      *b;
+    hcore_uint_t             i;
+
+    for (i = 0; i < HCORE_POOL_CACHE_SIZES; i++)
+    {
+        list = &cache->lists[i];
+
+        if (list->size != size || list->head == NULL) continue;
+
+        b          = list->head;
+        list->head = b->next;
+
+        list->n--;
+        cache->n--;
+
+        if (list->low > list->n) list->low = list->n;
+
+        cache->stat.hits++;
+
+        return b;
     }
 
-    return HCORE_ERROR;
-}
\ No newline at end of file
+    cache->stat.misses++;
+#endif
+
+    return hcore_memalign(HCORE_POOL_ALIGNMENT, size, log);
+}
+
+static void
+hcore_pool_cache_put(void *p, size_t size)
+{
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t      *cache = hcore_pool_cache_init();
+    hcore_pool_cache_list_t *list, *unused = NULL;
+    hcore_pool_block_t      *b;
+    hcore_uint_t             i;
+
+    if (cache->n >= cache->max) goto release;
+
+    for (i = 0; i < HCORE_POOL_CACHE_SIZES; i++)
+    {
+        list = &cache->lists[i];
+
+        if (list->size == size) goto found;
+
+        if (list->size == 0 && unused == NULL) unused = list;
+    }
+
+    if (unused == NULL) goto release;
+
+    list       = unused;
+    list->size = size;
+    list->low  = 0;
+
+found:
+
+    b          = p;
+    b->next    = list->head;
+    list->head = b;
+
+    list->n++;
+    cache->n++;
+
+    return;
+
+release:
+
+    cache->stat.released++;
+#endif
+
+    hcore_free(p);
+}
+
+static hcore_pool_large_t *
+hcore_pool_large_get(size_t size, hcore_log_t *log)
+{
+    hcore_pool_large_t *l;
+
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t      *cache = hcore_pool_cache_init();
+    hcore_pool_cache_list_t *list;
+    hcore_uint_t             c;
+
+    if (cache->max
+        && size <= hcore_pool_large_class_size(HCORE_POOL_LARGE_CLASSES - 1))
+    {
+        for (c = 0; hcore_pool_large_class_size(c) < size; c++)
+        {
+            /* void */
+        }
+
+        list = &cache->lists[HCORE_POOL_CACHE_SIZES + c];
+        size = list->size;
+
+        if (list->head)
+        {
+            l          = (hcore_pool_large_t *)list->head;
+            list->head = list->head->next;
+
+            list->n--;
+
+            if (list->low > list->n) list->low = list->n;
+
+            cache->stat.hits++;
+
+            l->size = size;
+
+            return l;
+        }
+
+        cache->stat.misses++;
+    }
+#endif
+
+    l = hcore_malloc(size);
+    if (l == NULL)
+    {
+        hcore_log_error(HCORE_LOG_EMERG, log, errno, "malloc(%uz) failed",
+                        size);
+        return NULL;
+    }
+
+    l->size = size;
+
+    return l;
+}
+
+static void
+hcore_pool_large_put(hcore_pool_large_t *l)
+{
+    if (l->offset)
+    {
+        hcore_free((hcore_uchar_t *)l - l->offset);
+        return;
+    }
+
+#ifndef _HCORE_DEBUG
+    hcore_pool_cache_t      *cache = &hcore_pool_cache;
+    hcore_pool_cache_list_t *list;
+    hcore_pool_block_t      *b;
+    hcore_uint_t             c;
+
+    if (cache->max == 0) goto release;
+
+    for (c = 0; c < HCORE_POOL_LARGE_CLASSES; c++)
+    {
+        list = &cache->lists[HCORE_POOL_CACHE_SIZES + c];
+
+        if (list->size != l->size) continue;
+
+        if (list->n >= HCORE_POOL_LARGE_CACHE) break;
+
+        b          = (hcore_pool_block_t *)l;
+        b->next    = list->head;
+        list->head = b;
+
+        list->n++;
+
+        return;
+    }
+
+release:
+
+    if (cache->inited) cache->stat.released++;
+#endif
+
+    hcore_free(l);
+}
+
+static void
+hcore_pool_cache_expire(void)
+{
+#ifndef _HCORE_DEBUG
+    if (hcore_monotonic_time() - hcore_pool_cache.trimmed
+        >= HCORE_POOL_CACHE_IDLE)
+    {
+        hcore_pool_cache_trim();
+    }
+#endif
+}
+
+#ifndef _HCORE_DEBUG
+static hcore_pool_cache_t *
+hcore_pool_cache_init(void)
+{
+    hcore_pool_cache_t *cache = &hcore_pool_cache;
+    hcore_uint_t        c;
+
+    if (cache->inited) return cache;
+
+    cache->inited  = 1;
+    cache->max     = HCORE_POOL_CACHE_MAX;
+    cache->trimmed = hcore_monotonic_time();
+
+    for (c = 0; c < HCORE_POOL_LARGE_CLASSES; c++)
+    {
+        cache->lists[HCORE_POOL_CACHE_SIZES + c].size =
+            hcore_pool_large_class_size(c);
+    }
+
+    // the blocks are released when the thread exits
+
+    if (pthread_once(&hcore_pool_cache_once, hcore_pool_cache_create_key) == 0)
+    {
+        pthread_setspecific(hcore_pool_cache_key, cache);
+    }
+
+    return cache;
+}
+
+static void
+hcore_pool_cache_create_key(void)
+{
+    pthread_key_create(&hcore_pool_cache_key, hcore_pool_cache_exit);
+}
+
+static void
+hcore_pool_cache_exit(void *data)
+{
+    hcore_pool_cache_set_max(0);
+}
+#endif
+
+hcore_int_t
+hcore_pool_enable_recycle(hcore_pool_t *pool)
+{
+    hcore_assert(pool && !pool->customed);
+
+    if (pool->customed) return HCORE_ERROR;
+
+    if (pool->recycled) return HCORE_OK;
+
+    pool->recycled =
+        hcore_palloc_small(pool, HCORE_POOL_FREE_CLASSES * sizeof(void *),
+                           HCORE_ALIGNMENT);
+    if (pool->recycled == NULL) return HCORE_ERROR;
+
+    hcore_memzero(pool->recycled, HCORE_POOL_FREE_CLASSES * sizeof(void *));
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_pfree_sized(hcore_pool_t *pool, void *p, size_t size)
+{
+    hcore_uint_t c;
+
+    if (pool->customed || size > pool->max)
+    {
+        return hcore_pfree(pool, p);
+    }
+
+    if (!hcore_pool_recyclable(pool, size))
+    {
+        return HCORE_DECLINED;
+    }
+
+    // it has the size of its class, see hcore_pnalloc()
+
+    c = hcore_pool_class_of(size);
+
+    hcore_memcpy(p, &pool->recycled[c], sizeof(void *));
+
+    pool->recycled[c] = p;
+
+    return HCORE_OK;
+}
@@ -0,0 +1,426 @@
+/**
+ * @file hcore_reactor.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for pthread_attr_setaffinity_np()
+#endif
+
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_debug.h>
+#include <hcore_event.h>
+#include <hcore_reactor.h>
+
+#include <sched.h>
+#include <sys/eventfd.h>
+
+static hcore_int_t hcore_init_worker(hcore_reactor_t *r, hcore_worker_t *wk);
+static void        hcore_free_worker(hcore_worker_t *wk);
+static void       *hcore_worker_cycle(void *data);
+static void        hcore_worker_mailbox_handler(hcore_event_t *ev);
+static void        hcore_worker_quit_handler(hcore_worker_t *wk,
+                                             hcore_task_t   *task);
+
+hcore_reactor_t *
+hcore_create_reactor(hcore_pool_t *pool, hcore_uint_t n)
+{
+    long             ncpus;
+    hcore_uint_t     i;
+    hcore_reactor_t *r;
+
+    hcore_assert(pool);
+
+    if (pool == NULL) return NULL;
+
+    if (n == 0)
+    {
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n     = ncpus > 0 ? (hcore_uint_t)ncpus : 1;
+    }
+
+    r = hcore_pcalloc(pool, sizeof(hcore_reactor_t));
+    if (r == NULL) return NULL;
+
+    r->workers = hcore_pcalloc(pool, sizeof(hcore_worker_t) * n);
+    if (r->workers == NULL) return NULL;
+
+    for (i = 0; i < n; i++)
+    {
+        r->workers[i].id      = i;
+        r->workers[i].cpu     = -1;
+        r->workers[i].reactor = r;
+    }
+
+    r->nworkers = n;
+    r->pool     = pool;
+    r->log      = pool->log;
+
+    return r;
+}
+
+hcore_int_t
+hcore_reactor_listen(hcore_reactor_t *r, struct sockaddr *sockaddr,
+                     socklen_t socklen)
+{
+    hcore_assert(r && sockaddr && !r->running);
+
+    if (socklen > sizeof(hcore_sockaddr_t)) return HCORE_ERROR;
+
+    hcore_memcpy(&r->sockaddr, sockaddr, socklen);
+    r->socklen = socklen;
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_start_reactor(hcore_reactor_t *r)
+{
+    int             err;
+    long            ncpus;
+    cpu_set_t       cpuset;
+    hcore_uint_t    i;
+    hcore_worker_t *wk;
+    pthread_attr_t  attr;
+
+    hcore_assert(r && !r->running);
+    hcore_assert(r->socklen == 0 || r->handler);
+
+    /*
+     * the loops are created here, so the failure is reported before any
+     * thread is started
+     */
+
+    for (i = 0; i < r->nworkers; i++)
+    {
+        if (hcore_init_worker(r, &r->workers[i]) != HCORE_OK) goto failed;
+    }
+
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus <= 0) ncpus = 1;
+
+    r->running = 1;
+
+    for (i = 0; i < r->nworkers; i++)
+    {
+        wk = &r->workers[i];
+
+        pthread_attr_init(&attr);
+
+        if (r->affinity)
+        {
+            wk->cpu = (int)(i % ncpus);
+
+            CPU_ZERO(&cpuset);
+            CPU_SET(wk->cpu, &cpuset);
+
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        err = pthread_create(&wk->tid, &attr, hcore_worker_cycle, wk);
+
+        pthread_attr_destroy(&attr);
+
+        if (err)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, r->log, err,
+                            "pthread_create() of worker %ui failed", i);
+            hcore_stop_reactor(r);
+            return HCORE_ERROR;
+        }
+
+        wk->started = 1;
+    }
+
+    hcore_log_debug(r->log, 0, "reactor: %ui workers are started",
+                    r->nworkers);
+
+    return HCORE_OK;
+
+failed:
+
+    for (i = 0; i < r->nworkers; i++)
+    {
+        hcore_free_worker(&r->workers[i]);
+    }
+
+    return HCORE_ERROR;
+}
+
+void
+hcore_stop_reactor(hcore_reactor_t *r)
+{
+    hcore_uint_t    i;
+    hcore_worker_t *wk;
+
+    hcore_assert(r);
+
+    if (r == NULL || !r->running) return;
+
+    for (i = 0; i < r->nworkers; i++)
+    {
+        wk = &r->workers[i];
+
+        if (!wk->started) continue;
+
+        wk->quit_task.handler = hcore_worker_quit_handler;
+
+        if (hcore_worker_post(wk, &wk->quit_task) != HCORE_OK)
+        {
+            /* the thread can't be stopped, leave its resources */
+
+            hcore_log_error(HCORE_LOG_EMERG, r->log, 0,
+                            "failed to stop worker %ui", i);
+            wk->started = 0;
+            wk->pool    = NULL;
+        }
+    }
+
+    for (i = 0; i < r->nworkers; i++)
+    {
+        wk = &r->workers[i];
+
+        if (wk->started)
+        {
+            pthread_join(wk->tid, NULL);
+            wk->started = 0;
+        }
+
+        if (wk->pool) hcore_free_worker(wk);
+    }
+
+    r->running = 0;
+}
+
+hcore_int_t
+hcore_worker_post(hcore_worker_t *wk, hcore_task_t *task)
+{
+    uint64_t      one;
+    hcore_task_t *head;
+
+    hcore_assert(wk && task && task->handler);
+
+    head = __atomic_load_n(&wk->mailbox, __ATOMIC_RELAXED);
+
+    do
+    {
+        task->next = head;
+    } while (!__atomic_compare_exchange_n(&wk->mailbox, &head, task, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    if (head)
+    {
+        /* the worker was notified by the first post */
+        return HCORE_OK;
+    }
+
+    one = 1;
+
+    if (write(wk->notify->fd, &one, sizeof(uint64_t)) != sizeof(uint64_t))
+    {
+        hcore_log_error(HCORE_LOG_ALERT, wk->reactor->log, errno,
+                        "write() to eventfd of worker %ui failed", wk->id);
+        return HCORE_ERROR;
+    }
+
+    return HCORE_OK;
+}
+
+static hcore_int_t
+hcore_init_worker(hcore_reactor_t *r, hcore_worker_t *wk)
+{
+    int                 efd;
+    hcore_listening_t  *ls;
+    hcore_connection_t *c;
+
+    wk->log      = *r->log;
+    wk->mailbox  = NULL;
+    wk->quit     = 0;
+    wk->ntasks   = 0;
+    wk->nwakeup  = 0;
+
+    wk->pool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &wk->log);
+    if (wk->pool == NULL) return HCORE_ERROR;
+
+    wk->loop = hcore_create_event_loop(wk->pool, 0);
+    if (wk->loop == NULL) return HCORE_ERROR;
+
+    if (r->connections)
+    {
+        wk->table = hcore_create_connection_table(wk->pool, r->connections, 0);
+        if (wk->table == NULL) return HCORE_ERROR;
+    }
+
+    /* mailbox */
+
+    efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, r->log, errno, "eventfd() failed");
+        return HCORE_ERROR;
+    }
+
+    c = hcore_create_connection(&wk->log, efd);
+    if (c == NULL)
+    {
+        close(efd);
+        return HCORE_ERROR;
+    }
+
+    wk->notify = c;
+
+    c->data         = wk;
+    c->rev->handler = hcore_worker_mailbox_handler;
+    c->rev->log     = c->log;
+
+    if (hcore_event_add(wk->loop, c->rev, HCORE_EVENT_READ, 0) != HCORE_OK)
+    {
+        return HCORE_ERROR;
+    }
+
+    if (r->socklen == 0) return HCORE_OK;
+
+    /* listening, the others listen on the resolved address of the first */
+
+    ls = hcore_create_listening(wk->pool, &r->sockaddr.sockaddr, r->socklen);
+    if (ls == NULL) return HCORE_ERROR;
+
+    ls->reuseport = 1;
+    ls->handler   = r->handler;
+    ls->table     = wk->table;
+    ls->log       = &wk->log;
+    ls->loop      = wk->loop;
+    ls->data      = wk;
+
+    if (hcore_open_listening(ls) != HCORE_OK) return HCORE_ERROR;
+
+    wk->listening = ls;
+
+    if (hcore_event_add(wk->loop, ls->connection->rev, HCORE_EVENT_READ, 0)
+        != HCORE_OK)
+    {
+        return HCORE_ERROR;
+    }
+
+    if (wk->id == 0)
+    {
+        hcore_memcpy(&r->sockaddr, &ls->sockaddr, ls->socklen);
+        r->socklen = ls->socklen;
+    }
+
+    return HCORE_OK;
+}
+
+static void
+hcore_free_worker(hcore_worker_t *wk)
+{
+    if (wk->listening)
+    {
+        hcore_close_listening(wk->listening);
+        wk->listening = NULL;
+    }
+
+    if (wk->notify)
+    {
+        hcore_destroy_connection(wk->notify);
+        wk->notify = NULL;
+    }
+
+    if (wk->loop)
+    {
+        hcore_destroy_event_loop(wk->loop);
+        wk->loop = NULL;
+    }
+
+    if (wk->pool)
+    {
+        hcore_destroy_pool(wk->pool);
+        wk->pool = NULL;
+    }
+
+    wk->table = NULL;
+}
+
+static void *
+hcore_worker_cycle(void *data)
+{
+    hcore_worker_t *wk = data;
+
+    hcore_log_debug(&wk->log, 0, "worker %ui: started on cpu %d", wk->id,
+                    wk->cpu);
+
+    while (!wk->quit)
+    {
+        if (hcore_event_process(wk->loop, HCORE_TIMER_INFINITE) != HCORE_OK)
+        {
+            hcore_log_error(HCORE_LOG_EMERG, &wk->log, 0,
+                            "worker %ui: event loop failed", wk->id);
+            break;
+        }
+    }
+
+    hcore_log_debug(&wk->log, 0, "worker %ui: exited", wk->id);
+
+    return NULL;
+}
+
+static void
+hcore_worker_mailbox_handler(hcore_event_t *ev)
+{
+    uint64_t            n;
+    hcore_task_t       *task, *next, *list;
+    hcore_worker_t     *wk;
+    hcore_connection_t *c;
+
+    c  = ev->data;
+    wk = c->data;
+
+    /*
+     * reset the eventfd before taking the tasks, so a post after taking
+     * notifies again
+     */
+
+    if (read(c->fd, &n, sizeof(uint64_t)) == -1 && errno != EAGAIN)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, errno,
+                        "read() from eventfd failed");
+    }
+
+    wk->nwakeup++;
+
+    list = __atomic_exchange_n(&wk->mailbox, NULL, __ATOMIC_ACQUIRE);
+
+    // the latest is first, reverse it to the order of posting
+
+    for (task = NULL; list; list = next)
+    {
+        next       = list->next;
+        list->next = task;
+        task       = list;
+    }
+
+    for (/* void */; task; task = next)
+    {
+        next = task->next;
+
+        wk->ntasks++;
+
+        // the task may be released by handler
+        task->handler(wk, task);
+    }
+}
+
+static void
+hcore_worker_quit_handler(hcore_worker_t *wk, hcore_task_t *task)
+{
+    wk->quit = 1;
+}
@@ -0,0 +1,673 @@
+/**
+ * @file hcore_shmap.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief hash map in the shared memory pool, it's shared by processes
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ * shmap: shared map
+ * ttl: time to live
+ * lru: least recently used
+ */
+
+#include <hcore_base.h>
+#include <hcore_crc32.h>
+#include <hcore_debug.h>
+#include <hcore_lib.h>
+#include <hcore_shmap.h>
+#include <hcore_string.h>
+#include <hcore_time.h>
+
+#define HCORE_SHMAP_EXPIRE 2 // max expired entries removed by an insert
+
+#define hcore_shmap_level(state) ((hcore_uint_t)((state) >> 32))
+#define hcore_shmap_split(state) ((hcore_uint_t)((state)&0xffffffff))
+
+#define hcore_shmap_key(node)   ((node)->data)
+#define hcore_shmap_value(node) ((node)->data + (node)->klen)
+
+#define hcore_shmap_expired(node, now) \
+    ((node)->expire && (hcore_msec_int_t)((node)->expire - (now)) <= 0)
+
+static hcore_uint_t         hcore_shmap_round(hcore_uint_t n);
+static hcore_shmap_node_t **hcore_shmap_bucket(hcore_shmap_sh_t *sh,
+                                               hcore_uint32_t    hash);
+static hcore_shmap_node_t **hcore_shmap_lookup(hcore_shmap_sh_t *sh,
+                                               hcore_uint32_t    hash,
+                                               const void *key, size_t klen);
+static void hcore_shmap_unlink(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                               hcore_shmap_node_t **prev);
+static void hcore_shmap_remove(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                               hcore_shmap_node_t *node);
+static void hcore_shmap_expire(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                               hcore_msec_t now);
+static hcore_shmap_node_t *hcore_shmap_alloc(hcore_shmap_t *map,
+                                             hcore_uint_t   stripe,
+                                             size_t         size);
+static hcore_shmap_node_t *hcore_shmap_insert(hcore_shmap_t *map,
+                                              hcore_uint_t stripe,
+                                              hcore_uint32_t hash,
+                                              const void *key, size_t klen,
+                                              size_t vlen, hcore_msec_t ttl,
+                                              hcore_msec_t now);
+static void hcore_shmap_grow(hcore_shmap_t *map, hcore_uint_t stripe);
+
+hcore_shmap_t *
+hcore_create_shmap(hcore_shpool_t *shpool, hcore_uint_t nbuckets,
+                   hcore_uint_t nstripes)
+{
+    hcore_shmap_t    *map;
+    hcore_shmap_sh_t *sh;
+    hcore_uint_t      i, nsegments;
+
+    hcore_assert(shpool && nbuckets);
+
+    if (shpool == NULL || nbuckets == 0) return NULL;
+
+    nbuckets = hcore_shmap_round(nbuckets);
+    nstripes = hcore_min(hcore_shmap_round(hcore_max(nstripes, 1)), nbuckets);
+
+    nsegments = (nbuckets + HCORE_SHMAP_SEGMENT_SIZE - 1)
+                / HCORE_SHMAP_SEGMENT_SIZE;
+
+    if (nsegments > HCORE_SHMAP_SEGMENTS)
+    {
+        hcore_log_error(HCORE_LOG_ERR, shpool->log, 0,
+                        "too many buckets of shmap: %ud", nbuckets);
+        return NULL;
+    }
+
+    map = hcore_malloc(sizeof(hcore_shmap_t));
+    if (map == NULL) return NULL;
+
+    hcore_memzero(map, sizeof(hcore_shmap_t));
+
+    map->shpool = shpool;
+
+    map->locks = hcore_malloc(nstripes * sizeof(hcore_shmtx_t));
+    if (map->locks == NULL) goto failed;
+
+    hcore_memzero(map->locks, nstripes * sizeof(hcore_shmtx_t));
+
+    sh = hcore_shpool_calloc(shpool, sizeof(hcore_shmap_sh_t));
+    if (sh == NULL) goto failed;
+
+    map->sh = sh;
+
+    sh->nbuckets = nbuckets;
+    sh->nstripes = nstripes;
+
+    sh->stripes = hcore_shpool_calloc(shpool,
+                                      nstripes * sizeof(hcore_shmap_stripe_t));
+    if (sh->stripes == NULL) goto failed;
+
+    for (i = 0; i < nstripes; i++)
+    {
+        hcore_queue_init(&sh->stripes[i].lru);
+
+        if (hcore_shmtx_init(&map->locks[i], &sh->stripes[i].lock)
+            != HCORE_OK)
+        {
+            goto failed;
+        }
+    }
+
+    if (hcore_shmtx_init(&map->resize, &sh->resize) != HCORE_OK) goto failed;
+
+    for (i = 0; i < nsegments; i++)
+    {
+        sh->segments[i] = hcore_shpool_calloc(
+            shpool, HCORE_SHMAP_SEGMENT_SIZE * sizeof(hcore_shmap_node_t *));
+        if (sh->segments[i] == NULL) goto failed;
+    }
+
+    return map;
+
+failed:
+
+    hcore_log_error(HCORE_LOG_ERR, shpool->log, 0,
+                    "failed to create shmap: no memory");
+
+    hcore_destroy_shmap(map);
+
+    return NULL;
+}
+
+void
+hcore_destroy_shmap(hcore_shmap_t *map)
+{
+    hcore_shmap_sh_t   *sh;
+    hcore_shmap_node_t *node, *next;
+    hcore_uint_t        i, k;
+
+    hcore_assert(map);
+
+    if (map == NULL) return;
+
+    sh = map->sh;
+
+    if (sh)
+    {
+        for (i = 0; i < HCORE_SHMAP_SEGMENTS && sh->segments[i]; i++)
+        {
+            for (k = 0; k < HCORE_SHMAP_SEGMENT_SIZE; k++)
+            {
+                for (node = sh->segments[i][k]; node; node = next)
+                {
+                    next = node->next;
+                    hcore_shpool_free(map->shpool, node);
+                }
+            }
+
+            hcore_shpool_free(map->shpool, sh->segments[i]);
+        }
+
+        if (sh->stripes) hcore_shpool_free(map->shpool, sh->stripes);
+
+        hcore_shpool_free(map->shpool, sh);
+    }
+
+    if (map->locks) hcore_free(map->locks);
+
+    hcore_free(map);
+}
+
+hcore_int_t
+hcore_shmap_set(hcore_shmap_t *map, const void *key, size_t klen,
+                const void *value, size_t vlen, hcore_msec_t ttl)
+{
+    hcore_uint32_t        hash;
+    hcore_uint_t          stripe;
+    hcore_msec_t          now;
+    hcore_shmap_node_t  **prev, *node;
+    hcore_shmap_stripe_t *st;
+
+    hcore_assert(map && key);
+
+    hash   = hcore_crc32_long((hcore_uchar_t *)key, klen);
+    stripe = hash & (map->sh->nstripes - 1);
+    st     = &map->sh->stripes[stripe];
+    now    = hcore_monotonic_time();
+
+    hcore_shmtx_lock(&map->locks[stripe]);
+
+    hcore_shmap_expire(map, st, now);
+
+    prev = hcore_shmap_lookup(map->sh, hash, key, klen);
+
+    if (*prev && (*prev)->vlen == vlen)
+    {
+        // replace in place
+
+        node = *prev;
+
+        hcore_memcpy(hcore_shmap_value(node), value, vlen);
+
+        node->expire = ttl ? (now + ttl) | 1 : 0;
+
+        hcore_queue_remove(&node->lru);
+        hcore_queue_insert_head(&st->lru, &node->lru);
+
+        hcore_shmtx_unlock(&map->locks[stripe]);
+
+        return HCORE_OK;
+    }
+
+    if (*prev)
+    {
+        hcore_shmap_unlink(map, st, prev);
+    }
+
+    node = hcore_shmap_insert(map, stripe, hash, key, klen, vlen, ttl, now);
+
+    if (node)
+    {
+        hcore_memcpy(hcore_shmap_value(node), value, vlen);
+    }
+
+    hcore_shmtx_unlock(&map->locks[stripe]);
+
+    if (node == NULL) return HCORE_ERROR;
+
+    hcore_shmap_grow(map, stripe);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_shmap_get(hcore_shmap_t *map, const void *key, size_t klen, void *buf,
+                size_t *len)
+{
+    hcore_uint32_t        hash;
+    hcore_uint_t          stripe;
+    hcore_shmap_node_t  **prev, *node;
+    hcore_shmap_stripe_t *st;
+
+    hcore_assert(map && key && len);
+
+    hash   = hcore_crc32_long((hcore_uchar_t *)key, klen);
+    stripe = hash & (map->sh->nstripes - 1);
+    st     = &map->sh->stripes[stripe];
+
+    hcore_shmtx_lock(&map->locks[stripe]);
+
+    prev = hcore_shmap_lookup(map->sh, hash, key, klen);
+    node = *prev;
+
+    if (node == NULL)
+    {
+        hcore_shmtx_unlock(&map->locks[stripe]);
+        return HCORE_DECLINED;
+    }
+
+    if (hcore_shmap_expired(node, hcore_monotonic_time()))
+    {
+        hcore_shmap_unlink(map, st, prev);
+        hcore_shmtx_unlock(&map->locks[stripe]);
+        return HCORE_DECLINED;
+    }
+
+    hcore_memcpy(buf, hcore_shmap_value(node), hcore_min(*len, node->vlen));
+
+    *len = node->vlen;
+
+    hcore_queue_remove(&node->lru);
+    hcore_queue_insert_head(&st->lru, &node->lru);
+
+    hcore_shmtx_unlock(&map->locks[stripe]);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_shmap_incr(hcore_shmap_t *map, const void *key, size_t klen,
+                 hcore_int_t delta, hcore_msec_t ttl, hcore_int_t *value)
+{
+    hcore_uint32_t        hash;
+    hcore_uint_t          stripe;
+    hcore_int_t           n;
+    hcore_msec_t          now;
+    hcore_shmap_node_t  **prev, *node;
+    hcore_shmap_stripe_t *st;
+
+    hcore_assert(map && key);
+
+    hash   = hcore_crc32_long((hcore_uchar_t *)key, klen);
+    stripe = hash & (map->sh->nstripes - 1);
+    st     = &map->sh->stripes[stripe];
+    now    = hcore_monotonic_time();
+
+    hcore_shmtx_lock(&map->locks[stripe]);
+
+    hcore_shmap_expire(map, st, now);
+
+    prev = hcore_shmap_lookup(map->sh, hash, key, klen);
+    node = *prev;
+
+    if (node
+        && (node->vlen != sizeof(hcore_int_t)
+            || hcore_shmap_expired(node, now)))
+    {
+        hcore_shmap_unlink(map, st, prev);
+        node = NULL;
+    }
+
+    if (node)
+    {
+        // the value may be unaligned
+
+        hcore_memcpy(&n, hcore_shmap_value(node), sizeof(hcore_int_t));
+        n += delta;
+
+        hcore_queue_remove(&node->lru);
+        hcore_queue_insert_head(&st->lru, &node->lru);
+    }
+    else
+    {
+        node = hcore_shmap_insert(map, stripe, hash, key, klen,
+                                  sizeof(hcore_int_t), ttl, now);
+        n = delta;
+    }
+
+    if (node)
+    {
+        hcore_memcpy(hcore_shmap_value(node), &n, sizeof(hcore_int_t));
+    }
+
+    hcore_shmtx_unlock(&map->locks[stripe]);
+
+    if (node == NULL) return HCORE_ERROR;
+
+    if (value) *value = n;
+
+    hcore_shmap_grow(map, stripe);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_shmap_delete(hcore_shmap_t *map, const void *key, size_t klen)
+{
+    hcore_uint32_t       hash;
+    hcore_uint_t         stripe;
+    hcore_shmap_node_t **prev;
+
+    hcore_assert(map && key);
+
+    hash   = hcore_crc32_long((hcore_uchar_t *)key, klen);
+    stripe = hash & (map->sh->nstripes - 1);
+
+    hcore_shmtx_lock(&map->locks[stripe]);
+
+    prev = hcore_shmap_lookup(map->sh, hash, key, klen);
+
+    if (*prev == NULL)
+    {
+        hcore_shmtx_unlock(&map->locks[stripe]);
+        return HCORE_DECLINED;
+    }
+
+    hcore_shmap_unlink(map, &map->sh->stripes[stripe], prev);
+
+    hcore_shmtx_unlock(&map->locks[stripe]);
+
+    return HCORE_OK;
+}
+
+hcore_uint_t
+hcore_shmap_count(hcore_shmap_t *map)
+{
+    hcore_uint_t i, n;
+
+    hcore_assert(map);
+
+    for (i = 0, n = 0; i < map->sh->nstripes; i++)
+    {
+        n += map->sh->stripes[i].count;
+    }
+
+    return n;
+}
+
+static hcore_uint_t
+hcore_shmap_round(hcore_uint_t n)
+{
+    hcore_uint_t r;
+
+    for (r = 1; r < n; r <<= 1)
+    {
+        // nothing
+    }
+
+    return r;
+}
+
+/*
+ * linear hashing: the buckets below 'split' are split in this level, so
+ * they are addressed by one more bit
+ */
+static hcore_shmap_node_t **
+hcore_shmap_bucket(hcore_shmap_sh_t *sh, hcore_uint32_t hash)
+{
+    hcore_atomic_uint_t state;
+    hcore_uint_t        size, b;
+
+    state = hcore_atomic_fetch(&sh->state);
+    size  = sh->nbuckets << hcore_shmap_level(state);
+    b     = hash & (size - 1);
+
+    if (b < hcore_shmap_split(state))
+    {
+        b = hash & ((size << 1) - 1);
+    }
+
+    return &sh->segments[b / HCORE_SHMAP_SEGMENT_SIZE]
+                        [b % HCORE_SHMAP_SEGMENT_SIZE];
+}
+
+static hcore_shmap_node_t **
+hcore_shmap_lookup(hcore_shmap_sh_t *sh, hcore_uint32_t hash, const void *key,
+                   size_t klen)
+{
+    hcore_shmap_node_t **prev, *node;
+
+    for (prev = hcore_shmap_bucket(sh, hash); (node = *prev);
+         prev = &node->next)
+    {
+        if (node->hash == hash && node->klen == klen
+            && hcore_memcmp(hcore_shmap_key(node), key, klen) == 0)
+        {
+            break;
+        }
+    }
+
+    return prev;
+}
+
+static void
+hcore_shmap_unlink(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                   hcore_shmap_node_t **prev)
+{
+    hcore_shmap_node_t *node = *prev;
+
+    *prev = node->next;
+
+    hcore_queue_remove(&node->lru);
+    st->count--;
+
+    hcore_shpool_free(map->shpool, node);
+}
+
+static void
+hcore_shmap_remove(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                   hcore_shmap_node_t *node)
+{
+    hcore_shmap_node_t **prev;
+
+    for (prev = hcore_shmap_bucket(map->sh, node->hash); *prev != node;
+         prev = &(*prev)->next)
+    {
+        // nothing
+    }
+
+    hcore_shmap_unlink(map, st, prev);
+}
+
+/*
+ * the expired entries are gathered at the tail of LRU as they aren't
+ * touched, so a few of them are removed for each insert
+ */
+static void
+hcore_shmap_expire(hcore_shmap_t *map, hcore_shmap_stripe_t *st,
+                   hcore_msec_t now)
+{
+    hcore_uint_t        n;
+    hcore_queue_t      *q;
+    hcore_shmap_node_t *node;
+
+    for (n = 0; n < HCORE_SHMAP_EXPIRE && !hcore_queue_empty(&st->lru); n++)
+    {
+        q    = hcore_queue_last(&st->lru);
+        node = hcore_queue_data(q, hcore_shmap_node_t, lru);
+
+        if (!hcore_shmap_expired(node, now)) return;
+
+        hcore_shmap_remove(map, st, node);
+    }
+}
+
+/*
+ * the least recently used entries of the stripe are evicted if the pool is
+ * exhausted, then those of other stripes which aren't locked
+ */
+static hcore_shmap_node_t *
+hcore_shmap_alloc(hcore_shmap_t *map, hcore_uint_t stripe, size_t size)
+{
+    hcore_uint_t          n, i, k;
+    hcore_queue_t        *q;
+    hcore_shmap_node_t   *node;
+    hcore_shmap_stripe_t *st;
+
+    for (n = 0;; n++)
+    {
+        node = hcore_shpool_alloc(map->shpool, size);
+
+        if (node || n == HCORE_SHMAP_EVICT) return node;
+
+        st = &map->sh->stripes[stripe];
+
+        if (!hcore_queue_empty(&st->lru))
+        {
+            q = hcore_queue_last(&st->lru);
+            hcore_shmap_remove(map, st,
+                               hcore_queue_data(q, hcore_shmap_node_t, lru));
+            continue;
+        }
+
+        for (k = 1; k < map->sh->nstripes; k++)
+        {
+            i  = (stripe + k) & (map->sh->nstripes - 1);
+            st = &map->sh->stripes[i];
+
+            if (hcore_queue_empty(&st->lru)
+                || !hcore_shmtx_trylock(&map->locks[i]))
+            {
+                continue;
+            }
+
+            if (!hcore_queue_empty(&st->lru))
+            {
+                q = hcore_queue_last(&st->lru);
+                hcore_shmap_remove(
+                    map, st, hcore_queue_data(q, hcore_shmap_node_t, lru));
+            }
+
+            hcore_shmtx_unlock(&map->locks[i]);
+
+            break;
+        }
+
+        if (k == map->sh->nstripes) return NULL; // nothing to evict
+    }
+}
+
+static hcore_shmap_node_t *
+hcore_shmap_insert(hcore_shmap_t *map, hcore_uint_t stripe,
+                   hcore_uint32_t hash, const void *key, size_t klen,
+                   size_t vlen, hcore_msec_t ttl, hcore_msec_t now)
+{
+    hcore_shmap_node_t  **bucket, *node;
+    hcore_shmap_stripe_t *st = &map->sh->stripes[stripe];
+
+    node = hcore_shmap_alloc(map, stripe,
+                             sizeof(hcore_shmap_node_t) + klen + vlen);
+    if (node == NULL)
+    {
+        hcore_log_error(HCORE_LOG_ERR, map->shpool->log, 0,
+                        "failed to insert into shmap: no memory");
+        return NULL;
+    }
+
+    node->hash   = hash;
+    node->klen   = klen;
+    node->vlen   = vlen;
+    node->expire = ttl ? (now + ttl) | 1 : 0; // 0 is never
+
+    hcore_memcpy(hcore_shmap_key(node), key, klen);
+
+    // the bucket is got after eviction, which doesn't split buckets
+
+    bucket     = hcore_shmap_bucket(map->sh, hash);
+    node->next = *bucket;
+    *bucket    = node;
+
+    hcore_queue_insert_head(&st->lru, &node->lru);
+    st->count++;
+
+    return node;
+}
+
+/*
+ * split a bucket if the stripe is overloaded, it's done after the stripe
+ * is unlocked, as it locks the stripe of the bucket split
+ */
+static void
+hcore_shmap_grow(hcore_shmap_t *map, hcore_uint_t stripe)
+{
+    hcore_shmap_sh_t    *sh = map->sh;
+    hcore_atomic_uint_t  state;
+    hcore_uint_t         level, split, size, b, seg;
+    hcore_shmap_node_t **from, **to, *node;
+
+    state = hcore_atomic_fetch(&sh->state);
+    size  = sh->nbuckets << hcore_shmap_level(state);
+
+    if (sh->stripes[stripe].count * sh->nstripes
+        <= (size + hcore_shmap_split(state)) * HCORE_SHMAP_LOAD)
+    {
+        return;
+    }
+
+    if (!hcore_shmtx_trylock(&map->resize)) return; // another one is splitting
+
+    state = hcore_atomic_fetch(&sh->state);
+    level = hcore_shmap_level(state);
+    split = hcore_shmap_split(state);
+    size  = sh->nbuckets << level;
+
+    b   = size + split; // new bucket
+    seg = b / HCORE_SHMAP_SEGMENT_SIZE;
+
+    if (seg >= HCORE_SHMAP_SEGMENTS) goto done;
+
+    if (sh->segments[seg] == NULL)
+    {
+        sh->segments[seg] = hcore_shpool_calloc(
+            map->shpool,
+            HCORE_SHMAP_SEGMENT_SIZE * sizeof(hcore_shmap_node_t *));
+
+        if (sh->segments[seg] == NULL) goto done;
+    }
+
+    // the old and new bucket are in the same stripe
+
+    stripe = split & (sh->nstripes - 1);
+
+    hcore_shmtx_lock(&map->locks[stripe]);
+    {
+        from = &sh->segments[split / HCORE_SHMAP_SEGMENT_SIZE]
+                            [split % HCORE_SHMAP_SEGMENT_SIZE];
+        to   = &sh->segments[seg][b % HCORE_SHMAP_SEGMENT_SIZE];
+
+        while ((node = *from))
+        {
+            if ((node->hash & ((size << 1) - 1)) == split)
+            {
+                from = &node->next;
+                continue;
+            }
+
+            *from      = node->next;
+            node->next = *to;
+            *to        = node;
+        }
+
+        if (++split == size)
+        {
+            level++;
+            split = 0;
+        }
+
+        __atomic_store_n(&sh->state, (hcore_atomic_uint_t)level << 32 | split,
+                         __ATOMIC_SEQ_CST);
+    }
+    hcore_shmtx_unlock(&map->locks[stripe]);
+
+done:
+
+    hcore_shmtx_unlock(&map->resize);
+}
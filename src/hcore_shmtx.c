@@ -15,6 +15,10 @@
 #include <hcore_debug.h>
 #include <hcore_shmtx.h>
 
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
 static void hcore_shmtx_wakeup(hcore_shmtx_t *mtx);
 
 hcore_int_t
@@ -24,7 +28,10 @@ hcore_shmtx_init(hcore_shmtx_t *mtx, hcore_shmtx_sh_t *addr)
 
     if (mtx == NULL || addr == NULL) return HCORE_ERROR;
 
-    mtx->lock = &addr->lock;
+    mtx->lock  = &addr->lock;
+    mtx->wait  = &addr->wait;
+    mtx->futex = &addr->futex;
+    mtx->sleep = 0;
 
     if (mtx->spin == (hcore_uint_t)-1)
     {
@@ -32,7 +39,8 @@ hcore_shmtx_init(hcore_shmtx_t *mtx, hcore_shmtx_sh_t *addr)
     }
 
     /* Use default spin value if not set */
-    mtx->spin = 1 << 11;
+    mtx->spin  = 1 << 11;
+    mtx->sleep = 1;
 
     return HCORE_OK;
 }
@@ -40,8 +48,9 @@ hcore_shmtx_init(hcore_shmtx_t *mtx, hcore_shmtx_sh_t *addr)
 void
 hcore_shmtx_lock(hcore_shmtx_t *mtx)
 {
-    hcore_uint_t i, n;
-    hcore_pid_t  pid = hcore_getpid();
+    hcore_uint_t   i, n;
+    hcore_uint32_t futex;
+    hcore_pid_t    pid = hcore_getpid();
 
     for (;;)
     {
@@ -67,6 +76,32 @@ hcore_shmtx_lock(hcore_shmtx_t *mtx)
             }
         }
 
+        if (mtx->sleep)
+        {
+            /*
+             * the value of futex is read before counting self as a waiter,
+             * so an unlock after the check below changes it and the wait
+             * returns at once
+             */
+
+            futex = __atomic_load_n(mtx->futex, __ATOMIC_SEQ_CST);
+
+            hcore_atomic_fetch_add(mtx->wait, 1);
+
+            if (*mtx->lock == 0 && hcore_atomic_cmp_set(mtx->lock, 0, pid))
+            {
+                hcore_atomic_fetch_add(mtx->wait, -1);
+                return;
+            }
+
+            // it isn't FUTEX_PRIVATE, the waiters are in different processes
+            syscall(SYS_futex, mtx->futex, FUTEX_WAIT, futex, NULL, NULL, 0);
+
+            hcore_atomic_fetch_add(mtx->wait, -1);
+
+            continue;
+        }
+
         // If we have spun for the maximum amount of time, then yield the
         // remainder of our timeslice.
         hcore_sched_yield();
@@ -104,5 +139,302 @@ hcore_shmtx_force_unlock(hcore_shmtx_t *mtx, hcore_pid_t pid)
 static void
 hcore_shmtx_wakeup(hcore_shmtx_t *mtx)
 {
-    // nothing
-}
\ No newline at end of file
+    /*
+     * the sleepers are counted in the shared memory, a handle that doesn't
+     * sleep wakes the sleepers of other handles too
+     */
+
+    if (hcore_atomic_fetch(mtx->wait) == 0)
+    {
+        return;
+    }
+
+    __atomic_fetch_add(mtx->futex, 1, __ATOMIC_SEQ_CST);
+
+    syscall(SYS_futex, mtx->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static hcore_uint_t hcore_shrwlock_enter(hcore_shrwlock_t *rw, hcore_pid_t pid);
+static hcore_shrwlock_reader_t *hcore_shrwlock_reader(hcore_shrwlock_sh_t *sh);
+static void hcore_shrwlock_wakeup(hcore_shrwlock_t *rw);
+
+hcore_int_t
+hcore_shrwlock_init(hcore_shrwlock_t *rw, hcore_shrwlock_sh_t *addr)
+{
+    hcore_assert(rw && addr);
+
+    if (rw == NULL || addr == NULL) return HCORE_ERROR;
+
+    rw->sh   = addr;
+    rw->slot = 0;
+
+    if (rw->spin == 0)
+    {
+        /* Use default spin value if not set */
+        rw->spin = 1 << 11;
+    }
+
+    return HCORE_OK;
+}
+
+hcore_uint_t
+hcore_shrwlock_tryrlock(hcore_shrwlock_t *rw)
+{
+    return hcore_shrwlock_enter(rw, hcore_getpid());
+}
+
+void
+hcore_shrwlock_rlock(hcore_shrwlock_t *rw)
+{
+    hcore_uint_t         i, n;
+    hcore_uint32_t       futex;
+    hcore_pid_t          pid = hcore_getpid();
+    hcore_shrwlock_sh_t *sh  = rw->sh;
+
+    for (;;)
+    {
+        if (hcore_shrwlock_enter(rw, pid)) return;
+
+        for (n = 1; n < rw->spin; n <<= 1)
+        {
+            for (i = 0; i < n; i++)
+            {
+                hcore_cpu_pause();
+            }
+
+            if (hcore_shrwlock_enter(rw, pid)) return;
+        }
+
+        // sleep until the writer leaves, see hcore_shmtx_lock()
+
+        futex = __atomic_load_n(&sh->futex, __ATOMIC_SEQ_CST);
+
+        hcore_atomic_fetch_add(&sh->wait, 1);
+
+        if (hcore_shrwlock_enter(rw, pid))
+        {
+            hcore_atomic_fetch_add(&sh->wait, -1);
+            return;
+        }
+
+        syscall(SYS_futex, &sh->futex, FUTEX_WAIT, futex, NULL, NULL, 0);
+
+        hcore_atomic_fetch_add(&sh->wait, -1);
+    }
+}
+
+hcore_uint_t
+hcore_shrwlock_trywlock(hcore_shrwlock_t *rw)
+{
+    hcore_pid_t          pid = hcore_getpid();
+    hcore_shrwlock_sh_t *sh  = rw->sh;
+
+    if (sh->lock != 0 || !hcore_atomic_cmp_set(&sh->lock, 0, pid))
+    {
+        return 0;
+    }
+
+    if (hcore_shrwlock_reader(sh) == NULL)
+    {
+        return 1;
+    }
+
+    // the readers are still in
+
+    hcore_atomic_cmp_set(&sh->lock, pid, 0);
+    hcore_shrwlock_wakeup(rw);
+
+    return 0;
+}
+
+void
+hcore_shrwlock_wlock(hcore_shrwlock_t *rw)
+{
+    hcore_uint_t             i, n;
+    hcore_uint32_t           futex;
+    hcore_pid_t              pid = hcore_getpid();
+    hcore_shrwlock_sh_t     *sh  = rw->sh;
+    hcore_shrwlock_reader_t *r;
+
+    /*
+     * 1. own 'lock' like hcore_shmtx_lock(), the readers never hold it, so
+     * a writer is not starved by them
+     */
+
+    for (;;)
+    {
+        if (sh->lock == 0 && hcore_atomic_cmp_set(&sh->lock, 0, pid))
+        {
+            break;
+        }
+
+        for (n = 1; n < rw->spin; n <<= 1)
+        {
+            for (i = 0; i < n; i++)
+            {
+                hcore_cpu_pause();
+            }
+
+            if (sh->lock == 0 && hcore_atomic_cmp_set(&sh->lock, 0, pid))
+            {
+                goto locked;
+            }
+        }
+
+        futex = __atomic_load_n(&sh->futex, __ATOMIC_SEQ_CST);
+
+        hcore_atomic_fetch_add(&sh->wait, 1);
+
+        if (sh->lock == 0 && hcore_atomic_cmp_set(&sh->lock, 0, pid))
+        {
+            hcore_atomic_fetch_add(&sh->wait, -1);
+            break;
+        }
+
+        syscall(SYS_futex, &sh->futex, FUTEX_WAIT, futex, NULL, NULL, 0);
+
+        hcore_atomic_fetch_add(&sh->wait, -1);
+    }
+
+locked:
+
+    // 2. no reader enters now, wait for the current readers to leave
+
+    while ((r = hcore_shrwlock_reader(sh)) != NULL)
+    {
+        for (n = 1; n < rw->spin && r->pid; n <<= 1)
+        {
+            for (i = 0; i < n; i++)
+            {
+                hcore_cpu_pause();
+            }
+        }
+
+        if (r->pid == 0) continue;
+
+        futex = __atomic_load_n(&sh->futex, __ATOMIC_SEQ_CST);
+
+        hcore_atomic_fetch_add(&sh->wait, 1);
+
+        if (r->pid != 0)
+        {
+            syscall(SYS_futex, &sh->futex, FUTEX_WAIT, futex, NULL, NULL, 0);
+        }
+
+        hcore_atomic_fetch_add(&sh->wait, -1);
+    }
+}
+
+void
+hcore_shrwlock_unlock(hcore_shrwlock_t *rw)
+{
+    hcore_pid_t          pid = hcore_getpid();
+    hcore_shrwlock_sh_t *sh  = rw->sh;
+
+    if (sh->lock == (hcore_atomic_uint_t)pid)
+    {
+        hcore_atomic_cmp_set(&sh->lock, pid, 0);
+        hcore_shrwlock_wakeup(rw);
+        return;
+    }
+
+    if (hcore_atomic_cmp_set(&sh->readers[rw->slot].pid, pid, 0))
+    {
+        hcore_shrwlock_wakeup(rw);
+    }
+}
+
+hcore_uint_t
+hcore_shrwlock_force_unlock(hcore_shrwlock_t *rw, hcore_pid_t pid)
+{
+    hcore_uint_t         i, rc;
+    hcore_shrwlock_sh_t *sh = rw->sh;
+
+    rc = hcore_atomic_cmp_set(&sh->lock, pid, 0);
+
+    for (i = 0; i < HCORE_SHRWLOCK_READERS; i++)
+    {
+        if (sh->readers[i].pid == (hcore_atomic_uint_t)pid
+            && hcore_atomic_cmp_set(&sh->readers[i].pid, pid, 0))
+        {
+            rc = 1;
+        }
+    }
+
+    if (rc)
+    {
+        hcore_shrwlock_wakeup(rw);
+    }
+
+    return rc;
+}
+
+static hcore_uint_t
+hcore_shrwlock_enter(hcore_shrwlock_t *rw, hcore_pid_t pid)
+{
+    hcore_uint_t         i, n;
+    hcore_shrwlock_sh_t *sh = rw->sh;
+
+    if (sh->lock != 0) return 0;
+
+    // the slots are probed from pid, so readers mostly don't share a line
+
+    for (n = 0; n < HCORE_SHRWLOCK_READERS; n++)
+    {
+        i = (pid + n) % HCORE_SHRWLOCK_READERS;
+
+        if (sh->readers[i].pid != 0
+            || !hcore_atomic_cmp_set(&sh->readers[i].pid, 0, pid))
+        {
+            continue;
+        }
+
+        /*
+         * the writer sets 'lock' before checking slots, and the reader sets
+         * slot before checking 'lock', so at least one of them backs off
+         */
+
+        if (sh->lock == 0)
+        {
+            rw->slot = i;
+            return 1;
+        }
+
+        hcore_atomic_cmp_set(&sh->readers[i].pid, pid, 0);
+        hcore_shrwlock_wakeup(rw);
+
+        return 0;
+    }
+
+    return 0; // all slots are busy
+}
+
+static hcore_shrwlock_reader_t *
+hcore_shrwlock_reader(hcore_shrwlock_sh_t *sh)
+{
+    hcore_uint_t i;
+
+    for (i = 0; i < HCORE_SHRWLOCK_READERS; i++)
+    {
+        if (sh->readers[i].pid != 0) return &sh->readers[i];
+    }
+
+    return NULL;
+}
+
+static void
+hcore_shrwlock_wakeup(hcore_shrwlock_t *rw)
+{
+    hcore_shrwlock_sh_t *sh = rw->sh;
+
+    if (hcore_atomic_fetch(&sh->wait) == 0)
+    {
+        return;
+    }
+
+    // the readers are all woken, they can hold the lock together
+
+    __atomic_fetch_add(&sh->futex, 1, __ATOMIC_SEQ_CST);
+
+    syscall(SYS_futex, &sh->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
@@ -20,8 +20,10 @@
 #include <hcore_string.h>
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 
 
 #define HCORE_SLAB_PAGE_FREE  0
@@ -43,6 +45,11 @@
 #define HCORE_SLAB_MIN_SIZE(pagesize) (pagesize << 3)
 
 #define hcore_slab_get_slots(pool) ((hcore_slab_page_t *)((pool) + 1))
+#define hcore_slab_get_nslots(pool) \
+    (hcore_getpagesize_shift() - (pool)->min_shift)
+#define hcore_slab_get_stats(pool) \
+    ((hcore_slab_stat_t *)(hcore_slab_get_slots(pool)     \
+                           + hcore_slab_get_nslots(pool)))
 
 #define hcore_slab_get_page_type(page) ((page)->prev & HCORE_SLAB_PAGE_MASK)
 
@@ -77,6 +84,26 @@ static void               hcore_slab_free_pages(hcore_slab_pool_t *pool,
                                                 hcore_slab_page_t *page, hcore_int_t page_n);
 static void  hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p);
 static void *hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size);
+static void  hcore_slab_update_largest(hcore_slab_pool_t *pool);
+
+static hcore_atomic_uint_t hcore_shpool_lock_timed(hcore_shpool_t *shpool);
+static void hcore_shpool_unlock_timed(hcore_shpool_t *shpool,
+                                      hcore_atomic_uint_t start);
+
+static hcore_uint_t hcore_shpool_cache_slot(hcore_slab_pool_t *pool,
+                                            size_t             size);
+static hcore_int_t  hcore_shpool_cache_slot_of(hcore_slab_pool_t *pool,
+                                               void              *p);
+static void        *hcore_shpool_cache_alloc(hcore_shpool_t *shpool,
+                                             size_t          size);
+static void  hcore_shpool_cache_free(hcore_shpool_t *shpool, hcore_uint_t slot,
+                                     void *p);
+static void  hcore_shpool_cache_check(hcore_shpool_cache_t *cache);
+static void  hcore_shpool_atfork(void);
+static void  hcore_shpool_atfork_child(void);
+
+static pthread_once_t hcore_shpool_once = PTHREAD_ONCE_INIT;
+static hcore_uint_t   hcore_shpool_generation;
 
 hcore_shpool_t *
 hcore_create_shpool(hcore_log_t *log, const char *name, size_t size)
@@ -289,8 +316,8 @@ error:
 
 /*
  * internal construction : | sizeof(hcore_slab_pool_t) | max_slab_n *
- * sizeof(hcore_slab_page_t) | n * sizeof(hcore_slab_page_t) | align_padding
- * | n * page |
+ * sizeof(hcore_slab_page_t) | max_slab_n * sizeof(hcore_slab_stat_t) | n *
+ * sizeof(hcore_slab_page_t) | align_padding | n * page |
  *
  * max_slab_n : pagesize_shift - this.min_shift
  *
@@ -324,6 +351,10 @@ hcore_slab_init(hcore_slab_pool_t *pool)
 
     p += n * sizeof(hcore_slab_page_t); // skip headers of slab
 
+    hcore_memzero(p, n * sizeof(hcore_slab_stat_t));
+
+    p += n * sizeof(hcore_slab_stat_t); // skip statistics of slab
+
     size = pool->end - p; // size of all pages
 
     /*
@@ -360,36 +391,40 @@ hcore_slab_init(hcore_slab_pool_t *pool)
         page->slab = page_n;
     }
 
-    pool->last  = pool->pages + page_n;
-    pool->pfree = page_n;
+    pool->last    = pool->pages + page_n;
+    pool->pfree   = page_n;
+    pool->largest = page_n;
+
+    pool->page_reqs  = 0;
+    pool->page_fails = 0;
+    pool->lock_count = 0;
+    pool->lock_nsec  = 0;
 }
 
 
 static void
 hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
 {
+    hcore_int_t        pagesize       = hcore_getpagesize();
+    hcore_int_t        pagesize_shift = hcore_getpagesize_shift();
+    hcore_int_t        exact_size     = hcore_get_slab_exact_size();
+    hcore_int_t        exact_shift    = hcore_get_slab_exact_shift();
+    size_t             size;
+    uintptr_t          slab, m, *bitmap;
+    hcore_uint_t       i, n, type, slot, shift, map;
+    hcore_slab_page_t *slots, *page;
+    hcore_slab_stat_t *stats = hcore_slab_get_stats(pool);
+
     if ((hcore_uchar_t *)p < pool->start || (hcore_uchar_t *)p > pool->end)
     {
         goto failed;
     }
 
-    hcore_int_t        pagesize    = hcore_getpagesize();
-    hcore_int_t        exact_size  = hcore_get_slab_exact_size();
-    hcore_int_t        exact_shift = hcore_get_slab_exact_shift();
-    hcore_uint_t       i, type;
-    hcore_slab_page_t *page;
-    uintptr_t          slab, m;
-
-    i    = ((hcore_uchar_t *)p - pool->start) >> pagesize;
-    page = &pool->pages[i];
+    n    = ((hcore_uchar_t *)p - pool->start) >> pagesize_shift;
+    page = &pool->pages[n];
     slab = page->slab;
     type = hcore_slab_get_page_type(page);
 
-    hcore_uint_t       shift, slot, n;
-    size_t             size;
-    uintptr_t         *bitmap;
-    hcore_slab_page_t *slots;
-
     switch (type)
     {
     case HCORE_SLAB_SMALL:
@@ -402,13 +437,13 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
         }
 
         // count position in map
-        i = ((uintptr_t)p & (pagesize - 1)) >> shift;
-        m = (uintptr_t)1 << (i % (8 * sizeof(uintptr_t)));
-        i /= 8 * sizeof(uintptr_t);
+        n = ((uintptr_t)p & (pagesize - 1)) >> shift;
+        m = (uintptr_t)1 << (n % (8 * sizeof(uintptr_t)));
+        n /= 8 * sizeof(uintptr_t);
 
         bitmap = (uintptr_t *)((uintptr_t)p & ~((uintptr_t)pagesize - 1));
 
-        if (bitmap[i] & m)
+        if (bitmap[n] & m)
         {
             slot = shift - pool->min_shift;
 
@@ -425,7 +460,11 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
                 hcore_slab_set_page_prev(page->next, page, HCORE_SLAB_SMALL);
             }
 
-            bitmap[i] &= ~m; // unset bit
+            bitmap[n] &= ~m; // unset bit
+
+            stats[slot].used--;
+
+            // the slabs which are used by bitmap self
 
             n = (pagesize >> shift) / ((1 << shift) * 8);
 
@@ -441,15 +480,15 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
                 goto done; // no empty in current map
             }
 
-            hcore_uint_t map_n;
-
-            map_n = (pagesize >> shift) / (8 * sizeof(uintptr_t));
+            map = (pagesize >> shift) / (8 * sizeof(uintptr_t));
 
-            for (i = i + 1; i < map_n; i++)
+            for (i = i + 1; i < map; i++)
             {
-                if (bitmap[i]) goto done; // all no empty in other maps
+                if (bitmap[i]) goto done; // no empty in other maps
             }
 
+            stats[slot].total -= (pagesize >> shift) - n;
+
             hcore_slab_free_pages(pool, page, 1); // free empty page
 
             goto done;
@@ -460,6 +499,7 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
     case HCORE_SLAB_EXACT:
         m    = (uintptr_t)1 << (((uintptr_t)p & (pagesize - 1)) >> exact_shift);
         size = exact_size;
+
         if ((uintptr_t)p & (size - 1)) goto wrong_chunk;
 
         if (slab & m)
@@ -481,6 +521,8 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
 
             page->slab &= ~m; // unset bit
 
+            stats[slot].used--;
+
             // free empty page
 
             if (page->slab)
@@ -488,6 +530,8 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
                 goto done;
             }
 
+            stats[slot].total -= 8 * sizeof(uintptr_t);
+
             hcore_slab_free_pages(pool, page, 1);
 
             goto done;
@@ -523,6 +567,8 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
 
             page->slab &= ~m; // unset bit
 
+            stats[slot].used--;
+
             // free empty page
 
             if (page->slab & HCORE_SLAB_MAP_MASK)
@@ -530,6 +576,8 @@ hcore_slab_free_locked(hcore_slab_pool_t *pool, void *p)
                 goto done;
             }
 
+            stats[slot].total -= pagesize >> shift;
+
             hcore_slab_free_pages(pool, page, 1);
 
             goto done;
@@ -573,13 +621,17 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
 {
     hcore_int_t        pagesize       = hcore_getpagesize();
     hcore_int_t        pagesize_shift = hcore_getpagesize_shift();
-    hcore_int_t        exact_size     = hcore_get_slab_exact_size();
     hcore_int_t        exact_shift    = hcore_get_slab_exact_shift();
-    hcore_slab_page_t *page;
-    uintptr_t          p;
+    size_t             s;
+    uintptr_t          p, m, mask, *bitmap;
+    hcore_uint_t       i, n, slot, shift, map;
+    hcore_slab_page_t *page, *slots;
+    hcore_slab_stat_t *stat = NULL;
 
-    if (hcore_get_slab_max_size() < size)
+    if ((size_t)hcore_get_slab_max_size() < size)
     {
+        pool->page_reqs++;
+
         page = hcore_slab_alloc_pages(pool, (size >> pagesize_shift)
                                                 + ((size % pagesize) ? 1 : 0));
 
@@ -590,18 +642,17 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
         else
         {
             p = 0;
+
+            pool->page_fails++;
         }
 
         goto done;
     }
 
-    hcore_int_t  shift;
-    hcore_uint_t slot;
-
     if (pool->min_size < size)
     {
         shift = 1; // include remainder
-        for (size_t s = size - 1
+        for (s = size - 1
              /* To avoid to exceed need mininum size when no remainder */
              ;
              s >>= 1; shift++)
@@ -617,58 +668,54 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
         slot  = 0;
     }
 
-    hcore_slab_page_t *slots, *prev;
-    uintptr_t         *bitmap, m;
-    hcore_uint_t       map_n, i, bit_n;
+    stat = &hcore_slab_get_stats(pool)[slot];
+    stat->reqs++;
 
     slots = hcore_slab_get_slots(pool);
     page  = slots[slot].next;
 
     if (page->next != page)
     {
-        if (shift < exact_shift)
+        if (shift < (hcore_uint_t)exact_shift)
         {
             bitmap = (uintptr_t *)hcore_slab_get_page_addr(pool, page,
                                                            pagesize_shift);
 
-            map_n = (pagesize >> shift) / (8 * sizeof(uintptr_t));
+            map = (pagesize >> shift) / (8 * sizeof(uintptr_t));
 
-            for (i = 0; i < map_n; i++)
+            for (n = 0; n < map; n++)
             {
-                if (bitmap[i] != HCORE_SLAB_BUSY)
-                {
-                    for (m = 1, bit_n = 0; m; m <<= 1, bit_n++)
-                    {
-                        if (bitmap[i] & m) continue;
+                if (bitmap[n] == HCORE_SLAB_BUSY) continue;
 
-                        bitmap[i] |= m; // set bit
+                for (m = 1, i = 0; m; m <<= 1, i++)
+                {
+                    if (bitmap[n] & m) continue;
 
-                        hcore_uint_t size = (i * 8 * sizeof(uintptr_t) + i)
-                                            << shift;
+                    bitmap[n] |= m; // set bit
 
-                        p = (uintptr_t)bitmap + size;
+                    p = (uintptr_t)bitmap
+                        + ((n * 8 * sizeof(uintptr_t) + i) << shift);
 
-                        if (bitmap[i] == HCORE_SLAB_BUSY)
+                    if (bitmap[n] == HCORE_SLAB_BUSY)
+                    {
+                        for (n = n + 1; n < map; n++)
                         {
-                            for (i = i + 1; i < map_n; i++)
+                            if (bitmap[n] != HCORE_SLAB_BUSY)
                             {
-                                if (bitmap[i] != HCORE_SLAB_BUSY)
-                                {
-                                    goto done;
-                                }
+                                goto done;
                             }
-
-                            hcore_slab_remove_full_page(page, HCORE_SLAB_SMALL);
                         }
 
-                        goto done;
+                        hcore_slab_remove_full_page(page, HCORE_SLAB_SMALL);
                     }
+
+                    goto done;
                 }
             }
         }
-        else if (shift == exact_shift)
+        else if (shift == (hcore_uint_t)exact_shift)
         {
-            for (m = 1, bit_n = 0; m; m << 1, bit_n++)
+            for (m = 1, i = 0; m; m <<= 1, i++)
             {
                 if (page->slab & m) continue;
 
@@ -679,48 +726,52 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
                     hcore_slab_remove_full_page(page, HCORE_SLAB_EXACT);
                 }
 
+                p = hcore_slab_get_page_addr(pool, page, pagesize_shift)
+                    + (i << shift);
+
                 goto done;
             }
         }
         else // shift > exact_shift
         {
-            uintptr_t mask;
-
             /*
              * count amount of slabs and represent it with mask (each bit
              * equal to 1 slab) */
             mask = ((uintptr_t)1 << (pagesize >> shift)) - 1;
             mask <<= HCORE_SLAB_MAP_SHIFT;
 
-            for (m = (uintptr_t)1 << HCORE_SLAB_MAP_SHIFT, bit_n = 0; m & mask;
-                 m <<= 1, bit_n++)
+            for (m = (uintptr_t)1 << HCORE_SLAB_MAP_SHIFT, i = 0; m & mask;
+                 m <<= 1, i++)
             {
                 if (page->slab & m) continue;
 
                 page->slab |= m; // set bit
 
-                if (page->slab & HCORE_SLAB_MAP_MASK == mask)
+                if ((page->slab & HCORE_SLAB_MAP_MASK) == mask)
                 {
                     hcore_slab_remove_full_page(page, HCORE_SLAB_BIG);
                 }
 
-                p = hcore_slab_get_page_addr(pool, page, pagesize_shift);
-
+                p = hcore_slab_get_page_addr(pool, page, pagesize_shift)
+                    + (i << shift);
 
                 goto done;
             }
         }
+
+        // a page which isn't full is always in the list
+
+        hcore_bug_on();
     }
+
     // else the slot is empty
 
     page = hcore_slab_alloc_pages(pool, 1);
 
     if (page)
     {
-        if (shift < exact_shift)
+        if (shift < (hcore_uint_t)exact_shift)
         {
-            hcore_uint_t n;
-
             bitmap = (uintptr_t *)hcore_slab_get_page_addr(pool, page,
                                                            pagesize_shift);
 
@@ -732,8 +783,7 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
 
             /* "n" elements for bitmap, plus one requested */
 
-            for (i = 0;
-                 i < (n + 1) / (8 * sizeof(uintptr_t) /* bits of a map(, and 1 bit represent 1 slab) */); i++)
+            for (i = 0; i < (n + 1) / (8 * sizeof(uintptr_t)); i++)
             {
                 /*
                  * map self used size */
@@ -742,16 +792,18 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
 
             /*
              * count maps of remainder */
-            m = ((uintptr_t)1 << ((n + 1) % (8 * sizeof(uintptr_t)))) - 1;
+            m         = ((uintptr_t)1 << ((n + 1) % (8 * sizeof(uintptr_t)))) - 1;
             bitmap[i] = m;
 
-            map_n = (pagesize >> shift) / (8 * sizeof(uintptr_t));
+            map = (pagesize >> shift) / (8 * sizeof(uintptr_t));
 
-            for (i = i + 1; i < map_n; i++)
+            for (i = i + 1; i < map; i++)
             {
                 bitmap[i] = 0;
             }
 
+            stat->total += (pagesize >> shift) - n;
+
             page->slab = shift;
             page->next = &slots[slot];
             hcore_slab_set_page_prev(page, &slots[slot], HCORE_SLAB_SMALL);
@@ -763,8 +815,10 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
 
             goto done;
         }
-        else if (shift == exact_shift)
+        else if (shift == (hcore_uint_t)exact_shift)
         {
+            stat->total += 8 * sizeof(uintptr_t);
+
             page->slab = 1; // fitst slab
             page->next = &slots[slot];
             hcore_slab_set_page_prev(page, &slots[slot], HCORE_SLAB_EXACT);
@@ -777,6 +831,8 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
         }
         else // shift > exact_shift
         {
+            stat->total += pagesize >> shift;
+
             page->slab = ((uintptr_t)1 << HCORE_SLAB_MAP_SHIFT) | shift;
             page->next = &slots[slot];
             hcore_slab_set_page_prev(page, &slots[slot], HCORE_SLAB_BIG);
@@ -792,6 +848,18 @@ hcore_slab_alloc_locked(hcore_slab_pool_t *pool, size_t size)
     p = 0;
 
 done:
+    if (stat)
+    {
+        if (p)
+        {
+            stat->used++;
+        }
+        else
+        {
+            stat->fails++;
+        }
+    }
+
     return (void *)p;
 }
 
@@ -803,7 +871,7 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
 
     pool->pfree += page_n;
 
-    // TODO: why update the slab?
+    // the head of free pages holds the number of them
     page->slab = page_n--;
 
     if (page_n)
@@ -813,7 +881,7 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
 
     if (page->next)
     {
-        // update pointor
+        // unlink from the list of slot
         prev             = hcore_slab_get_page_prev(page);
         prev->next       = page->next;
         page->next->prev = page->prev;
@@ -825,7 +893,7 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
     {
         /*
          * join next page to the free page if type of next page is
-         * 'HCORE_SLAB_PAGE' */
+         * 'HCORE_SLAB_PAGE' and it's free */
 
         if (hcore_slab_get_page_type(join) == HCORE_SLAB_PAGE)
         {
@@ -838,8 +906,9 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
                 prev->next       = join->next;
                 join->next->prev = join->prev;
 
-                hcore_slab_remove_full_page(join, HCORE_SLAB_PAGE);
-                page->slab = HCORE_SLAB_PAGE_FREE;
+                join->slab = HCORE_SLAB_PAGE_FREE;
+                join->next = NULL;
+                hcore_slab_set_page_prev(join, 0, HCORE_SLAB_PAGE);
             }
         }
     }
@@ -848,7 +917,7 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
     {
         /*
          * join the free page to prev page if type of prev page is
-         * 'HCORE_SLAB_PAGE' */
+         * 'HCORE_SLAB_PAGE' and it's free */
 
         join = page - 1;
 
@@ -856,6 +925,7 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
         {
             if (join->slab == HCORE_SLAB_PAGE_FREE)
             {
+                // the tail of free pages points to its head
                 join = hcore_slab_get_page_prev(join);
             }
 
@@ -864,8 +934,13 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
                 page_n += join->slab;
                 join->slab += page->slab;
 
-                hcore_slab_remove_full_page(join, HCORE_SLAB_PAGE);
-                join->slab = HCORE_SLAB_PAGE_FREE;
+                prev             = hcore_slab_get_page_prev(join);
+                prev->next       = join->next;
+                join->next->prev = join->prev;
+
+                page->slab = HCORE_SLAB_PAGE_FREE;
+                page->next = NULL;
+                hcore_slab_set_page_prev(page, 0, HCORE_SLAB_PAGE);
 
                 page = join;
             }
@@ -880,17 +955,22 @@ hcore_slab_free_pages(hcore_slab_pool_t *pool, hcore_slab_page_t *page,
     page->next->prev = (uintptr_t)page;
 
     pool->free.next = page;
+
+    if (pool->largest < page->slab) pool->largest = page->slab;
 }
 
 static hcore_slab_page_t *
 hcore_slab_alloc_pages(hcore_slab_pool_t *pool, hcore_uint_t alloc_page_n)
 {
     hcore_slab_page_t *page, *p;
+    hcore_uint_t       largest;
 
     for (page = pool->free.next; page != &pool->free; page = page->next)
     {
         if (alloc_page_n <= page->slab)
         {
+            largest = (page->slab == pool->largest);
+
             if (alloc_page_n < page->slab)
             {
                 // point to head of the pages
@@ -923,6 +1003,8 @@ hcore_slab_alloc_pages(hcore_slab_pool_t *pool, hcore_uint_t alloc_page_n)
 
             pool->pfree -= alloc_page_n;
 
+            if (largest) hcore_slab_update_largest(pool);
+
             if (--alloc_page_n == 0)
             {
                 // only allocate one page
@@ -934,7 +1016,7 @@ hcore_slab_alloc_pages(hcore_slab_pool_t *pool, hcore_uint_t alloc_page_n)
             {
                 p->slab = HCORE_SLAB_PAGE_BUSY;
                 p->next = NULL;
-                hcore_slab_set_page_prev(page, 0, HCORE_SLAB_PAGE);
+                hcore_slab_set_page_prev(p, 0, HCORE_SLAB_PAGE);
                 p++;
             }
 
@@ -945,21 +1027,70 @@ hcore_slab_alloc_pages(hcore_slab_pool_t *pool, hcore_uint_t alloc_page_n)
     return NULL;
 }
 
+static void
+hcore_slab_update_largest(hcore_slab_pool_t *pool)
+{
+    hcore_slab_page_t *page;
+    hcore_uint_t       largest = 0;
+
+    // the largest run is split, find the next one
+
+    for (page = pool->free.next; page != &pool->free; page = page->next)
+    {
+        if (largest < page->slab) largest = page->slab;
+    }
+
+    pool->largest = largest;
+}
+
+static hcore_atomic_uint_t
+hcore_shpool_lock_timed(hcore_shpool_t *shpool)
+{
+    struct timespec ts;
+
+    hcore_shmtx_lock(&shpool->mutex);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (hcore_atomic_uint_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+hcore_shpool_unlock_timed(hcore_shpool_t *shpool, hcore_atomic_uint_t start)
+{
+    struct timespec    ts;
+    hcore_slab_pool_t *sp = shpool->sp;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    sp->lock_count++;
+    sp->lock_nsec += (hcore_atomic_uint_t)ts.tv_sec * 1000000000 + ts.tv_nsec
+                     - start;
+
+    hcore_shmtx_unlock(&shpool->mutex);
+}
+
 
 void *
 hcore_shpool_alloc(hcore_shpool_t *shpool, size_t size)
 {
-    void *p;
+    void               *p;
+    hcore_atomic_uint_t start;
 
     hcore_assert(shpool && size);
 
     if (shpool == NULL && size == 0) return NULL;
 
-    hcore_shmtx_lock(&shpool->mutex);
+    if (shpool->cache && size <= (size_t)hcore_get_slab_max_size())
+    {
+        return hcore_shpool_cache_alloc(shpool, size);
+    }
+
+    start = hcore_shpool_lock_timed(shpool);
     {
         p = hcore_slab_alloc_locked(shpool->sp, size);
     }
-    hcore_shmtx_unlock(&shpool->mutex);
+    hcore_shpool_unlock_timed(shpool, start);
 
     return p;
 }
@@ -989,15 +1120,29 @@ hcore_shpool_calloc(hcore_shpool_t *shpool, size_t size)
 void
 hcore_shpool_free(hcore_shpool_t *shpool, void *p)
 {
+    hcore_int_t         slot;
+    hcore_atomic_uint_t start;
+
     hcore_assert(shpool && p);
 
     if (shpool == NULL && p == NULL) return;
 
-    hcore_shmtx_lock(&shpool->mutex);
+    if (shpool->cache)
+    {
+        slot = hcore_shpool_cache_slot_of(shpool->sp, p);
+
+        if (slot != -1)
+        {
+            hcore_shpool_cache_free(shpool, slot, p);
+            return;
+        }
+    }
+
+    start = hcore_shpool_lock_timed(shpool);
     {
         hcore_slab_free_locked(shpool->sp, p);
     }
-    hcore_shmtx_unlock(&shpool->mutex);
+    hcore_shpool_unlock_timed(shpool, start);
 }
 
 void
@@ -1007,6 +1152,294 @@ hcore_shpool_free_locked(hcore_shpool_t *shpool, void *p)
     hcore_slab_free_locked(shpool->sp, p);
 }
 
+hcore_int_t
+hcore_shpool_init_cache(hcore_shpool_t *shpool, hcore_uint_t size)
+{
+    hcore_shpool_cache_t *cache;
+    hcore_uint_t          i, nslots;
+    void                **objs;
+
+    hcore_assert(shpool && shpool->cache == NULL);
+
+    if (shpool == NULL || shpool->cache) return HCORE_ERROR;
+
+    if (size == 0) size = HCORE_SHPOOL_CACHE_SIZE;
+
+    if (pthread_once(&hcore_shpool_once, hcore_shpool_atfork) != 0)
+    {
+        return HCORE_ERROR;
+    }
+
+    // a magazine for each slot, and the objects follow the magazines
+
+    nslots = hcore_getpagesize_shift() - shpool->sp->min_shift;
+
+    cache = hcore_malloc(sizeof(hcore_shpool_cache_t)
+                         + nslots * sizeof(hcore_shpool_magazine_t)
+                         + nslots * size * sizeof(void *));
+    if (cache == NULL)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, shpool->log, errno,
+                        "failed to allocate magazines of shpool");
+        return HCORE_ERROR;
+    }
+
+    cache->generation = hcore_shpool_generation;
+    cache->size       = size;
+    cache->nslots     = nslots;
+
+    objs = (void **)&cache->mags[nslots];
+
+    for (i = 0; i < nslots; i++)
+    {
+        cache->mags[i].n    = 0;
+        cache->mags[i].objs = objs + i * size;
+    }
+
+    shpool->cache = cache;
+
+    return HCORE_OK;
+}
+
+void
+hcore_shpool_flush_cache(hcore_shpool_t *shpool)
+{
+    hcore_shpool_cache_t    *cache;
+    hcore_shpool_magazine_t *mag;
+    hcore_uint_t             i;
+    hcore_atomic_uint_t      start;
+
+    hcore_assert(shpool);
+
+    if (shpool == NULL || shpool->cache == NULL) return;
+
+    cache = shpool->cache;
+
+    hcore_shpool_cache_check(cache);
+
+    start = hcore_shpool_lock_timed(shpool);
+    {
+        for (i = 0; i < cache->nslots; i++)
+        {
+            mag = &cache->mags[i];
+
+            while (mag->n)
+            {
+                hcore_slab_free_locked(shpool->sp, mag->objs[--mag->n]);
+            }
+        }
+    }
+    hcore_shpool_unlock_timed(shpool, start);
+}
+
+void
+hcore_shpool_stat(hcore_shpool_t *shpool, hcore_shpool_stat_t *stat)
+{
+    hcore_slab_pool_t *sp;
+    hcore_slab_stat_t *stats;
+    hcore_uint_t       i;
+
+    hcore_assert(shpool && stat);
+
+    if (shpool == NULL || stat == NULL) return;
+
+    sp    = shpool->sp;
+    stats = hcore_slab_get_stats(sp);
+
+    stat->pages      = sp->last - sp->pages;
+    stat->free_pages = sp->pfree;
+    stat->largest    = sp->largest;
+    stat->page_reqs  = sp->page_reqs;
+    stat->page_fails = sp->page_fails;
+    stat->lock_count = sp->lock_count;
+    stat->lock_nsec  = sp->lock_nsec;
+
+    stat->nslots = hcore_min(hcore_slab_get_nslots(sp), HCORE_SHPOOL_MAX_SLOTS);
+
+    for (i = 0; i < stat->nslots; i++)
+    {
+        stat->slots[i].size  = (size_t)1 << (i + sp->min_shift);
+        stat->slots[i].total = stats[i].total;
+        stat->slots[i].used  = stats[i].used;
+        stat->slots[i].reqs  = stats[i].reqs;
+        stat->slots[i].fails = stats[i].fails;
+    }
+}
+
+static hcore_uint_t
+hcore_shpool_cache_slot(hcore_slab_pool_t *pool, size_t size)
+{
+    size_t       s;
+    hcore_uint_t shift;
+
+    // the same as hcore_slab_alloc_locked()
+
+    if (size <= pool->min_size) return 0;
+
+    for (s = size - 1, shift = 1; s >>= 1; shift++)
+    {
+        // nothing
+    }
+
+    return shift - pool->min_shift;
+}
+
+static hcore_int_t
+hcore_shpool_cache_slot_of(hcore_slab_pool_t *pool, void *p)
+{
+    hcore_slab_page_t *page;
+    hcore_uint_t       shift;
+
+    if ((hcore_uchar_t *)p < pool->start || (hcore_uchar_t *)p >= pool->end)
+    {
+        return -1;
+    }
+
+    /*
+     * the type and shift of page don't change while the object is allocated,
+     * so they are read without lock
+     */
+
+    page = &pool->pages[((hcore_uchar_t *)p - pool->start)
+                        >> hcore_getpagesize_shift()];
+
+    switch (hcore_slab_get_page_type(page))
+    {
+    case HCORE_SLAB_SMALL:
+    case HCORE_SLAB_BIG:
+        shift = page->slab & HCORE_SLAB_SHIFT_MASK;
+        break;
+
+    case HCORE_SLAB_EXACT:
+        shift = hcore_get_slab_exact_shift();
+        break;
+
+    default:
+        return -1; // pages aren't cached
+    }
+
+    if ((uintptr_t)p & (((uintptr_t)1 << shift) - 1))
+    {
+        return -1; // wrong chunk, let hcore_slab_free_locked() ignore it
+    }
+
+    return shift - pool->min_shift;
+}
+
+static void *
+hcore_shpool_cache_alloc(hcore_shpool_t *shpool, size_t size)
+{
+    hcore_shpool_cache_t    *cache = shpool->cache;
+    hcore_shpool_magazine_t *mag;
+    hcore_uint_t             slot, n;
+    void                    *p;
+    hcore_atomic_uint_t      start;
+
+    hcore_shpool_cache_check(cache);
+
+    slot = hcore_shpool_cache_slot(shpool->sp, size);
+    mag  = &cache->mags[slot];
+
+    if (mag->n)
+    {
+        return mag->objs[--mag->n];
+    }
+
+    // refill half of magazine under one lock
+
+    size = (size_t)1 << (slot + shpool->sp->min_shift);
+    n    = hcore_max(cache->size / 2, 1);
+
+    start = hcore_shpool_lock_timed(shpool);
+    {
+        while (mag->n < n)
+        {
+            p = hcore_slab_alloc_locked(shpool->sp, size);
+            if (p == NULL) break;
+
+            mag->objs[mag->n++] = p;
+        }
+    }
+    hcore_shpool_unlock_timed(shpool, start);
+
+    if (mag->n)
+    {
+        return mag->objs[--mag->n];
+    }
+
+    // the pool is exhausted, reclaim the objects cached by other slots
+
+    hcore_shpool_flush_cache(shpool);
+
+    start = hcore_shpool_lock_timed(shpool);
+    {
+        p = hcore_slab_alloc_locked(shpool->sp, size);
+    }
+    hcore_shpool_unlock_timed(shpool, start);
+
+    return p;
+}
+
+static void
+hcore_shpool_cache_free(hcore_shpool_t *shpool, hcore_uint_t slot, void *p)
+{
+    hcore_shpool_cache_t    *cache = shpool->cache;
+    hcore_shpool_magazine_t *mag;
+    hcore_uint_t             n;
+    hcore_atomic_uint_t      start;
+
+    hcore_shpool_cache_check(cache);
+
+    mag = &cache->mags[slot];
+
+    if (mag->n == cache->size)
+    {
+        // flush half of magazine under one lock
+
+        n = hcore_max(cache->size / 2, 1);
+
+        start = hcore_shpool_lock_timed(shpool);
+        {
+            while (n--)
+            {
+                hcore_slab_free_locked(shpool->sp, mag->objs[--mag->n]);
+            }
+        }
+        hcore_shpool_unlock_timed(shpool, start);
+    }
+
+    mag->objs[mag->n++] = p;
+}
+
+static void
+hcore_shpool_cache_check(hcore_shpool_cache_t *cache)
+{
+    hcore_uint_t i;
+
+    if (cache->generation == hcore_shpool_generation) return;
+
+    // inherited from the parent, its objects mustn't be used by the child
+
+    for (i = 0; i < cache->nslots; i++)
+    {
+        cache->mags[i].n = 0;
+    }
+
+    cache->generation = hcore_shpool_generation;
+}
+
+static void
+hcore_shpool_atfork(void)
+{
+    pthread_atfork(NULL, NULL, hcore_shpool_atfork_child);
+}
+
+static void
+hcore_shpool_atfork_child(void)
+{
+    hcore_shpool_generation++;
+}
+
 void
 hcore_destroy_shpool(hcore_shpool_t *shpool)
 {
@@ -1014,6 +1447,12 @@ hcore_destroy_shpool(hcore_shpool_t *shpool)
 
     if (shpool == NULL) return;
 
+    if (shpool->cache)
+    {
+        hcore_shpool_flush_cache(shpool);
+        hcore_free(shpool->cache);
+    }
+
     if (munmap(shpool->addr, shpool->size) == -1)
     {
         hcore_log_error(HCORE_LOG_ALERT, shpool->log, errno,
@@ -1047,5 +1486,25 @@ hcore_shpool_dump(hcore_shpool_t *shpool)
                     shpool->name ? shpool->name : "anonymity", sp->min_shift,
                     sp->min_size, sp->pages, sp->last, sp->pfree, sp->addr,
                     sp->start, sp->end);
+
+    hcore_shpool_stat_t stat;
+    hcore_uint_t        i;
+
+    hcore_shpool_stat(shpool, &stat);
+
+    hcore_log_debug(shpool->log, 0,
+                    "pages: %ud, free: %ud, largest: %ud, page_reqs: %uL, "
+                    "page_fails: %uL, lock_count: %uL, lock_nsec: %uL",
+                    stat.pages, stat.free_pages, stat.largest, stat.page_reqs,
+                    stat.page_fails, stat.lock_count, stat.lock_nsec);
+
+    for (i = 0; i < stat.nslots; i++)
+    {
+        hcore_log_debug(shpool->log, 0,
+                        "slot %uz: total: %uL, used: %uL, reqs: %uL, fails: %uL",
+                        stat.slots[i].size, stat.slots[i].total,
+                        stat.slots[i].used, stat.slots[i].reqs,
+                        stat.slots[i].fails);
+    }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,595 @@
+/**
+ * @file hcore_thread_pool.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_debug.h>
+#include <hcore_event.h>
+#include <hcore_thread_pool.h>
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+static hcore_int_t hcore_thread_deque_init(hcore_pool_t         *pool,
+                                           hcore_thread_deque_t *dq,
+                                           hcore_uint_t          size);
+static hcore_int_t hcore_thread_deque_push(hcore_thread_deque_t *dq,
+                                           hcore_thread_task_t  *task);
+static hcore_thread_task_t *hcore_thread_deque_take(hcore_thread_deque_t *dq);
+static hcore_thread_task_t *hcore_thread_deque_steal(hcore_thread_deque_t *dq);
+
+static void                *hcore_thread_cycle(void *data);
+static hcore_thread_task_t *hcore_thread_get_task(hcore_thread_worker_t *wk);
+static void hcore_thread_run_task(hcore_thread_pool_t *tp,
+                                  hcore_thread_task_t *task);
+static void hcore_thread_notify_handler(hcore_event_t *ev);
+static uint64_t hcore_thread_time(void);
+
+hcore_thread_pool_t *
+hcore_create_thread_pool(hcore_pool_t *pool, hcore_uint_t n, hcore_uint_t size)
+{
+    int                    err;
+    long                   ncpus;
+    hcore_uint_t           i;
+    hcore_thread_pool_t   *tp;
+    hcore_thread_worker_t *wk;
+
+    hcore_assert(pool);
+
+    if (pool == NULL) return NULL;
+
+    if (n == 0)
+    {
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n     = ncpus > 0 ? (hcore_uint_t)ncpus : 1;
+    }
+
+    if (size == 0) size = HCORE_THREAD_POOL_DEQUE_SIZE_DEFAULT;
+
+    tp = hcore_pcalloc(pool, sizeof(hcore_thread_pool_t));
+    if (tp == NULL) return NULL;
+
+    tp->workers = hcore_pcalloc(pool, sizeof(hcore_thread_worker_t) * n);
+    if (tp->workers == NULL) return NULL;
+
+    tp->nworkers = n;
+    tp->log      = pool->log;
+
+    for (i = 0; i < n; i++)
+    {
+        wk = &tp->workers[i];
+
+        wk->id   = i;
+        wk->tp   = tp;
+        wk->seed = i + 1;
+
+        if (hcore_thread_deque_init(pool, &wk->deque, size) != HCORE_OK)
+        {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        wk = &tp->workers[i];
+
+        err = pthread_create(&wk->tid, NULL, hcore_thread_cycle, wk);
+        if (err)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, tp->log, err,
+                            "pthread_create() of thread pool failed");
+            hcore_destroy_thread_pool(tp);
+            return NULL;
+        }
+
+        tp->nthreads++;
+    }
+
+    return tp;
+}
+
+void
+hcore_destroy_thread_pool(hcore_thread_pool_t *tp)
+{
+    hcore_uint_t i;
+
+    hcore_assert(tp);
+
+    if (tp == NULL) return;
+
+    __atomic_store_n(&tp->quit, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&tp->epoch, 1, __ATOMIC_SEQ_CST);
+
+    syscall(SYS_futex, &tp->epoch, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+
+    for (i = 0; i < tp->nthreads; i++)
+    {
+        pthread_join(tp->workers[i].tid, NULL);
+    }
+
+    tp->nthreads = 0;
+}
+
+hcore_int_t
+hcore_thread_pool_post(hcore_thread_pool_t *tp, hcore_thread_task_t *task,
+                       hcore_thread_notify_t *notify)
+{
+    hcore_thread_task_t *head;
+
+    hcore_assert(tp && task && task->handler);
+
+    if (__atomic_load_n(&tp->quit, __ATOMIC_RELAXED))
+    {
+        hcore_log_error(HCORE_LOG_ALERT, tp->log, 0,
+                        "thread pool was destroyed");
+        return HCORE_ERROR;
+    }
+
+    task->notify = notify;
+    task->posted = hcore_thread_time();
+
+    __atomic_fetch_add(&tp->nposted, 1, __ATOMIC_RELAXED);
+
+    head = __atomic_load_n(&tp->injected, __ATOMIC_RELAXED);
+
+    do
+    {
+        task->next = head;
+    } while (!__atomic_compare_exchange_n(&tp->injected, &head, task, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    /*
+     * a thread which is going to sleep either sees the task, or sleeps on
+     * the old epoch and returns at once. The tasks pushed onto a non-empty
+     * stack are taken with the first one, the thread which takes them wakes up
+     * another one to steal.
+     */
+
+    __atomic_fetch_add(&tp->epoch, 1, __ATOMIC_SEQ_CST);
+
+    if (head == NULL && __atomic_load_n(&tp->nsleeps, __ATOMIC_SEQ_CST))
+    {
+        syscall(SYS_futex, &tp->epoch, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    return HCORE_OK;
+}
+
+void
+hcore_thread_pool_stat(hcore_thread_pool_t *tp, hcore_thread_pool_stat_t *stat)
+{
+    hcore_uint_t ndone;
+
+    hcore_assert(tp && stat);
+
+    ndone = __atomic_load_n(&tp->ndone, __ATOMIC_RELAXED);
+
+    stat->nposted  = __atomic_load_n(&tp->nposted, __ATOMIC_RELAXED);
+    stat->nsteals  = __atomic_load_n(&tp->nsteals, __ATOMIC_RELAXED);
+    stat->wait_max = __atomic_load_n(&tp->wait_max, __ATOMIC_RELAXED);
+    stat->depth    = stat->nposted - ndone;
+    stat->wait_avg = ndone
+                         ? __atomic_load_n(&tp->wait_ns, __ATOMIC_RELAXED)
+                               / ndone
+                         : 0;
+}
+
+hcore_thread_notify_t *
+hcore_create_thread_notify(hcore_event_loop_t *loop)
+{
+    int                    efd;
+    hcore_connection_t    *c;
+    hcore_thread_notify_t *notify;
+
+    hcore_assert(loop);
+
+    notify = hcore_pcalloc(loop->pool, sizeof(hcore_thread_notify_t));
+    if (notify == NULL) return NULL;
+
+    efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, loop->log, errno, "eventfd() failed");
+        return NULL;
+    }
+
+    c = hcore_create_connection(loop->log, efd);
+    if (c == NULL)
+    {
+        close(efd);
+        return NULL;
+    }
+
+    c->data         = notify;
+    c->rev->handler = hcore_thread_notify_handler;
+    c->rev->log     = c->log;
+
+    if (hcore_event_add(loop, c->rev, HCORE_EVENT_READ, 0) != HCORE_OK)
+    {
+        hcore_destroy_connection(c);
+        return NULL;
+    }
+
+    notify->connection = c;
+    notify->loop       = loop;
+
+    return notify;
+}
+
+void
+hcore_destroy_thread_notify(hcore_thread_notify_t *notify)
+{
+    hcore_assert(notify);
+
+    if (notify == NULL || notify->connection == NULL) return;
+
+    while (__atomic_load_n(&notify->busy, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+
+    hcore_event_del(notify->loop, notify->connection->rev, HCORE_EVENT_READ,
+                    HCORE_CLOSE_EVENT);
+
+    hcore_destroy_connection(notify->connection);
+
+    notify->connection = NULL;
+}
+
+static void *
+hcore_thread_cycle(void *data)
+{
+    hcore_uint32_t         epoch;
+    hcore_thread_task_t   *task;
+    hcore_thread_pool_t   *tp;
+    hcore_thread_worker_t *wk;
+
+    wk = data;
+    tp = wk->tp;
+
+    for (;;)
+    {
+        task = hcore_thread_get_task(wk);
+
+        if (task)
+        {
+            hcore_thread_run_task(tp, task);
+            continue;
+        }
+
+        /* sleep until a task is posted */
+
+        epoch = __atomic_load_n(&tp->epoch, __ATOMIC_SEQ_CST);
+
+        __atomic_fetch_add(&tp->nsleeps, 1, __ATOMIC_SEQ_CST);
+
+        task = hcore_thread_get_task(wk);
+
+        if (task == NULL && !__atomic_load_n(&tp->quit, __ATOMIC_SEQ_CST))
+        {
+            syscall(SYS_futex, &tp->epoch, FUTEX_WAIT_PRIVATE, epoch, NULL,
+                    NULL, 0);
+        }
+
+        __atomic_fetch_sub(&tp->nsleeps, 1, __ATOMIC_SEQ_CST);
+
+        if (task)
+        {
+            hcore_thread_run_task(tp, task);
+            continue;
+        }
+
+        if (__atomic_load_n(&tp->quit, __ATOMIC_SEQ_CST)
+            && __atomic_load_n(&tp->ndone, __ATOMIC_SEQ_CST)
+                   == __atomic_load_n(&tp->nposted, __ATOMIC_SEQ_CST))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static hcore_thread_task_t *
+hcore_thread_get_task(hcore_thread_worker_t *wk)
+{
+    hcore_uint_t         i, n, victim;
+    hcore_thread_pool_t *tp;
+    hcore_thread_task_t *task, *list, *next;
+
+    tp = wk->tp;
+
+    // 1. the own deque
+
+    task = hcore_thread_deque_take(&wk->deque);
+    if (task) return task;
+
+    // 2. the injected tasks are moved to the own deque, so others can steal
+
+    if (__atomic_load_n(&tp->injected, __ATOMIC_RELAXED))
+    {
+        list = __atomic_exchange_n(&tp->injected, NULL, __ATOMIC_ACQUIRE);
+
+        // the latest is first, reverse it to the order of posting
+
+        for (task = NULL; list; list = next)
+        {
+            next       = list->next;
+            list->next = task;
+            task       = list;
+        }
+
+        if (task)
+        {
+            for (list = task->next; list; list = next)
+            {
+                next = list->next;
+
+                if (hcore_thread_deque_push(&wk->deque, list) != HCORE_OK)
+                {
+                    // the deque is full, run it here
+                    hcore_thread_run_task(tp, list);
+                }
+            }
+
+            /* wake up a sleeping thread to steal the rest */
+
+            if (task->next && __atomic_load_n(&tp->nsleeps, __ATOMIC_SEQ_CST))
+            {
+                __atomic_fetch_add(&tp->epoch, 1, __ATOMIC_SEQ_CST);
+                syscall(SYS_futex, &tp->epoch, FUTEX_WAKE_PRIVATE, 1, NULL,
+                        NULL, 0);
+            }
+
+            return task;
+        }
+    }
+
+    // 3. steal from others, starting at a random victim
+
+    n = tp->nworkers;
+
+    wk->seed = wk->seed * 1103515245 + 12345;
+    victim   = (wk->seed >> 16) % n;
+
+    for (i = 0; i < n; i++, victim = (victim + 1) % n)
+    {
+        if (victim == wk->id) continue;
+
+        task = hcore_thread_deque_steal(&tp->workers[victim].deque);
+
+        if (task)
+        {
+            __atomic_fetch_add(&tp->nsteals, 1, __ATOMIC_RELAXED);
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+hcore_thread_run_task(hcore_thread_pool_t *tp, hcore_thread_task_t *task)
+{
+    uint64_t               wait, max, one;
+    hcore_thread_task_t   *head;
+    hcore_thread_notify_t *notify;
+
+    wait = hcore_thread_time() - task->posted;
+
+    __atomic_fetch_add(&tp->wait_ns, wait, __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&tp->wait_max, __ATOMIC_RELAXED);
+
+    while (wait > max
+           && !__atomic_compare_exchange_n(&tp->wait_max, &max, wait, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        /* void */
+    }
+
+    notify = task->notify;
+
+    task->handler(task);
+
+    /* the task mustn't be touched after it's counted if it isn't notified */
+
+    if (notify == NULL)
+    {
+        __atomic_fetch_add(&tp->ndone, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    /*
+     * the loop may handle the task and destroy the notify before the
+     * eventfd is written, so the destroying waits for it
+     */
+
+    __atomic_fetch_add(&notify->busy, 1, __ATOMIC_SEQ_CST);
+
+    head = __atomic_load_n(&notify->completed, __ATOMIC_RELAXED);
+
+    do
+    {
+        task->next = head;
+    } while (!__atomic_compare_exchange_n(&notify->completed, &head, task, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&tp->ndone, 1, __ATOMIC_SEQ_CST);
+
+    if (head == NULL)
+    {
+        one = 1;
+
+        if (write(notify->connection->fd, &one, sizeof(uint64_t))
+            != sizeof(uint64_t))
+        {
+            hcore_log_error(HCORE_LOG_ALERT, tp->log, errno,
+                            "write() to eventfd of thread notify failed");
+        }
+    }
+
+    __atomic_fetch_sub(&notify->busy, 1, __ATOMIC_RELEASE);
+}
+
+static void
+hcore_thread_notify_handler(hcore_event_t *ev)
+{
+    uint64_t               n;
+    hcore_connection_t    *c;
+    hcore_thread_task_t   *task, *next, *list;
+    hcore_thread_notify_t *notify;
+
+    c      = ev->data;
+    notify = c->data;
+
+    if (read(c->fd, &n, sizeof(uint64_t)) == -1 && errno != EAGAIN)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, errno,
+                        "read() from eventfd failed");
+    }
+
+    list = __atomic_exchange_n(&notify->completed, NULL, __ATOMIC_ACQUIRE);
+
+    for (task = NULL; list; list = next)
+    {
+        next       = list->next;
+        list->next = task;
+        task       = list;
+    }
+
+    for (/* void */; task; task = next)
+    {
+        next = task->next;
+
+        notify->ncompleted++;
+
+        task->event.ready = 1;
+
+        // the task may be released by handler
+        task->event.handler(&task->event);
+    }
+}
+
+static hcore_int_t
+hcore_thread_deque_init(hcore_pool_t *pool, hcore_thread_deque_t *dq,
+                        hcore_uint_t size)
+{
+    hcore_uint_t n;
+
+    for (n = 1; n < size; n <<= 1)
+    {
+        /* void */
+    }
+
+    dq->buf = hcore_pcalloc(pool, sizeof(hcore_thread_task_t *) * n);
+    if (dq->buf == NULL) return HCORE_ERROR;
+
+    dq->top    = 0;
+    dq->bottom = 0;
+    dq->mask   = n - 1;
+
+    return HCORE_OK;
+}
+
+static hcore_int_t
+hcore_thread_deque_push(hcore_thread_deque_t *dq, hcore_thread_task_t *task)
+{
+    int64_t b, t;
+
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+
+    if (b - t > (int64_t)dq->mask) return HCORE_AGAIN;
+
+    __atomic_store_n(&dq->buf[b & dq->mask], task, __ATOMIC_RELAXED);
+
+    // the task is published to thieves by 'bottom'
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELEASE);
+
+    return HCORE_OK;
+}
+
+static hcore_thread_task_t *
+hcore_thread_deque_take(hcore_thread_deque_t *dq)
+{
+    int64_t              b, t;
+    hcore_thread_task_t *task;
+
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (t > b)
+    {
+        // empty
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    task = __atomic_load_n(&dq->buf[b & dq->mask], __ATOMIC_RELAXED);
+
+    if (t == b)
+    {
+        // the last one, race with thieves
+
+        if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            task = NULL;
+        }
+
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return task;
+}
+
+static hcore_thread_task_t *
+hcore_thread_deque_steal(hcore_thread_deque_t *dq)
+{
+    int64_t              b, t;
+    hcore_thread_task_t *task;
+
+    t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b) return NULL;
+
+    task = __atomic_load_n(&dq->buf[t & dq->mask], __ATOMIC_RELAXED);
+
+    if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED))
+    {
+        // lost the race
+        return NULL;
+    }
+
+    return task;
+}
+
+static uint64_t
+hcore_thread_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
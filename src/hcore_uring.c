@@ -0,0 +1,777 @@
+/**
+ * @file hcore_uring.c
+ * @author homqyy (yilupiaoxuewhq@163.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 homqyy
+ *
+ * @format: UTF-8
+ * @abbr:
+ */
+
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_debug.h>
+#include <hcore_event.h>
+#include <hcore_uring.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static hcore_int_t hcore_uring_setup(hcore_uring_t *ring,
+                                     hcore_uint_t   entries);
+static struct io_uring_sqe *hcore_uring_get_sqe(hcore_uring_t *ring);
+static struct io_uring_sqe *hcore_uring_prep(hcore_uring_t *ring,
+                                             hcore_event_t *ev,
+                                             hcore_uint_t   type);
+static void hcore_uring_event_handler(hcore_event_t *ev);
+static void hcore_uring_complete(hcore_uring_t *ring, hcore_uring_op_t *op,
+                                 int res, unsigned flags);
+static void hcore_uring_recycle(hcore_uring_t *ring, hcore_uint_t bid);
+
+hcore_int_t
+hcore_event_use_uring(hcore_event_loop_t *loop, hcore_uint_t entries)
+{
+    hcore_int_t         rc;
+    hcore_uint_t        i;
+    hcore_uring_t      *ring;
+    hcore_connection_t *c;
+
+    hcore_assert(loop && loop->uring == NULL);
+
+    if (loop == NULL) return HCORE_ERROR;
+
+    if (entries == 0) entries = HCORE_URING_ENTRIES_DEFAULT;
+
+    ring = hcore_pcalloc(loop->pool, sizeof(hcore_uring_t));
+    if (ring == NULL) return HCORE_ERROR;
+
+    ring->fd   = -1;
+    ring->loop = loop;
+    ring->log  = loop->log;
+
+    rc = hcore_uring_setup(ring, entries);
+    if (rc != HCORE_OK) return rc;
+
+    /*
+     * at most 'cq_entries' completions can be pending, so are operations
+     */
+
+    ring->ops = hcore_palloc(loop->pool,
+                             sizeof(hcore_uring_op_t) * ring->cq_entries);
+    if (ring->ops == NULL) goto failed;
+
+    for (i = 0; i < ring->cq_entries; i++)
+    {
+        ring->ops[i].event = NULL;
+        ring->ops[i].next  = ring->free;
+        ring->free         = &ring->ops[i];
+    }
+
+    c = hcore_create_connection(loop->log, ring->fd);
+    if (c == NULL) goto failed;
+
+    ring->connection = c;
+
+    c->shared       = 1;
+    c->data         = ring;
+    c->rev->handler = hcore_uring_event_handler;
+    c->rev->log     = c->log;
+
+    /* level-triggered, the rest of completions are notified again */
+
+    if (hcore_event_add(loop, c->rev, HCORE_EVENT_READ, 0) != HCORE_OK)
+    {
+        goto failed;
+    }
+
+    loop->uring = ring;
+
+    hcore_log_debug(loop->log, 0, "io_uring: fd:%d sq:%ud cq:%ud", ring->fd,
+                    ring->sq_entries, ring->cq_entries);
+
+    return HCORE_OK;
+
+failed:
+
+    hcore_destroy_uring(ring);
+
+    return HCORE_ERROR;
+}
+
+void
+hcore_destroy_uring(hcore_uring_t *ring)
+{
+    hcore_assert(ring);
+
+    if (ring == NULL) return;
+
+    if (ring->connection)
+    {
+        /* the fd is shared, it's closed below */
+        hcore_destroy_connection(ring->connection);
+        ring->connection = NULL;
+    }
+
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+
+    if (ring->fd != -1 && close(ring->fd) == -1)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, errno,
+                        "io_uring close() failed");
+    }
+
+    if (ring->br) munmap(ring->br, ring->br_size);
+
+    ring->sqes    = NULL;
+    ring->cq_ring = NULL;
+    ring->sq_ring = NULL;
+    ring->br      = NULL;
+    ring->fd      = -1;
+}
+
+hcore_int_t
+hcore_uring_setup_buffers(hcore_uring_t *ring, hcore_uint_t n, size_t size)
+{
+    size_t                  pagesize;
+    hcore_uint_t            i;
+    hcore_err_t             err;
+    struct io_uring_buf_reg reg;
+
+    hcore_assert(ring && ring->br == NULL);
+    hcore_assert(n && (n & (n - 1)) == 0 && n < 32768 && size);
+
+    ring->bufs = hcore_palloc(ring->loop->pool, n * size);
+    if (ring->bufs == NULL) return HCORE_ERROR;
+
+    /* the ring of buffers must be aligned to page */
+
+    pagesize      = hcore_getpagesize();
+    ring->br_size = (n * sizeof(struct io_uring_buf) + pagesize - 1)
+                  & ~(pagesize - 1);
+
+    ring->br = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->br == MAP_FAILED)
+    {
+        ring->br = NULL;
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, errno,
+                        "mmap(%uz) of buffers ring failed", ring->br_size);
+        return HCORE_ERROR;
+    }
+
+    hcore_memzero(&reg, sizeof(reg));
+
+    reg.ring_addr    = (uintptr_t)ring->br;
+    reg.ring_entries = n;
+    reg.bgid         = HCORE_URING_BGID;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1)
+        == -1)
+    {
+        err = errno;
+
+        munmap(ring->br, ring->br_size);
+        ring->br = NULL;
+
+        if (err == EINVAL)
+        {
+            hcore_log_error(HCORE_LOG_NOTICE, ring->log, err,
+                            "provided buffers of io_uring aren't supported");
+            return HCORE_DECLINED;
+        }
+
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, err,
+                        "io_uring_register(IORING_REGISTER_PBUF_RING) failed");
+        return HCORE_ERROR;
+    }
+
+    ring->nbufs    = n;
+    ring->buf_size = size;
+    ring->br_tail  = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        hcore_uring_recycle(ring, i);
+    }
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_uring_recv(hcore_uring_t *ring, hcore_connection_t *c, hcore_buf_t *b)
+{
+    size_t               size;
+    struct io_uring_sqe *sqe;
+
+    hcore_assert(ring && c && b);
+
+    size = hcore_buf_get_freesize(b);
+    if (size == 0)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                        "no free space in buffer to receive");
+        return HCORE_ERROR;
+    }
+
+    sqe = hcore_uring_prep(ring, c->rev, HCORE_URING_OP_RECV);
+    if (sqe == NULL) return HCORE_ERROR;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd     = c->fd;
+    sqe->addr   = (uintptr_t)b->last;
+    sqe->len    = size;
+
+    c->rev->op->buf = b;
+
+    hcore_log_debug(c->log, 0, "io_uring recv: fd:#%d %uz", c->fd, size);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_uring_recv_multishot(hcore_uring_t *ring, hcore_connection_t *c)
+{
+    struct io_uring_sqe *sqe;
+
+    hcore_assert(ring && c);
+
+    if (ring->br == NULL)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, c->log, 0,
+                        "provided buffers of io_uring aren't set up");
+        return HCORE_ERROR;
+    }
+
+    sqe = hcore_uring_prep(ring, c->rev, HCORE_URING_OP_RECV_MULTISHOT);
+    if (sqe == NULL) return HCORE_ERROR;
+
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = c->fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = HCORE_URING_BGID;
+
+    hcore_log_debug(c->log, 0, "io_uring recv multishot: fd:#%d", c->fd);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_uring_send_chain(hcore_uring_t *ring, hcore_connection_t *c,
+                       hcore_chain_t *out)
+{
+    size_t               size, total;
+    hcore_uint_t         n;
+    hcore_uchar_t       *prev_last;
+    hcore_chain_t       *cl;
+    hcore_uring_op_t    *op;
+    struct iovec        *iov;
+    struct io_uring_sqe *sqe;
+
+    hcore_assert(ring && c);
+
+    for (cl = out; cl; cl = cl->next)
+    {
+        hcore_assert(!cl->buf->in_file);
+
+        if (hcore_buf_get_size(cl->buf)) break;
+    }
+
+    if (cl == NULL) return HCORE_DONE;
+
+    sqe = hcore_uring_prep(ring, c->wev, HCORE_URING_OP_SEND);
+    if (sqe == NULL) return HCORE_ERROR;
+
+    op  = c->wev->op;
+    n   = 0;
+    iov = NULL;
+
+    total     = 0;
+    prev_last = NULL;
+
+    for (/* void */; cl; cl = cl->next)
+    {
+        size = hcore_buf_get_size(cl->buf);
+
+        if (size == 0) continue;
+
+        if (iov && prev_last == cl->buf->pos)
+        {
+            // concat buffer
+            iov->iov_len += size;
+        }
+        else
+        {
+            if (n == HCORE_URING_IOV_MAX) break;
+
+            iov = &op->iovs[n++];
+
+            iov->iov_base = (void *)cl->buf->pos;
+            iov->iov_len  = size;
+        }
+
+        prev_last = cl->buf->pos + size;
+        total += size;
+    }
+
+    hcore_memzero(&op->msg, sizeof(struct msghdr));
+
+    op->msg.msg_iov    = op->iovs;
+    op->msg.msg_iovlen = n;
+    op->out            = out;
+
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = c->fd;
+    sqe->addr      = (uintptr_t)&op->msg;
+    sqe->msg_flags = MSG_NOSIGNAL;
+
+    if (c->flush == HCORE_TCP_FLUSH_MORE) sqe->msg_flags |= MSG_MORE;
+
+    hcore_log_debug(c->log, 0, "io_uring sendmsg: fd:#%d %uz in %ui iovs",
+                    c->fd, total, n);
+
+    return HCORE_OK;
+}
+
+hcore_int_t
+hcore_uring_cancel(hcore_uring_t *ring, hcore_connection_t *c)
+{
+    hcore_event_t       *rev, *wev;
+    struct io_uring_sqe *sqe;
+
+    hcore_assert(ring && c);
+
+    rev = c->rev;
+    wev = c->wev;
+
+    if (rev->op == NULL && wev->op == NULL) return HCORE_OK;
+
+    /* the late completions of detached operations are dropped */
+
+    if (rev->op)
+    {
+        rev->op->event = NULL;
+        rev->op        = NULL;
+    }
+
+    if (wev->op)
+    {
+        wev->op->event = NULL;
+        wev->op        = NULL;
+    }
+
+    sqe = hcore_uring_get_sqe(ring);
+    if (sqe == NULL) return HCORE_ERROR;
+
+    sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+    sqe->fd           = c->fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data    = 0;
+
+    hcore_log_debug(c->log, 0, "io_uring cancel: fd:#%d", c->fd);
+
+    /*
+     * submit it at once, the operations are still queued are submitted
+     * before it, so they are canceled too
+     */
+
+    return hcore_uring_submit(ring);
+}
+
+hcore_int_t
+hcore_uring_submit(hcore_uring_t *ring)
+{
+    int         n;
+    hcore_err_t err;
+
+    hcore_assert(ring);
+
+    if (ring->to_submit == 0) return HCORE_OK;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    for (;;)
+    {
+        n = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 0, 0, NULL,
+                    0);
+
+        ring->nenters++;
+
+        if (n >= 0) break;
+
+        err = errno;
+
+        if (err == EINTR) continue;
+
+        if (err == EAGAIN || err == EBUSY)
+        {
+            /* the rest is submitted after completions are handled */
+
+            hcore_log_debug(ring->log, err, "io_uring_enter() not ready");
+            return HCORE_OK;
+        }
+
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, err,
+                        "io_uring_enter() failed");
+        return HCORE_ERROR;
+    }
+
+    hcore_log_debug(ring->log, 0, "io_uring submit: %d of %ui", n,
+                    ring->to_submit);
+
+    ring->to_submit -= n;
+    ring->nsqes += n;
+
+    return HCORE_OK;
+}
+
+static hcore_int_t
+hcore_uring_setup(hcore_uring_t *ring, hcore_uint_t entries)
+{
+    int                    fd;
+    unsigned               i;
+    hcore_err_t            err;
+    hcore_uchar_t         *sq, *cq;
+    struct io_uring_params p;
+
+    hcore_memzero(&p, sizeof(p));
+
+    p.flags = IORING_SETUP_CLAMP;
+
+    fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd == -1)
+    {
+        err = errno;
+
+        if (err == ENOSYS || err == EPERM || err == EACCES || err == EINVAL)
+        {
+            hcore_log_error(HCORE_LOG_NOTICE, ring->log, err,
+                            "io_uring isn't available, use epoll");
+            return HCORE_DECLINED;
+        }
+
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, err,
+                        "io_uring_setup(%ui) failed", entries);
+        return HCORE_ERROR;
+    }
+
+    ring->fd = fd;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size =
+        p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sq_ring_size = hcore_max(ring->sq_ring_size, ring->cq_ring_size);
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        goto failed;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED)
+        {
+            ring->cq_ring = NULL;
+            goto failed;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        goto failed;
+    }
+
+    sq = ring->sq_ring;
+    cq = ring->cq_ring;
+
+    ring->sq_head       = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail       = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_array      = (unsigned *)(sq + p.sq_off.array);
+    ring->sq_mask       = *(unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_entries    = p.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head    = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask    = *(unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cq_entries = p.cq_entries;
+    ring->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* the sqes are used in order, so the indirect array is identical */
+
+    for (i = 0; i < ring->sq_entries; i++)
+    {
+        ring->sq_array[i] = i;
+    }
+
+    return HCORE_OK;
+
+failed:
+
+    hcore_log_error(HCORE_LOG_ALERT, ring->log, errno,
+                    "mmap() of io_uring failed");
+
+    hcore_destroy_uring(ring);
+
+    return HCORE_ERROR;
+}
+
+static struct io_uring_sqe *
+hcore_uring_get_sqe(hcore_uring_t *ring)
+{
+    unsigned             head;
+    struct io_uring_sqe *sqe;
+
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    if (ring->sq_local_tail - head == ring->sq_entries)
+    {
+        /* the queue is full, submit it earlier */
+
+        if (hcore_uring_submit(ring) != HCORE_OK) return NULL;
+
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+        if (ring->sq_local_tail - head == ring->sq_entries)
+        {
+            hcore_log_error(HCORE_LOG_ALERT, ring->log, 0,
+                            "submission queue of io_uring is full");
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+
+    hcore_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    ring->sq_local_tail++;
+    ring->to_submit++;
+
+    return sqe;
+}
+
+static struct io_uring_sqe *
+hcore_uring_prep(hcore_uring_t *ring, hcore_event_t *ev, hcore_uint_t type)
+{
+    hcore_uring_op_t    *op;
+    struct io_uring_sqe *sqe;
+
+    if (ev->op)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, 0,
+                        "operation of io_uring is already in flight");
+        return NULL;
+    }
+
+    op = ring->free;
+    if (op == NULL)
+    {
+        hcore_log_error(HCORE_LOG_ALERT, ring->log, 0,
+                        "%ui operations of io_uring are not enough",
+                        (hcore_uint_t)ring->cq_entries);
+        return NULL;
+    }
+
+    sqe = hcore_uring_get_sqe(ring);
+    if (sqe == NULL) return NULL;
+
+    ring->free = op->next;
+
+    op->event = ev;
+    op->type  = type;
+    op->buf   = NULL;
+    op->out   = NULL;
+    op->next  = NULL;
+
+    ev->op    = op;
+    ev->ready = 0;
+
+    sqe->user_data = (uintptr_t)op;
+
+    return sqe;
+}
+
+static void
+hcore_uring_event_handler(hcore_event_t *ev)
+{
+    unsigned             head, tail, flags, n;
+    int                  res;
+    hcore_uring_t       *ring;
+    hcore_uring_op_t    *op;
+    hcore_connection_t  *c;
+    struct io_uring_cqe *cqe;
+
+    c    = ev->data;
+    ring = c->data;
+
+    head = *ring->cq_head;
+
+    /*
+     * the handlers may arm new operations, so the number of completions is
+     * bounded, the rest are notified again by epoll
+     */
+
+    for (n = 0; n < ring->cq_entries; n++)
+    {
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head == tail) break;
+
+        cqe = &ring->cqes[head & ring->cq_mask];
+
+        op    = (hcore_uring_op_t *)(uintptr_t)cqe->user_data;
+        res   = cqe->res;
+        flags = cqe->flags;
+
+        /* give the cqe back before calling handler */
+
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        ring->ncqes++;
+
+        hcore_uring_complete(ring, op, res, flags);
+    }
+}
+
+static void
+hcore_uring_complete(hcore_uring_t *ring, hcore_uring_op_t *op, int res,
+                     unsigned flags)
+{
+    size_t              size, left;
+    hcore_uint_t        type, buffer, bid;
+    hcore_buf_t        *b;
+    hcore_chain_t      *cl;
+    hcore_event_t      *ev;
+    hcore_connection_t *c;
+
+    /* the completion of cancellation */
+    if (op == NULL) return;
+
+    ev   = op->event;
+    type = op->type;
+    b    = op->buf;
+    cl   = op->out;
+
+    buffer = (flags & IORING_CQE_F_BUFFER) ? 1 : 0;
+    bid    = flags >> IORING_CQE_BUFFER_SHIFT;
+
+    if (!(flags & IORING_CQE_F_MORE))
+    {
+        /* it's the last completion of operation */
+
+        if (ev) ev->op = NULL;
+
+        op->event  = NULL;
+        op->next   = ring->free;
+        ring->free = op;
+    }
+
+    if (ev == NULL)
+    {
+        hcore_log_debug(ring->log, 0, "io_uring: stale completion %p", op);
+
+        if (buffer) hcore_uring_recycle(ring, bid);
+
+        return;
+    }
+
+    c = ev->data;
+
+    hcore_log_debug(c->log, 0, "io_uring: fd:#%d op:%ui res:%d flags:%04XD",
+                    c->fd, type, res, flags);
+
+    ev->ready  = 1;
+    ev->result = res;
+    ev->buffer = buffer;
+    ev->buf_id = bid;
+
+    if (res > 0)
+    {
+        switch (type)
+        {
+        case HCORE_URING_OP_RECV:
+            b->last += res;
+            c->recv_size += res;
+            break;
+
+        case HCORE_URING_OP_RECV_MULTISHOT:
+            c->recv_size += res;
+            break;
+
+        case HCORE_URING_OP_SEND:
+
+            for (left = res; cl && left; cl = cl->next)
+            {
+                size = hcore_min(left, (size_t)hcore_buf_get_size(cl->buf));
+
+                cl->buf->pos += size;
+                left -= size;
+            }
+
+            c->sent_size += res;
+            break;
+        }
+    }
+    else if (res == 0)
+    {
+        if (type != HCORE_URING_OP_SEND) ev->eof = 1;
+    }
+    else if (res != -ENOBUFS)
+    {
+        ev->error = 1;
+        hcore_log_error(HCORE_LOG_ALERT, c->log, -res,
+                        "io_uring operation %ui failed", type);
+    }
+
+    ev->handler(ev);
+
+    /* the data was consumed by the handler */
+
+    if (buffer) hcore_uring_recycle(ring, bid);
+}
+
+static void
+hcore_uring_recycle(hcore_uring_t *ring, hcore_uint_t bid)
+{
+    struct io_uring_buf *buf;
+
+    buf = &ring->br->bufs[ring->br_tail & (ring->nbufs - 1)];
+
+    buf->addr = (uintptr_t)hcore_uring_buffer(ring, bid);
+    buf->len  = ring->buf_size;
+    buf->bid  = bid;
+
+    ring->br_tail++;
+
+    __atomic_store_n(&ring->br->tail, ring->br_tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,891 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+class PoolTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, (char *)"@STDOUT", HCORE_LOG_ERR);
+
+        // every test starts with an empty cache
+
+        hcore_pool_cache_set_max(0);
+        hcore_pool_cache_set_max(HCORE_POOL_CACHE_MAX);
+        hcore_pool_cache_stat(&fStat);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t             fLog;
+    hcore_pool_cache_stat_t fStat; // at start of test
+};
+
+TEST_F(PoolTest, blocks)
+{
+    hcore_pool_t  *pool, *b;
+    hcore_uchar_t *ps[64];
+    hcore_uint_t   blocks = 0;
+
+    pool = hcore_create_pool(1024, &fLog);
+    ASSERT_TRUE(pool);
+
+    // the objects fill several blocks, the header of block is kept
+
+    for (int i = 0; i < 64; i++)
+    {
+        ps[i] = (hcore_uchar_t *)hcore_pnalloc(pool, 200);
+        ASSERT_TRUE(ps[i]);
+        memset(ps[i], i, 200);
+    }
+
+    for (b = pool; b; b = b->d.next)
+    {
+        EXPECT_EQ(b->d.end, (hcore_uchar_t *)b + 1024);
+        EXPECT_GT(b->d.last, (hcore_uchar_t *)&b->d + sizeof(hcore_pool_data_t));
+        EXPECT_LE(b->d.last, b->d.end);
+        blocks++;
+    }
+
+    EXPECT_GE(blocks, 64u / (1024 / 200));
+
+    for (int i = 0; i < 64; i++)
+    {
+        EXPECT_EQ(ps[i][0], i);
+        EXPECT_EQ(ps[i][199], i);
+    }
+
+    hcore_destroy_pool(pool);
+}
+
+#ifndef _HCORE_DEBUG
+
+TEST_F(PoolTest, blockCache)
+{
+    hcore_pool_t           *pool, *pools[5];
+    hcore_pool_cache_stat_t stat;
+
+    hcore_pool_cache_set_max(4);
+
+    // 1. the blocks are cached by destroying
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(hcore_pnalloc(pool, 3000));
+
+    hcore_destroy_pool(pool);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.misses - fStat.misses, 3u);
+    EXPECT_EQ(stat.hits - fStat.hits, 0u);
+    EXPECT_EQ(stat.cached, 3u);
+
+    // 2. and reused without the system allocator
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(hcore_pnalloc(pool, 3000));
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.misses - fStat.misses, 3u);
+    EXPECT_EQ(stat.hits - fStat.hits, 3u);
+    EXPECT_EQ(stat.cached, 0u);
+
+    hcore_destroy_pool(pool);
+
+    // 3. the blocks over the high-water mark are released
+
+    for (int i = 0; i < 5; i++)
+    {
+        pools[i] = hcore_create_pool(4096, &fLog);
+        ASSERT_TRUE(pools[i]);
+    }
+
+    for (int i = 0; i < 5; i++) hcore_destroy_pool(pools[i]);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 4u);
+    EXPECT_EQ(stat.released - fStat.released, 1u);
+
+    // 4. the sizes are limited
+
+    hcore_pool_cache_set_max(HCORE_POOL_CACHE_MAX);
+
+    for (int i = 0; i < HCORE_POOL_CACHE_SIZES + 1; i++)
+    {
+        pool = hcore_create_pool(1024 * (i + 1), &fLog);
+        ASSERT_TRUE(pool);
+        hcore_destroy_pool(pool);
+    }
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 7u);
+    EXPECT_EQ(stat.released - fStat.released, 2u);
+
+    // 5. the cache is disabled
+
+    hcore_pool_cache_set_max(0);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 0u);
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+    hcore_destroy_pool(pool);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 0u);
+}
+
+TEST_F(PoolTest, blockCacheTrim)
+{
+    hcore_pool_t           *pools[4];
+    hcore_pool_cache_stat_t stat;
+
+    for (int i = 0; i < 4; i++) pools[i] = hcore_create_pool(4096, &fLog);
+    for (int i = 0; i < 4; i++) hcore_destroy_pool(pools[i]);
+
+    // 1. the blocks cached since last trimming aren't idle
+
+    hcore_pool_cache_trim();
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 4u);
+
+    // 2. two blocks are used, and the others are idle
+
+    for (int i = 0; i < 2; i++) pools[i] = hcore_create_pool(4096, &fLog);
+    for (int i = 0; i < 2; i++) hcore_destroy_pool(pools[i]);
+
+    hcore_pool_cache_trim();
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 2u);
+
+    hcore_pool_cache_trim();
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.cached, 0u);
+    EXPECT_EQ(stat.released - fStat.released, 4u);
+}
+
+TEST_F(PoolTest, blockCacheThread)
+{
+    hcore_pool_cache_stat_t stat;
+
+    // the cache of thread is released when it exits
+
+    std::thread t([this, &stat]() {
+        hcore_pool_t *pool = hcore_create_pool(4096, &fLog);
+
+        hcore_destroy_pool(pool);
+
+        hcore_pool_cache_stat(&stat);
+    });
+
+    t.join();
+
+    EXPECT_EQ(stat.cached, 1u);
+    EXPECT_EQ(stat.misses, 1u);
+}
+
+TEST_F(PoolTest, largeCache)
+{
+    hcore_pool_t           *pool;
+    hcore_pool_cache_stat_t stat;
+    void                   *p, *q;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    // 1. a large one is reused by the same class
+
+    p = hcore_pnalloc(pool, 8000);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+
+    q = hcore_pnalloc(pool, 6000);
+    EXPECT_EQ(q, p);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.hits - fStat.hits, 1u);
+
+    // 2. and grown in place within its class
+
+    memset(q, 'q', 6000);
+    p = hcore_prealloc(pool, q, 6000, 8000);
+    EXPECT_EQ(p, q);
+    EXPECT_EQ(((char *)p)[5999], 'q');
+
+    // 3. the ones over the cache are released
+
+    void *ps[HCORE_POOL_LARGE_CACHE + 1];
+
+    for (auto &l : ps) ASSERT_TRUE(l = hcore_pnalloc(pool, 5000));
+
+    hcore_pool_cache_stat(&fStat);
+
+    for (auto &l : ps) EXPECT_EQ(hcore_pfree(pool, l), HCORE_OK);
+
+    hcore_pool_cache_stat(&stat);
+    EXPECT_EQ(stat.released - fStat.released, 1u);
+
+    // 4. the ones too large aren't cached
+
+    p = hcore_pnalloc(pool, 300 * 1024);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+
+    hcore_pool_cache_stat(&fStat);
+    EXPECT_EQ(fStat.released - stat.released, 1u);
+
+    hcore_destroy_pool(pool);
+}
+
+#endif // !_HCORE_DEBUG
+
+static void
+countCleanup(void *data)
+{
+    (*(int *)data)++;
+}
+
+TEST_F(PoolTest, reset)
+{
+    hcore_pool_t         *pool;
+    hcore_pool_cleanup_t *c;
+    void                 *first, *p;
+    int                   n = 0;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    first = hcore_pnalloc(pool, 100);
+    ASSERT_TRUE(first);
+
+    // the space of some blocks, a large one and a cleanup
+
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(hcore_pnalloc(pool, 3000));
+
+    ASSERT_TRUE(hcore_pnalloc(pool, 10000));
+
+    c = hcore_pool_cleanup_add(pool, 0);
+    ASSERT_TRUE(c);
+    c->handler = countCleanup;
+    c->data    = &n;
+
+    hcore_reset_pool(pool);
+
+    EXPECT_EQ(n, 1);
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+    EXPECT_FALSE(pool->cleanup);
+    EXPECT_EQ(pool->current, pool);
+
+    // the blocks are reused
+
+    EXPECT_EQ(hcore_pnalloc(pool, 100), first);
+
+    for (int i = 0; i < 3; i++)
+    {
+        p = hcore_pnalloc(pool, 3000);
+        ASSERT_TRUE(p);
+        EXPECT_TRUE(pool->d.next);
+    }
+
+    hcore_pool_t *b;
+    hcore_uint_t  blocks = 0;
+
+    for (b = pool; b; b = b->d.next) blocks++;
+
+    EXPECT_EQ(blocks, 3u);
+
+    hcore_destroy_pool(pool);
+
+    EXPECT_EQ(n, 1);
+}
+
+TEST_F(PoolTest, markRelease)
+{
+    hcore_pool_t         *pool;
+    hcore_pool_mark_t     outer, inner;
+    hcore_pool_cleanup_t *c;
+    void                 *keep, *p, *q;
+    int                   n = 0;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    keep = hcore_pnalloc(pool, 16);
+    ASSERT_TRUE(keep);
+    memset(keep, 'k', 16);
+
+    hcore_pool_mark(pool, &outer);
+
+    // 1. a message is a pointer bump and a rewind
+
+    p = hcore_pnalloc(pool, 100);
+    ASSERT_TRUE(p);
+
+    hcore_pool_release(pool, &outer);
+
+    hcore_pool_mark(pool, &outer);
+    EXPECT_EQ(hcore_pnalloc(pool, 100), p);
+
+    // 2. the new blocks, the large ones and the cleanups are rolled back
+
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(hcore_pnalloc(pool, 3000));
+
+    ASSERT_TRUE(hcore_pnalloc(pool, 10000));
+
+    c = hcore_pool_cleanup_add(pool, 0);
+    ASSERT_TRUE(c);
+    c->handler = countCleanup;
+    c->data    = &n;
+
+    // 3. the nested one
+
+    hcore_pool_mark(pool, &inner);
+
+    q = hcore_pnalloc(pool, 2000);
+    ASSERT_TRUE(q);
+
+    ASSERT_TRUE(hcore_pnalloc(pool, 20000));
+
+    hcore_pool_release(pool, &inner);
+
+    EXPECT_EQ(hcore_pnalloc(pool, 2000), q);
+    EXPECT_EQ(n, 0);
+
+    hcore_pool_release(pool, &outer);
+
+    EXPECT_EQ(n, 1);
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+    EXPECT_FALSE(pool->cleanup);
+    EXPECT_EQ(hcore_pnalloc(pool, 100), p);
+
+    for (int i = 0; i < 16; i++) EXPECT_EQ(((char *)keep)[i], 'k');
+
+    hcore_destroy_pool(pool);
+
+    EXPECT_EQ(n, 1);
+}
+
+TEST_F(PoolTest, largeFree)
+{
+    hcore_pool_t      *pool;
+    hcore_pool_mark_t  mark;
+    std::vector<void *> ps;
+    void              *p, *small;
+
+    // see HCORE_POOL_LARGE_HEADER
+    size_t header = (sizeof(hcore_pool_large_t) + 15) & ~(size_t)15;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    // 1. freed in any order
+
+    for (int i = 0; i < 64; i++)
+    {
+        p = hcore_pnalloc(pool, 5000 + i * 1000);
+        ASSERT_TRUE(p);
+        memset(p, i, 5000 + i * 1000);
+        ps.push_back(p);
+    }
+
+    srand(1);
+
+    while (!ps.empty())
+    {
+        size_t i = rand() % ps.size();
+
+        EXPECT_EQ(hcore_pfree(pool, ps[i]), HCORE_OK);
+        ps.erase(ps.begin() + i);
+    }
+
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    // 2. the ones not large of the pool aren't freed, even if the bytes in
+    // front of them look like the header of a large one
+
+    EXPECT_EQ(hcore_pfree(pool, NULL), HCORE_ERROR);
+
+    small = hcore_pnalloc(pool, 100);
+    ASSERT_TRUE(small);
+    EXPECT_EQ(hcore_pfree(pool, small), HCORE_ERROR);
+
+    p = hcore_pnalloc(pool, 5000);
+    ASSERT_TRUE(p);
+
+    small = hcore_pnalloc(pool, header + 100);
+    ASSERT_TRUE(small);
+    memcpy(small, (char *)p - header, header);
+
+    EXPECT_EQ(hcore_pfree(pool, (char *)small + header), HCORE_ERROR);
+    EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    // 3. the ones before the mark are kept by release, even freed in it
+
+    p = hcore_pnalloc(pool, 5000);
+    ASSERT_TRUE(p);
+
+    hcore_pool_mark(pool, &mark);
+
+    for (int i = 0; i < 4; i++) ASSERT_TRUE(hcore_pnalloc(pool, 5000));
+
+    EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+
+    p = hcore_pnalloc(pool, 5000);
+    ASSERT_TRUE(p);
+
+    hcore_pool_release(pool, &mark);
+
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    p = hcore_pnalloc(pool, 5000);
+    ASSERT_TRUE(p);
+
+    hcore_pool_mark(pool, &mark);
+    ASSERT_TRUE(hcore_pnalloc(pool, 5000));
+    hcore_pool_release(pool, &mark);
+
+    EXPECT_FALSE(hcore_queue_empty(&pool->large));
+    EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+
+    hcore_destroy_pool(pool);
+}
+
+TEST_F(PoolTest, recycle)
+{
+    hcore_pool_t *pool;
+    void         *p, *large;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    p = hcore_pnalloc(pool, 100);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(hcore_pfree_sized(pool, p, 100), HCORE_DECLINED);
+
+    ASSERT_EQ(hcore_pool_enable_recycle(pool), HCORE_OK);
+
+    // 1. reused by the same class
+
+    p = hcore_pnalloc(pool, 100);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(hcore_pfree_sized(pool, p, 100), HCORE_OK);
+
+    EXPECT_EQ(hcore_pnalloc(pool, 112), p);
+    EXPECT_NE(hcore_pnalloc(pool, 112), p);
+
+    p = hcore_pnalloc(pool, 1);
+    hcore_pfree_sized(pool, p, 1);
+
+    EXPECT_NE(hcore_pnalloc(pool, 17), p);
+    EXPECT_EQ(hcore_pnalloc(pool, 16), p);
+
+    // 2. the large ones are freed
+
+    large = hcore_pnalloc(pool, 8192);
+    ASSERT_TRUE(large);
+    EXPECT_EQ(hcore_pfree_sized(pool, large, 8192), HCORE_OK);
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    // 3. the lists are emptied by reset, and it's still enabled
+
+    p = hcore_pnalloc(pool, 32);
+    hcore_pfree_sized(pool, p, 32);
+
+    hcore_reset_pool(pool);
+
+    ASSERT_TRUE(pool->recycled);
+
+    for (int i = 0; i < HCORE_POOL_FREE_CLASSES; i++)
+    {
+        EXPECT_FALSE(pool->recycled[i]);
+    }
+
+    p = hcore_pnalloc(pool, 32);
+    EXPECT_EQ(hcore_pfree_sized(pool, p, 32), HCORE_OK);
+    EXPECT_EQ(hcore_pnalloc(pool, 32), p);
+
+    hcore_destroy_pool(pool);
+}
+
+TEST_F(PoolTest, recyclePrealloc)
+{
+    hcore_pool_t *pool;
+    char         *p, *q, *r;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    ASSERT_EQ(hcore_pool_enable_recycle(pool), HCORE_OK);
+
+    // the one grown in place takes the size of its new class
+
+    p = (char *)hcore_pnalloc(pool, 32);
+    ASSERT_TRUE(p);
+
+    EXPECT_EQ(hcore_prealloc(pool, p, 32, 40), p);
+
+    q = (char *)hcore_pnalloc(pool, 16);
+    ASSERT_TRUE(q);
+    EXPECT_GE(q, p + 48);
+    memset(q, 'q', 16);
+
+    EXPECT_EQ(hcore_pfree_sized(pool, p, 40), HCORE_OK);
+
+    r = (char *)hcore_pnalloc(pool, 48);
+    EXPECT_EQ(r, p);
+    memset(r, 'r', 48);
+
+    for (int i = 0; i < 16; i++) EXPECT_EQ(q[i], 'q');
+
+    hcore_destroy_pool(pool);
+}
+
+/* a custom pool over malloc(), it counts the live allocations */
+
+static void *
+customAlloc(void *pool, size_t size)
+{
+    (*(int *)pool)++;
+    return malloc(size);
+}
+
+static void
+customFree(void *pool, void *p)
+{
+    (*(int *)pool)--;
+    free(p);
+}
+
+static void
+customDestroy(void *pool)
+{
+}
+
+TEST_F(PoolTest, customPrealloc)
+{
+    hcore_pool_t *pool;
+    char         *p, *q;
+    int           live = 0;
+
+    pool = hcore_create_custom_pool(&fLog, &live, customAlloc, customFree,
+                                    customDestroy);
+    ASSERT_TRUE(pool);
+
+    // no header of large is read in front of the memory of custom pool
+
+    p = (char *)hcore_palloc(pool, 16);
+    ASSERT_TRUE(p);
+    memset(p, 'p', 16);
+
+    q = (char *)hcore_prealloc(pool, p, 16, 32);
+    ASSERT_TRUE(q);
+    EXPECT_EQ(live, 1);
+
+    for (int i = 0; i < 16; i++) EXPECT_EQ(q[i], 'p');
+
+    memset(q, 'q', 32);
+
+    p = (char *)hcore_prealloc(pool, q, 32, 8000);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(live, 1);
+
+    for (int i = 0; i < 32; i++) EXPECT_EQ(p[i], 'q');
+
+    EXPECT_EQ(hcore_prealloc(pool, p, 8000, 100), p);
+    EXPECT_EQ(hcore_prealloc(pool, p, 8000, 0), (void *)NULL);
+    EXPECT_EQ(live, 0);
+
+    hcore_destroy_pool(pool);
+}
+
+#define isAligned(p, a) (((uintptr_t)(p) & ((a) - 1)) == 0)
+
+TEST_F(PoolTest, aligned)
+{
+    hcore_pool_t     *pool;
+    hcore_pool_mark_t mark;
+    void             *p;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    // 1. the word after an odd one
+
+    ASSERT_TRUE(hcore_pnalloc(pool, 3));
+
+    p = hcore_palloc(pool, 8);
+    ASSERT_TRUE(p);
+    EXPECT_TRUE(isAligned(p, HCORE_ALIGNMENT));
+
+    // 2. the cache line and SIMD in blocks, the new ones too
+
+    for (size_t align = 16; align <= 256; align <<= 1)
+    {
+        for (int i = 0; i < 20; i++)
+        {
+            ASSERT_TRUE(hcore_pnalloc(pool, 1));
+
+            p = hcore_palloc_aligned(pool, 200 + i, align);
+            ASSERT_TRUE(p);
+            EXPECT_TRUE(isAligned(p, align));
+            memset(p, 'a', 200 + i);
+        }
+    }
+
+    p = hcore_palloc_aligned(pool, pool->max - 63, 64);
+    ASSERT_TRUE(p);
+    EXPECT_TRUE(isAligned(p, 64));
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    // 3. the large ones, they're freed and rolled back
+
+    for (size_t align = 8; align <= 4096; align <<= 1)
+    {
+        p = hcore_palloc_aligned(pool, 10000, align);
+        ASSERT_TRUE(p);
+        EXPECT_TRUE(isAligned(p, align));
+        memset(p, 'l', 10000);
+
+        EXPECT_EQ(hcore_pfree(pool, p), HCORE_OK);
+    }
+
+    hcore_pool_mark(pool, &mark);
+
+    ASSERT_TRUE(p = hcore_palloc_aligned(pool, 10000, 128));
+    EXPECT_TRUE(isAligned(p, 128));
+
+    hcore_pool_release(pool, &mark);
+
+    EXPECT_TRUE(hcore_queue_empty(&pool->large));
+
+    // 4. the unaligned ones recycled aren't taken
+
+    ASSERT_EQ(hcore_pool_enable_recycle(pool), HCORE_OK);
+
+    ASSERT_TRUE(hcore_pnalloc(pool, 1));
+
+    p = hcore_pnalloc(pool, 32);
+    ASSERT_TRUE(p);
+
+    if (!isAligned(p, 64))
+    {
+        hcore_pfree_sized(pool, p, 32);
+        EXPECT_NE(hcore_palloc_aligned(pool, 32, 64), p);
+        EXPECT_EQ(hcore_pnalloc(pool, 32), p);
+    }
+
+    p = hcore_palloc_aligned(pool, 32, 64);
+    ASSERT_TRUE(p);
+    hcore_pfree_sized(pool, p, 32);
+    EXPECT_EQ(hcore_palloc_aligned(pool, 32, 64), p);
+
+    hcore_destroy_pool(pool);
+}
+
+static hcore_uint_t
+countBlocks(hcore_pool_t *pool)
+{
+    hcore_uint_t n = 0;
+
+    for (hcore_pool_t *b = pool; b; b = b->d.next) n++;
+
+    return n;
+}
+
+TEST_F(PoolTest, recycleSteady)
+{
+    hcore_pool_t *pool;
+    void         *objs[64];
+    size_t        sizes[64];
+    hcore_uint_t  blocks = 0;
+
+    pool = hcore_create_pool(4096, &fLog);
+    ASSERT_TRUE(pool);
+
+    ASSERT_EQ(hcore_pool_enable_recycle(pool), HCORE_OK);
+
+    // a long-lived pool allocates and drops objects of 32-512 bytes
+
+    srand(1);
+
+    for (int round = 0; round < 4000; round++)
+    {
+        if (round == 2000) blocks = countBlocks(pool);
+
+        for (int i = 0; i < 64; i++)
+        {
+            sizes[i] = 32 + rand() % 481;
+            objs[i]  = hcore_pnalloc(pool, sizes[i]);
+            ASSERT_TRUE(objs[i]);
+            memset(objs[i], i, sizes[i]);
+        }
+
+        for (int i = 0; i < 64; i++)
+        {
+            ASSERT_EQ(((unsigned char *)objs[i])[0], i);
+            ASSERT_EQ(((unsigned char *)objs[i])[sizes[i] - 1], i);
+
+            hcore_pfree_sized(pool, objs[i], sizes[i]);
+        }
+    }
+
+    // it's bounded by the objects of each class, not the rounds (about 17000
+    // blocks without recycling)
+
+    EXPECT_LT(countBlocks(pool), 32u);
+    EXPECT_LE(countBlocks(pool), blocks + 4);
+
+    hcore_destroy_pool(pool);
+}
+
+/*
+ * A short-lived pool is created for each request, compare the cache of
+ * blocks with the system allocator.
+ */
+
+#define BENCH_LOOPS 1000000
+
+TEST_F(PoolTest, DISABLED_createBenchmark)
+{
+    for (int cached = 1; cached >= 0; cached--)
+    {
+        struct timeval tv0, tv1;
+
+        hcore_pool_cache_set_max(cached ? HCORE_POOL_CACHE_MAX : 0);
+
+        gettimeofday(&tv0, NULL);
+
+        for (int i = 0; i < BENCH_LOOPS; i++)
+        {
+            hcore_pool_t *pool =
+                hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+
+            // the data of request fill two blocks
+
+            for (int k = 0; k < 8; k++) hcore_pnalloc(pool, 3000);
+
+            hcore_destroy_pool(pool);
+        }
+
+        gettimeofday(&tv1, NULL);
+
+        double t =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%s: %.1f ns per pool\n", cached ? "cache " : "system",
+               t * 1e9 / BENCH_LOOPS);
+    }
+
+    hcore_pool_cache_set_max(HCORE_POOL_CACHE_MAX);
+}
+
+/*
+ * The objects of a cache line are updated, compare the ones aligned with
+ * the ones crossing two lines.
+ */
+
+typedef struct
+{
+    uint64_t v[8];
+} benchLine;
+
+TEST_F(PoolTest, DISABLED_alignedBenchmark)
+{
+    const int n = 64 * 1024; // beyond the caches
+
+    for (int aligned = 1; aligned >= 0; aligned--)
+    {
+        struct timeval tv0, tv1;
+        hcore_pool_t  *pool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        std::vector<benchLine *> objs(n);
+
+        for (auto &o : objs)
+        {
+            o = (benchLine *)(aligned
+                                  ? hcore_palloc_aligned(pool, sizeof(benchLine),
+                                                         HCORE_CACHELINE_SIZE)
+                                  : (char *)hcore_palloc_aligned(
+                                        pool, sizeof(benchLine) + 4,
+                                        HCORE_CACHELINE_SIZE)
+                                        + 4);
+            memset(o, 0, sizeof(benchLine));
+        }
+
+        gettimeofday(&tv0, NULL);
+
+        for (int r = 0; r < BENCH_LOOPS / n; r++)
+        {
+            for (auto o : objs)
+            {
+                for (int k = 0; k < 8; k++) o->v[k] += k;
+            }
+        }
+
+        gettimeofday(&tv1, NULL);
+
+        double t =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%s: %.2f ns per object\n", aligned ? "aligned  " : "unaligned",
+               t * 1e9 / (BENCH_LOOPS / n) / n);
+
+        hcore_destroy_pool(pool);
+    }
+}
+
+/*
+ * A pool holds 'n' large ones and frees the oldest, the cost of free doesn't
+ * depend on 'n'.
+ */
+
+TEST_F(PoolTest, DISABLED_largeBenchmark)
+{
+    for (int n = 1000; n <= 10000; n *= 10)
+    {
+        struct timeval      tv0, tv1;
+        std::vector<void *> ps(n);
+        hcore_pool_t       *pool = hcore_create_pool(4096, &fLog);
+
+        for (auto &p : ps) p = hcore_pnalloc(pool, 8000);
+
+        gettimeofday(&tv0, NULL);
+
+        for (int i = 0; i < BENCH_LOOPS; i++)
+        {
+            hcore_pfree(pool, ps[i % n]);
+            ps[i % n] = hcore_pnalloc(pool, 8000);
+        }
+
+        gettimeofday(&tv1, NULL);
+
+        double t =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%5d large: %.1f ns per free and alloc\n", n,
+               t * 1e9 / BENCH_LOOPS);
+
+        hcore_destroy_pool(pool);
+    }
+}
@@ -9,6 +9,9 @@ extern "C"
 
 #include <gtest/gtest.h>
 
+#include <sys/time.h>
+#include <sys/wait.h>
+
 class ShpoolTest : public ::testing::Test {
   protected:
     void
@@ -324,6 +327,129 @@ TEST_F(ShpoolTest, allocateSmallAdLocked)
     }
 }
 
+/* the slab allocator: the slots of small, exact and big sizes, and pages */
+
+static void
+expectAllPagesFree(hcore_shpool_t *shpool)
+{
+    hcore_slab_pool_t *sp     = shpool->sp;
+    hcore_uint_t       page_n = (sp->end - sp->start) / hcore_getpagesize();
+
+    // the free pages are coalesced into one run again
+
+    EXPECT_EQ(sp->pfree, page_n);
+    EXPECT_EQ(sp->free.next, sp->pages);
+    EXPECT_EQ(sp->pages->slab, page_n);
+    EXPECT_EQ(sp->pages->next, &sp->free);
+}
+
+static void
+testSlots(hcore_shpool_t *shpool, size_t size, size_t slot, hcore_uint_t n)
+{
+    hcore_slab_pool_t *sp = shpool->sp;
+    hcore_uchar_t     *ps[2048];
+
+    ASSERT_LE(n, HCORE_ARRAY_NUM(ps));
+
+    for (hcore_uint_t i = 0; i < n; i++)
+    {
+        ps[i] = (hcore_uchar_t *)hcore_shpool_alloc(shpool, size);
+
+        ASSERT_TRUE(ps[i]) << "size " << size << " #" << i;
+        EXPECT_EQ((uintptr_t)ps[i] % slot, 0u) << "size " << size;
+        EXPECT_TRUE(ps[i] >= sp->start && ps[i] + size <= sp->end);
+
+        memset(ps[i], (int)i, size);
+    }
+
+    // no slot is overlapped by another
+
+    for (hcore_uint_t i = 0; i < n; i++)
+    {
+        EXPECT_EQ(ps[i][0], (hcore_uchar_t)i);
+        EXPECT_EQ(ps[i][size - 1], (hcore_uchar_t)i);
+    }
+
+    // the pages are freed when their slots are all free
+
+    for (hcore_uint_t i = 0; i < n; i += 2) hcore_shpool_free(shpool, ps[i]);
+    for (hcore_uint_t i = 1; i < n; i += 2) hcore_shpool_free(shpool, ps[i]);
+
+    expectAllPagesFree(shpool);
+}
+
+TEST_F(ShpoolTest, slabSlots)
+{
+    hcore_shpool_t *shpool   = bigShpoolAnonymity;
+    size_t          pagesize = hcore_getpagesize();
+    size_t          min      = shpool->sp->min_size;
+    size_t          exact    = hcore_get_slab_exact_size();
+    size_t          max      = hcore_get_slab_max_size();
+
+    // small: the bitmap is at the start of page
+
+    testSlots(shpool, 1, min, 3 * pagesize / min);
+    testSlots(shpool, min + 1, 2 * min, 3 * pagesize / (2 * min));
+
+    // exact: the bitmap is in the page header
+
+    testSlots(shpool, exact, exact, 3 * pagesize / exact);
+    testSlots(shpool, exact - 1, exact, 3 * pagesize / exact);
+
+    // big: the bitmap is in the high bits of page header
+
+    testSlots(shpool, exact + 1, 2 * exact, 3 * pagesize / (2 * exact));
+    testSlots(shpool, max, max, 7);
+}
+
+TEST_F(ShpoolTest, slabPages)
+{
+    hcore_shpool_t    *shpool   = bigShpoolAnonymity;
+    hcore_slab_pool_t *sp       = shpool->sp;
+    size_t             pagesize = hcore_getpagesize();
+    hcore_uint_t       page_n   = (sp->end - sp->start) / pagesize;
+    hcore_uchar_t     *a, *b, *c, *d, *p;
+
+    a = (hcore_uchar_t *)hcore_shpool_alloc(shpool, 3 * pagesize);
+    b = (hcore_uchar_t *)hcore_shpool_alloc(shpool, pagesize + 1);
+    c = (hcore_uchar_t *)hcore_shpool_alloc(shpool, 4 * pagesize);
+    d = (hcore_uchar_t *)hcore_shpool_alloc(shpool, pagesize);
+    ASSERT_TRUE(a && b && c && d);
+
+    EXPECT_EQ((uintptr_t)a % pagesize, 0u);
+    EXPECT_GE(b, a + 3 * pagesize);
+    EXPECT_GE(c, b + 2 * pagesize);
+    EXPECT_GE(d, c + 4 * pagesize);
+    EXPECT_EQ(sp->pfree, page_n - 10);
+
+    memset(a, 'a', 3 * pagesize);
+    memset(c, 'c', 4 * pagesize);
+
+    // the neighbours are coalesced in any order of freeing
+
+    hcore_shpool_free(shpool, b);
+    EXPECT_EQ(sp->pfree, page_n - 8);
+
+    hcore_shpool_free(shpool, c);
+    EXPECT_EQ(sp->pfree, page_n - 4);
+    EXPECT_EQ(a[3 * pagesize - 1], 'a');
+
+    hcore_shpool_free(shpool, a);
+    hcore_shpool_free(shpool, d);
+
+    expectAllPagesFree(shpool);
+
+    // the run is reused as a whole
+
+    p = (hcore_uchar_t *)hcore_shpool_alloc(shpool, page_n * pagesize);
+    ASSERT_EQ(p, sp->start);
+    EXPECT_EQ(sp->pfree, 0u);
+
+    hcore_shpool_free(shpool, p);
+
+    expectAllPagesFree(shpool);
+}
+
 TEST_F(ShpoolTest, getpool)
 {
     hcore_shpool_t *shpool;
@@ -467,3 +593,294 @@ done:
 error:
     if (error == HCORE_BOOL_TRUE) ADD_FAILURE();
 }
+
+TEST_F(ShpoolTest, cache)
+{
+    hcore_shpool_t          *shpool = bigShpoolAnonymity;
+    hcore_slab_pool_t       *sp     = shpool->sp;
+    hcore_shpool_magazine_t *mag;
+    hcore_uint_t             pfree = sp->pfree;
+    void                    *p[16];
+
+    ASSERT_EQ(hcore_shpool_init_cache(shpool, 8), HCORE_OK);
+    ASSERT_TRUE(shpool->cache);
+    EXPECT_EQ(shpool->cache->size, 8u);
+    EXPECT_EQ(shpool->cache->nslots,
+              (hcore_uint_t)(hcore_getpagesize_shift() - sp->min_shift));
+
+    mag = &shpool->cache->mags[0];
+
+    // 1. the magazine is refilled with half of it
+
+    p[0] = hcore_shpool_alloc(shpool, sp->min_size);
+    ASSERT_TRUE(p[0]);
+    EXPECT_EQ(mag->n, 3u);
+    EXPECT_EQ(sp->pfree, pfree - 1);
+
+    for (int i = 1; i < 16; i++)
+    {
+        p[i] = hcore_shpool_alloc(shpool, sp->min_size);
+        ASSERT_TRUE(p[i]);
+
+        for (int k = 0; k < i; k++) EXPECT_NE(p[i], p[k]);
+    }
+
+    // 2. the magazine is flushed by half when it's full
+
+    for (int i = 0; i < 16; i++)
+    {
+        hcore_shpool_free(shpool, p[i]);
+        EXPECT_LE(mag->n, 8u);
+    }
+
+    EXPECT_GT(mag->n, 0u);
+
+    // 3. the pages aren't cached
+
+    p[0] = hcore_shpool_alloc(shpool, hcore_getpagesize());
+    ASSERT_TRUE(p[0]);
+    hcore_shpool_free(shpool, p[0]);
+
+    // 4. all objects are returned
+
+    hcore_shpool_flush_cache(shpool);
+    EXPECT_EQ(mag->n, 0u);
+    EXPECT_EQ(sp->pfree, pfree);
+}
+
+TEST_F(ShpoolTest, cacheExhausted)
+{
+    hcore_shpool_t    *shpool = shpoolAnonymity;
+    hcore_slab_pool_t *sp     = shpool->sp;
+    hcore_uint_t       n      = 0;
+    void              *p;
+
+    ASSERT_EQ(hcore_shpool_init_cache(shpool, 0), HCORE_OK);
+
+    // the objects cached by a slot are reclaimed for another slot
+
+    for (p = hcore_shpool_alloc(shpool, sp->min_size); p;
+         p = hcore_shpool_alloc(shpool, sp->min_size))
+    {
+        n++;
+    }
+
+    EXPECT_GT(n, 0u);
+    EXPECT_EQ(sp->pfree, 0u);
+}
+
+TEST_F(ShpoolTest, stat)
+{
+    hcore_shpool_t     *shpool = bigShpoolWithName, *peer;
+    hcore_shpool_stat_t stat;
+    hcore_int_t         pagesize = hcore_getpagesize();
+    void               *p[64], *page;
+
+    hcore_shpool_stat(shpool, &stat);
+    EXPECT_EQ(stat.nslots,
+              (hcore_uint_t)(hcore_getpagesize_shift() - shpool->sp->min_shift));
+    EXPECT_EQ(stat.free_pages, stat.pages);
+    EXPECT_EQ(stat.largest, stat.pages);
+    EXPECT_EQ(stat.lock_count, 0u);
+
+    // 1. the slots of 32 bytes
+
+    for (int i = 0; i < 64; i++)
+    {
+        p[i] = hcore_shpool_alloc(shpool, 20);
+        ASSERT_TRUE(p[i]);
+    }
+
+    page = hcore_shpool_alloc(shpool, pagesize * 3);
+    ASSERT_TRUE(page);
+
+    EXPECT_FALSE(hcore_shpool_alloc(shpool, shpool->size));
+
+    // 2. a monitoring process reads them without lock
+
+    peer = hcore_get_shpool(&log, "BigShpoolTest");
+    ASSERT_TRUE(peer);
+
+    hcore_shpool_stat(peer, &stat);
+
+    EXPECT_EQ(stat.slots[2].size, 32u);
+    EXPECT_EQ(stat.slots[2].used, 64u);
+    EXPECT_EQ(stat.slots[2].reqs, 64u);
+    EXPECT_EQ(stat.slots[2].fails, 0u);
+    EXPECT_EQ(stat.slots[2].total, (hcore_atomic_uint_t)pagesize / 32 - 1);
+    EXPECT_EQ(stat.slots[0].total, 0u);
+
+    EXPECT_EQ(stat.free_pages, stat.pages - 4);
+    EXPECT_EQ(stat.largest, stat.pages - 4);
+    EXPECT_EQ(stat.page_reqs, 2u);
+    EXPECT_EQ(stat.page_fails, 1u);
+    EXPECT_EQ(stat.lock_count, 66u);
+    EXPECT_GT(stat.lock_nsec, 0u);
+
+    // 3. the free pages are joined
+
+    hcore_shpool_free(shpool, page);
+
+    hcore_shpool_stat(peer, &stat);
+    EXPECT_EQ(stat.largest, stat.pages - 1);
+
+    for (int i = 0; i < 64; i++) hcore_shpool_free(shpool, p[i]);
+
+    hcore_shpool_stat(peer, &stat);
+
+    EXPECT_EQ(stat.slots[2].used, 0u);
+    EXPECT_EQ(stat.slots[2].total, 0u);
+    EXPECT_EQ(stat.free_pages, stat.pages);
+    EXPECT_EQ(stat.largest, stat.pages);
+
+    hcore_destroy_shpool(peer);
+}
+
+#define CACHE_OBJS 512
+
+TEST_F(ShpoolTest, cacheShared)
+{
+    hcore_shpool_t *shpool = bigShpoolAnonymity;
+    hcore_uint_t    pfree  = shpool->sp->pfree;
+    hcore_atomic_t *n;
+    int           **child;
+    int            *objs[CACHE_OBJS];
+    pid_t           pid;
+    int             id, bad, status;
+
+    n = (hcore_atomic_t *)hcore_shpool_calloc(shpool, sizeof(hcore_atomic_t));
+    ASSERT_TRUE(n);
+
+    child = (int **)hcore_shpool_calloc(shpool, CACHE_OBJS * sizeof(int *));
+    ASSERT_TRUE(child);
+
+    ASSERT_EQ(hcore_shpool_init_cache(shpool, 0), HCORE_OK);
+
+    // the parent has cached objects before fork
+
+    hcore_shpool_free(shpool, hcore_shpool_alloc(shpool, sizeof(int)));
+    ASSERT_GT(shpool->cache->mags[0].n, 0u);
+
+    pid = fork();
+    id  = pid == 0 ? 1 : 2;
+
+    // the objects of both processes mustn't overlap
+
+    for (int i = 0; i < CACHE_OBJS; i++)
+    {
+        objs[i] = (int *)hcore_shpool_alloc(shpool, sizeof(int));
+        ASSERT_TRUE(objs[i]);
+        *objs[i] = id;
+    }
+
+    hcore_atomic_fetch_add(n, 1);
+
+    while (hcore_atomic_fetch(n) != 2) usleep(1000);
+
+    bad = 0;
+
+    for (int i = 0; i < CACHE_OBJS; i++)
+    {
+        if (*objs[i] != id) bad++;
+    }
+
+    if (pid == 0)
+    {
+        // the child frees half, and leaves the other half to parent
+
+        for (int i = 0; i < CACHE_OBJS; i++)
+        {
+            if (i % 2)
+            {
+                child[i] = objs[i];
+            }
+            else
+            {
+                hcore_shpool_free(shpool, objs[i]);
+            }
+        }
+
+        hcore_shpool_flush_cache(shpool);
+        _exit(bad);
+    }
+
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(bad, 0);
+
+    // the objects are freed across processes
+
+    for (int i = 0; i < CACHE_OBJS; i++)
+    {
+        hcore_shpool_free(shpool, objs[i]);
+
+        if (child[i]) hcore_shpool_free(shpool, child[i]);
+    }
+
+    hcore_shpool_free(shpool, child);
+    hcore_shpool_free(shpool, (void *)n);
+    hcore_shpool_flush_cache(shpool);
+
+    EXPECT_EQ(shpool->sp->pfree, pfree);
+}
+
+/*
+ * Processes churn small objects, compare the magazines with taking the lock
+ * for each object.
+ */
+
+#define BENCH_PROCS 4
+#define BENCH_LOOPS 1000000
+#define BENCH_BATCH 16
+
+TEST_F(ShpoolTest, DISABLED_cacheBenchmark)
+{
+    hcore_shpool_t *shpool = bigShpoolAnonymity;
+
+    for (int cache = 0; cache < 2; cache++)
+    {
+        struct timeval tv0, tv1;
+
+        if (cache)
+        {
+            ASSERT_EQ(hcore_shpool_init_cache(shpool, 0), HCORE_OK);
+        }
+
+        gettimeofday(&tv0, NULL);
+
+        for (int i = 0; i < BENCH_PROCS; i++)
+        {
+            if (fork() == 0)
+            {
+                void *p[BENCH_BATCH];
+
+                for (int k = 0; k < BENCH_LOOPS / BENCH_BATCH; k++)
+                {
+                    for (int j = 0; j < BENCH_BATCH; j++)
+                    {
+                        p[j] = hcore_shpool_alloc(shpool, 32);
+                    }
+
+                    for (int j = 0; j < BENCH_BATCH; j++)
+                    {
+                        hcore_shpool_free(shpool, p[j]);
+                    }
+                }
+
+                hcore_shpool_flush_cache(shpool);
+                _exit(0);
+            }
+        }
+
+        for (int i = 0; i < BENCH_PROCS; i++) wait(NULL);
+
+        gettimeofday(&tv1, NULL);
+
+        double wall =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%s: %d procs, %.1f ns per alloc + free\n",
+               cache ? "magazine" : "locked  ", BENCH_PROCS,
+               wall * 1e9 / (BENCH_PROCS * BENCH_LOOPS));
+    }
+}
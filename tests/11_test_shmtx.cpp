@@ -8,6 +8,10 @@ extern "C"
 
 #include <gtest/gtest.h>
 
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
 class ShmtxTest : public ::testing::Test {
   protected:
     void
@@ -82,6 +86,7 @@ TEST_F(ShmtxTest, init)
     EXPECT_EQ(hcore_shmtx_init(&mtx, shlock), HCORE_OK);
     EXPECT_EQ(mtx.lock, &shlock->lock);
     EXPECT_EQ(mtx.spin, 2048);
+    EXPECT_TRUE(mtx.sleep);
 
     // 2. Initialize a shared mutex with a spin value of -1.
 
@@ -90,6 +95,7 @@ TEST_F(ShmtxTest, init)
     EXPECT_EQ(hcore_shmtx_init(&mtx, shlock), HCORE_OK);
     EXPECT_EQ(mtx.lock, &shlock->lock);
     EXPECT_EQ(mtx.spin, (hcore_uint_t)-1);
+    EXPECT_FALSE(mtx.sleep);
 }
 
 TEST_F(ShmtxTest, trylock)
@@ -154,9 +160,10 @@ TEST_F(ShmtxTest, unlock)
 
     // 3. Unlock a shared mutex that is locked by another process.
 
-    hcore_pid_t pid = fork();
+    // the shared counter is allocated before forking, so both see it
     hcore_atomic_t *n = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
                                                          sizeof(hcore_atomic_t));
+    hcore_pid_t pid = fork();
 
     hcore_log_error(HCORE_LOG_INFO, &fLog, 0, "pid: %d", pid);
 
@@ -169,7 +176,7 @@ TEST_F(ShmtxTest, unlock)
         hcore_log_error(HCORE_LOG_INFO, &fLog, 0, "[%ud] child: lock shared mutex", *n);
 
         hcore_shmtx_lock(&fMutex);
-        EXPECT_EQ(fSharedLock->lock, pid); 
+        EXPECT_EQ(fSharedLock->lock, hcore_getpid());
 
         notify_next(&fLog, n);
 
@@ -181,6 +188,8 @@ TEST_F(ShmtxTest, unlock)
         EXPECT_EQ(fSharedLock->lock, 0); 
 
         notify_next(&fLog, n);
+
+        _exit(HasFailure());
     }
     else
     {
@@ -210,7 +219,10 @@ TEST_F(ShmtxTest, unlock)
 
         // 8. wait for the child process to exit.
 
-        waitpid(pid, NULL, 0);
+        int status;
+
+        waitpid(pid, &status, 0);
+        EXPECT_EQ(status, 0);
     }
 }
 TEST_F(ShmtxTest, forceUnlock)
@@ -229,9 +241,10 @@ TEST_F(ShmtxTest, forceUnlock)
 
     // 3. Force unlock a shared mutex that is locked by another process.
 
-    hcore_pid_t pid = fork();
+    // the shared counter is allocated before forking, so both see it
     hcore_atomic_t *n = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
                                                          sizeof(hcore_atomic_t));
+    hcore_pid_t pid = fork();
 
     if (pid == 0)
     {
@@ -240,6 +253,8 @@ TEST_F(ShmtxTest, forceUnlock)
         hcore_shmtx_lock(&fMutex);
         EXPECT_EQ(fSharedLock->lock, hcore_getpid());
         notify_next(&fLog, n);
+
+        _exit(HasFailure());
     }
     else
     {
@@ -250,7 +265,11 @@ TEST_F(ShmtxTest, forceUnlock)
         EXPECT_EQ(fSharedLock->lock, 0);
 
         // wait for the child process to exit.
-        waitpid(pid, NULL, 0);
+
+        int status;
+
+        waitpid(pid, &status, 0);
+        EXPECT_EQ(status, 0);
     }
 }
 
@@ -272,12 +291,12 @@ TEST_F(ShmtxTest, lockInSingleProcess)
 
 TEST_F(ShmtxTest, lockInMultiprocess)
 {
-    hcore_pid_t pid = fork();
-
     // create a shared variable to synchronize the two processes.
     hcore_atomic_t *n = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
                                                          sizeof(hcore_atomic_t));
 
+    hcore_pid_t pid = fork();
+
     if (pid == 0)
     {
         // Child process.
@@ -292,6 +311,8 @@ TEST_F(ShmtxTest, lockInMultiprocess)
         wait_next(&fLog, n, 2);
         hcore_shmtx_unlock(&fMutex);
         notify_next(&fLog, n);
+
+        _exit(0);
     }
     else
     {
@@ -316,4 +337,410 @@ TEST_F(ShmtxTest, lockInMultiprocess)
 
         waitpid(pid, NULL, 0);
     }
-}
\ No newline at end of file
+}
+
+TEST_F(ShmtxTest, sleep)
+{
+    hcore_atomic_t *n = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
+                                                         sizeof(hcore_atomic_t));
+
+    hcore_shmtx_lock(&fMutex);
+
+    hcore_pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        // Child process: it sleeps on the futex until the parent unlocks.
+
+        hcore_shmtx_lock(&fMutex);
+        notify_next(&fLog, n);
+        hcore_shmtx_unlock(&fMutex);
+
+        _exit(0);
+    }
+
+    // Parent process.
+
+    for (int i = 0; i < 1000 && hcore_atomic_fetch(&fSharedLock->wait) == 0;
+         i++)
+    {
+        usleep(1000);
+    }
+
+    EXPECT_EQ(fSharedLock->wait, 1);
+    EXPECT_EQ(*n, 0);
+
+    hcore_shmtx_unlock(&fMutex);
+
+    wait_next(&fLog, n, 1);
+    waitpid(pid, NULL, 0);
+
+    EXPECT_EQ(fSharedLock->wait, 0);
+    EXPECT_EQ(fSharedLock->lock, 0);
+    EXPECT_NE(fSharedLock->futex, 0u);
+}
+
+TEST_F(ShmtxTest, sleepWokenBySpinner)
+{
+    hcore_shmtx_t spinner;
+
+    hcore_atomic_t *n = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
+                                                         sizeof(hcore_atomic_t));
+
+    // the handle of parent doesn't sleep, but it wakes the sleeper of child
+
+    spinner.spin = (hcore_uint_t)-1;
+    hcore_shmtx_init(&spinner, fSharedLock);
+    ASSERT_FALSE(spinner.sleep);
+
+    hcore_shmtx_lock(&spinner);
+
+    hcore_pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        fMutex.spin = 0;
+        hcore_shmtx_init(&fMutex, fSharedLock);
+
+        hcore_shmtx_lock(&fMutex);
+        notify_next(&fLog, n);
+        hcore_shmtx_unlock(&fMutex);
+
+        _exit(0);
+    }
+
+    for (int i = 0; i < 1000 && hcore_atomic_fetch(&fSharedLock->wait) == 0;
+         i++)
+    {
+        usleep(1000);
+    }
+
+    EXPECT_EQ(fSharedLock->wait, 1);
+
+    hcore_shmtx_unlock(&spinner);
+
+    wait_next(&fLog, n, 1);
+    waitpid(pid, NULL, 0);
+
+    EXPECT_EQ(fSharedLock->wait, 0);
+    EXPECT_EQ(fSharedLock->lock, 0);
+}
+
+/*
+ * Processes increase a shared counter under the lock, the holder is
+ * preempted sometimes as there are more processes than cpus. Compare
+ * sleeping on futex with spinning and yielding.
+ */
+
+#define BENCH_PROCS 32
+#define BENCH_LOOPS 20000
+
+static void
+contend(hcore_shmtx_t *mtx, hcore_atomic_t *counter)
+{
+    for (int i = 0; i < BENCH_LOOPS; i++)
+    {
+        hcore_shmtx_lock(mtx);
+
+        // a short critical section
+
+        for (int k = 0; k < 100; k++) hcore_cpu_pause();
+
+        (*counter)++;
+
+        hcore_shmtx_unlock(mtx);
+    }
+}
+
+TEST_F(ShmtxTest, DISABLED_contentionBenchmark)
+{
+    for (int spin = 0; spin < 2; spin++)
+    {
+        hcore_shmtx_t   mtx = {0};
+        hcore_atomic_t *counter;
+        struct rusage   ru0, ru1;
+        struct timeval  tv0, tv1;
+
+        memset(fSharedLock, 0, sizeof(hcore_shmtx_sh_t));
+
+        if (spin) mtx.spin = (hcore_uint_t)-1;
+
+        ASSERT_EQ(hcore_shmtx_init(&mtx, fSharedLock), HCORE_OK);
+
+        if (spin) mtx.spin = 1 << 11; // the same spinning before yielding
+
+        counter = (hcore_atomic_t *)hcore_shpool_calloc(fShpoolAnonymity,
+                                                        sizeof(hcore_atomic_t));
+        ASSERT_TRUE(counter);
+
+        getrusage(RUSAGE_CHILDREN, &ru0);
+        gettimeofday(&tv0, NULL);
+
+        for (int i = 0; i < BENCH_PROCS; i++)
+        {
+            if (fork() == 0)
+            {
+                contend(&mtx, counter);
+                _exit(0);
+            }
+        }
+
+        for (int i = 0; i < BENCH_PROCS; i++) wait(NULL);
+
+        gettimeofday(&tv1, NULL);
+        getrusage(RUSAGE_CHILDREN, &ru1);
+
+        EXPECT_EQ(*counter, (hcore_atomic_uint_t)BENCH_PROCS * BENCH_LOOPS);
+
+        double wall = (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+        double cpu  = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec)
+                     + (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) / 1e6
+                     + (ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec)
+                     + (ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) / 1e6;
+
+        printf("%s: %d procs, %.0f locks/s, wall %.2fs, cpu %.2fs\n",
+               spin ? "spin + yield" : "spin + futex", BENCH_PROCS,
+               BENCH_PROCS * BENCH_LOOPS / wall, wall, cpu);
+    }
+}
+
+class ShrwlockTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, (char *)"@STDOUT", HCORE_LOG_INFO);
+
+        fShpool = hcore_create_shpool(&fLog, NULL, 64 * 1024);
+        ASSERT_TRUE(fShpool);
+
+        fSh = (hcore_shrwlock_sh_t *)hcore_shpool_calloc(
+            fShpool, sizeof(hcore_shrwlock_sh_t));
+        ASSERT_TRUE(fSh);
+
+        fN = (hcore_atomic_t *)hcore_shpool_calloc(fShpool,
+                                                   sizeof(hcore_atomic_t));
+        ASSERT_TRUE(fN);
+
+        memset(&fRw, 0, sizeof(fRw));
+        ASSERT_EQ(hcore_shrwlock_init(&fRw, fSh), HCORE_OK);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_shpool(fShpool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t          fLog;
+    hcore_shpool_t      *fShpool;
+    hcore_shrwlock_sh_t *fSh;
+    hcore_shrwlock_t     fRw;
+    hcore_atomic_t      *fN;
+};
+
+TEST_F(ShrwlockTest, init)
+{
+#ifdef _HCORE_DEBUG
+    EXPECT_DEBUG_DEATH(hcore_shrwlock_init(NULL, NULL),
+                       "hcore_shrwlock_init: Assertion");
+#else
+    EXPECT_EQ(hcore_shrwlock_init(NULL, NULL), HCORE_ERROR);
+#endif
+
+    EXPECT_EQ(fRw.sh, fSh);
+    EXPECT_EQ(fRw.spin, 1u << 11);
+
+    // each reader is in its own cache line
+
+    EXPECT_EQ((uintptr_t)&fSh->readers[1] - (uintptr_t)&fSh->readers[0],
+              (uintptr_t)HCORE_CACHELINE_SIZE);
+}
+
+TEST_F(ShrwlockTest, readers)
+{
+    // 1. the readers in two processes hold the lock together
+
+    ASSERT_TRUE(hcore_shrwlock_tryrlock(&fRw));
+    EXPECT_EQ(fSh->readers[fRw.slot].pid, (hcore_atomic_uint_t)hcore_getpid());
+
+    hcore_pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        hcore_shrwlock_rlock(&fRw);
+        notify_next(&fLog, fN);
+        wait_next(&fLog, fN, 2);
+        hcore_shrwlock_unlock(&fRw);
+        _exit(0);
+    }
+
+    wait_next(&fLog, fN, 1);
+
+    // 2. the writer can't get in
+
+    EXPECT_FALSE(hcore_shrwlock_trywlock(&fRw));
+    EXPECT_EQ(fSh->lock, 0u);
+
+    hcore_shrwlock_unlock(&fRw);
+
+    EXPECT_FALSE(hcore_shrwlock_trywlock(&fRw));
+
+    notify_next(&fLog, fN);
+    waitpid(pid, NULL, 0);
+
+    // 3. the readers are all left
+
+    EXPECT_TRUE(hcore_shrwlock_trywlock(&fRw));
+    EXPECT_EQ(fSh->lock, (hcore_atomic_uint_t)hcore_getpid());
+    EXPECT_FALSE(hcore_shrwlock_tryrlock(&fRw));
+
+    hcore_shrwlock_unlock(&fRw);
+    EXPECT_EQ(fSh->lock, 0u);
+}
+
+TEST_F(ShrwlockTest, writer)
+{
+    ASSERT_TRUE(hcore_shrwlock_tryrlock(&fRw));
+
+    hcore_pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        // the writer waits for the reader of parent
+
+        hcore_shrwlock_wlock(&fRw);
+        notify_next(&fLog, fN);
+        wait_next(&fLog, fN, 2);
+        hcore_shrwlock_unlock(&fRw);
+        _exit(0);
+    }
+
+    for (int i = 0; i < 1000 && hcore_atomic_fetch(&fSh->wait) == 0; i++)
+    {
+        usleep(1000);
+    }
+
+    // the writer owns 'lock' at once, so new readers are blocked
+
+    EXPECT_EQ(fSh->lock, (hcore_atomic_uint_t)pid);
+    EXPECT_EQ(*fN, 0u);
+
+    hcore_shrwlock_unlock(&fRw);
+
+    wait_next(&fLog, fN, 1);
+
+    EXPECT_FALSE(hcore_shrwlock_tryrlock(&fRw));
+
+    notify_next(&fLog, fN);
+
+    // sleep until the writer leaves
+
+    hcore_shrwlock_rlock(&fRw);
+    EXPECT_EQ(fSh->lock, 0u);
+    hcore_shrwlock_unlock(&fRw);
+
+    waitpid(pid, NULL, 0);
+
+    EXPECT_EQ(fSh->wait, 0u);
+}
+
+TEST_F(ShrwlockTest, forceUnlock)
+{
+    // the reader and writer die with the lock
+
+    for (int w = 0; w < 2; w++)
+    {
+        hcore_pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            if (w)
+            {
+                hcore_shrwlock_wlock(&fRw);
+            }
+            else
+            {
+                hcore_shrwlock_rlock(&fRw);
+            }
+
+            _exit(0);
+        }
+
+        waitpid(pid, NULL, 0);
+
+        EXPECT_FALSE(hcore_shrwlock_trywlock(&fRw));
+        EXPECT_EQ(hcore_shrwlock_tryrlock(&fRw), (hcore_uint_t)!w);
+
+        if (!w) hcore_shrwlock_unlock(&fRw);
+
+        EXPECT_FALSE(hcore_shrwlock_force_unlock(&fRw, hcore_getpid()));
+        EXPECT_TRUE(hcore_shrwlock_force_unlock(&fRw, pid));
+        EXPECT_FALSE(hcore_shrwlock_force_unlock(&fRw, pid));
+
+        EXPECT_TRUE(hcore_shrwlock_trywlock(&fRw));
+        hcore_shrwlock_unlock(&fRw);
+    }
+}
+
+/*
+ * Processes look up a table under the read lock, compare the reader slots
+ * with an exclusive hcore_shmtx_t.
+ */
+
+#define BENCH_READ_LOOPS 1000000
+
+TEST_F(ShrwlockTest, DISABLED_readBenchmark)
+{
+    hcore_shmtx_sh_t *msh;
+    hcore_shmtx_t     mtx = {0};
+
+    msh = (hcore_shmtx_sh_t *)hcore_shpool_calloc(fShpool,
+                                                 sizeof(hcore_shmtx_sh_t));
+    ASSERT_TRUE(msh);
+    ASSERT_EQ(hcore_shmtx_init(&mtx, msh), HCORE_OK);
+
+    for (int procs = 1; procs <= 8; procs <<= 1)
+    {
+        for (int rw = 1; rw >= 0; rw--)
+        {
+            struct timeval tv0, tv1;
+
+            gettimeofday(&tv0, NULL);
+
+            for (int i = 0; i < procs; i++)
+            {
+                if (fork() == 0)
+                {
+                    for (int k = 0; k < BENCH_READ_LOOPS; k++)
+                    {
+                        if (rw)
+                        {
+                            hcore_shrwlock_rlock(&fRw);
+                            hcore_shrwlock_unlock(&fRw);
+                        }
+                        else
+                        {
+                            hcore_shmtx_lock(&mtx);
+                            hcore_shmtx_unlock(&mtx);
+                        }
+                    }
+
+                    _exit(0);
+                }
+            }
+
+            for (int i = 0; i < procs; i++) wait(NULL);
+
+            gettimeofday(&tv1, NULL);
+
+            double wall =
+                (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+            printf("%s: %d procs, %.1f M reads/s\n",
+                   rw ? "shrwlock" : "shmtx   ", procs,
+                   procs * BENCH_READ_LOOPS / wall / 1e6);
+        }
+    }
+}
@@ -0,0 +1,345 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_log.h>
+#include <hcore_shmap.h>
+#include <hcore_shpool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <sys/time.h>
+#include <sys/wait.h>
+
+class ShmapTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, (char *)"@STDOUT", HCORE_LOG_ERR);
+
+        fShpool = hcore_create_shpool(&fLog, NULL, 4 * 1024 * 1024);
+        ASSERT_TRUE(fShpool);
+
+        fMap = hcore_create_shmap(fShpool, 4, 2);
+        ASSERT_TRUE(fMap);
+    }
+
+    void
+    TearDown() override
+    {
+        if (fMap) hcore_destroy_shmap(fMap);
+
+        hcore_destroy_shpool(fShpool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t     fLog;
+    hcore_shpool_t *fShpool;
+    hcore_shmap_t  *fMap;
+};
+
+static hcore_int_t
+setString(hcore_shmap_t *map, const char *key, const char *value,
+          hcore_msec_t ttl = 0)
+{
+    return hcore_shmap_set(map, key, strlen(key), value, strlen(value), ttl);
+}
+
+static std::string
+getString(hcore_shmap_t *map, const char *key)
+{
+    char   buf[64];
+    size_t len = sizeof(buf);
+
+    if (hcore_shmap_get(map, key, strlen(key), buf, &len) != HCORE_OK)
+    {
+        return "(nil)";
+    }
+
+    return std::string(buf, hcore_min(len, sizeof(buf)));
+}
+
+TEST_F(ShmapTest, create)
+{
+    hcore_shmap_t *map;
+
+    // the numbers are rounded up to power of 2
+
+    map = hcore_create_shmap(fShpool, 1000, 100);
+    ASSERT_TRUE(map);
+    EXPECT_EQ(map->sh->nbuckets, 1024u);
+    EXPECT_EQ(map->sh->nstripes, 128u);
+    EXPECT_TRUE(map->sh->segments[1]);
+    EXPECT_FALSE(map->sh->segments[2]);
+    hcore_destroy_shmap(map);
+
+    // the stripes are limited to buckets
+
+    map = hcore_create_shmap(fShpool, 2, 8);
+    ASSERT_TRUE(map);
+    EXPECT_EQ(map->sh->nstripes, 2u);
+    hcore_destroy_shmap(map);
+
+#ifndef _HCORE_DEBUG
+    EXPECT_FALSE(hcore_create_shmap(fShpool, 0, 0));
+    EXPECT_FALSE(hcore_create_shmap(fShpool, 1u << 30, 0));
+#endif
+}
+
+TEST_F(ShmapTest, setGet)
+{
+    char   buf[4];
+    size_t len;
+
+    EXPECT_EQ(getString(fMap, "key"), "(nil)");
+
+    EXPECT_EQ(setString(fMap, "key", "value"), HCORE_OK);
+    EXPECT_EQ(getString(fMap, "key"), "value");
+    EXPECT_EQ(hcore_shmap_count(fMap), 1u);
+
+    // replaced in place and with a new entry
+
+    EXPECT_EQ(setString(fMap, "key", "VALUE"), HCORE_OK);
+    EXPECT_EQ(getString(fMap, "key"), "VALUE");
+
+    EXPECT_EQ(setString(fMap, "key", "a longer value"), HCORE_OK);
+    EXPECT_EQ(getString(fMap, "key"), "a longer value");
+    EXPECT_EQ(hcore_shmap_count(fMap), 1u);
+
+    // the value is truncated
+
+    len = sizeof(buf);
+    EXPECT_EQ(hcore_shmap_get(fMap, "key", 3, buf, &len), HCORE_OK);
+    EXPECT_EQ(len, strlen("a longer value"));
+    EXPECT_EQ(memcmp(buf, "a lo", sizeof(buf)), 0);
+
+    // the keys are binary
+
+    EXPECT_EQ(hcore_shmap_set(fMap, "k\0a", 3, "1", 1, 0), HCORE_OK);
+    EXPECT_EQ(hcore_shmap_set(fMap, "k\0b", 3, "2", 1, 0), HCORE_OK);
+
+    len = sizeof(buf);
+    EXPECT_EQ(hcore_shmap_get(fMap, "k\0b", 3, buf, &len), HCORE_OK);
+    EXPECT_EQ(buf[0], '2');
+
+    EXPECT_EQ(hcore_shmap_delete(fMap, "key", 3), HCORE_OK);
+    EXPECT_EQ(hcore_shmap_delete(fMap, "key", 3), HCORE_DECLINED);
+    EXPECT_EQ(getString(fMap, "key"), "(nil)");
+    EXPECT_EQ(hcore_shmap_count(fMap), 2u);
+}
+
+TEST_F(ShmapTest, grow)
+{
+    char        key[32];
+    hcore_int_t v;
+
+    for (int i = 0; i < 10000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        ASSERT_EQ(hcore_shmap_incr(fMap, key, strlen(key), i, 0, NULL),
+                  HCORE_OK);
+    }
+
+    EXPECT_EQ(hcore_shmap_count(fMap), 10000u);
+
+    // the buckets are split one by one
+
+    hcore_atomic_uint_t state = fMap->sh->state;
+    hcore_uint_t        n = (4u << (state >> 32)) + (state & 0xffffffff);
+
+    EXPECT_GE(n * HCORE_SHMAP_LOAD, 10000u / 2);
+    EXPECT_LE(n, 10000u);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        ASSERT_EQ(hcore_shmap_incr(fMap, key, strlen(key), 1, 0, &v),
+                  HCORE_OK);
+        ASSERT_EQ(v, i + 1);
+    }
+}
+
+TEST_F(ShmapTest, ttl)
+{
+    hcore_int_t v;
+
+    EXPECT_EQ(setString(fMap, "short", "1", 20), HCORE_OK);
+    EXPECT_EQ(setString(fMap, "long", "1", 60000), HCORE_OK);
+    EXPECT_EQ(hcore_shmap_incr(fMap, "counter", 7, 1, 20, &v), HCORE_OK);
+    EXPECT_EQ(v, 1);
+    EXPECT_EQ(hcore_shmap_incr(fMap, "counter", 7, 1, 20, &v), HCORE_OK);
+    EXPECT_EQ(v, 2);
+
+    EXPECT_EQ(getString(fMap, "short"), "1");
+
+    usleep(60 * 1000);
+
+    EXPECT_EQ(getString(fMap, "short"), "(nil)");
+    EXPECT_EQ(getString(fMap, "long"), "1");
+
+    // a new window is started
+
+    EXPECT_EQ(hcore_shmap_incr(fMap, "counter", 7, 1, 20, &v), HCORE_OK);
+    EXPECT_EQ(v, 1);
+
+    EXPECT_EQ(hcore_shmap_count(fMap), 2u);
+}
+
+TEST_F(ShmapTest, evict)
+{
+    hcore_shpool_t *shpool;
+    hcore_shmap_t  *map;
+    char            key[32], value[200];
+    int             n = 2000;
+
+    shpool = hcore_create_shpool(&fLog, NULL, 64 * 1024);
+    ASSERT_TRUE(shpool);
+
+    map = hcore_create_shmap(shpool, 16, 4);
+    ASSERT_TRUE(map);
+
+    memset(value, 'v', sizeof(value));
+
+    // far more than the pool holds, the least recently used are evicted
+
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        ASSERT_EQ(hcore_shmap_set(map, key, strlen(key), value, sizeof(value),
+                                  0),
+                  HCORE_OK);
+
+        // "key-0" is always used
+
+        EXPECT_EQ(getString(map, "key-0").size(), 64u);
+    }
+
+    EXPECT_LT(hcore_shmap_count(map), (hcore_uint_t)n);
+    EXPECT_EQ(getString(map, "key-1"), "(nil)");
+
+    snprintf(key, sizeof(key), "key-%d", n - 1);
+    EXPECT_NE(getString(map, key), "(nil)");
+
+    hcore_destroy_shmap(map);
+    hcore_destroy_shpool(shpool);
+}
+
+#define SHARED_PROCS 4
+#define SHARED_LOOPS 1000
+
+TEST_F(ShmapTest, shared)
+{
+    char        key[32];
+    hcore_int_t v;
+    pid_t       pids[SHARED_PROCS];
+    int         status;
+
+    for (int p = 0; p < SHARED_PROCS; p++)
+    {
+        pids[p] = fork();
+
+        if (pids[p] == 0)
+        {
+            int bad = 0;
+
+            for (int i = 0; i < SHARED_LOOPS; i++)
+            {
+                if (hcore_shmap_incr(fMap, "hits", 4, 1, 0, NULL) != HCORE_OK)
+                {
+                    bad++;
+                }
+
+                snprintf(key, sizeof(key), "%d-%d", p, i);
+
+                if (hcore_shmap_set(fMap, key, strlen(key), &i, sizeof(i), 0)
+                    != HCORE_OK)
+                {
+                    bad++;
+                }
+            }
+
+            _exit(bad);
+        }
+    }
+
+    for (int p = 0; p < SHARED_PROCS; p++)
+    {
+        ASSERT_EQ(waitpid(pids[p], &status, 0), pids[p]);
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    EXPECT_EQ(hcore_shmap_incr(fMap, "hits", 4, 0, 0, &v), HCORE_OK);
+    EXPECT_EQ(v, SHARED_PROCS * SHARED_LOOPS);
+
+    EXPECT_EQ(hcore_shmap_count(fMap),
+              (hcore_uint_t)(SHARED_PROCS * SHARED_LOOPS + 1));
+
+    for (int p = 0; p < SHARED_PROCS; p++)
+    {
+        for (int i = 0; i < SHARED_LOOPS; i++)
+        {
+            int    n;
+            size_t len = sizeof(n);
+
+            snprintf(key, sizeof(key), "%d-%d", p, i);
+            ASSERT_EQ(hcore_shmap_get(fMap, key, strlen(key), &n, &len),
+                      HCORE_OK);
+            EXPECT_EQ(n, i);
+        }
+    }
+}
+
+/*
+ * Processes look up and update a table of rate limit, compare lock striping
+ * with a single lock.
+ */
+
+#define BENCH_PROCS 4
+#define BENCH_LOOPS 200000
+#define BENCH_KEYS  4096
+
+TEST_F(ShmapTest, DISABLED_stripeBenchmark)
+{
+    for (hcore_uint_t nstripes = 1; nstripes <= 64; nstripes <<= 6)
+    {
+        hcore_shmap_t *map;
+        struct timeval tv0, tv1;
+
+        map = hcore_create_shmap(fShpool, 1024, nstripes);
+        ASSERT_TRUE(map);
+
+        gettimeofday(&tv0, NULL);
+
+        for (int p = 0; p < BENCH_PROCS; p++)
+        {
+            if (fork() == 0)
+            {
+                char key[32];
+
+                for (int i = 0; i < BENCH_LOOPS; i++)
+                {
+                    snprintf(key, sizeof(key), "client-%d",
+                             (i * 7919 + p) % BENCH_KEYS);
+
+                    hcore_shmap_incr(map, key, strlen(key), 1, 1000, NULL);
+                }
+
+                _exit(0);
+            }
+        }
+
+        for (int p = 0; p < BENCH_PROCS; p++) wait(NULL);
+
+        gettimeofday(&tv1, NULL);
+
+        double wall =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%2u stripes: %d procs, %.1f M incr/s, %u entries\n", nstripes,
+               BENCH_PROCS, BENCH_PROCS * BENCH_LOOPS / wall / 1e6,
+               hcore_shmap_count(map));
+
+        hcore_destroy_shmap(map);
+    }
+}
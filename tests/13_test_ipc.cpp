@@ -0,0 +1,580 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_ipc.h>
+#include <hcore_log.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <deque>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+class IpcTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, (char *)"@STDOUT", HCORE_LOG_ERR);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t fLog;
+};
+
+TEST_F(IpcTest, create)
+{
+    hcore_ipc_t *ipc;
+
+    // the slots are rounded up to power of 2
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_SPSC, 5, 10);
+    ASSERT_TRUE(ipc);
+    EXPECT_EQ(ipc->sh->n, 8u);
+    EXPECT_EQ(ipc->sh->size, 10u);
+    EXPECT_EQ(ipc->sh->slot_size % 8, 0u);
+    EXPECT_EQ(ipc->fd, -1);
+    EXPECT_EQ((uintptr_t)ipc->sh->data % HCORE_CACHELINE_SIZE, 0u);
+    hcore_destroy_ipc(ipc);
+
+    // the records are in bytes
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_RECORD, 1, 100);
+    ASSERT_TRUE(ipc);
+    EXPECT_EQ(ipc->sh->n, 256u);
+    hcore_destroy_ipc(ipc);
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_MPMC | HCORE_IPC_EVENTFD, 4,
+                           8);
+    ASSERT_TRUE(ipc);
+    EXPECT_NE(ipc->fd, -1);
+    hcore_destroy_ipc(ipc);
+
+    // invalid flags
+
+    EXPECT_FALSE(hcore_create_ipc(&fLog, NULL, 0, 4, 8));
+    EXPECT_FALSE(
+        hcore_create_ipc(&fLog, NULL, HCORE_IPC_SPSC | HCORE_IPC_MPMC, 4, 8));
+    EXPECT_FALSE(hcore_create_ipc(&fLog, NULL,
+                                  HCORE_IPC_MPMC | HCORE_IPC_RECORD, 4, 8));
+    EXPECT_FALSE(hcore_create_ipc(&fLog, "/IpcTest",
+                                  HCORE_IPC_SPSC | HCORE_IPC_EVENTFD, 4, 8));
+}
+
+static void
+testSendRecv(hcore_ipc_t *ipc, hcore_uint_t n)
+{
+    char    buf[64];
+    ssize_t len;
+
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), HCORE_AGAIN);
+
+    // 1. fill the ring
+
+    for (hcore_uint_t i = 0; i < n; i++)
+    {
+        snprintf(buf, sizeof(buf), "msg %u", i);
+        ASSERT_EQ(hcore_ipc_send(ipc, buf, strlen(buf)), HCORE_OK);
+    }
+
+    EXPECT_EQ(hcore_ipc_send(ipc, "x", 1), HCORE_AGAIN);
+
+    // 2. the buffer is too small, the message is left
+
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, 2), HCORE_ERROR);
+
+    // 3. in order, and the ring is reused
+
+    for (hcore_uint_t k = 0; k < 3; k++)
+    {
+        for (hcore_uint_t i = 0; i < n; i++)
+        {
+            char expect[64];
+
+            snprintf(expect, sizeof(expect), "msg %u", i);
+
+            len = hcore_ipc_recv(ipc, buf, sizeof(buf));
+            ASSERT_EQ(len, (ssize_t)strlen(expect));
+            EXPECT_EQ(memcmp(buf, expect, len), 0);
+
+            ASSERT_EQ(hcore_ipc_send(ipc, expect, len), HCORE_OK);
+        }
+    }
+
+    EXPECT_EQ(hcore_ipc_send(ipc, "x", 1), HCORE_AGAIN);
+}
+
+TEST_F(IpcTest, spsc)
+{
+    hcore_ipc_t *ipc;
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_SPSC, 4, 16);
+    ASSERT_TRUE(ipc);
+
+    EXPECT_EQ(hcore_ipc_send(ipc, "01234567890123456", 17), HCORE_ERROR);
+
+    testSendRecv(ipc, 4);
+
+    hcore_destroy_ipc(ipc);
+}
+
+TEST_F(IpcTest, mpmc)
+{
+    hcore_ipc_t *ipc;
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_MPMC, 4, 16);
+    ASSERT_TRUE(ipc);
+
+    testSendRecv(ipc, 4);
+
+    hcore_destroy_ipc(ipc);
+}
+
+TEST_F(IpcTest, record)
+{
+    hcore_ipc_t       *ipc;
+    unsigned char      buf[256], out[256];
+    ssize_t            len;
+    hcore_uint_t       sent = 0, recv = 0;
+    std::deque<size_t> lens;
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_RECORD, 4, 200);
+    ASSERT_TRUE(ipc);
+
+    EXPECT_EQ(hcore_ipc_send(ipc, buf, 201), HCORE_ERROR);
+
+    // the records of various length are wrapped around many times
+
+    srand(1);
+
+    for (int round = 0; round < 1000; round++)
+    {
+        for (;;)
+        {
+            size_t n = rand() % 201;
+
+            for (size_t i = 0; i < n; i++) buf[i] = (unsigned char)(sent + i);
+
+            if (hcore_ipc_send(ipc, buf, n) == HCORE_AGAIN) break;
+
+            lens.push_back(n);
+            sent++;
+        }
+
+        ASSERT_GE(lens.size(), 4u);
+
+        for (int k = rand() % 4; k >= 0; k--)
+        {
+            size_t n = lens.front();
+
+            lens.pop_front();
+
+            len = hcore_ipc_recv(ipc, out, sizeof(out));
+            ASSERT_EQ(len, (ssize_t)n);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                ASSERT_EQ(out[i], (unsigned char)(recv + i));
+            }
+
+            recv++;
+        }
+    }
+
+    EXPECT_GT(recv, 1000u);
+
+    hcore_destroy_ipc(ipc);
+}
+
+TEST_F(IpcTest, named)
+{
+    hcore_ipc_t *ipc, *peer;
+    char         buf[16];
+
+    ipc = hcore_create_ipc(&fLog, "/IpcTest", HCORE_IPC_SPSC, 4, 16);
+    ASSERT_TRUE(ipc);
+
+    peer = hcore_get_ipc(&fLog, "/IpcTest");
+    ASSERT_TRUE(peer);
+    EXPECT_FALSE(peer->create);
+    EXPECT_NE(peer->sh, ipc->sh);
+
+    ASSERT_EQ(hcore_ipc_send(ipc, "hello", 5), HCORE_OK);
+    ASSERT_EQ(hcore_ipc_recv(peer, buf, sizeof(buf)), 5);
+    EXPECT_EQ(memcmp(buf, "hello", 5), 0);
+
+    hcore_destroy_ipc(peer);
+    hcore_destroy_ipc(ipc);
+
+    EXPECT_FALSE(hcore_get_ipc(&fLog, "/IpcTest"));
+}
+
+TEST_F(IpcTest, namedReattach)
+{
+    hcore_uint_t modes[] = {HCORE_IPC_SPSC, HCORE_IPC_RECORD};
+    hcore_ipc_t *ipc, *producer, *consumer;
+    char         buf[16];
+    hcore_uint_t sent;
+
+    for (hcore_uint_t mode : modes)
+    {
+        ipc = hcore_create_ipc(&fLog, "/IpcTest", mode, 4, 16);
+        ASSERT_TRUE(ipc);
+
+        // the ring has been used before the others attach to it
+
+        for (hcore_uint_t i = 0; i < 6; i++)
+        {
+            ASSERT_EQ(hcore_ipc_send(ipc, &i, sizeof(i)), HCORE_OK);
+            ASSERT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)),
+                      (ssize_t)sizeof(i));
+        }
+
+        consumer = hcore_get_ipc(&fLog, "/IpcTest");
+        ASSERT_TRUE(consumer);
+        EXPECT_EQ(hcore_ipc_recv(consumer, buf, sizeof(buf)), HCORE_AGAIN);
+
+        producer = hcore_get_ipc(&fLog, "/IpcTest");
+        ASSERT_TRUE(producer);
+
+        for (sent = 0; sent < 10; sent++)
+        {
+            if (hcore_ipc_send(producer, &sent, sizeof(sent)) == HCORE_AGAIN)
+            {
+                break;
+            }
+        }
+
+        EXPECT_GE(sent, 4u);
+        EXPECT_LT(sent, 10u);
+
+        // nothing unread was overwritten
+
+        for (hcore_uint_t i = 0; i < sent; i++)
+        {
+            ASSERT_EQ(hcore_ipc_recv(consumer, buf, sizeof(buf)),
+                      (ssize_t)sizeof(i));
+            EXPECT_EQ(memcmp(buf, &i, sizeof(i)), 0);
+        }
+
+        EXPECT_EQ(hcore_ipc_recv(consumer, buf, sizeof(buf)), HCORE_AGAIN);
+
+        // the creator consumes again after the other consumer
+
+        ASSERT_EQ(hcore_ipc_send(producer, "x", 1), HCORE_OK);
+        EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), 1);
+        EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), HCORE_AGAIN);
+
+        hcore_destroy_ipc(producer);
+        hcore_destroy_ipc(consumer);
+        hcore_destroy_ipc(ipc);
+    }
+}
+
+TEST_F(IpcTest, wait)
+{
+    hcore_ipc_t *ipc;
+    int          status;
+    pid_t        pid;
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_SPSC, 4, 16);
+    ASSERT_TRUE(ipc);
+
+    EXPECT_EQ(hcore_ipc_wait(ipc, 10), HCORE_AGAIN);
+    EXPECT_EQ(ipc->sh->wait, 0u);
+
+    pid = fork();
+
+    if (pid == 0)
+    {
+        char buf[16];
+
+        // the consumer sleeps until the message is sent
+
+        while (hcore_ipc_recv(ipc, buf, sizeof(buf)) == HCORE_AGAIN)
+        {
+            if (hcore_ipc_wait(ipc, 0) != HCORE_OK) _exit(1);
+        }
+
+        _exit(memcmp(buf, "ping", 4) ? 2 : 0);
+    }
+
+    for (int i = 0; i < 1000 && hcore_atomic_fetch(&ipc->sh->wait) == 0; i++)
+    {
+        usleep(1000);
+    }
+
+    EXPECT_EQ(ipc->sh->wait, 1u);
+
+    ASSERT_EQ(hcore_ipc_send(ipc, "ping", 4), HCORE_OK);
+
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(ipc->sh->wait, 0u);
+    EXPECT_NE(ipc->sh->doorbell, 0u);
+
+    hcore_destroy_ipc(ipc);
+}
+
+TEST_F(IpcTest, eventfd)
+{
+    hcore_ipc_t  *ipc;
+    struct pollfd pfd;
+    char          buf[16];
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_MPMC | HCORE_IPC_EVENTFD, 4,
+                           16);
+    ASSERT_TRUE(ipc);
+
+    pfd.fd     = ipc->fd;
+    pfd.events = POLLIN;
+
+    // no signal while the consumer isn't armed
+
+    ASSERT_EQ(hcore_ipc_send(ipc, "a", 1), HCORE_OK);
+    EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+    EXPECT_EQ(hcore_ipc_arm(ipc), HCORE_AGAIN);
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), 1);
+
+    // the armed consumer is signaled once
+
+    EXPECT_EQ(hcore_ipc_arm(ipc), HCORE_OK);
+
+    ASSERT_EQ(hcore_ipc_send(ipc, "b", 1), HCORE_OK);
+    ASSERT_EQ(hcore_ipc_send(ipc, "c", 1), HCORE_OK);
+    EXPECT_EQ(poll(&pfd, 1, 0), 1);
+    EXPECT_EQ(ipc->sh->wait, 0u);
+
+    EXPECT_EQ(hcore_ipc_wait(ipc, 10), HCORE_OK);
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), 1);
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), 1);
+    EXPECT_EQ(hcore_ipc_recv(ipc, buf, sizeof(buf)), HCORE_AGAIN);
+
+    EXPECT_EQ(hcore_ipc_wait(ipc, 10), HCORE_AGAIN);
+
+    hcore_destroy_ipc(ipc);
+}
+
+#define MPMC_PROCS 2
+#define MPMC_MSGS  20000
+
+typedef struct
+{
+    hcore_atomic_t recv;
+    hcore_atomic_t sum;
+} mpmcResult;
+
+TEST_F(IpcTest, mpmcShared)
+{
+    hcore_ipc_t *ipc;
+    mpmcResult  *res;
+    pid_t        pids[MPMC_PROCS * 2];
+    int          status;
+
+    ipc = hcore_create_ipc(&fLog, NULL, HCORE_IPC_MPMC, 64, sizeof(int));
+    ASSERT_TRUE(ipc);
+
+    res = (mpmcResult *)mmap(NULL, sizeof(mpmcResult), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANON, -1, 0);
+    ASSERT_NE(res, MAP_FAILED);
+    memset(res, 0, sizeof(mpmcResult));
+
+    for (int p = 0; p < MPMC_PROCS * 2; p++)
+    {
+        pids[p] = fork();
+
+        if (pids[p] != 0) continue;
+
+        if (p < MPMC_PROCS)
+        {
+            // producer
+
+            for (int i = 1; i <= MPMC_MSGS; i++)
+            {
+                while (hcore_ipc_send(ipc, &i, sizeof(i)) == HCORE_AGAIN)
+                {
+                    hcore_sched_yield();
+                }
+            }
+
+            _exit(0);
+        }
+
+        // consumer
+
+        for (;;)
+        {
+            int     v;
+            ssize_t n = hcore_ipc_recv(ipc, &v, sizeof(v));
+
+            if (n == HCORE_AGAIN)
+            {
+                if (hcore_atomic_fetch(&res->recv) == MPMC_PROCS * MPMC_MSGS)
+                {
+                    _exit(0);
+                }
+
+                hcore_ipc_wait(ipc, 10);
+                continue;
+            }
+
+            if (n != sizeof(v)) _exit(1);
+
+            hcore_atomic_fetch_add(&res->sum, v);
+            hcore_atomic_fetch_add(&res->recv, 1);
+        }
+    }
+
+    for (int p = 0; p < MPMC_PROCS * 2; p++)
+    {
+        ASSERT_EQ(waitpid(pids[p], &status, 0), pids[p]);
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    EXPECT_EQ(res->recv, (hcore_atomic_uint_t)MPMC_PROCS * MPMC_MSGS);
+    EXPECT_EQ(res->sum, (hcore_atomic_uint_t)MPMC_PROCS * MPMC_MSGS
+                            * (MPMC_MSGS + 1) / 2);
+
+    munmap(res, sizeof(mpmcResult));
+    hcore_destroy_ipc(ipc);
+}
+
+/*
+ * A process sends messages of 64 bytes to another one, compare the ring with
+ * a pipe.
+ */
+
+#define BENCH_MSGS 1000000
+#define BENCH_SIZE 64
+
+static double
+benchRing(hcore_ipc_t *ipc)
+{
+    struct timeval tv0, tv1;
+    char           buf[BENCH_SIZE] = {0};
+    pid_t          pid;
+
+    gettimeofday(&tv0, NULL);
+
+    pid = fork();
+
+    if (pid == 0)
+    {
+        for (int i = 0; i < BENCH_MSGS;)
+        {
+            ssize_t n = hcore_ipc_recv(ipc, buf, sizeof(buf));
+
+            if (n == HCORE_AGAIN)
+            {
+                hcore_ipc_wait(ipc, 0);
+                continue;
+            }
+
+            i++;
+        }
+
+        _exit(0);
+    }
+
+    for (int i = 0; i < BENCH_MSGS; i++)
+    {
+        while (hcore_ipc_send(ipc, buf, sizeof(buf)) == HCORE_AGAIN)
+        {
+            hcore_sched_yield();
+        }
+    }
+
+    waitpid(pid, NULL, 0);
+
+    gettimeofday(&tv1, NULL);
+
+    return (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+}
+
+TEST_F(IpcTest, DISABLED_throughputBenchmark)
+{
+    const char  *names[] = {"spsc", "mpmc", "record"};
+    hcore_uint_t flags[] = {HCORE_IPC_SPSC, HCORE_IPC_MPMC, HCORE_IPC_RECORD};
+
+    for (int k = 0; k < 3; k++)
+    {
+        hcore_ipc_t *ipc =
+            hcore_create_ipc(&fLog, NULL, flags[k], 1024, BENCH_SIZE);
+        ASSERT_TRUE(ipc);
+
+        double t = benchRing(ipc);
+
+        // the steady state, no one sleeps
+
+        struct timeval tv0, tv1;
+        char           buf[BENCH_SIZE] = {0};
+
+        gettimeofday(&tv0, NULL);
+
+        for (int i = 0; i < BENCH_MSGS; i++)
+        {
+            hcore_ipc_send(ipc, buf, sizeof(buf));
+            hcore_ipc_recv(ipc, buf, sizeof(buf));
+        }
+
+        gettimeofday(&tv1, NULL);
+
+        double s =
+            (tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6;
+
+        printf("%-6s: %.1f ns per message, %.1f ns without sleeping\n",
+               names[k], t * 1e9 / BENCH_MSGS, s * 1e9 / BENCH_MSGS);
+
+        hcore_destroy_ipc(ipc);
+    }
+
+    // pipe, a message is copied twice and costs two syscalls
+
+    struct timeval tv0, tv1;
+    char           buf[BENCH_SIZE] = {0};
+    int            fds[2];
+
+    ASSERT_EQ(pipe(fds), 0);
+
+    gettimeofday(&tv0, NULL);
+
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        close(fds[1]);
+
+        for (int i = 0; i < BENCH_MSGS; i++)
+        {
+            if (read(fds[0], buf, sizeof(buf)) != sizeof(buf)) _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(fds[0]);
+
+    for (int i = 0; i < BENCH_MSGS; i++)
+    {
+        ASSERT_EQ(write(fds[1], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+    }
+
+    waitpid(pid, NULL, 0);
+    close(fds[1]);
+
+    gettimeofday(&tv1, NULL);
+
+    printf("pipe  : %.1f ns per message\n",
+           ((tv1.tv_sec - tv0.tv_sec) + (tv1.tv_usec - tv0.tv_usec) / 1e6)
+               * 1e9 / BENCH_MSGS);
+}
@@ -0,0 +1,446 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_event_timer.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+class EventTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        int fds[2];
+
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+
+        fLoop = hcore_create_event_loop(fPool, 0);
+        ASSERT_TRUE(fLoop);
+
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+        fConn = hcore_create_connection(&fLog, fds[0]);
+        ASSERT_TRUE(fConn);
+        fPeer = fds[1];
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_connection(fConn);
+        close(fPeer);
+        hcore_destroy_event_loop(fLoop);
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t         fLog;
+    hcore_pool_t       *fPool;
+    hcore_event_loop_t *fLoop;
+    hcore_connection_t *fConn;
+    int                 fPeer;
+};
+
+static hcore_uint_t gHandled;
+
+static void
+readHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c = (hcore_connection_t *)ev->data;
+    hcore_uchar_t       buf[64];
+
+    gHandled++;
+
+    while (hcore_tcp_recv(c, buf, sizeof(buf)) > 0)
+    {
+        // drain
+    }
+}
+
+static void
+timerHandler(hcore_event_t *ev)
+{
+    if (ev->timeout) gHandled++;
+}
+
+TEST_F(EventTest, readEvent)
+{
+    gHandled            = 0;
+    fConn->rev->handler = readHandler;
+
+    ASSERT_EQ(hcore_event_add(fLoop, fConn->rev, HCORE_EVENT_READ, 0),
+              HCORE_OK);
+    EXPECT_TRUE(fConn->rev->active);
+
+    // 1. no event, return at timeout
+
+    EXPECT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    EXPECT_EQ(gHandled, 0);
+
+    // 2. readable
+
+    ASSERT_EQ(write(fPeer, "hello", 5), 5);
+    EXPECT_EQ(hcore_event_process(fLoop, 1000), HCORE_OK);
+    EXPECT_EQ(gHandled, 1);
+    EXPECT_FALSE(fConn->rev->ready);
+
+    // 3. deleted
+
+    ASSERT_EQ(hcore_event_del(fLoop, fConn->rev, HCORE_EVENT_READ, 0),
+              HCORE_OK);
+    EXPECT_FALSE(fConn->rev->active);
+
+    ASSERT_EQ(write(fPeer, "hello", 5), 5);
+    EXPECT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    EXPECT_EQ(gHandled, 1);
+}
+
+TEST_F(EventTest, connEvent)
+{
+    gHandled            = 0;
+    fConn->rev->handler = readHandler;
+    fConn->wev->handler = timerHandler;
+
+    ASSERT_EQ(hcore_event_add_conn(fLoop, fConn), HCORE_OK);
+    EXPECT_TRUE(fConn->rev->active);
+    EXPECT_TRUE(fConn->wev->active);
+
+    // writable at first
+
+    EXPECT_EQ(hcore_event_process(fLoop, 1000), HCORE_OK);
+    EXPECT_TRUE(fConn->wev->ready);
+    EXPECT_EQ(gHandled, 0);
+
+    ASSERT_EQ(write(fPeer, "hello", 5), 5);
+    EXPECT_EQ(hcore_event_process(fLoop, 1000), HCORE_OK);
+    EXPECT_EQ(gHandled, 1);
+
+    ASSERT_EQ(hcore_event_del_conn(fLoop, fConn, 0), HCORE_OK);
+    EXPECT_FALSE(fConn->rev->active);
+    EXPECT_FALSE(fConn->wev->active);
+}
+
+TEST_F(EventTest, timer)
+{
+    hcore_event_t ev1 = {0}, ev2 = {0};
+    hcore_msec_t  start;
+
+    gHandled    = 0;
+    ev1.handler = timerHandler;
+    ev2.handler = timerHandler;
+
+    EXPECT_EQ(hcore_event_find_timer(fLoop), HCORE_TIMER_INFINITE);
+
+    hcore_event_add_timer(fLoop, &ev1, 20);
+    hcore_event_add_timer(fLoop, &ev2, 5000);
+    EXPECT_TRUE(ev1.timer_set);
+    EXPECT_LE(hcore_event_find_timer(fLoop), 20);
+
+    // the wait is bounded by the nearest timer
+
+    start = fLoop->current_msec;
+    EXPECT_EQ(hcore_event_process(fLoop, HCORE_TIMER_INFINITE), HCORE_OK);
+    EXPECT_GE(fLoop->current_msec - start, 20);
+    EXPECT_EQ(gHandled, 1);
+    EXPECT_FALSE(ev1.timer_set);
+    EXPECT_TRUE(ev1.timeout);
+
+    hcore_event_del_timer(fLoop, &ev2);
+    EXPECT_FALSE(ev2.timer_set);
+    EXPECT_EQ(hcore_event_find_timer(fLoop), HCORE_TIMER_INFINITE);
+}
+
+struct TimerCase {
+    hcore_event_t ev;
+    hcore_msec_t  deadline;
+    hcore_msec_t  fired;
+};
+
+static hcore_msec_t gNow;
+
+static void
+recordHandler(hcore_event_t *ev)
+{
+    ((TimerCase *)ev->data)->fired = gNow;
+}
+
+static void
+runTimers(hcore_event_loop_t *loop, std::vector<TimerCase> &cases,
+          hcore_uint_t seed)
+{
+    hcore_msec_t start = loop->current_msec;
+
+    srand(seed);
+
+    for (auto &tc : cases)
+    {
+        // spread over all levels of the wheel
+        hcore_msec_t timeout = rand() % (1 << (rand() % 22));
+
+        tc.ev.data    = &tc;
+        tc.ev.handler = recordHandler;
+        tc.deadline   = start + timeout;
+        tc.fired      = 0;
+
+        hcore_event_add_timer(loop, &tc.ev, timeout);
+    }
+
+    // cancel some of them
+
+    for (size_t i = 0; i < cases.size(); i += 7)
+    {
+        hcore_event_del_timer(loop, &cases[i].ev);
+    }
+
+    for (gNow = start; gNow <= start + (1 << 21); gNow += rand() % 5000)
+    {
+        hcore_msec_t nearest = HCORE_TIMER_INFINITE;
+
+        loop->current_msec = gNow;
+        hcore_event_expire_timers(loop);
+
+        for (auto &tc : cases)
+        {
+            if (tc.ev.timer_set) nearest = std::min(nearest, tc.deadline);
+        }
+
+        // never sleep over the nearest timer
+
+        if (nearest == HCORE_TIMER_INFINITE)
+            ASSERT_EQ(hcore_event_find_timer(loop), HCORE_TIMER_INFINITE);
+        else
+            ASSERT_LE(gNow + hcore_event_find_timer(loop), nearest);
+    }
+
+    loop->current_msec = gNow;
+    hcore_event_expire_timers(loop);
+}
+
+TEST_F(EventTest, timerWheel)
+{
+    hcore_event_loop_t    *wheelLoop;
+    std::vector<TimerCase> expected(5000), actual(5000);
+
+    wheelLoop = hcore_create_event_loop(fPool, 0);
+    ASSERT_TRUE(wheelLoop);
+    ASSERT_EQ(hcore_event_timer_use_wheel(wheelLoop, 1), HCORE_OK);
+
+    wheelLoop->current_msec = fLoop->current_msec;
+    wheelLoop->timer_wheel->msec = fLoop->current_msec;
+
+    runTimers(fLoop, expected, 1);
+    runTimers(wheelLoop, actual, 1);
+
+    // the wheel fires every timer at the same round as the rbtree
+
+    for (size_t i = 0; i < actual.size(); i++)
+    {
+        EXPECT_EQ(actual[i].ev.timer_set, 0);
+
+        if (i % 7 == 0)
+        {
+            EXPECT_EQ(actual[i].fired, 0);
+            continue;
+        }
+
+        EXPECT_GE(actual[i].fired, actual[i].deadline);
+        EXPECT_EQ(actual[i].fired, expected[i].fired);
+    }
+
+    EXPECT_EQ(wheelLoop->timer_wheel->count, 0);
+    EXPECT_EQ(hcore_event_find_timer(wheelLoop), HCORE_TIMER_INFINITE);
+
+    // can't switch once timers are armed
+
+    hcore_event_add_timer(fLoop, &expected[0].ev, 1000);
+    EXPECT_EQ(hcore_event_timer_use_wheel(fLoop, 1), HCORE_ERROR);
+    hcore_event_del_timer(fLoop, &expected[0].ev);
+
+    hcore_destroy_event_loop(wheelLoop);
+}
+
+TEST_F(EventTest, timerWheelRearm)
+{
+    hcore_event_loop_t *wheelLoop;
+    hcore_event_t       ev;
+    hcore_msec_t        start;
+
+    wheelLoop = hcore_create_event_loop(fPool, 0);
+    ASSERT_TRUE(wheelLoop);
+    ASSERT_EQ(hcore_event_timer_use_wheel(wheelLoop, 1), HCORE_OK);
+
+    start                        = wheelLoop->current_msec;
+    wheelLoop->timer_wheel->msec = start;
+
+    hcore_memzero(&ev, sizeof(ev));
+    ev.handler = timerHandler;
+    gHandled   = 0;
+
+    // re-armed within HCORE_TIMER_LAZY_DELAY, the later deadline is kept
+
+    hcore_event_add_timer(wheelLoop, &ev, 100);
+
+    wheelLoop->current_msec = start + 50;
+    hcore_event_expire_timers(wheelLoop);
+
+    hcore_event_add_timer(wheelLoop, &ev, 100);
+    EXPECT_EQ(ev.timer.key, start + 150);
+
+    wheelLoop->current_msec = start + 149;
+    hcore_event_expire_timers(wheelLoop);
+    EXPECT_EQ(gHandled, 0);
+    EXPECT_TRUE(ev.timer_set);
+
+    wheelLoop->current_msec = start + 151;
+    hcore_event_expire_timers(wheelLoop);
+    EXPECT_EQ(gHandled, 1);
+    EXPECT_FALSE(ev.timer_set);
+
+    hcore_destroy_event_loop(wheelLoop);
+}
+
+static double
+benchTimers(hcore_event_loop_t *loop, std::vector<hcore_event_t> &events)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    srand(1);
+
+    // arm, re-arm, cancel half and expire the rest
+
+    for (auto &ev : events)
+    {
+        ev.handler = timerHandler;
+        hcore_event_add_timer(loop, &ev, rand() % 60000);
+    }
+
+    for (auto &ev : events)
+    {
+        hcore_event_add_timer(loop, &ev, 1000 + rand() % 60000);
+    }
+
+    for (size_t i = 0; i < events.size(); i += 2)
+    {
+        hcore_event_del_timer(loop, &events[i]);
+    }
+
+    while (hcore_event_find_timer(loop) != HCORE_TIMER_INFINITE)
+    {
+        loop->current_msec += 10;
+        hcore_event_expire_timers(loop);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count()
+           / (events.size() * 3);
+}
+
+TEST_F(EventTest, DISABLED_timerBenchmark)
+{
+    for (size_t n : {10000, 100000, 1000000})
+    {
+        hcore_event_loop_t        *wheelLoop;
+        std::vector<hcore_event_t> events(n);
+        double                     rbtree, wheel;
+
+        wheelLoop = hcore_create_event_loop(fPool, 0);
+        ASSERT_TRUE(wheelLoop);
+        ASSERT_EQ(hcore_event_timer_use_wheel(wheelLoop, 1), HCORE_OK);
+
+        rbtree = benchTimers(fLoop, events);
+        events.assign(n, hcore_event_t{});
+        wheel = benchTimers(wheelLoop, events);
+
+        printf("timers %zu: rbtree %.1f ns/op, wheel %.1f ns/op\n", n, rbtree,
+               wheel);
+
+        hcore_destroy_event_loop(wheelLoop);
+    }
+}
+
+static hcore_connection_table_t *gTable;
+static hcore_event_loop_t       *gLoop;
+static hcore_connection_t       *gConns[2];
+
+static void
+replaceHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c     = (hcore_connection_t *)ev->data;
+    hcore_connection_t *other = gConns[c == gConns[0]];
+    int                 fds[2];
+
+    gHandled++;
+
+    // close the other one and reuse its slot for a new fd
+
+    hcore_event_del_conn(gLoop, other, HCORE_CLOSE_EVENT);
+    hcore_put_connection(gTable, other);
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    close(fds[1]);
+
+    other = hcore_get_connection(gTable, fds[0], gTable->log);
+    ASSERT_TRUE(other);
+    other->rev->handler = replaceHandler;
+    other->wev->handler = replaceHandler;
+}
+
+TEST_F(EventTest, staleEvent)
+{
+    int fds[2][2];
+
+    gHandled = 0;
+    gLoop    = fLoop;
+    gTable   = hcore_create_connection_table(fPool, 2, 0);
+    ASSERT_TRUE(gTable);
+
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds[i]),
+                  0);
+
+        gConns[i] = hcore_get_connection(gTable, fds[i][0], &fLog);
+        ASSERT_TRUE(gConns[i]);
+        gConns[i]->rev->handler = replaceHandler;
+
+        ASSERT_EQ(hcore_event_add(fLoop, gConns[i]->rev, HCORE_EVENT_READ, 0),
+                  HCORE_OK);
+        ASSERT_EQ(write(fds[i][1], "x", 1), 1);
+    }
+
+    // both are ready in one wait, the event of replaced one is stale
+
+    EXPECT_EQ(hcore_event_process(fLoop, 1000), HCORE_OK);
+    EXPECT_EQ(gHandled, 1);
+
+    for (int i = 0; i < 2; i++)
+    {
+        close(fds[i][1]);
+
+        if (gConns[i]->fd != -1)
+        {
+            if (gConns[i]->rev->active)
+                hcore_event_del(fLoop, gConns[i]->rev, HCORE_EVENT_READ,
+                                HCORE_CLOSE_EVENT);
+            hcore_put_connection(gTable, gConns[i]);
+        }
+    }
+}
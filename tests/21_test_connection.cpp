@@ -0,0 +1,1059 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_buf.h>
+#include <hcore_connection.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+class UdpTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+
+        fServer = createSocket(&fServerAddr);
+        fClient = createSocket(&fClientAddr);
+        ASSERT_TRUE(fServer && fClient);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_connection(fServer);
+        hcore_destroy_connection(fClient);
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_connection_t *
+    createSocket(struct sockaddr_in *addr)
+    {
+        socklen_t socklen = sizeof(*addr);
+        int       fd      = socket(AF_INET, SOCK_DGRAM, 0);
+
+        hcore_memzero(addr, sizeof(*addr));
+        addr->sin_family      = AF_INET;
+        addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1) return NULL;
+        if (getsockname(fd, (struct sockaddr *)addr, &socklen) == -1)
+            return NULL;
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        return hcore_create_connection(&fLog, fd);
+    }
+
+    void
+    initMsgs(hcore_udp_msg_t *msgs, hcore_uint_t n, size_t size)
+    {
+        for (hcore_uint_t i = 0; i < n; i++)
+        {
+            msgs[i].buf     = hcore_alloc_buf(fPool, size);
+            msgs[i].socklen = 0;
+            ASSERT_TRUE(msgs[i].buf);
+        }
+    }
+
+    hcore_log_t         fLog;
+    hcore_pool_t       *fPool;
+    hcore_connection_t *fServer;
+    hcore_connection_t *fClient;
+    struct sockaddr_in  fServerAddr;
+    struct sockaddr_in  fClientAddr;
+};
+
+TEST_F(UdpTest, batch)
+{
+    hcore_udp_msg_t out[10], in[16];
+
+    initMsgs(out, 10, 64);
+    initMsgs(in, 16, 64);
+
+    for (int i = 0; i < 10; i++)
+    {
+        out[i].buf->last += sprintf((char *)out[i].buf->last, "msg-%d", i);
+        hcore_memcpy(&out[i].sockaddr, &fServerAddr, sizeof(fServerAddr));
+        out[i].socklen = sizeof(fServerAddr);
+    }
+
+    // 1. send all by one call
+
+    EXPECT_EQ(hcore_udp_send_batch(fClient, out, 10), 10);
+    EXPECT_EQ(hcore_buf_get_size(out[9].buf), 0);
+    EXPECT_EQ(fClient->sent_size, 50);
+
+    // 2. receive all by one call, peer is filled
+
+    fServer->bind_peer = 1;
+
+    ASSERT_EQ(hcore_udp_recv_batch(fServer, in, 16), 10);
+
+    for (int i = 0; i < 10; i++)
+    {
+        char expected[16];
+
+        sprintf(expected, "msg-%d", i);
+        EXPECT_EQ(std::string((char *)in[i].buf->pos,
+                              hcore_buf_get_size(in[i].buf)),
+                  expected);
+        EXPECT_EQ(in[i].socklen, sizeof(fClientAddr));
+        EXPECT_EQ(in[i].sockaddr.sockaddr_in.sin_port, fClientAddr.sin_port);
+    }
+
+    EXPECT_EQ(hcore_udp_recv_batch(fServer, in + 10, 6), HCORE_AGAIN);
+    EXPECT_FALSE(fServer->rev->ready);
+
+    // 3. reply to the bound peer
+
+    ASSERT_EQ(fServer->socklen, sizeof(fClientAddr));
+
+    for (int i = 0; i < 10; i++) in[i].socklen = 0;
+
+    EXPECT_EQ(hcore_udp_send_batch(fServer, in, 10), 10);
+    EXPECT_EQ(hcore_udp_recv_batch(fClient, out, 10), 10);
+    EXPECT_EQ(std::string((char *)out[3].buf->pos,
+                          hcore_buf_get_size(out[3].buf)),
+              "msg-3");
+}
+
+TEST_F(UdpTest, batchUnknown)
+{
+    hcore_connection_t *a, *b;
+    hcore_udp_msg_t     msgs[4];
+    int                 fds[2];
+
+    // peer of unix socketpair is unnamed
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    a = hcore_create_connection(&fLog, fds[0]);
+    b = hcore_create_connection(&fLog, fds[1]);
+    ASSERT_TRUE(a && b);
+
+    initMsgs(msgs, 4, 32);
+
+    for (int i = 0; i < 4; i++) *msgs[i].buf->last++ = 'a' + i;
+
+    EXPECT_EQ(hcore_udp_send_batch(a, msgs, 4), 4);
+
+    b->known = 1;
+    EXPECT_EQ(hcore_udp_recv_batch(b, msgs, 4), HCORE_AGAIN);
+
+    for (int i = 0; i < 4; i++) *msgs[i].buf->last++ = 'a' + i;
+
+    EXPECT_EQ(hcore_udp_send_batch(a, msgs, 4), 4);
+
+    b->known = 0;
+    EXPECT_EQ(hcore_udp_recv_batch(b, msgs, 4), 4);
+    EXPECT_EQ(*msgs[2].buf->pos, 'c');
+
+    hcore_destroy_connection(a);
+    hcore_destroy_connection(b);
+}
+
+TEST_F(UdpTest, recvBindIpv6)
+{
+    hcore_connection_t *server;
+    struct sockaddr_in6 addr, peer;
+    socklen_t           socklen = sizeof(addr);
+    hcore_uchar_t       buf[16];
+    int                 fd, cfd;
+
+    fd  = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    cfd = socket(AF_INET6, SOCK_DGRAM, 0);
+    ASSERT_TRUE(fd != -1 && cfd != -1);
+
+    hcore_memzero(&addr, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr   = in6addr_loopback;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(fd);
+        close(cfd);
+        GTEST_SKIP() << "IPv6 loopback isn't available";
+    }
+
+    ASSERT_EQ(getsockname(fd, (struct sockaddr *)&addr, &socklen), 0);
+
+    server = hcore_create_connection(&fLog, fd);
+    ASSERT_TRUE(server);
+
+    // the peer of IPv6 is larger than 'struct sockaddr'
+
+    ASSERT_EQ(sendto(cfd, "v6", 2, 0, (struct sockaddr *)&addr, sizeof(addr)),
+              2);
+
+    server->bind_peer = 1;
+
+    ASSERT_EQ(hcore_udp_recv(server, buf, sizeof(buf)), 2);
+    ASSERT_EQ(server->socklen, sizeof(struct sockaddr_in6));
+
+    socklen = sizeof(peer);
+    ASSERT_EQ(getsockname(cfd, (struct sockaddr *)&peer, &socklen), 0);
+
+    EXPECT_EQ(((struct sockaddr_in6 *)server->sockaddr)->sin6_port,
+              peer.sin6_port);
+    EXPECT_EQ(memcmp(&((struct sockaddr_in6 *)server->sockaddr)->sin6_addr,
+                     &in6addr_loopback, sizeof(struct in6_addr)),
+              0);
+
+    // the later ones are received with the bound peer
+
+    ASSERT_EQ(sendto(cfd, "v6", 2, 0, (struct sockaddr *)&addr, sizeof(addr)),
+              2);
+    EXPECT_EQ(hcore_udp_recv(server, buf, sizeof(buf)), 2);
+
+    hcore_destroy_connection(server);
+    close(cfd);
+}
+
+TEST_F(UdpTest, gsoGro)
+{
+    hcore_udp_msg_t out[11], in[16];
+    hcore_buf_t     views[16];
+
+    if (hcore_udp_enable_gso(fClient) != HCORE_OK)
+    {
+        GTEST_SKIP() << "UDP_SEGMENT isn't supported";
+    }
+
+    initMsgs(out, 11, 1000);
+    initMsgs(in, 16, 65536);
+
+    for (int i = 0; i < 11; i++)
+    {
+        size_t size = (i == 10) ? 500 : 1000;
+
+        memset(out[i].buf->last, 'a' + i, size);
+        out[i].buf->last += size;
+        hcore_memcpy(&out[i].sockaddr, &fServerAddr, sizeof(fServerAddr));
+        out[i].socklen = sizeof(fServerAddr);
+    }
+
+    // 1. segmented by kernel if GRO isn't enabled
+
+    ASSERT_EQ(hcore_udp_send_batch(fClient, out, 11), 11);
+    ASSERT_EQ(hcore_udp_recv_batch(fServer, in, 16), 11);
+    EXPECT_EQ(hcore_buf_get_size(in[10].buf), 500);
+    EXPECT_EQ(in[3].segment, 0);
+    EXPECT_EQ(*in[3].buf->pos, 'd');
+
+    // 2. coalesced message is split to views
+
+    ASSERT_EQ(hcore_udp_enable_gro(fServer), HCORE_OK);
+
+    for (int i = 0; i < 11; i++)
+    {
+        out[i].buf->pos = out[i].buf->start;
+        in[i].buf->pos = in[i].buf->last = in[i].buf->start;
+    }
+
+    ASSERT_EQ(hcore_udp_send_batch(fClient, out, 11), 11);
+    ASSERT_EQ(hcore_udp_recv_batch(fServer, in, 16), 1);
+    EXPECT_EQ(hcore_buf_get_size(in[0].buf), 10500);
+    EXPECT_EQ(in[0].segment, 1000);
+
+    ASSERT_EQ(hcore_udp_split_msg(&in[0], views, 16), 11);
+    EXPECT_EQ(views[3].pos, in[0].buf->pos + 3000);
+    EXPECT_EQ(*views[3].pos, 'd');
+    EXPECT_EQ(hcore_buf_get_size(&views[10]), 500);
+}
+
+static double
+cpuTime()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+TEST_F(UdpTest, DISABLED_gsoBenchmark)
+{
+    hcore_udp_msg_t out[HCORE_UDP_BATCH_MAX], in[HCORE_UDP_BATCH_MAX];
+    hcore_buf_t     views[HCORE_UDP_BATCH_MAX];
+    const int       rounds = 20000;
+
+    initMsgs(out, HCORE_UDP_BATCH_MAX, 1200);
+    initMsgs(in, HCORE_UDP_BATCH_MAX, 65536);
+
+    for (auto &msg : out)
+    {
+        msg.buf->last = msg.buf->end;
+        hcore_memcpy(&msg.sockaddr, &fServerAddr, sizeof(fServerAddr));
+        msg.socklen = sizeof(fServerAddr);
+    }
+
+    for (int offload = 0; offload < 2; offload++)
+    {
+        size_t received = 0;
+
+        if (offload)
+        {
+            ASSERT_EQ(hcore_udp_enable_gso(fClient), HCORE_OK);
+            ASSERT_EQ(hcore_udp_enable_gro(fServer), HCORE_OK);
+        }
+
+        auto   start = std::chrono::steady_clock::now();
+        double cpu   = cpuTime();
+
+        for (int r = 0; r < rounds; r++)
+        {
+            ssize_t n;
+
+            for (auto &msg : out) msg.buf->pos = msg.buf->start;
+
+            ASSERT_EQ(hcore_udp_send_batch(fClient, out, HCORE_UDP_BATCH_MAX),
+                      HCORE_UDP_BATCH_MAX);
+
+            while ((n = hcore_udp_recv_batch(fServer, in, HCORE_UDP_BATCH_MAX))
+                   > 0)
+            {
+                for (ssize_t i = 0; i < n; i++)
+                {
+                    received += hcore_udp_split_msg(&in[i], views,
+                                                    HCORE_UDP_BATCH_MAX);
+                    in[i].buf->pos = in[i].buf->last = in[i].buf->start;
+                }
+            }
+        }
+
+        double secs = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+        printf("%s: %zu datagrams, %.0f pps, %.2f cpu seconds\n",
+               offload ? "gso/gro" : "plain", received, received / secs,
+               cpuTime() - cpu);
+    }
+}
+
+TEST(TcpTest, recvChain)
+{
+    hcore_log_t         log;
+    hcore_connection_t *c;
+    hcore_chain_t      *in, *cl, **ll;
+    hcore_uint_t        nbufs;
+    int                 fds[2];
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    c = hcore_create_connection(&log, fds[0]);
+    ASSERT_TRUE(c);
+
+    // chain of 4 small buffers, the first is full
+
+    ll = &in;
+
+    for (int i = 0; i < 4; i++)
+    {
+        cl = hcore_alloc_chain(c->pool);
+        ASSERT_TRUE(cl);
+
+        cl->buf = hcore_alloc_buf(c->pool, 8);
+        ASSERT_TRUE(cl->buf);
+
+        *ll = cl;
+        ll  = &cl->next;
+    }
+
+    *ll = NULL;
+
+    in->buf->last = in->buf->end;
+
+    EXPECT_EQ(hcore_tcp_recv_chain(c, in, &nbufs), HCORE_AGAIN);
+    EXPECT_FALSE(c->rev->ready);
+
+    // 1. scattered into 2 buffers
+
+    ASSERT_EQ(write(fds[1], "0123456789", 10), 10);
+    EXPECT_EQ(hcore_tcp_recv_chain(c, in, &nbufs), 10);
+    EXPECT_EQ(nbufs, 2);
+    EXPECT_EQ(hcore_buf_get_size(in->next->buf), 8);
+    EXPECT_EQ(hcore_buf_get_size(in->next->next->buf), 2);
+    EXPECT_EQ(in->next->next->buf->pos[1], '9');
+
+    // 2. continue from the partial buffer
+
+    ASSERT_EQ(write(fds[1], "abcdefghijklmnopq", 17), 17);
+    EXPECT_EQ(hcore_tcp_recv_chain(c, in, &nbufs), 14);
+    EXPECT_EQ(nbufs, 2);
+    EXPECT_EQ(in->next->next->buf->pos[2], 'a');
+    EXPECT_EQ(hcore_buf_get_freesize(in->next->next->next->buf), 0);
+
+    // 3. peer is closed
+
+    for (cl = in; cl; cl = cl->next) cl->buf->last = cl->buf->pos;
+
+    close(fds[1]);
+    EXPECT_EQ(hcore_tcp_recv_chain(c, in, NULL), 3);
+    EXPECT_EQ(hcore_tcp_recv_chain(c, in, NULL), 0);
+    EXPECT_TRUE(c->rev->eof);
+
+    hcore_destroy_connection(c);
+    hcore_destroy_log(&log);
+}
+
+static hcore_chain_t *
+appendBuf(hcore_pool_t *pool, hcore_chain_t ***ll, hcore_buf_t *b)
+{
+    hcore_chain_t *cl = hcore_alloc_chain(pool);
+
+    if (cl == NULL || b == NULL) return NULL;
+
+    cl->buf  = b;
+    cl->next = NULL;
+    **ll     = cl;
+    *ll      = &cl->next;
+
+    return cl;
+}
+
+static hcore_buf_t *
+memBuf(hcore_pool_t *pool, const char *data)
+{
+    hcore_buf_t *b = hcore_alloc_buf(pool, strlen(data));
+
+    if (b) b->last = hcore_cpymem(b->last, data, strlen(data));
+
+    return b;
+}
+
+TEST(TcpTest, sendChainFile)
+{
+    hcore_log_t         log;
+    hcore_connection_t *c;
+    hcore_chain_t      *out, **ll, *rest;
+    std::string         content, expected, received;
+    char                path[] = "/tmp/hcore_test_sendfile_XXXXXX";
+    char                buf[65536];
+    int                 fds[2], pipefds[2], file;
+    ssize_t             n;
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    c = hcore_create_connection(&log, fds[0]);
+    ASSERT_TRUE(c);
+    c->wev->ready = 1;
+
+    file = mkstemp(path);
+    ASSERT_NE(file, -1);
+    unlink(path);
+
+    for (int i = 0; i < 100000; i++) content += (char)('a' + i % 26);
+
+    ASSERT_EQ(write(file, content.data(), content.size()),
+              (ssize_t)content.size());
+
+    ASSERT_EQ(pipe(pipefds), 0);
+    ASSERT_EQ(write(pipefds[1], "<pipe>", 6), 6);
+
+    // memory, file, memory, pipe and memory are mixed
+
+    ll = &out;
+    ASSERT_TRUE(appendBuf(c->pool, &ll, memBuf(c->pool, "head:")));
+    ASSERT_TRUE(appendBuf(c->pool, &ll,
+                          hcore_alloc_file_buf(c->pool, file, 10,
+                                               content.size() - 10, 0)));
+    ASSERT_TRUE(appendBuf(c->pool, &ll, memBuf(c->pool, ":middle:")));
+    ASSERT_TRUE(appendBuf(c->pool, &ll,
+                          hcore_alloc_file_buf(c->pool, pipefds[0], 0, 6, 1)));
+    ASSERT_TRUE(appendBuf(c->pool, &ll, memBuf(c->pool, ":tail")));
+
+    expected = "head:" + content.substr(10) + ":middle:<pipe>:tail";
+
+    // partial sends update offsets and continue
+
+    rest = out;
+
+    while (rest)
+    {
+        c->wev->ready = 1;
+
+        rest = hcore_tcp_send_chain(c, rest);
+        ASSERT_NE(rest, HCORE_CHAIN_ERROR);
+
+        while ((n = read(fds[1], buf, sizeof(buf))) > 0)
+        {
+            received.append(buf, n);
+        }
+    }
+
+    EXPECT_EQ(received.size(), expected.size());
+    EXPECT_TRUE(received == expected);
+    EXPECT_EQ(out->next->buf->file_pos, (off_t)content.size());
+    EXPECT_EQ(c->sent_size, (off_t)expected.size());
+
+    close(file);
+    close(pipefds[0]);
+    close(pipefds[1]);
+    close(fds[1]);
+    hcore_destroy_connection(c);
+    hcore_destroy_log(&log);
+}
+
+static void
+tcpPair(int fds[2])
+{
+    struct sockaddr_in addr;
+    socklen_t          socklen = sizeof(addr);
+    int                ls;
+
+    hcore_memzero(&addr, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ls = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(bind(ls, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(ls, 1), 0);
+    ASSERT_EQ(getsockname(ls, (struct sockaddr *)&addr, &socklen), 0);
+
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(fds[0], (struct sockaddr *)&addr, sizeof(addr)), 0);
+    fds[1] = accept(ls, NULL, NULL);
+    ASSERT_NE(fds[1], -1);
+    close(ls);
+
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+}
+
+static int gFreed;
+
+static void
+countFree(hcore_chain_t *cl)
+{
+    gFreed++;
+}
+
+static size_t
+drain(int fd, std::string *received)
+{
+    char    buf[65536];
+    ssize_t n;
+    size_t  total = 0;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        if (received) received->append(buf, n);
+        total += n;
+    }
+
+    return total;
+}
+
+TEST(TcpTest, zerocopy)
+{
+    hcore_log_t         log;
+    hcore_connection_t *c;
+    hcore_chain_t      *out, *cl, **ll;
+    std::string         expected, received;
+    int                 fds[2];
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+    tcpPair(fds);
+
+    c = hcore_create_connection(&log, fds[0]);
+    ASSERT_TRUE(c);
+
+    if (hcore_tcp_enable_zerocopy(c, 64 * 1024) != HCORE_OK)
+    {
+        hcore_destroy_connection(c);
+        close(fds[1]);
+        GTEST_SKIP() << "SO_ZEROCOPY isn't supported";
+    }
+
+    // a small buffer is copied and large ones are sent by zerocopy
+
+    gFreed = 0;
+    ll     = &out;
+
+    for (int i = 0; i < 4; i++)
+    {
+        size_t size = (i == 0) ? 100 : 256 * 1024;
+
+        cl = hcore_alloc_chain(c->pool);
+        ASSERT_TRUE(cl);
+
+        cl->buf = hcore_alloc_buf(c->pool, size);
+        ASSERT_TRUE(cl->buf);
+        memset(cl->buf->last, '0' + i, size);
+        cl->buf->last += size;
+        cl->free = countFree;
+
+        expected.append((char *)cl->buf->pos, size);
+
+        *ll = cl;
+        ll  = &cl->next;
+    }
+
+    *ll = NULL;
+
+    for (int i = 0; i < 10000 && (out || gFreed < 4); i++)
+    {
+        c->wev->ready = 1;
+
+        if (out)
+        {
+            out = hcore_tcp_send_chain(c, out);
+            ASSERT_NE(out, HCORE_CHAIN_ERROR);
+        }
+        else
+        {
+            ASSERT_EQ(hcore_tcp_reap_zerocopy(c), HCORE_OK);
+            usleep(100);
+        }
+
+        drain(fds[1], &received);
+    }
+
+    EXPECT_EQ(out, nullptr);
+    EXPECT_EQ(gFreed, 4);
+    EXPECT_EQ(c->zc_done, c->zc_seq);
+    EXPECT_GT(c->zc_seq, 0);
+    EXPECT_EQ(c->zc_busy, nullptr);
+    EXPECT_TRUE(received == expected);
+
+    hcore_destroy_connection(c);
+    close(fds[1]);
+    hcore_destroy_log(&log);
+}
+
+TEST(TcpTest, DISABLED_zerocopyBenchmark)
+{
+    hcore_log_t log;
+    const off_t total = 256 * 1024 * 1024;
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+    for (size_t size = 4096; size <= 4 * 1024 * 1024; size *= 4)
+    {
+        for (int zerocopy = 0; zerocopy < 2; zerocopy++)
+        {
+            hcore_connection_t *c;
+            hcore_chain_t      *out = NULL, *cl;
+            hcore_buf_t        *b;
+            int                 fds[2];
+            off_t               received = 0;
+
+            tcpPair(fds);
+
+            c = hcore_create_connection(&log, fds[0]);
+            ASSERT_TRUE(c);
+
+            if (zerocopy)
+            {
+                ASSERT_EQ(hcore_tcp_enable_zerocopy(c, 1), HCORE_OK);
+            }
+
+            b = hcore_alloc_buf(c->pool, size);
+            ASSERT_TRUE(b);
+            memset(b->start, 'x', size);
+
+            auto   start = std::chrono::steady_clock::now();
+            double cpu   = cpuTime();
+
+            while (received < total)
+            {
+                if (out == NULL)
+                {
+                    cl = hcore_alloc_chain(c->pool);
+                    ASSERT_TRUE(cl);
+
+                    b->pos = b->start;
+                    b->last = b->end;
+                    cl->buf = b;
+                    out     = cl;
+                }
+
+                c->wev->ready = 1;
+                out           = hcore_tcp_send_chain(c, out);
+                ASSERT_NE(out, HCORE_CHAIN_ERROR);
+
+                received += drain(fds[1], NULL);
+            }
+
+            double secs = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+            printf("%8zu bytes %-8s: %7.0f MB/s, %.2f cpu seconds\n", size,
+                   zerocopy ? "zerocopy" : "copy", total / secs / 1e6,
+                   cpuTime() - cpu);
+
+            hcore_destroy_connection(c);
+            close(fds[1]);
+        }
+    }
+
+    hcore_destroy_log(&log);
+}
+
+TEST(TcpTest, flush)
+{
+    hcore_log_t         log;
+    hcore_connection_t *c;
+    hcore_chain_t      *out, **ll;
+    std::string         received;
+    int                 fds[2];
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+    for (int policy : {HCORE_TCP_FLUSH_CORK, HCORE_TCP_FLUSH_MORE})
+    {
+        tcpPair(fds);
+
+        c = hcore_create_connection(&log, fds[0]);
+        ASSERT_TRUE(c);
+
+        c->flush      = policy;
+        c->wev->ready = 1;
+
+        // the header and body are held until flushing
+
+        EXPECT_EQ(hcore_tcp_send(c, (hcore_uchar_t *)"header:", 7), 7);
+
+        ll = &out;
+        ASSERT_TRUE(appendBuf(c->pool, &ll, memBuf(c->pool, "body")));
+        EXPECT_EQ(hcore_tcp_send_chain(c, out), nullptr);
+
+        received.clear();
+        EXPECT_EQ(drain(fds[1], &received), 0);
+
+        ASSERT_EQ(hcore_connection_flush(c), HCORE_OK);
+        EXPECT_FALSE(c->corked);
+
+        for (int i = 0; i < 100 && received.size() < 11; i++)
+        {
+            drain(fds[1], &received);
+            usleep(100);
+        }
+
+        EXPECT_EQ(received, "header:body");
+
+        hcore_destroy_connection(c);
+        close(fds[1]);
+    }
+
+    hcore_destroy_log(&log);
+}
+
+TEST(TcpTest, DISABLED_flushBenchmark)
+{
+    hcore_log_t log;
+    const char *names[] = {"immediate", "cork", "more"};
+    char        body[1000];
+    const int   messages = 20000;
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+    memset(body, 'b', sizeof(body));
+
+    for (int policy : {HCORE_TCP_FLUSH_IMMEDIATE, HCORE_TCP_FLUSH_CORK,
+                       HCORE_TCP_FLUSH_MORE})
+    {
+        hcore_connection_t *c;
+        struct tcp_info     info;
+        socklen_t           len = sizeof(info);
+        int                 fds[2], on = 1;
+        double              latency = 0;
+
+        tcpPair(fds);
+
+        c = hcore_create_connection(&log, fds[0]);
+        ASSERT_TRUE(c);
+
+        // as usual for a server
+        setsockopt(fds[0], IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        c->flush = policy;
+
+        for (int i = 0; i < messages; i++)
+        {
+            size_t received = 0;
+            auto   start    = std::chrono::steady_clock::now();
+
+            // header and body are produced by two calls
+
+            c->wev->ready = 1;
+            ASSERT_EQ(hcore_tcp_send(c, (hcore_uchar_t *)"header", 6), 6);
+            ASSERT_EQ(hcore_tcp_send(c, (hcore_uchar_t *)body, sizeof(body)),
+                      (ssize_t)sizeof(body));
+            ASSERT_EQ(hcore_connection_flush(c), HCORE_OK);
+
+            while (received < 6 + sizeof(body)) received += drain(fds[1], NULL);
+
+            latency += std::chrono::duration<double, std::micro>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        }
+
+        ASSERT_EQ(getsockopt(fds[0], IPPROTO_TCP, TCP_INFO, &info, &len), 0);
+
+        printf("%-9s: %.2f segments/message, %.1f us/message\n",
+               names[policy], (double)info.tcpi_segs_out / messages,
+               latency / messages);
+
+        hcore_destroy_connection(c);
+        close(fds[1]);
+    }
+
+    hcore_destroy_log(&log);
+}
+
+TEST(ConnectionTableTest, getAndPut)
+{
+    hcore_log_t               log;
+    hcore_pool_t             *pool;
+    hcore_connection_table_t *table;
+    hcore_connection_t       *c[4], *c2;
+    hcore_uint_t              instance;
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_EMERG);
+
+    pool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &log);
+    ASSERT_TRUE(pool);
+
+    table = hcore_create_connection_table(pool, 4, 0);
+    ASSERT_TRUE(table);
+    EXPECT_EQ(table->nfree, 4);
+
+    for (int i = 0; i < 4; i++)
+    {
+        c[i] = hcore_get_connection(table, -1, &log);
+        ASSERT_TRUE(c[i]);
+        EXPECT_TRUE(c[i]->pool);
+        EXPECT_EQ(c[i]->rev->data, c[i]);
+        EXPECT_EQ(c[i]->wev->data, c[i]);
+    }
+
+    // slots are contiguous
+
+    EXPECT_EQ(c[3] - c[0], 3);
+    EXPECT_EQ(c[3]->rev - c[0]->rev, 3);
+
+    EXPECT_EQ(hcore_get_connection(table, -1, &log), nullptr);
+    EXPECT_EQ(table->nfailed, 1);
+    EXPECT_EQ(hcore_connection_table_used(table), 4);
+
+    // the last put is the first got, with toggled instance
+
+    instance = c[1]->rev->instance;
+
+    hcore_put_connection(table, c[2]);
+    hcore_put_connection(table, c[1]);
+    EXPECT_EQ(table->nfree, 2);
+    EXPECT_EQ(c[1]->fd, -1);
+
+    c2 = hcore_get_connection(table, -1, &log);
+    EXPECT_EQ(c2, c[1]);
+    EXPECT_NE(c2->rev->instance, instance);
+    EXPECT_EQ(c2->rev->instance, c2->wev->instance);
+
+    EXPECT_EQ(table->nfree, 1);
+    EXPECT_EQ(table->high_water, 4);
+
+    hcore_put_connection(table, c[0]);
+    hcore_put_connection(table, c2);
+    hcore_put_connection(table, c[3]);
+    EXPECT_EQ(table->nfree, 4);
+
+    hcore_destroy_pool(pool);
+    hcore_destroy_log(&log);
+}
+
+static hcore_uint_t gAccepted;
+
+static void
+acceptHandler(hcore_connection_t *c)
+{
+    gAccepted++;
+
+    EXPECT_EQ(c->sockaddr->sa_family, AF_INET);
+    EXPECT_TRUE(fcntl(c->fd, F_GETFL) & O_NONBLOCK);
+
+    if (c->listening->table)
+        hcore_put_connection(c->listening->table, c);
+    else
+        hcore_destroy_connection(c);
+}
+
+TEST(ListeningTest, acceptBudget)
+{
+    hcore_log_t         log;
+    hcore_pool_t       *pool;
+    hcore_event_loop_t *loop;
+    hcore_listening_t  *ls, *ls2;
+    struct sockaddr_in  addr;
+    int                 clients[5];
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_EMERG);
+
+    pool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &log);
+    ASSERT_TRUE(pool);
+    loop = hcore_create_event_loop(pool, 0);
+    ASSERT_TRUE(loop);
+
+    hcore_memzero(&addr, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ls = hcore_create_listening(pool, (struct sockaddr *)&addr, sizeof(addr));
+    ASSERT_TRUE(ls);
+
+    ls->handler       = acceptHandler;
+    ls->accept_budget = 2;
+    ls->reuseport     = 1;
+    ls->table         = hcore_create_connection_table(pool, 8, 0);
+    ASSERT_TRUE(ls->table);
+
+    ls->loop = loop;
+
+    ASSERT_EQ(hcore_open_listening(ls), HCORE_OK);
+    ASSERT_EQ(hcore_event_add(loop, ls->connection->rev, HCORE_EVENT_READ, 0),
+              HCORE_OK);
+
+    // another listening on the same port by SO_REUSEPORT
+
+    ls2 = hcore_create_listening(pool, &ls->sockaddr.sockaddr, ls->socklen);
+    ASSERT_TRUE(ls2);
+    ls2->handler      = acceptHandler;
+    ls2->defer_accept = 1;
+
+    EXPECT_EQ(hcore_open_listening(ls2), HCORE_ERROR);
+    ls2->reuseport = 1;
+    ASSERT_EQ(hcore_open_listening(ls2), HCORE_OK);
+    hcore_close_listening(ls2);
+
+    // 5 connections are accepted with budget 2 per event
+
+    gAccepted = 0;
+
+    for (int i = 0; i < 5; i++)
+    {
+        clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(connect(clients[i], &ls->sockaddr.sockaddr, ls->socklen), 0);
+    }
+
+    EXPECT_EQ(hcore_event_process(loop, 1000), HCORE_OK);
+    EXPECT_EQ(gAccepted, 2);
+    EXPECT_TRUE(ls->connection->rev->ready);
+
+    EXPECT_EQ(hcore_event_process(loop, 1000), HCORE_OK);
+    EXPECT_EQ(gAccepted, 4);
+
+    EXPECT_EQ(hcore_event_process(loop, 1000), HCORE_OK);
+    EXPECT_EQ(gAccepted, 5);
+    EXPECT_FALSE(ls->connection->rev->ready);
+    EXPECT_EQ(ls->naccepted, 5);
+    EXPECT_EQ(ls->table->nfree, 8);
+    EXPECT_EQ(ls->table->high_water, 1);
+
+    for (int fd : clients) close(fd);
+
+    hcore_event_del(loop, ls->connection->rev, HCORE_EVENT_READ, 0);
+    hcore_close_listening(ls);
+    hcore_destroy_event_loop(loop);
+    hcore_destroy_pool(pool);
+    hcore_destroy_log(&log);
+}
+
+TEST(ListeningTest, acceptPaused)
+{
+    hcore_log_t         log;
+    hcore_pool_t       *pool;
+    hcore_event_loop_t *loop;
+    hcore_listening_t  *ls;
+    struct sockaddr_in  addr;
+    struct rlimit       rl, low;
+    int                 client, fd;
+
+    hcore_open_log(&log, HCORE_LOG_FILE_STDOUT, HCORE_LOG_EMERG);
+
+    pool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &log);
+    ASSERT_TRUE(pool);
+    loop = hcore_create_event_loop(pool, 0);
+    ASSERT_TRUE(loop);
+
+    hcore_memzero(&addr, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ls = hcore_create_listening(pool, (struct sockaddr *)&addr, sizeof(addr));
+    ASSERT_TRUE(ls);
+
+    ls->handler      = acceptHandler;
+    ls->loop         = loop;
+    ls->accept_delay = 50;
+
+    ASSERT_EQ(hcore_open_listening(ls), HCORE_OK);
+    ASSERT_EQ(hcore_event_add(loop, ls->connection->rev, HCORE_EVENT_READ, 0),
+              HCORE_OK);
+
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, &ls->sockaddr.sockaddr, ls->socklen), 0);
+
+    // 1. no fd is left for the accepted one, accepting is paused
+
+    fd = dup(0);
+    ASSERT_NE(fd, -1);
+    close(fd);
+
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &rl), 0);
+    low          = rl;
+    low.rlim_cur = fd;
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &low), 0);
+
+    gAccepted = 0;
+
+    EXPECT_EQ(hcore_event_process(loop, 1000), HCORE_OK);
+
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &rl), 0);
+
+    EXPECT_EQ(gAccepted, 0);
+    EXPECT_FALSE(ls->connection->rev->active);
+    EXPECT_TRUE(ls->connection->rev->timer_set);
+
+    // 2. it's resumed by the timer
+
+    for (int i = 0; i < 10 && gAccepted == 0; i++)
+    {
+        EXPECT_EQ(hcore_event_process(loop, 100), HCORE_OK);
+    }
+
+    EXPECT_EQ(gAccepted, 1);
+    EXPECT_TRUE(ls->connection->rev->active);
+    EXPECT_FALSE(ls->connection->rev->timer_set);
+
+    close(client);
+
+    hcore_event_del(loop, ls->connection->rev, HCORE_EVENT_READ, 0);
+    hcore_close_listening(ls);
+    hcore_destroy_event_loop(loop);
+    hcore_destroy_pool(pool);
+    hcore_destroy_log(&log);
+}
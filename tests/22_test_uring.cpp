@@ -0,0 +1,420 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+#include <hcore_uring.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+static hcore_uring_t *gRing;
+static hcore_uint_t   gCompleted;
+static std::string    gReceived;
+
+class UringTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        int         fds[2];
+        hcore_int_t rc;
+
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+
+        fLoop = hcore_create_event_loop(fPool, 0);
+        ASSERT_TRUE(fLoop);
+
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+        fConn = hcore_create_connection(&fLog, fds[0]);
+        ASSERT_TRUE(fConn);
+        fPeer = fds[1];
+
+        rc = hcore_event_use_uring(fLoop, 0);
+        if (rc == HCORE_DECLINED) GTEST_SKIP() << "io_uring isn't available";
+
+        ASSERT_EQ(rc, HCORE_OK);
+        fRing = fLoop->uring;
+        gRing = fRing;
+    }
+
+    void
+    TearDown() override
+    {
+        if (fRing) hcore_uring_cancel(fRing, fConn);
+        hcore_destroy_connection(fConn);
+        close(fPeer);
+        hcore_destroy_event_loop(fLoop);
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    void
+    runUntil(hcore_uint_t *counter, hcore_uint_t n)
+    {
+        for (int i = 0; *counter < n && i < 100; i++)
+        {
+            ASSERT_EQ(hcore_event_process(fLoop, 100), HCORE_OK);
+        }
+    }
+
+    hcore_log_t         fLog;
+    hcore_pool_t       *fPool;
+    hcore_event_loop_t *fLoop;
+    hcore_uring_t      *fRing = NULL;
+    hcore_connection_t *fConn;
+    int                 fPeer;
+};
+
+static void
+completeHandler(hcore_event_t *ev)
+{
+    gCompleted++;
+}
+
+static void
+multishotHandler(hcore_event_t *ev)
+{
+    gCompleted++;
+
+    if (ev->buffer)
+    {
+        gReceived.append((char *)hcore_uring_buffer(gRing, ev->buf_id),
+                         ev->result);
+    }
+}
+
+TEST_F(UringTest, recvAndSend)
+{
+    char           buf[64];
+    hcore_buf_t   *b, *b1, *b2;
+    hcore_chain_t  cl1, cl2;
+
+    gCompleted = 0;
+
+    fConn->rev->handler = completeHandler;
+    fConn->wev->handler = completeHandler;
+
+    // send a chain by one sendmsg
+
+    b1 = hcore_alloc_buf(fPool, 16);
+    b2 = hcore_alloc_buf(fPool, 16);
+    b1->last = hcore_cpymem(b1->last, "hello ", 6);
+    b2->last = hcore_cpymem(b2->last, "world", 5);
+
+    cl1.buf  = b1;
+    cl1.next = &cl2;
+    cl2.buf  = b2;
+    cl2.next = NULL;
+
+    ASSERT_EQ(hcore_uring_send_chain(fRing, fConn, &cl1), HCORE_OK);
+    EXPECT_TRUE(fConn->wev->op);
+
+    runUntil(&gCompleted, 1);
+    ASSERT_EQ(gCompleted, 1u);
+
+    EXPECT_FALSE(fConn->wev->op);
+    EXPECT_EQ(fConn->wev->result, 11);
+    EXPECT_EQ(fConn->sent_size, 11);
+    EXPECT_EQ(hcore_buf_get_size(b1), 0);
+    EXPECT_EQ(hcore_buf_get_size(b2), 0);
+    EXPECT_EQ(hcore_uring_send_chain(fRing, fConn, &cl1), HCORE_DONE);
+
+    ASSERT_EQ(read(fPeer, buf, sizeof(buf)), 11);
+    EXPECT_EQ(std::string(buf, 11), "hello world");
+
+    // recv is completed after peer writes
+
+    b = hcore_alloc_buf(fPool, 64);
+
+    ASSERT_EQ(hcore_uring_recv(fRing, fConn, b), HCORE_OK);
+    ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    EXPECT_EQ(gCompleted, 1u);
+
+    ASSERT_EQ(write(fPeer, "ping", 4), 4);
+
+    runUntil(&gCompleted, 2);
+    ASSERT_EQ(gCompleted, 2u);
+
+    EXPECT_EQ(fConn->rev->result, 4);
+    EXPECT_EQ(std::string((char *)b->pos, hcore_buf_get_size(b)), "ping");
+
+    // eof
+
+    ASSERT_EQ(hcore_uring_recv(fRing, fConn, b), HCORE_OK);
+    shutdown(fPeer, SHUT_WR);
+
+    runUntil(&gCompleted, 3);
+    ASSERT_EQ(gCompleted, 3u);
+
+    EXPECT_EQ(fConn->rev->result, 0);
+    EXPECT_TRUE(fConn->rev->eof);
+}
+
+TEST_F(UringTest, multishot)
+{
+    hcore_int_t rc;
+
+    gCompleted = 0;
+    gReceived.clear();
+
+    rc = hcore_uring_setup_buffers(fRing, 4, 8);
+    if (rc == HCORE_DECLINED) GTEST_SKIP() << "provided buffers unsupported";
+    ASSERT_EQ(rc, HCORE_OK);
+
+    fConn->rev->handler = multishotHandler;
+
+    ASSERT_EQ(hcore_uring_recv_multishot(fRing, fConn), HCORE_OK);
+
+    // one operation is completed many times, the buffers are reused
+
+    for (int i = 0; i < 10; i++)
+    {
+        hcore_uint_t n = gCompleted;
+
+        ASSERT_EQ(write(fPeer, "0123456789abcdef", 16), 16);
+
+        while (gReceived.size() < (size_t)(i + 1) * 16 && gCompleted < n + 10)
+        {
+            ASSERT_EQ(hcore_event_process(fLoop, 100), HCORE_OK);
+        }
+
+        ASSERT_TRUE(fConn->rev->op);
+    }
+
+    ASSERT_EQ(gReceived.size(), 160u);
+    EXPECT_EQ(gReceived.substr(0, 16), "0123456789abcdef");
+    EXPECT_EQ(fConn->recv_size, 160);
+
+    // it's finished by eof
+
+    shutdown(fPeer, SHUT_WR);
+
+    for (int i = 0; !fConn->rev->eof && i < 100; i++)
+    {
+        ASSERT_EQ(hcore_event_process(fLoop, 100), HCORE_OK);
+    }
+
+    EXPECT_TRUE(fConn->rev->eof);
+    EXPECT_FALSE(fConn->rev->op);
+}
+
+TEST_F(UringTest, cancel)
+{
+    hcore_buf_t *b;
+
+    gCompleted = 0;
+
+    fConn->rev->handler = completeHandler;
+
+    b = hcore_alloc_buf(fPool, 64);
+
+    ASSERT_EQ(hcore_uring_recv(fRing, fConn, b), HCORE_OK);
+    ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+
+    // the handler isn't called after cancellation
+
+    ASSERT_EQ(hcore_uring_cancel(fRing, fConn), HCORE_OK);
+    EXPECT_FALSE(fConn->rev->op);
+
+    ASSERT_EQ(write(fPeer, "ping", 4), 4);
+
+    for (int i = 0; i < 5; i++)
+    {
+        ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    }
+
+    EXPECT_EQ(gCompleted, 0u);
+    EXPECT_EQ(hcore_buf_get_size(b), 0);
+
+    // all operations are given back
+
+    hcore_uint_t     nfree = 0;
+    hcore_uring_op_t *op;
+
+    for (op = fRing->free; op; op = op->next) nfree++;
+
+    EXPECT_EQ(nfree, (hcore_uint_t)fRing->cq_entries);
+}
+
+/*
+ * Request/response over many connections: with epoll each request costs a
+ * recv() and a send() besides the shared epoll_wait(), with io_uring the
+ * operations of all connections are submitted by one io_uring_enter().
+ */
+
+#define BENCH_CONNS  64
+#define BENCH_ROUNDS 2000
+
+static hcore_uint_t gResponses;
+
+static void
+benchRecvHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c  = (hcore_connection_t *)ev->data;
+    hcore_chain_t      *cl = (hcore_chain_t *)c->data;
+
+    hcore_uring_send_chain(gRing, c, cl);
+}
+
+static void
+benchSendHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c  = (hcore_connection_t *)ev->data;
+    hcore_chain_t      *cl = (hcore_chain_t *)c->data;
+
+    gResponses++;
+
+    cl->buf->pos  = cl->buf->start;
+    cl->buf->last = cl->buf->start;
+
+    hcore_uring_recv(gRing, c, cl->buf);
+}
+
+static void
+benchEpollHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c = (hcore_connection_t *)ev->data;
+    hcore_uchar_t       buf[64];
+    ssize_t             n;
+
+    while ((n = hcore_tcp_recv(c, buf, sizeof(buf))) > 0)
+    {
+        hcore_tcp_send(c, buf, n);
+        gResponses++;
+    }
+}
+
+static double
+runBenchmark(hcore_event_loop_t *loop, std::vector<int> &peers,
+             hcore_uint_t *syscalls, hcore_uint_t extra)
+{
+    char buf[64];
+    auto start = std::chrono::steady_clock::now();
+
+    gResponses = 0;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        hcore_uint_t expected = (r + 1) * BENCH_CONNS;
+
+        for (int fd : peers) EXPECT_EQ(write(fd, "request", 7), 7);
+
+        while (gResponses < expected)
+        {
+            hcore_event_process(loop, 100);
+            (*syscalls)++; // epoll_wait()
+        }
+
+        *syscalls += extra;
+
+        for (int fd : peers) EXPECT_EQ(read(fd, buf, sizeof(buf)), 7);
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start)
+        .count();
+}
+
+TEST_F(UringTest, DISABLED_batchBenchmark)
+{
+    std::vector<int>                 peers;
+    std::vector<hcore_connection_t *> conns;
+    hcore_uint_t                     syscalls;
+    double                           t;
+
+    // epoll: recv() + recv() of EAGAIN + send() per request
+
+    for (int i = 0; i < BENCH_CONNS; i++)
+    {
+        int fds[2];
+
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+        hcore_connection_t *c = hcore_create_connection(&fLog, fds[0]);
+        c->rev->handler       = benchEpollHandler;
+        c->wev->ready         = 1;
+        ASSERT_EQ(hcore_event_add(fLoop, c->rev, HCORE_EVENT_READ, 0),
+                  HCORE_OK);
+
+        conns.push_back(c);
+        peers.push_back(fds[1]);
+    }
+
+    syscalls = 0;
+    t = runBenchmark(fLoop, peers, &syscalls, 3 * BENCH_CONNS);
+
+    printf("epoll   : %.0f req/s, %.2f syscalls/req\n",
+           BENCH_ROUNDS * BENCH_CONNS / t,
+           (double)syscalls / (BENCH_ROUNDS * BENCH_CONNS));
+
+    for (hcore_connection_t *c : conns)
+    {
+        hcore_event_del(fLoop, c->rev, HCORE_EVENT_READ, HCORE_CLOSE_EVENT);
+        hcore_destroy_connection(c);
+    }
+
+    for (int fd : peers) close(fd);
+
+    conns.clear();
+    peers.clear();
+
+    // io_uring: recv and send are operations, one io_uring_enter() per loop
+
+    for (int i = 0; i < BENCH_CONNS; i++)
+    {
+        int fds[2];
+
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+        hcore_connection_t *c  = hcore_create_connection(&fLog, fds[0]);
+        hcore_chain_t      *cl = hcore_alloc_chain(c->pool);
+
+        cl->buf  = hcore_alloc_buf(c->pool, 64);
+        cl->next = NULL;
+
+        c->data         = cl;
+        c->rev->handler = benchRecvHandler;
+        c->wev->handler = benchSendHandler;
+
+        ASSERT_EQ(hcore_uring_recv(fRing, c, cl->buf), HCORE_OK);
+
+        conns.push_back(c);
+        peers.push_back(fds[1]);
+    }
+
+    syscalls = 0;
+    fRing->nenters = 0;
+    t = runBenchmark(fLoop, peers, &syscalls, 0);
+    syscalls += fRing->nenters;
+
+    printf("io_uring: %.0f req/s, %.2f syscalls/req, %.1f sqes/enter\n",
+           BENCH_ROUNDS * BENCH_CONNS / t,
+           (double)syscalls / (BENCH_ROUNDS * BENCH_CONNS),
+           (double)fRing->nsqes / fRing->nenters);
+
+    for (hcore_connection_t *c : conns)
+    {
+        hcore_uring_cancel(fRing, c);
+        hcore_destroy_connection(c);
+    }
+
+    for (int fd : peers) close(fd);
+}
@@ -0,0 +1,369 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_event.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+#include <hcore_reactor.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+class ReactorTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t   fLog;
+    hcore_pool_t *fPool;
+};
+
+typedef struct
+{
+    hcore_task_t          task;
+    pthread_t             tid;      // thread which ran the task
+    hcore_uint_t          seq;      // order of posting
+    std::atomic<int>     *done;
+} testTask;
+
+static void
+recordHandler(hcore_worker_t *wk, hcore_task_t *task)
+{
+    testTask *t = (testTask *)task->data;
+
+    t->tid = pthread_self();
+    t->seq = wk->ntasks;
+    t->done->fetch_add(1);
+}
+
+TEST_F(ReactorTest, post)
+{
+    hcore_reactor_t      *r;
+    std::atomic<int>      done(0);
+    std::vector<testTask> tasks(2000);
+
+    r = hcore_create_reactor(fPool, 2);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(r->nworkers, 2u);
+    ASSERT_EQ(hcore_start_reactor(r), HCORE_OK);
+
+    // post from two threads to both workers
+
+    auto producer = [&](size_t from) {
+        for (size_t i = from; i < tasks.size(); i += 2)
+        {
+            tasks[i].task.handler = recordHandler;
+            tasks[i].task.data    = &tasks[i];
+            tasks[i].done         = &done;
+
+            EXPECT_EQ(hcore_worker_post(&r->workers[(i / 2) % 2],
+                                        &tasks[i].task),
+                      HCORE_OK);
+        }
+    };
+
+    std::thread p1(producer, 0), p2(producer, 1);
+
+    p1.join();
+    p2.join();
+
+    for (int i = 0; done.load() < (int)tasks.size() && i < 500; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    ASSERT_EQ(done.load(), (int)tasks.size());
+
+    // the tasks are run by their worker in the order of each producer
+
+    hcore_uint_t last[2][2] = {{0, 0}, {0, 0}};
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        hcore_uint_t w = (i / 2) % 2;
+
+        EXPECT_TRUE(pthread_equal(tasks[i].tid, r->workers[w].tid));
+        EXPECT_GT(tasks[i].seq, last[w][i % 2]);
+
+        last[w][i % 2] = tasks[i].seq;
+    }
+
+    EXPECT_EQ(r->workers[0].ntasks + r->workers[1].ntasks, tasks.size());
+    EXPECT_LE(r->workers[0].nwakeup, r->workers[0].ntasks);
+
+    hcore_stop_reactor(r);
+
+    EXPECT_FALSE(r->running);
+    EXPECT_FALSE(r->workers[0].loop);
+}
+
+/* echo server, the connection is handled by the worker accepted it */
+
+static void
+echoClose(hcore_connection_t *c)
+{
+    hcore_worker_t *wk = (hcore_worker_t *)c->listening->data;
+
+    hcore_event_del(wk->loop, c->rev, HCORE_EVENT_READ, HCORE_CLOSE_EVENT);
+    hcore_put_connection(wk->table, c);
+}
+
+static void
+echoReadHandler(hcore_event_t *ev)
+{
+    hcore_connection_t *c = (hcore_connection_t *)ev->data;
+    hcore_uchar_t       buf[4096];
+    ssize_t             n;
+
+    for (;;)
+    {
+        n = hcore_tcp_recv(c, buf, sizeof(buf));
+
+        if (n == HCORE_AGAIN) return;
+
+        if (n <= 0)
+        {
+            echoClose(c);
+            return;
+        }
+
+        if (hcore_tcp_send(c, buf, n) != n)
+        {
+            echoClose(c);
+            return;
+        }
+    }
+}
+
+static void
+echoHandler(hcore_connection_t *c)
+{
+    hcore_worker_t *wk = (hcore_worker_t *)c->listening->data;
+
+    c->rev->handler = echoReadHandler;
+    c->wev->ready   = 1;
+
+    if (hcore_event_add(wk->loop, c->rev, HCORE_EVENT_READ, 0) != HCORE_OK)
+    {
+        hcore_put_connection(wk->table, c);
+    }
+}
+
+static void
+usedHandler(hcore_worker_t *wk, hcore_task_t *task)
+{
+    std::atomic<int> *used = (std::atomic<int> *)task->data;
+
+    used->store((int)hcore_connection_table_used(wk->table));
+}
+
+// the table is only touched by its worker, so ask the worker for it
+static int
+tableUsed(hcore_worker_t *wk)
+{
+    std::atomic<int> used(-1);
+    hcore_task_t     task;
+
+    task.handler = usedHandler;
+    task.data    = &used;
+
+    if (hcore_worker_post(wk, &task) != HCORE_OK) return -1;
+
+    while (used.load() == -1) std::this_thread::yield();
+
+    return used.load();
+}
+
+static hcore_reactor_t *
+startEcho(hcore_pool_t *pool, hcore_uint_t n)
+{
+    struct sockaddr_in sin;
+    hcore_reactor_t   *r;
+
+    r = hcore_create_reactor(pool, n);
+    if (r == NULL) return NULL;
+
+    hcore_memzero(&sin, sizeof(sin));
+    sin.sin_family      = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    r->connections = 256;
+    r->handler     = echoHandler;
+    r->affinity    = 1;
+
+    if (hcore_reactor_listen(r, (struct sockaddr *)&sin, sizeof(sin))
+            != HCORE_OK
+        || hcore_start_reactor(r) != HCORE_OK)
+    {
+        return NULL;
+    }
+
+    return r;
+}
+
+static int
+connectEcho(hcore_reactor_t *r)
+{
+    int fd, on;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+
+    on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(fd, &r->sockaddr.sockaddr, r->socklen) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+TEST_F(ReactorTest, echo)
+{
+    hcore_reactor_t *r;
+    hcore_uint_t     naccepted;
+    char             buf[16];
+    std::vector<int> fds;
+
+    r = startEcho(fPool, 2);
+    ASSERT_TRUE(r);
+
+    // the port of first worker is shared by all workers
+
+    EXPECT_NE(((struct sockaddr_in *)&r->sockaddr)->sin_port, 0);
+    EXPECT_EQ(r->workers[0].listening->sockaddr.sockaddr_in.sin_port,
+              r->workers[1].listening->sockaddr.sockaddr_in.sin_port);
+
+    for (int i = 0; i < 32; i++)
+    {
+        int fd = connectEcho(r);
+        ASSERT_NE(fd, -1);
+
+        ASSERT_EQ(write(fd, "hello", 5), 5);
+        ASSERT_EQ(read(fd, buf, sizeof(buf)), 5);
+        EXPECT_EQ(memcmp(buf, "hello", 5), 0);
+
+        fds.push_back(fd);
+    }
+
+    naccepted = 0;
+
+    for (hcore_uint_t i = 0; i < r->nworkers; i++)
+    {
+        naccepted += r->workers[i].listening->naccepted;
+    }
+
+    EXPECT_EQ(naccepted, 32u);
+
+    for (int fd : fds) close(fd);
+
+    // the connections are closed by workers
+
+    for (int i = 0; i < 100; i++)
+    {
+        if (tableUsed(&r->workers[0]) == 0 && tableUsed(&r->workers[1]) == 0)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(tableUsed(&r->workers[0]), 0);
+    EXPECT_EQ(tableUsed(&r->workers[1]), 0);
+
+    hcore_stop_reactor(r);
+}
+
+/*
+ * Each worker has a client thread with 16 connections doing ping-pong, the
+ * throughput should grow with the number of workers until the cores are
+ * used up.
+ */
+
+TEST_F(ReactorTest, DISABLED_echoBenchmark)
+{
+    const int  nconns   = 16;
+    const auto duration = std::chrono::seconds(2);
+
+    for (hcore_uint_t n = 1; n <= 8; n *= 2)
+    {
+        hcore_reactor_t          *r = startEcho(fPool, n);
+        std::atomic<long>         total(0);
+        std::vector<std::thread>  clients;
+
+        ASSERT_TRUE(r);
+
+        for (hcore_uint_t i = 0; i < n; i++)
+        {
+            clients.emplace_back([&]() {
+                std::vector<int> fds;
+                char             buf[64];
+                long             count = 0;
+
+                for (int k = 0; k < nconns; k++)
+                {
+                    fds.push_back(connectEcho(r));
+                }
+
+                auto end = std::chrono::steady_clock::now() + duration;
+
+                while (std::chrono::steady_clock::now() < end)
+                {
+                    for (int fd : fds)
+                    {
+                        if (write(fd, buf, sizeof(buf)) != sizeof(buf)) break;
+                    }
+
+                    for (int fd : fds)
+                    {
+                        if (read(fd, buf, sizeof(buf)) <= 0) break;
+                        count++;
+                    }
+                }
+
+                for (int fd : fds) close(fd);
+
+                total += count;
+            });
+        }
+
+        for (auto &t : clients) t.join();
+
+        printf("workers: %u, %.0f req/s\n", (unsigned)n,
+               total.load() / std::chrono::duration<double>(duration).count());
+
+        // wait for workers to close connections
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        hcore_stop_reactor(r);
+    }
+}
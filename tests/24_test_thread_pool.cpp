@@ -0,0 +1,302 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_event.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+#include <hcore_thread_pool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+class ThreadPoolTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+
+        fLoop = hcore_create_event_loop(fPool, 0);
+        ASSERT_TRUE(fLoop);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_event_loop(fLoop);
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t         fLog;
+    hcore_pool_t       *fPool;
+    hcore_event_loop_t *fLoop;
+};
+
+typedef struct
+{
+    hcore_thread_task_t task;
+    hcore_uint_t        input;
+    hcore_uint_t        output;
+    pthread_t           tid;
+} poolTask;
+
+static hcore_uint_t gCompleted;
+static pthread_t    gLoopThread;
+
+static void
+squareHandler(hcore_thread_task_t *task)
+{
+    poolTask *t = (poolTask *)task->ctx;
+
+    t->output = t->input * t->input;
+    t->tid    = pthread_self();
+}
+
+static void
+sleepHandler(hcore_thread_task_t *task)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static void
+completeHandler(hcore_event_t *ev)
+{
+    poolTask *t = (poolTask *)ev->data;
+
+    // the completion is handled in the thread of loop
+    EXPECT_TRUE(pthread_equal(pthread_self(), gLoopThread));
+    EXPECT_EQ(t->output, t->input * t->input);
+
+    gCompleted++;
+}
+
+TEST_F(ThreadPoolTest, postAndNotify)
+{
+    hcore_thread_pool_t     *tp;
+    hcore_thread_notify_t   *notify;
+    hcore_thread_pool_stat_t stat;
+    std::vector<poolTask>    tasks(1000);
+
+    tp = hcore_create_thread_pool(fPool, 4, 64);
+    ASSERT_TRUE(tp);
+
+    notify = hcore_create_thread_notify(fLoop);
+    ASSERT_TRUE(notify);
+
+    gCompleted  = 0;
+    gLoopThread = pthread_self();
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        tasks[i].input              = i;
+        tasks[i].task.handler       = squareHandler;
+        tasks[i].task.ctx           = &tasks[i];
+        tasks[i].task.event.handler = completeHandler;
+        tasks[i].task.event.data    = &tasks[i];
+
+        ASSERT_EQ(hcore_thread_pool_post(tp, &tasks[i].task, notify),
+                  HCORE_OK);
+    }
+
+    // the completions are handled by the loop
+
+    for (int i = 0; gCompleted < tasks.size() && i < 500; i++)
+    {
+        ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    }
+
+    ASSERT_EQ(gCompleted, tasks.size());
+    EXPECT_EQ(notify->ncompleted, tasks.size());
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        EXPECT_EQ(tasks[i].output, i * i);
+        EXPECT_FALSE(pthread_equal(tasks[i].tid, pthread_self()));
+    }
+
+    hcore_thread_pool_stat(tp, &stat);
+
+    EXPECT_EQ(stat.nposted, tasks.size());
+    EXPECT_EQ(stat.depth, 0u);
+    EXPECT_GE(stat.wait_max, stat.wait_avg);
+
+    hcore_destroy_thread_pool(tp);
+    hcore_destroy_thread_notify(notify);
+
+    // it's refused after destroying
+
+    EXPECT_EQ(hcore_thread_pool_post(tp, &tasks[0].task, NULL), HCORE_ERROR);
+}
+
+TEST_F(ThreadPoolTest, steal)
+{
+    hcore_thread_pool_t     *tp;
+    hcore_thread_pool_stat_t stat;
+    std::vector<poolTask>    tasks(64);
+
+    tp = hcore_create_thread_pool(fPool, 4, 0);
+    ASSERT_TRUE(tp);
+
+    // a batch is taken by one thread, the others steal from it
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        tasks[i].task.handler = sleepHandler;
+
+        ASSERT_EQ(hcore_thread_pool_post(tp, &tasks[i].task, NULL), HCORE_OK);
+    }
+
+    // the posted tasks are finished before destroying returns
+
+    hcore_destroy_thread_pool(tp);
+
+    hcore_thread_pool_stat(tp, &stat);
+
+    EXPECT_EQ(stat.depth, 0u);
+    EXPECT_GT(stat.nsteals, 0u);
+}
+
+/*
+ * Dispatch overhead of empty tasks, compared with a queue protected by one
+ * mutex and condition variable.
+ */
+
+#define BENCH_TASKS   1000000
+#define BENCH_THREADS 4
+
+static void
+emptyHandler(hcore_thread_task_t *task)
+{
+}
+
+class MutexQueue {
+  public:
+    explicit MutexQueue(int n)
+    {
+        pthread_mutex_init(&fMutex, NULL);
+        pthread_cond_init(&fCond, NULL);
+
+        for (int i = 0; i < n; i++)
+        {
+            fThreads.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~MutexQueue()
+    {
+        pthread_mutex_lock(&fMutex);
+        fQuit = true;
+        pthread_cond_broadcast(&fCond);
+        pthread_mutex_unlock(&fMutex);
+
+        for (auto &t : fThreads) t.join();
+
+        pthread_cond_destroy(&fCond);
+        pthread_mutex_destroy(&fMutex);
+    }
+
+    void
+    post(hcore_thread_task_t *task)
+    {
+        pthread_mutex_lock(&fMutex);
+        fQueue.push_back(task);
+        pthread_cond_signal(&fCond);
+        pthread_mutex_unlock(&fMutex);
+    }
+
+    std::atomic<long> fDone{0};
+
+  private:
+    void
+    run()
+    {
+        for (;;)
+        {
+            hcore_thread_task_t *task;
+
+            pthread_mutex_lock(&fMutex);
+
+            while (!fQuit && fQueue.empty())
+            {
+                pthread_cond_wait(&fCond, &fMutex);
+            }
+
+            if (fQueue.empty())
+            {
+                pthread_mutex_unlock(&fMutex);
+                return;
+            }
+
+            task = fQueue.front();
+            fQueue.pop_front();
+
+            pthread_mutex_unlock(&fMutex);
+
+            task->handler(task);
+            fDone++;
+        }
+    }
+
+    pthread_mutex_t                   fMutex;
+    pthread_cond_t                    fCond;
+    std::deque<hcore_thread_task_t *> fQueue;
+    std::vector<std::thread>          fThreads;
+    bool                              fQuit = false;
+};
+
+TEST_F(ThreadPoolTest, DISABLED_dispatchBenchmark)
+{
+    std::vector<hcore_thread_task_t> tasks(BENCH_TASKS);
+    hcore_thread_pool_stat_t         stat;
+
+    for (auto &t : tasks) t.handler = emptyHandler;
+
+    {
+        MutexQueue q(BENCH_THREADS);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (auto &t : tasks) q.post(&t);
+
+        while (q.fDone.load() < BENCH_TASKS) std::this_thread::yield();
+
+        double t = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+        printf("mutex queue   : %.0f ns/task\n", t * 1e9 / BENCH_TASKS);
+    }
+
+    hcore_thread_pool_t *tp = hcore_create_thread_pool(fPool, BENCH_THREADS, 0);
+    ASSERT_TRUE(tp);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto &t : tasks) hcore_thread_pool_post(tp, &t, NULL);
+
+    do
+    {
+        std::this_thread::yield();
+        hcore_thread_pool_stat(tp, &stat);
+    } while (stat.depth);
+
+    double t =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    printf("work stealing : %.0f ns/task, %u steals, wait avg %lu ns\n",
+           t * 1e9 / BENCH_TASKS, (unsigned)stat.nsteals,
+           (unsigned long)stat.wait_avg);
+
+    hcore_destroy_thread_pool(tp);
+}
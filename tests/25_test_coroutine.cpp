@@ -0,0 +1,334 @@
+extern "C"
+{
+#include <hcore_base.h>
+#include <hcore_connection.h>
+#include <hcore_coroutine.h>
+#include <hcore_event.h>
+#include <hcore_log.h>
+#include <hcore_pool.h>
+}
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include <sys/socket.h>
+
+class CoroutineTest : public ::testing::Test {
+  protected:
+    void
+    SetUp() override
+    {
+        hcore_open_log(&fLog, HCORE_LOG_FILE_STDOUT, HCORE_LOG_ERR);
+
+        fPool = hcore_create_pool(HCORE_POOL_SIZE_DEFAULT, &fLog);
+        ASSERT_TRUE(fPool);
+
+        fLoop = hcore_create_event_loop(fPool, 0);
+        ASSERT_TRUE(fLoop);
+
+        fSched = hcore_create_co_sched(fLoop, 0, 0);
+        ASSERT_TRUE(fSched);
+    }
+
+    void
+    TearDown() override
+    {
+        hcore_destroy_co_sched(fSched);
+        hcore_destroy_event_loop(fLoop);
+        hcore_destroy_pool(fPool);
+        hcore_destroy_log(&fLog);
+    }
+
+    hcore_log_t         fLog;
+    hcore_pool_t       *fPool;
+    hcore_event_loop_t *fLoop;
+    hcore_co_sched_t   *fSched;
+};
+
+static void
+countHandler(hcore_co_t *co)
+{
+    int *n = (int *)co->data;
+
+    for (int i = 0; i < 3; i++)
+    {
+        (*n)++;
+        hcore_co_yield();
+    }
+}
+
+static void
+nestedHandler(hcore_co_t *co)
+{
+    int        *n = (int *)co->data;
+    hcore_co_t *child;
+
+    // the child yields back to its parent
+
+    child = hcore_co_spawn(co->sched, countHandler, n);
+
+    EXPECT_EQ(hcore_co_self(), co);
+
+    hcore_co_resume(child);
+
+    (*n) += 10;
+}
+
+TEST_F(CoroutineTest, switch)
+{
+    hcore_co_t *co, *again;
+    int         n = 0;
+
+    EXPECT_FALSE(hcore_co_self());
+
+    co = hcore_co_spawn(fSched, countHandler, &n);
+    ASSERT_TRUE(co);
+
+    // it runs until the first yield
+
+    EXPECT_EQ(n, 1);
+    EXPECT_FALSE(hcore_co_self());
+    EXPECT_EQ(fSched->ncos, 1u);
+
+    hcore_co_resume(co);
+    hcore_co_resume(co);
+    EXPECT_EQ(n, 3);
+
+    hcore_co_resume(co);
+    EXPECT_TRUE(co->done);
+    EXPECT_EQ(fSched->ncos, 0u);
+
+    // the stack is reused
+
+    again = hcore_co_spawn(fSched, countHandler, &n);
+    EXPECT_EQ(again, co);
+    EXPECT_EQ(fSched->nstacks, (hcore_uint_t)HCORE_CO_SLAB_SIZE);
+
+    while (!again->done) hcore_co_resume(again);
+
+    // a coroutine is spawned in another one
+
+    n  = 0;
+    co = hcore_co_spawn(fSched, nestedHandler, &n);
+
+    EXPECT_EQ(n, 12);
+    EXPECT_TRUE(co->done);
+    EXPECT_EQ(fSched->ncos, 1u);
+}
+
+TEST_F(CoroutineTest, limit)
+{
+    int n = 0;
+
+    fSched->max = 2;
+
+    EXPECT_TRUE(hcore_co_spawn(fSched, countHandler, &n));
+    EXPECT_TRUE(hcore_co_spawn(fSched, countHandler, &n));
+    EXPECT_FALSE(hcore_co_spawn(fSched, countHandler, &n));
+}
+
+static void
+overflow(volatile char *prev, int depth)
+{
+    volatile char buf[1024];
+
+    buf[0] = prev ? prev[0] : 0;
+
+    if (depth > 0) overflow(buf, depth - 1);
+}
+
+static void
+overflowHandler(hcore_co_t *co)
+{
+    // 1GB of frames is far beyond the stack of coroutine
+
+    overflow(NULL, 1024 * 1024);
+}
+
+TEST_F(CoroutineTest, guard)
+{
+    // the overflow of stack hits the guard page
+
+    ASSERT_DEATH(hcore_co_spawn(fSched, overflowHandler, NULL), "");
+}
+
+/* echo by a coroutine with sequential I/O */
+
+static void
+echoHandler(hcore_co_t *co)
+{
+    hcore_connection_t *c = (hcore_connection_t *)co->data;
+    hcore_uchar_t       buf[64];
+    ssize_t             n;
+
+    for (;;)
+    {
+        n = hcore_co_recv(c, buf, sizeof(buf));
+        if (n <= 0) break;
+
+        if (hcore_co_send(c, buf, n) != n) break;
+    }
+
+    hcore_event_del_conn(co->sched->loop, c, HCORE_CLOSE_EVENT);
+}
+
+TEST_F(CoroutineTest, echo)
+{
+    hcore_connection_t *c;
+    hcore_co_t         *co;
+    int                 fds[2];
+    char                buf[64];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    c = hcore_create_connection(&fLog, fds[0]);
+    ASSERT_TRUE(c);
+
+    co = hcore_co_spawn(fSched, echoHandler, c);
+    ASSERT_TRUE(co);
+    ASSERT_FALSE(co->done);
+
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(write(fds[1], "hello", 5), 5);
+
+        ssize_t n = -1;
+
+        for (int k = 0; k < 100 && n == -1; k++)
+        {
+            ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+            n = read(fds[1], buf, sizeof(buf));
+        }
+
+        ASSERT_EQ(n, 5);
+        EXPECT_EQ(memcmp(buf, "hello", 5), 0);
+    }
+
+    // the coroutine finishes when peer is closed
+
+    close(fds[1]);
+
+    for (int k = 0; k < 100 && !co->done; k++)
+    {
+        ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    }
+
+    EXPECT_TRUE(co->done);
+    EXPECT_EQ(fSched->ncos, 0u);
+
+    hcore_destroy_connection(c);
+}
+
+static void
+timeoutHandler(hcore_co_t *co)
+{
+    hcore_connection_t *c = (hcore_connection_t *)co->data;
+    hcore_uchar_t       buf[16];
+
+    co->timeout = 20;
+
+    EXPECT_EQ(hcore_co_recv(c, buf, sizeof(buf)), HCORE_ERROR);
+    EXPECT_TRUE(c->timeout);
+
+    hcore_event_del_conn(co->sched->loop, c, HCORE_CLOSE_EVENT);
+}
+
+TEST_F(CoroutineTest, timeout)
+{
+    hcore_connection_t *c;
+    hcore_co_t         *co;
+    int                 fds[2];
+
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+
+    c = hcore_create_connection(&fLog, fds[0]);
+    ASSERT_TRUE(c);
+
+    co = hcore_co_spawn(fSched, timeoutHandler, c);
+    ASSERT_TRUE(co);
+
+    for (int k = 0; k < 100 && !co->done; k++)
+    {
+        ASSERT_EQ(hcore_event_process(fLoop, 10), HCORE_OK);
+    }
+
+    EXPECT_TRUE(co->done);
+
+    hcore_destroy_connection(c);
+    close(fds[1]);
+}
+
+/*
+ * 1. cost of a pair of resume and yield
+ * 2. memory of 100k suspended coroutines
+ */
+
+#define BENCH_SWITCHES 10000000
+#define BENCH_COS      100000
+
+static void
+yieldHandler(hcore_co_t *co)
+{
+    for (;;) hcore_co_yield();
+}
+
+static long
+rssKB()
+{
+    long  size, rss;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if (fp == NULL) return 0;
+
+    if (fscanf(fp, "%ld %ld", &size, &rss) != 2) rss = 0;
+
+    fclose(fp);
+
+    return rss * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+TEST_F(CoroutineTest, DISABLED_switchBenchmark)
+{
+    hcore_co_t *co;
+
+    co = hcore_co_spawn(fSched, yieldHandler, NULL);
+    ASSERT_TRUE(co);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCH_SWITCHES; i++) hcore_co_resume(co);
+
+    double t =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    printf("resume + yield: %.1f ns\n", t * 1e9 / BENCH_SWITCHES);
+
+    // a guard page costs two entries of 'vm.max_map_count'
+
+    hcore_destroy_co_sched(fSched);
+
+    fSched = hcore_create_co_sched(fLoop, 16 * 1024, BENCH_COS);
+    ASSERT_TRUE(fSched);
+
+    fSched->guard = 0;
+
+    long rss = rssKB();
+
+    start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCH_COS; i++)
+    {
+        ASSERT_TRUE(hcore_co_spawn(fSched, yieldHandler, NULL));
+    }
+
+    t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    EXPECT_FALSE(hcore_co_spawn(fSched, yieldHandler, NULL));
+
+    printf("%d coroutines: spawn %.0f ns, %ld KB resident, %.1f KB each\n",
+           BENCH_COS, t * 1e9 / BENCH_COS, rssKB() - rss,
+           (double)(rssKB() - rss) / BENCH_COS);
+}